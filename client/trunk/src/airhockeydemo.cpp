@@ -1,5 +1,5 @@
 #include "airhockeydemo.h"
-#include "debug.h"
+#include "log.h"
 
 using namespace WiredMunk;
 
@@ -30,6 +30,7 @@ using namespace WiredMunk;
 AirHockeyDemo* app;
 int portNumber;
 char serverIP[16];
+const char* samplePrefix;
 
 static void drawCircle(cpFloat x, cpFloat y, cpFloat r, cpFloat a)
 {
@@ -232,6 +233,7 @@ void getCommandLineArgs(int argc, const char* argv[]) {
 	// Set defaults
 	portNumber = DEFAULT_PORT_NUMBER;
 	strcpy(serverIP, DEFAULT_SERVER_IP);
+	samplePrefix = NULL;
 	
 	// Get settings from command line
 	for (int i = 0; i < argc; ++i) {
@@ -239,8 +241,10 @@ void getCommandLineArgs(int argc, const char* argv[]) {
 			portNumber = atoi(argv[i + 1]);
 		} else if (strncmp(argv[i], "-s", 2) == 0) {
 			strcpy(serverIP, argv[i + 1]);
+		} else if (strncmp(argv[i], "-S", 2) == 0) {
+			samplePrefix = argv[i + 1];
 		} else if (strncmp(argv[i], "-h", 2) == 0) {
-			printf("Usage: %s [-s serverIP] [-p port]\n", argv[0]);
+			printf("Usage: %s [-s serverIP] [-p port] [-S sampleprefix]\n", argv[0]);
 			exit(0);
 		}
 	}
@@ -253,6 +257,8 @@ int main (int argc, const char* argv[]) {
 	// Create WiredMunk application
 	app = new AirHockeyDemo(serverIP, portNumber);
 	
+	if (samplePrefix != NULL) app->startSampling(samplePrefix);
+	
 	glutStuff(argc, argv);
 	
     return 0;
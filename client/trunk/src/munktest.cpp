@@ -1,5 +1,5 @@
 #include "munktest.h"
-#include "debug.h"
+#include "log.h"
 
 using namespace WiredMunk;
 
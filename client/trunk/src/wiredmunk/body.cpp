@@ -2,7 +2,7 @@
 #include "message.h"
 #include "socket.h"
 #include "wiredmunkapp.h"
-#include "debug.h"
+#include "log.h"
 
 using namespace WiredMunk;
 
@@ -216,5 +216,5 @@ void Body::sendObject() {
 	// Remember that the changes have been transmitted
 	setAltered(false);
 	
-	Debug::printf("Client transmitted body data\n");
+	LOG_DEBUG("Client transmitted body data\n");
 }
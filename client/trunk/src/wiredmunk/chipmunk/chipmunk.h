@@ -22,10 +22,51 @@
 #ifndef CHIPMUNK_HEADER
 #define CHIPMUNK_HEADER
 
+#include <stdlib.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 	
+// Define to time each phase of cpSpaceStep() and record the results in
+// cpSpace.stats.
+//#define CP_PROFILE_ENABLED
+
+// Define to count every allocation made by chipmunk in cpAllocationCount.
+// The count is not thread safe; it is intended for benchmarks.
+//#define CP_COUNT_ALLOCATIONS
+
+// Define to compile chipmunk's SIMD kernels as plain scalar code.
+//#define CP_NO_SIMD
+
+#ifdef CP_COUNT_ALLOCATIONS
+	extern unsigned long cpAllocationCount;
+	
+	void *cpCountedCalloc(size_t count, size_t size);
+	void *cpCountedMalloc(size_t size);
+	void *cpCountedRealloc(void *ptr, size_t size);
+	
+	#define cpcalloc cpCountedCalloc
+	#define cpmalloc cpCountedMalloc
+	#define cprealloc cpCountedRealloc
+#endif
+
+// Memory allocation functions used throughout chipmunk. Define any of these
+// before including chipmunk.h, or in the build settings, to route chipmunk's
+// allocations through other functions.
+#ifndef cpcalloc
+	#define cpcalloc calloc
+#endif
+#ifndef cpmalloc
+	#define cpmalloc malloc
+#endif
+#ifndef cprealloc
+	#define cprealloc realloc
+#endif
+#ifndef cpfree
+	#define cpfree free
+#endif
+	
 typedef double cpFloat;
 	
 static inline cpFloat
@@ -63,8 +104,11 @@ cpfclamp(cpFloat f, cpFloat min, cpFloat max){
 #include "cpBB.h"
 #include "cpBody.h"
 #include "cpArray.h"
+#include "cpBodyStore.h"
 #include "cpHashSet.h"
 #include "cpSpaceHash.h"
+#include "cpSweep.h"
+#include "cpBBTree.h"
 
 #include "cpShape.h"
 #include "cpPolyShape.h"
@@ -0,0 +1,499 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "chipmunk.h"
+
+#define DEFAULT_FATTEN 0.1
+#define DEFAULT_PREDICT 0.1
+
+static inline cpBB
+bbMerge(cpBB a, cpBB b)
+{
+	return cpBBNew(cpfmin(a.l, b.l), cpfmin(a.b, b.b), cpfmax(a.r, b.r), cpfmax(a.t, b.t));
+}
+
+// Half the perimeter of a box. Used to estimate the cost of queries.
+static inline cpFloat
+bbPerimeter(cpBB bb)
+{
+	return (bb.r - bb.l) + (bb.t - bb.b);
+}
+
+static cpBBTreeNode *
+getEmptyNode(cpBBTree *tree)
+{
+	cpBBTreeNode *node = tree->pooledNodes;
+	
+	// Make a new one if necessary.
+	if(node == NULL) return (cpBBTreeNode *)cpmalloc(sizeof(cpBBTreeNode));
+	
+	tree->pooledNodes = node->parent;
+	return node;
+}
+
+static void
+recycleNode(cpBBTree *tree, cpBBTreeNode *node)
+{
+	node->parent = tree->pooledNodes;
+	tree->pooledNodes = node;
+}
+
+// Equality function for the leaf set.
+static int
+leafSetEql(void *obj, void *elt)
+{
+	cpBBTreeNode *leaf = (cpBBTreeNode *)elt;
+	return (obj == leaf->obj);
+}
+
+// Transformation function for the leaf set.
+static void *
+leafSetTrans(void *obj, void *data)
+{
+	cpBBTreeNode *leaf = getEmptyNode((cpBBTree *)data);
+	leaf->obj = obj;
+	leaf->a = leaf->b = NULL;
+	leaf->height = 0;
+	
+	return leaf;
+}
+
+cpBBTree *
+cpBBTreeAlloc(void)
+{
+	return (cpBBTree *)cpcalloc(1, sizeof(cpBBTree));
+}
+
+cpBBTree *
+cpBBTreeInit(cpBBTree *tree, cpBBTreeBBFunc bbfunc)
+{
+	tree->fatten = DEFAULT_FATTEN;
+	tree->predict = DEFAULT_PREDICT;
+	tree->bbfunc = bbfunc;
+	tree->velocityfunc = NULL;
+	
+	tree->leaves = cpHashSetNew(0, &leafSetEql, &leafSetTrans);
+	
+	tree->root = NULL;
+	tree->pooledNodes = NULL;
+	
+	return tree;
+}
+
+cpBBTree *
+cpBBTreeNew(cpBBTreeBBFunc bbfunc)
+{
+	return cpBBTreeInit(cpBBTreeAlloc(), bbfunc);
+}
+
+static void
+freeNodes(cpBBTreeNode *node)
+{
+	if(node->obj == NULL){
+		freeNodes(node->a);
+		freeNodes(node->b);
+	}
+	
+	cpfree(node);
+}
+
+void
+cpBBTreeDestroy(cpBBTree *tree)
+{
+	// The leaves are freed along with the rest of the tree.
+	cpHashSetFree(tree->leaves);
+	if(tree->root) freeNodes(tree->root);
+	
+	cpBBTreeNode *node = tree->pooledNodes;
+	while(node){
+		cpBBTreeNode *next = node->parent;
+		cpfree(node);
+		node = next;
+	}
+}
+
+void
+cpBBTreeFree(cpBBTree *tree)
+{
+	if(!tree) return;
+	cpBBTreeDestroy(tree);
+	cpfree(tree);
+}
+
+// Point the parent of node at replacement instead.
+static inline void
+replaceChild(cpBBTree *tree, cpBBTreeNode *node, cpBBTreeNode *replacement)
+{
+	cpBBTreeNode *parent = node->parent;
+	replacement->parent = parent;
+	
+	if(parent == NULL){
+		tree->root = replacement;
+	} else if(parent->a == node){
+		parent->a = replacement;
+	} else {
+		parent->b = replacement;
+	}
+}
+
+static inline void
+refitNode(cpBBTreeNode *node)
+{
+	node->bb = bbMerge(node->a->bb, node->b->bb);
+	node->height = 1 + (node->a->height > node->b->height ? node->a->height : node->b->height);
+}
+
+// Rotate the taller child of node into its place if the children's heights
+// differ by more than one. Returns the node now at the top of the subtree.
+static cpBBTreeNode *
+balance(cpBBTree *tree, cpBBTreeNode *node)
+{
+	if(node->obj) return node;
+	
+	cpBBTreeNode *a = node->a;
+	cpBBTreeNode *b = node->b;
+	int difference = b->height - a->height;
+	
+	if(difference > 1){
+		// Move b up into node's place. node takes b's shorter child, and b
+		// keeps the taller one.
+		cpBBTreeNode *b1 = b->a;
+		cpBBTreeNode *b2 = b->b;
+		
+		replaceChild(tree, node, b);
+		b->a = node;
+		node->parent = b;
+		
+		if(b1->height > b2->height){
+			node->b = b2;
+			b2->parent = node;
+			b->b = b1;
+		} else {
+			node->b = b1;
+			b1->parent = node;
+			b->b = b2;
+		}
+		
+		refitNode(node);
+		refitNode(b);
+		return b;
+	} else if(difference < -1){
+		// The mirror image of the above.
+		cpBBTreeNode *a1 = a->a;
+		cpBBTreeNode *a2 = a->b;
+		
+		replaceChild(tree, node, a);
+		a->a = node;
+		node->parent = a;
+		
+		if(a1->height > a2->height){
+			node->a = a2;
+			a2->parent = node;
+			a->b = a1;
+		} else {
+			node->a = a1;
+			a1->parent = node;
+			a->b = a2;
+		}
+		
+		refitNode(node);
+		refitNode(a);
+		return a;
+	}
+	
+	return node;
+}
+
+// Walk from node up to the root, rebalancing and refitting the boxes.
+static void
+refitAncestors(cpBBTree *tree, cpBBTreeNode *node)
+{
+	while(node){
+		node = balance(tree, node);
+		refitNode(node);
+		
+		node = node->parent;
+	}
+}
+
+// Increase in the total perimeter of the tree from putting bb under node.
+static inline cpFloat
+descendCost(cpBBTreeNode *node, cpBB bb)
+{
+	cpFloat perimeter = bbPerimeter(bbMerge(node->bb, bb));
+	return (node->obj ? perimeter : perimeter - bbPerimeter(node->bb));
+}
+
+static void
+insertLeaf(cpBBTree *tree, cpBBTreeNode *leaf)
+{
+	if(tree->root == NULL){
+		tree->root = leaf;
+		leaf->parent = NULL;
+		return;
+	}
+	
+	// Find the cheapest node to pair the leaf with, measuring cost as the
+	// perimeter of the boxes that have to grow to hold it.
+	cpBB bb = leaf->bb;
+	cpBBTreeNode *sibling = tree->root;
+	while(sibling->obj == NULL){
+		cpFloat combined = bbPerimeter(bbMerge(sibling->bb, bb));
+		
+		// Cost of giving the sibling and the leaf a new parent here.
+		cpFloat cost = 2.0f*combined;
+		// Cost that every node further down will add by growing this one.
+		cpFloat inheritance = 2.0f*(combined - bbPerimeter(sibling->bb));
+		
+		cpFloat costA = descendCost(sibling->a, bb) + inheritance;
+		cpFloat costB = descendCost(sibling->b, bb) + inheritance;
+		
+		if(cost < costA && cost < costB) break;
+		sibling = (costA < costB ? sibling->a : sibling->b);
+	}
+	
+	cpBBTreeNode *parent = getEmptyNode(tree);
+	parent->obj = NULL;
+	replaceChild(tree, sibling, parent);
+	
+	parent->height = sibling->height + 1;
+	parent->a = sibling;
+	parent->b = leaf;
+	sibling->parent = parent;
+	leaf->parent = parent;
+	
+	refitAncestors(tree, parent);
+}
+
+static void
+removeLeaf(cpBBTree *tree, cpBBTreeNode *leaf)
+{
+	cpBBTreeNode *parent = leaf->parent;
+	
+	if(parent == NULL){
+		tree->root = NULL;
+		return;
+	}
+	
+	// The sibling takes the parent's place.
+	cpBBTreeNode *sibling = (parent->a == leaf ? parent->b : parent->a);
+	replaceChild(tree, parent, sibling);
+	recycleNode(tree, parent);
+	
+	refitAncestors(tree, sibling->parent);
+}
+
+// Box for an object's leaf.
+static inline cpBB
+fattenBB(cpBBTree *tree, void *obj, cpBB bb)
+{
+	cpFloat margin = cpfmax(bb.r - bb.l, bb.t - bb.b)*tree->fatten;
+	cpBB fat = cpBBNew(bb.l - margin, bb.b - margin, bb.r + margin, bb.t + margin);
+	
+	if(tree->velocityfunc){
+		cpVect d = cpvmult(tree->velocityfunc(obj), tree->predict);
+		if(d.x < 0.0f) fat.l += d.x; else fat.r += d.x;
+		if(d.y < 0.0f) fat.b += d.y; else fat.t += d.y;
+	}
+	
+	return fat;
+}
+
+void
+cpBBTreeInsert(cpBBTree *tree, void *obj, unsigned int id, cpBB bb)
+{
+	cpBBTreeNode *leaf = (cpBBTreeNode *)cpHashSetInsert(tree->leaves, id, obj, tree);
+	leaf->bb = fattenBB(tree, leaf->obj, bb);
+	
+	insertLeaf(tree, leaf);
+}
+
+void
+cpBBTreeRemove(cpBBTree *tree, void *obj, unsigned int id)
+{
+	cpBBTreeNode *leaf = (cpBBTreeNode *)cpHashSetRemove(tree->leaves, id, obj);
+	if(!leaf) return;
+	
+	removeLeaf(tree, leaf);
+	recycleNode(tree, leaf);
+}
+
+// Used by the cpBBTreeEach() iterator.
+typedef struct eachPair {
+	cpBBTreeIterator func;
+	void *data;
+} eachPair;
+
+static void
+eachHelper(void *elt, void *data)
+{
+	cpBBTreeNode *leaf = (cpBBTreeNode *)elt;
+	eachPair *pair = (eachPair *)data;
+	
+	pair->func(leaf->obj, pair->data);
+}
+
+void
+cpBBTreeEach(cpBBTree *tree, cpBBTreeIterator func, void *data)
+{
+	eachPair pair = {func, data};
+	cpHashSetEach(tree->leaves, &eachHelper, &pair);
+}
+
+static void
+reindexHelper(void *elt, void *data)
+{
+	cpBBTreeNode *leaf = (cpBBTreeNode *)elt;
+	cpBBTree *tree = (cpBBTree *)data;
+	
+	cpBB bb = tree->bbfunc(leaf->obj);
+	if(cpBBcontainsBB(leaf->bb, bb)) return;
+	
+	removeLeaf(tree, leaf);
+	leaf->bb = fattenBB(tree, leaf->obj, bb);
+	insertLeaf(tree, leaf);
+}
+
+void
+cpBBTreeReindex(cpBBTree *tree)
+{
+	cpHashSetEach(tree->leaves, &reindexHelper, tree);
+}
+
+static void
+query(cpBBTreeNode *node, void *obj, cpBB bb, cpBBTreeQueryFunc func, void *data)
+{
+	if(!cpBBintersects(node->bb, bb)) return;
+	
+	if(node->obj){
+		if(node->obj != obj) func(obj, node->obj, data);
+	} else {
+		query(node->a, obj, bb, func, data);
+		query(node->b, obj, bb, func, data);
+	}
+}
+
+void
+cpBBTreePointQuery(cpBBTree *tree, cpVect point, cpBBTreeQueryFunc func, void *data)
+{
+	if(tree->root) query(tree->root, &point, cpBBNew(point.x, point.y, point.x, point.y), func, data);
+}
+
+void
+cpBBTreeQuery(cpBBTree *tree, void *obj, cpBB bb, cpBBTreeQueryFunc func, void *data)
+{
+	if(tree->root) query(tree->root, obj, bb, func, data);
+}
+
+// Find the overlapping pairs with one object under a and the other under b.
+// Whichever node is a branch, or the taller if both are, is split first.
+static void
+queryNodes(cpBBTreeNode *a, cpBBTreeNode *b, cpBBTreeQueryFunc func, void *data)
+{
+	if(!cpBBintersects(a->bb, b->bb)) return;
+	
+	if(a->obj && b->obj){
+		func(a->obj, b->obj, data);
+	} else if(b->obj || (a->obj == NULL && a->height >= b->height)){
+		queryNodes(a->a, b, func, data);
+		queryNodes(a->b, b, func, data);
+	} else {
+		queryNodes(a, b->a, func, data);
+		queryNodes(a, b->b, func, data);
+	}
+}
+
+static void
+queryPairs(cpBBTreeNode *node, cpBBTreeQueryFunc func, void *data)
+{
+	if(node->obj) return;
+	
+	queryNodes(node->a, node->b, func, data);
+	queryPairs(node->a, func, data);
+	queryPairs(node->b, func, data);
+}
+
+void
+cpBBTreeQueryPairs(cpBBTree *tree, cpBBTreeQueryFunc func, void *data)
+{
+	if(tree->root) queryPairs(tree->root, func, data);
+}
+
+void
+cpBBTreeQueryTree(cpBBTree *tree, cpBBTree *other, cpBBTreeQueryFunc func, void *data)
+{
+	if(tree->root && other->root) queryNodes(tree->root, other->root, func, data);
+}
+
+// Fraction of the way from a to b where the segment enters bb, or INFINITY if it misses.
+static inline cpFloat
+segmentEnter(cpBB bb, cpVect a, cpVect b)
+{
+	cpFloat idx = 1.0f/(b.x - a.x);
+	cpFloat tx1 = (bb.l == a.x ? -INFINITY : (bb.l - a.x)*idx);
+	cpFloat tx2 = (bb.r == a.x ?  INFINITY : (bb.r - a.x)*idx);
+	
+	cpFloat idy = 1.0f/(b.y - a.y);
+	cpFloat ty1 = (bb.b == a.y ? -INFINITY : (bb.b - a.y)*idy);
+	cpFloat ty2 = (bb.t == a.y ?  INFINITY : (bb.t - a.y)*idy);
+	
+	cpFloat enter = cpfmax(cpfmin(tx1, tx2), cpfmin(ty1, ty2));
+	cpFloat exit = cpfmin(cpfmax(tx1, tx2), cpfmax(ty1, ty2));
+	
+	if(0.0f <= exit && enter <= exit && enter <= 1.0f){
+		return cpfmax(enter, 0.0f);
+	} else {
+		return INFINITY;
+	}
+}
+
+// Returns the nearest hit found so far.
+static cpFloat
+segmentQuery(cpBBTreeNode *node, cpVect a, cpVect b, cpFloat t_exit, cpBBTreeSegmentQueryFunc func, void *data)
+{
+	if(node->obj) return cpfmin(t_exit, func(node->obj, data));
+	
+	cpBBTreeNode *first = node->a;
+	cpBBTreeNode *second = node->b;
+	cpFloat t_first = segmentEnter(first->bb, a, b);
+	cpFloat t_second = segmentEnter(second->bb, a, b);
+	
+	// Visit the nearer child first, so a hit there can cull the other.
+	if(t_second < t_first){
+		cpBBTreeNode *node_temp = first; first = second; second = node_temp;
+		cpFloat t_temp = t_first; t_first = t_second; t_second = t_temp;
+	}
+	
+	if(t_first <= t_exit) t_exit = segmentQuery(first, a, b, t_exit, func, data);
+	if(t_second <= t_exit) t_exit = segmentQuery(second, a, b, t_exit, func, data);
+	
+	return t_exit;
+}
+
+void
+cpBBTreeSegmentQuery(cpBBTree *tree, cpVect a, cpVect b, cpBBTreeSegmentQueryFunc func, void *data)
+{
+	if(tree->root && segmentEnter(tree->root->bb, a, b) <= 1.0f)
+		segmentQuery(tree->root, a, b, 1.0f, func, data);
+}
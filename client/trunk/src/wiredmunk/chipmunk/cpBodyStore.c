@@ -0,0 +1,361 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "chipmunk.h"
+#include "cpSIMD.h"
+
+// Number of cpFloat arrays in a store.
+#define CP_BODY_STORE_ARRAYS 16
+
+// Number of bodies loaded into the store at a time. Small enough that the
+// bodies are still in the cache when their results are written back.
+#define CP_BODY_STORE_BATCH 64
+
+// Largest angle whose sine and cosine chipmunk calculates itself. The range
+// reduction loses accuracy beyond this, so larger angles are left to libm.
+#define CP_SINCOS_MAX 1.0e8
+
+// Constants for the sine and cosine, from the Cephes library. Pi/4 is split
+// into three parts so that the range reduction is exact.
+#define CP_FOPI 1.27323954473516268615
+#define CP_DP1 7.85398125648498535156e-1
+#define CP_DP2 3.77489470793079817668e-8
+#define CP_DP3 2.69515142907905952645e-15
+
+#define CP_SIN_POLY(zz) ((((((1.58962301576546568060e-10)*(zz) - 2.50507477628578072866e-8)*(zz) + 2.75573136213857245213e-6)*(zz) - 1.98412698295895385996e-4)*(zz) + 8.33333333332211858878e-3)*(zz) - 1.66666666666666307295e-1)
+#define CP_COS_POLY(zz) ((((((-1.13585365213876817300e-11)*(zz) + 2.08757008419747316778e-9)*(zz) - 2.75573141792967388112e-7)*(zz) + 2.48015872888517045348e-5)*(zz) - 1.38888888888730564116e-3)*(zz) + 4.16666666666665929218e-2)
+
+cpBodyStore*
+cpBodyStoreAlloc(void)
+{
+	return (cpBodyStore *)cpcalloc(1, sizeof(cpBodyStore));
+}
+
+cpBodyStore*
+cpBodyStoreInit(cpBodyStore *store)
+{
+	store->num = 0;
+	store->max = 0;
+	store->bodies = NULL;
+	
+	store->px = store->py = store->vx = store->vy = NULL;
+	store->fx = store->fy = store->v_biasx = store->v_biasy = NULL;
+	store->a = store->w = store->t = store->w_bias = NULL;
+	store->rotx = store->roty = store->m_inv = store->i_inv = NULL;
+	
+	return store;
+}
+
+cpBodyStore*
+cpBodyStoreNew(void)
+{
+	return cpBodyStoreInit(cpBodyStoreAlloc());
+}
+
+void
+cpBodyStoreDestroy(cpBodyStore *store)
+{
+	cpfree(store->bodies);
+	
+	// All of the arrays share the block allocated for the first.
+	cpfree(store->px);
+}
+
+void
+cpBodyStoreFree(cpBodyStore *store)
+{
+	if(!store) return;
+	cpBodyStoreDestroy(store);
+	cpfree(store);
+}
+
+// Make room for a number of bodies. The arrays' contents are not kept, as
+// they are reloaded by every integration phase.
+static void
+reserve(cpBodyStore *store, int count)
+{
+	if(count <= store->max) return;
+	
+	store->max = count;
+	store->bodies = (cpBody **)cprealloc(store->bodies, store->max*sizeof(cpBody *));
+	
+	cpfree(store->px);
+	cpFloat *block = (cpFloat *)cpmalloc(CP_BODY_STORE_ARRAYS*store->max*sizeof(cpFloat));
+	
+	cpFloat **arrays[CP_BODY_STORE_ARRAYS] = {
+		&store->px, &store->py, &store->vx, &store->vy,
+		&store->fx, &store->fy, &store->v_biasx, &store->v_biasy,
+		&store->a, &store->w, &store->t, &store->w_bias,
+		&store->rotx, &store->roty, &store->m_inv, &store->i_inv,
+	};
+	
+	for(int i=0; i<CP_BODY_STORE_ARRAYS; i++)
+		*arrays[i] = block + i*store->max;
+}
+
+// Sine and cosine of one angle. Must perform exactly the same operations as
+// sincosLanes() so that every body gets the same result whichever kernel
+// integrates it.
+static inline void
+sincosScalar(cpFloat x, cpFloat *s, cpFloat *c)
+{
+	cpFloat ax = fabs(x);
+	
+	// Also catches NaN.
+	if(!(ax <= CP_SINCOS_MAX)){
+		*s = sin(x);
+		*c = cos(x);
+		return;
+	}
+	
+	// Reduce to the nearest even multiple of pi/4.
+	int j = (int)(ax*CP_FOPI);
+	j += (j & 1);
+	
+	cpFloat y = (cpFloat)j;
+	cpFloat z = ((ax - y*CP_DP1) - y*CP_DP2) - y*CP_DP3;
+	cpFloat zz = z*z;
+	
+	cpFloat ps = z + z*(zz*CP_SIN_POLY(zz));
+	cpFloat pc = 1.0 - zz*0.5 + zz*zz*CP_COS_POLY(zz);
+	
+	// Pick the polynomials and signs for the octant.
+	cpFloat sv = (j & 2) ? pc : ps;
+	cpFloat cv = (j & 2) ? ps : pc;
+	
+	if(j & 4) sv = -sv;
+	if((j + 2) & 4) cv = -cv;
+	if(x < 0.0) sv = -sv;
+	
+	*s = sv;
+	*c = cv;
+}
+
+#ifdef CP_SIMD_ENABLED
+// Always inlined so that each version of a dispatched kernel gets a copy
+// compiled for its own instruction set.
+static inline __attribute__((always_inline)) void
+sincosLanes(const cpFloatLanes *angle, cpFloatLanes *s, cpFloatLanes *c)
+{
+	cpFloatLanes x = *angle;
+	cpFloatLanes zero = x - x;
+	cpFloatLanes ax = cpSelectLanes(x < zero, -x, x);
+	
+	// Lanes that sincosScalar() would pass to libm are zeroed so that they
+	// convert to integers safely, then patched afterwards.
+	cpMaskLanes large = ~(ax <= CP_SINCOS_MAX);
+	ax = cpSelectLanes(large, zero, ax);
+	
+	// 32 bit integers, which unlike 64 bit ones can be converted to and from
+	// doubles without AVX-512.
+	cpIntLanes j = __builtin_convertvector(ax*CP_FOPI, cpIntLanes);
+	j += (j & 1);
+	
+	cpFloatLanes y = __builtin_convertvector(j, cpFloatLanes);
+	cpFloatLanes z = ((ax - y*CP_DP1) - y*CP_DP2) - y*CP_DP3;
+	cpFloatLanes zz = z*z;
+	
+	cpFloatLanes ps = z + z*(zz*CP_SIN_POLY(zz));
+	cpFloatLanes pc = 1.0 - zz*0.5 + zz*zz*CP_COS_POLY(zz);
+	
+	cpMaskLanes swap = __builtin_convertvector((j & 2) != 0, cpMaskLanes);
+	cpFloatLanes sv = cpSelectLanes(swap, pc, ps);
+	cpFloatLanes cv = cpSelectLanes(swap, ps, pc);
+	
+	sv = cpSelectLanes(__builtin_convertvector((j & 4) != 0, cpMaskLanes), -sv, sv);
+	cv = cpSelectLanes(__builtin_convertvector(((j + 2) & 4) != 0, cpMaskLanes), -cv, cv);
+	sv = cpSelectLanes(x < zero, -sv, sv);
+	
+	if(cpAnyLanes(&large)){
+		for(int i=0; i<CP_SIMD_LANES; i++){
+			if(large[i]){
+				sv[i] = sin(x[i]);
+				cv[i] = cos(x[i]);
+			}
+		}
+	}
+	
+	*s = sv;
+	*c = cv;
+}
+#endif
+
+// Equivalent to cpBodyUpdatePosition() for every loaded body, except that the
+// angle is left unreduced.
+CP_SIMD_DISPATCH static void
+updatePositions(cpBodyStore *store, cpFloat dt)
+{
+	int i = 0;
+
+#ifdef CP_SIMD_ENABLED
+	for(; i + CP_SIMD_LANES <= store->num; i += CP_SIMD_LANES){
+		cpStoreLanes(store->px + i, cpLoadLanes(store->px + i) + (cpLoadLanes(store->vx + i) + cpLoadLanes(store->v_biasx + i))*dt);
+		cpStoreLanes(store->py + i, cpLoadLanes(store->py + i) + (cpLoadLanes(store->vy + i) + cpLoadLanes(store->v_biasy + i))*dt);
+		
+		cpFloatLanes a = cpLoadLanes(store->a + i) + (cpLoadLanes(store->w + i) + cpLoadLanes(store->w_bias + i))*dt;
+		cpFloatLanes s, c;
+		sincosLanes(&a, &s, &c);
+		
+		cpStoreLanes(store->a + i, a);
+		cpStoreLanes(store->rotx + i, c);
+		cpStoreLanes(store->roty + i, s);
+	}
+#endif
+
+	for(; i<store->num; i++){
+		store->px[i] = store->px[i] + (store->vx[i] + store->v_biasx[i])*dt;
+		store->py[i] = store->py[i] + (store->vy[i] + store->v_biasy[i])*dt;
+		
+		store->a[i] = store->a[i] + (store->w[i] + store->w_bias[i])*dt;
+		sincosScalar(store->a[i], &store->roty[i], &store->rotx[i]);
+	}
+}
+
+// Equivalent to cpBodyUpdateVelocity() for every loaded body.
+CP_SIMD_DISPATCH static void
+updateVelocities(cpBodyStore *store, cpVect gravity, cpFloat damping, cpFloat dt)
+{
+	int i = 0;
+
+#ifdef CP_SIMD_ENABLED
+	for(; i + CP_SIMD_LANES <= store->num; i += CP_SIMD_LANES){
+		cpFloatLanes m_inv = cpLoadLanes(store->m_inv + i);
+		
+		cpStoreLanes(store->vx + i, cpLoadLanes(store->vx + i)*damping + (gravity.x + cpLoadLanes(store->fx + i)*m_inv)*dt);
+		cpStoreLanes(store->vy + i, cpLoadLanes(store->vy + i)*damping + (gravity.y + cpLoadLanes(store->fy + i)*m_inv)*dt);
+		cpStoreLanes(store->w + i, cpLoadLanes(store->w + i)*damping + cpLoadLanes(store->t + i)*cpLoadLanes(store->i_inv + i)*dt);
+	}
+#endif
+
+	for(; i<store->num; i++){
+		store->vx[i] = store->vx[i]*damping + (gravity.x + store->fx[i]*store->m_inv[i])*dt;
+		store->vy[i] = store->vy[i]*damping + (gravity.y + store->fy[i]*store->m_inv[i])*dt;
+		store->w[i] = store->w[i]*damping + store->t[i]*store->i_inv[i]*dt;
+	}
+}
+
+// Run the position kernel over the loaded bodies and write the results back.
+static void
+flushPositions(cpBodyStore *store, cpFloat dt)
+{
+	updatePositions(store, dt);
+	
+	for(int n=0; n<store->num; n++){
+		cpBody *body = store->bodies[n];
+		
+		body->p = cpv(store->px[n], store->py[n]);
+		body->rot = cpv(store->rotx[n], store->roty[n]);
+		
+		// As cpBodySetAngle(). fmod() returns angles already in range unchanged,
+		// so it can be skipped for them.
+		cpFloat a = store->a[n];
+		body->a = (fabs(a) < (cpFloat)M_PI*2.0f) ? a : fmod(a, (cpFloat)M_PI*2.0f);
+		
+		body->v_bias = cpvzero;
+		body->w_bias = 0.0f;
+	}
+	
+	store->num = 0;
+}
+
+void
+cpBodyStoreUpdatePositions(cpBodyStore *store, cpArray *bodies, cpFloat dt)
+{
+	reserve(store, CP_BODY_STORE_BATCH);
+	store->num = 0;
+	
+	for(int i=0; i<bodies->num; i++){
+		cpBody *body = (cpBody *)bodies->arr[i];
+		
+		if(body->position_func != cpBodyUpdatePosition){
+			body->position_func(body, dt);
+			continue;
+		}
+		
+		int n = store->num++;
+		store->bodies[n] = body;
+		
+		store->px[n] = body->p.x;
+		store->py[n] = body->p.y;
+		store->vx[n] = body->v.x;
+		store->vy[n] = body->v.y;
+		store->v_biasx[n] = body->v_bias.x;
+		store->v_biasy[n] = body->v_bias.y;
+		store->a[n] = body->a;
+		store->w[n] = body->w;
+		store->w_bias[n] = body->w_bias;
+		
+		if(store->num == CP_BODY_STORE_BATCH) flushPositions(store, dt);
+	}
+	
+	flushPositions(store, dt);
+}
+
+// Run the velocity kernel over the loaded bodies and write the results back.
+static void
+flushVelocities(cpBodyStore *store, cpVect gravity, cpFloat damping, cpFloat dt)
+{
+	updateVelocities(store, gravity, damping, dt);
+	
+	for(int n=0; n<store->num; n++){
+		cpBody *body = store->bodies[n];
+		
+		body->v = cpv(store->vx[n], store->vy[n]);
+		body->w = store->w[n];
+	}
+	
+	store->num = 0;
+}
+
+void
+cpBodyStoreUpdateVelocities(cpBodyStore *store, cpArray *bodies, cpVect gravity, cpFloat damping, cpFloat dt)
+{
+	reserve(store, CP_BODY_STORE_BATCH);
+	store->num = 0;
+	
+	for(int i=0; i<bodies->num; i++){
+		cpBody *body = (cpBody *)bodies->arr[i];
+		
+		if(body->velocity_func != cpBodyUpdateVelocity){
+			body->velocity_func(body, gravity, damping, dt);
+			continue;
+		}
+		
+		int n = store->num++;
+		store->bodies[n] = body;
+		
+		store->vx[n] = body->v.x;
+		store->vy[n] = body->v.y;
+		store->fx[n] = body->f.x;
+		store->fy[n] = body->f.y;
+		store->m_inv[n] = body->m_inv;
+		store->w[n] = body->w;
+		store->t[n] = body->t;
+		store->i_inv[n] = body->i_inv;
+		
+		if(store->num == CP_BODY_STORE_BATCH) flushVelocities(store, gravity, damping, dt);
+	}
+	
+	flushVelocities(store, gravity, damping, dt);
+}
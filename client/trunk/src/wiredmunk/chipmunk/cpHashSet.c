@@ -28,38 +28,28 @@
 void
 cpHashSetDestroy(cpHashSet *set)
 {
-	// Free the chains.
-	for(int i=0; i<set->size; i++){
-		// Free the bins in the chain.
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			free(bin);
-			bin = next;
-		}
-	}
-	
 	// Free the table.
-	free(set->table);
+	cpfree(set->table);
 }
 
 void
 cpHashSetFree(cpHashSet *set)
 {
 	if(set) cpHashSetDestroy(set);
-	free(set);
+	cpfree(set);
 }
 
 cpHashSet *
 cpHashSetAlloc(void)
 {
-	return (cpHashSet *)calloc(1, sizeof(cpHashSet));
+	return (cpHashSet *)cpcalloc(1, sizeof(cpHashSet));
 }
 
 cpHashSet *
 cpHashSetInit(cpHashSet *set, int size, cpHashSetEqlFunc eqlFunc, cpHashSetTransFunc trans)
 {
-	set->size = next_prime(size);
+	// Leave room for size elements without the set being full.
+	set->size = next_prime(size*2);
 	set->entries = 0;
 	
 	set->eql = eqlFunc;
@@ -67,7 +57,7 @@ cpHashSetInit(cpHashSet *set, int size, cpHashSetEqlFunc eqlFunc, cpHashSetTrans
 	
 	set->default_value = NULL;
 	
-	set->table = (cpHashSetBin **)calloc(set->size, sizeof(cpHashSetBin *));
+	set->table = (cpHashSetBin *)cpcalloc(set->size, sizeof(cpHashSetBin));
 	
 	return set;
 }
@@ -78,65 +68,113 @@ cpHashSetNew(int size, cpHashSetEqlFunc eqlFunc, cpHashSetTransFunc trans)
 	return cpHashSetInit(cpHashSetAlloc(), size, eqlFunc, trans);
 }
 
+// Linear probing needs plenty of empty cells to keep the runs short.
 static int
 setIsFull(cpHashSet *set)
 {
-	return (set->entries >= set->size);
+	return (set->entries*2 > set->size);
+}
+
+// Index of the cell where a hash's run starts.
+static inline int
+homeIndex(cpHashSet *set, unsigned int hash)
+{
+	return hash%set->size;
+}
+
+static inline int
+nextIndex(cpHashSet *set, int index)
+{
+	index++;
+	return (index == set->size ? 0 : index);
+}
+
+// Find the cell holding an element equal to ptr, or the empty cell that ends its run.
+static int
+findIndex(cpHashSet *set, unsigned int hash, void *ptr)
+{
+	int index = homeIndex(set, hash);
+	
+	cpHashSetBin *bin = &set->table[index];
+	while(bin->elt && !(bin->hash == hash && set->eql(ptr, bin->elt))){
+		index = nextIndex(set, index);
+		bin = &set->table[index];
+	}
+	
+	return index;
 }
 
 static void
 cpHashSetResize(cpHashSet *set)
 {
+	cpHashSetBin *oldTable = set->table;
+	int oldSize = set->size;
+	
 	// Get the next approximate doubled prime.
-	int newSize = next_prime(set->size + 1);
-	// Allocate a new table.
-	cpHashSetBin **newTable = (cpHashSetBin **)calloc(newSize, sizeof(cpHashSetBin *));
+	set->size = next_prime(oldSize + 1);
+	set->table = (cpHashSetBin *)cpcalloc(set->size, sizeof(cpHashSetBin));
 	
-	// Iterate over the chains.
-	for(int i=0; i<set->size; i++){
-		// Rehash the bins into the new table.
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			
-			int index = bin->hash%newSize;
-			bin->next = newTable[index];
-			newTable[index] = bin;
-			
-			bin = next;
-		}
+	// Reinsert the elements into the new table.
+	for(int i=0; i<oldSize; i++){
+		cpHashSetBin *bin = &oldTable[i];
+		if(!bin->elt) continue;
+		
+		int index = homeIndex(set, bin->hash);
+		while(set->table[index].elt)
+			index = nextIndex(set, index);
+		
+		set->table[index] = *bin;
 	}
 	
-	free(set->table);
+	cpfree(oldTable);
+}
+
+// Empty a cell, then shift back any elements later in the run that would no
+// longer be reachable from their home cell.
+static void
+removeIndex(cpHashSet *set, int index)
+{
+	int next = index;
+	
+	for(;;){
+		next = nextIndex(set, next);
+		
+		cpHashSetBin *bin = &set->table[next];
+		if(!bin->elt) break;
+		
+		// Leave the element alone if its home is cyclically within (index, next].
+		int home = homeIndex(set, bin->hash);
+		if(index <= next ? (index < home && home <= next) : (index < home || home <= next))
+			continue;
+		
+		set->table[index] = *bin;
+		index = next;
+	}
 	
-	set->table = newTable;
-	set->size = newSize;
+	set->table[index].elt = NULL;
+	set->entries--;
 }
 
 void *
 cpHashSetInsert(cpHashSet *set, unsigned int hash, void *ptr, void *data)
 {
-	int index = hash%set->size;
-	
-	// Find the bin with the matching element.
-	cpHashSetBin *bin = set->table[index];
-	while(bin && !set->eql(ptr, bin->elt))
-		bin = bin->next;
+	int index = findIndex(set, hash, ptr);
 	
 	// Create it necessary.
-	if(!bin){
-		bin = (cpHashSetBin *)malloc(sizeof(cpHashSetBin));
-		bin->hash = hash;
-		bin->elt = set->trans(ptr, data); // Transform the pointer.
+	cpHashSetBin *bin = &set->table[index];
+	if(!bin->elt){
+		void *elt = set->trans(ptr, data); // Transform the pointer.
 		
-		bin->next = set->table[index];
-		set->table[index] = bin;
+		bin->hash = hash;
+		bin->elt = elt;
 		
 		set->entries++;
 		
 		// Resize the set if it's full.
 		if(setIsFull(set))
 			cpHashSetResize(set);
+		
+		return elt;
 	}
 	
 	return bin->elt;
@@ -145,75 +183,48 @@ cpHashSetInsert(cpHashSet *set, unsigned int hash, void *ptr, void *data)
 void *
 cpHashSetRemove(cpHashSet *set, unsigned int hash, void *ptr)
 {
-	int index = hash%set->size;
-	
-	// Pointer to the previous bin pointer.
-	cpHashSetBin **prev_ptr = &set->table[index];
-	// Pointer the the current bin.
-	cpHashSetBin *bin = set->table[index];
-	
-	// Find the bin
-	while(bin && !set->eql(ptr, bin->elt)){
-		prev_ptr = &bin->next;
-		bin = bin->next;
-	}
+	int index = findIndex(set, hash, ptr);
 	
 	// Remove it if it exists.
-	if(bin){
-		// Update the previos bin pointer to point to the next bin.
-		(*prev_ptr) = bin->next;
-		set->entries--;
-		
-		void *return_value = bin->elt;
-		free(bin);
-		return return_value;
-	}
+	void *return_value = set->table[index].elt;
+	if(return_value) removeIndex(set, index);
 	
-	return NULL;
+	return return_value;
 }
 
 void *
 cpHashSetFind(cpHashSet *set, unsigned int hash, void *ptr)
 {	
-	int index = hash%set->size;
-	cpHashSetBin *bin = set->table[index];
-	while(bin && !set->eql(ptr, bin->elt))
-		bin = bin->next;
-		
-	return (bin ? bin->elt : set->default_value);
+	void *elt = set->table[findIndex(set, hash, ptr)].elt;
+	return (elt ? elt : set->default_value);
 }
 
 void
 cpHashSetEach(cpHashSet *set, cpHashSetIterFunc func, void *data)
 {
 	for(int i=0; i<set->size; i++){
-		cpHashSetBin *bin;
-		for(bin = set->table[i]; bin; bin = bin->next)
-			func(bin->elt, data);
+		void *elt = set->table[i].elt;
+		if(elt) func(elt, data);
 	}
 }
 
 void
 cpHashSetReject(cpHashSet *set, cpHashSetRejectFunc func, void *data)
 {
-	// Iterate over all the chains.
+	// Removing an element can shift the next one in its run back into the cell
+	// that was just visited. Starting just after an empty cell means no run
+	// wraps around past the start, so shifted elements are always ones that
+	// haven't been visited yet. The set is never full, so there is always an
+	// empty cell.
+	int index = 0;
+	while(set->table[index].elt) index++;
+	
 	for(int i=0; i<set->size; i++){
-		// The rest works similarly to cpHashSetRemove() above.
-		cpHashSetBin **prev_ptr = &set->table[i];
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			
-			if(func(bin->elt, data)){
-				prev_ptr = &bin->next;
-			} else {
-				(*prev_ptr) = next;
-
-				set->entries--;
-				free(bin);
-			}
-			
-			bin = next;
-		}
+		index = nextIndex(set, index);
+		
+		// Check the cell again after each removal as another element may take its place.
+		void *elt;
+		while((elt = set->table[index].elt) && !func(elt, data))
+			removeIndex(set, index);
 	}
 }
@@ -24,11 +24,12 @@
 #include <math.h>
 
 #include "chipmunk.h"
+#include "cpSIMD.h"
 
 cpPolyShape *
 cpPolyShapeAlloc(void)
 {
-	return (cpPolyShape *)calloc(1, sizeof(cpPolyShape));
+	return (cpPolyShape *)cpcalloc(1, sizeof(cpPolyShape));
 }
 
 static void
@@ -82,16 +83,109 @@ cpPolyShapeCacheData(cpShape *shape, cpVect p, cpVect rot)
 	return cpBBNew(l, b, r, t);
 }
 
+#ifdef CP_SIMD_ENABLED
+// Same as cpPolyShapeCacheData(), but transforms four vertexes and axes at a
+// time and fills in the split lists used by the SIMD collision kernels.
+CP_SIMD_TARGET static cpBB
+cpPolyShapeCacheDataLanes(cpShape *shape, cpVect p, cpVect rot)
+{
+	cpPolyShape *poly = (cpPolyShape *)shape;
+	
+	cpVect *verts = poly->verts;
+	cpVect *tVerts = poly->tVerts;
+	cpPolyShapeAxis *axes = poly->axes;
+	cpPolyShapeAxis *tAxes = poly->tAxes;
+	
+	// Vertexes are transformed two to a vector, still interleaved. Rotating
+	// (x, y) is then (x, y)*rot.x + (y, x)*(-rot.y, rot.y).
+	cpFloatLanes pos = {p.x, p.y, p.x, p.y};
+	cpFloatLanes cosine = {rot.x, rot.x, rot.x, rot.x};
+	cpFloatLanes sine = {-rot.y, rot.y, -rot.y, rot.y};
+	
+	// The lists are allocated with room for whole vectors, so the last one is
+	// transformed along with whatever is in the padding.
+	int num = poly->numVerts;
+	int i;
+	
+	for(i=0; i<num; i+=CP_SIMD_LANES){
+		cpFloatLanes v0 = cpLoadLanes(&verts[i].x);
+		cpFloatLanes v1 = cpLoadLanes(&verts[i + 2].x);
+		
+		v0 = pos + (v0*cosine + cpShuffleLanes(v0, v0, 1, 0, 3, 2)*sine);
+		v1 = pos + (v1*cosine + cpShuffleLanes(v1, v1, 1, 0, 3, 2)*sine);
+		
+		cpStoreLanes(&tVerts[i].x, v0);
+		cpStoreLanes(&tVerts[i + 2].x, v1);
+		cpStoreLanes(poly->tVertsX + i, cpShuffleLanes(v0, v1, 0, 2, 4, 6));
+		cpStoreLanes(poly->tVertsY + i, cpShuffleLanes(v0, v1, 1, 3, 5, 7));
+		
+		// Axes are three values long, so four of them fill three vectors.
+		cpFloatLanes a0 = cpLoadLanes(&axes[i].n.x);
+		cpFloatLanes a1 = cpLoadLanes(&axes[i].n.x + 4);
+		cpFloatLanes a2 = cpLoadLanes(&axes[i].n.x + 8);
+		
+		cpFloatLanes nx = cpShuffleLanes(cpShuffleLanes(a0, a1, 0, 3, 6, 0), a2, 0, 1, 2, 5);
+		cpFloatLanes ny = cpShuffleLanes(cpShuffleLanes(a0, a1, 1, 4, 7, 0), a2, 0, 1, 2, 6);
+		cpFloatLanes d = cpShuffleLanes(cpShuffleLanes(a0, a1, 2, 5, 0, 0), a2, 0, 1, 4, 7);
+		
+		cpFloatLanes tnx = nx*rot.x - ny*rot.y;
+		cpFloatLanes tny = nx*rot.y + ny*rot.x;
+		cpFloatLanes td = (p.x*tnx + p.y*tny) + d;
+		
+		cpStoreLanes(&tAxes[i].n.x, cpShuffleLanes(cpShuffleLanes(tnx, tny, 0, 4, 0, 1), td, 0, 1, 4, 3));
+		cpStoreLanes(&tAxes[i].n.x + 4, cpShuffleLanes(cpShuffleLanes(tnx, tny, 5, 0, 2, 6), td, 0, 5, 2, 3));
+		cpStoreLanes(&tAxes[i].n.x + 8, cpShuffleLanes(cpShuffleLanes(tnx, tny, 0, 3, 7, 0), td, 6, 1, 2, 7));
+		cpStoreLanes(poly->tAxesX + i, tnx);
+		cpStoreLanes(poly->tAxesY + i, tny);
+		cpStoreLanes(poly->tAxesD + i, td);
+	}
+	
+	for(i=num; i<CP_SIMD_PADDED(num); i++){
+		poly->tVertsX[i] = poly->tVertsX[num - 1];
+		poly->tVertsY[i] = poly->tVertsY[num - 1];
+		poly->tAxesX[i] = poly->tAxesX[num - 1];
+		poly->tAxesY[i] = poly->tAxesY[num - 1];
+		poly->tAxesD[i] = poly->tAxesD[num - 1];
+	}
+	
+	// The padding repeats a vertex, so it can't change the bounds.
+	cpFloatLanes l = cpLoadLanes(poly->tVertsX), r = l;
+	cpFloatLanes b = cpLoadLanes(poly->tVertsY), t = b;
+	
+	for(i=CP_SIMD_LANES; i<num; i+=CP_SIMD_LANES){
+		cpFloatLanes x = cpLoadLanes(poly->tVertsX + i);
+		cpFloatLanes y = cpLoadLanes(poly->tVertsY + i);
+		
+		l = cpSelectLanes(l < x, l, x);
+		r = cpSelectLanes(r > x, r, x);
+		b = cpSelectLanes(b < y, b, y);
+		t = cpSelectLanes(t > y, t, y);
+	}
+	
+	cpBB bb = cpBBNew(l[0], b[0], r[0], t[0]);
+	for(i=1; i<CP_SIMD_LANES; i++){
+		bb.l = cpfmin(bb.l, l[i]);
+		bb.r = cpfmax(bb.r, r[i]);
+		bb.b = cpfmin(bb.b, b[i]);
+		bb.t = cpfmax(bb.t, t[i]);
+	}
+	
+	return bb;
+}
+#endif
+
 static void
 cpPolyShapeDestroy(cpShape *shape)
 {
 	cpPolyShape *poly = (cpPolyShape *)shape;
 	
-	free(poly->verts);
-	free(poly->tVerts);
+	cpfree(poly->verts);
+	cpfree(poly->tVerts);
 	
-	free(poly->axes);
-	free(poly->tAxes);
+	cpfree(poly->axes);
+	cpfree(poly->tAxes);
+	
+	cpfree(poly->tVertsX);
 }
 
 static int
@@ -107,15 +201,34 @@ static const cpShapeClass polyClass = {
 	cpPolyShapePointQuery,
 };
 
+#ifdef CP_SIMD_ENABLED
+// Used instead of polyClass when the CPU supports the SIMD kernels.
+static const cpShapeClass polyClassLanes = {
+	CP_POLY_SHAPE,
+	cpPolyShapeCacheDataLanes,
+	cpPolyShapeDestroy,
+	cpPolyShapePointQuery,
+};
+#endif
+
 cpPolyShape *
 cpPolyShapeInit(cpPolyShape *poly, cpBody *body, int numVerts, cpVect *verts, cpVect offset)
 {	
 	poly->numVerts = numVerts;
 
-	poly->verts = (cpVect *)calloc(numVerts, sizeof(cpVect));
-	poly->tVerts = (cpVect *)calloc(numVerts, sizeof(cpVect));
-	poly->axes = (cpPolyShapeAxis *)calloc(numVerts, sizeof(cpPolyShapeAxis));
-	poly->tAxes = (cpPolyShapeAxis *)calloc(numVerts, sizeof(cpPolyShapeAxis));
+	// Lists are padded to a whole number of lanes for the SIMD kernels.
+	int padded = CP_SIMD_PADDED(numVerts);
+	poly->verts = (cpVect *)cpcalloc(padded, sizeof(cpVect));
+	poly->tVerts = (cpVect *)cpcalloc(padded, sizeof(cpVect));
+	poly->axes = (cpPolyShapeAxis *)cpcalloc(padded, sizeof(cpPolyShapeAxis));
+	poly->tAxes = (cpPolyShapeAxis *)cpcalloc(padded, sizeof(cpPolyShapeAxis));
+	
+	// The split lists share one allocation.
+	poly->tVertsX = (cpFloat *)cpcalloc(5*padded, sizeof(cpFloat));
+	poly->tVertsY = poly->tVertsX + padded;
+	poly->tAxesX = poly->tVertsX + 2*padded;
+	poly->tAxesY = poly->tVertsX + 3*padded;
+	poly->tAxesD = poly->tVertsX + 4*padded;
 	
 	for(int i=0; i<numVerts; i++){
 		cpVect a = cpvadd(offset, verts[i]);
@@ -127,7 +240,11 @@ cpPolyShapeInit(cpPolyShape *poly, cpBody *body, int numVerts, cpVect *verts, cp
 		poly->axes[i].d = cpvdot(n, a);
 	}
 	
+#ifdef CP_SIMD_ENABLED
+	cpShapeInit((cpShape *)poly, cpSIMDSupported() ? &polyClassLanes : &polyClass, body);
+#else
 	cpShapeInit((cpShape *)poly, &polyClass, body);
+#endif
 
 	return poly;
 }
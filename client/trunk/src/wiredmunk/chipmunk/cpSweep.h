@@ -0,0 +1,84 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The sweep is an alternative to the spatial hash that needs no tuning.
+// Objects are kept in a list sorted by the left edge of their bounding boxes.
+// Finding overlapping pairs is then a single sweep along the list, testing
+// each object only against those that start before it ends. The list is
+// kept from step to step and resorted with an insertion sort, which is close
+// to linear when objects move coherently.
+//
+// A sweep only finds pairs along one axis, so objects spread out along the y
+// axis and stacked in x will be tested against each other needlessly.
+
+// Entry in the sorted list.
+typedef struct cpSweepProxy{
+	// Bounding box of the object when it was last indexed.
+	cpBB bb;
+	// Pointer to the object
+	void *obj;
+} cpSweepProxy;
+
+// BBox callback. Called whenever the sweep needs a bounding box from an object.
+typedef cpBB (*cpSweepBBFunc)(void *obj);
+
+typedef struct cpSweep{
+	// Number of objects in the list, and number of proxies allocated.
+	int num, max;
+	// Proxies sorted by bb.l.
+	cpSweepProxy *proxies;
+	
+	// BBox callback.
+	cpSweepBBFunc bbfunc;
+} cpSweep;
+
+//Basic allocation/destruction functions.
+cpSweep *cpSweepAlloc(void);
+cpSweep *cpSweepInit(cpSweep *sweep, int size, cpSweepBBFunc bbfunc);
+cpSweep *cpSweepNew(int size, cpSweepBBFunc bbfunc);
+
+void cpSweepDestroy(cpSweep *sweep);
+void cpSweepFree(cpSweep *sweep);
+
+// Add an object to the sweep.
+void cpSweepInsert(cpSweep *sweep, void *obj, cpBB bb);
+// Remove an object from the sweep.
+void cpSweepRemove(cpSweep *sweep, void *obj);
+
+// Iterator function
+typedef void (*cpSweepIterator)(void *obj, void *data);
+// Iterate over the objects in the sweep.
+void cpSweepEach(cpSweep *sweep, cpSweepIterator func, void *data);
+
+// Fetch new bounding boxes for all the objects and resort the list.
+void cpSweepReindex(cpSweep *sweep);
+
+// Query callback.
+typedef int (*cpSweepQueryFunc)(void *obj1, void *obj2, void *data);
+// Point query the sweep. A reference to the query point is passed as obj1 to the query callback.
+void cpSweepPointQuery(cpSweep *sweep, cpVect point, cpSweepQueryFunc func, void *data);
+// Query the sweep for a given BBox.
+void cpSweepQuery(cpSweep *sweep, void *obj, cpBB bb, cpSweepQueryFunc func, void *data);
+// Find every overlapping pair of objects in the sweep.
+void cpSweepQueryPairs(cpSweep *sweep, cpSweepQueryFunc func, void *data);
+// Find every overlapping pair with one object from each sweep. The object
+// from sweep is passed to the callback as obj1.
+void cpSweepQuerySweep(cpSweep *sweep, cpSweep *other, cpSweepQueryFunc func, void *data);
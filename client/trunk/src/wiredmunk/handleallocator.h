@@ -0,0 +1,105 @@
+#ifndef _HANDLE_ALLOCATOR_H_
+#define _HANDLE_ALLOCATOR_H_
+
+#include <vector>
+
+#define HANDLE_GENERATION_BITS 8
+#define HANDLE_GENERATION_MASK 0xFF
+
+namespace WiredMunk {
+
+	/**
+	 * Allocates generational handles for use as network object IDs.  A handle
+	 * packs a slot index into its upper bits and the slot's generation into
+	 * its lower bits.  Released slots are kept on a free list and reused with
+	 * an incremented generation, so handles stay small (and therefore cheap
+	 * to index and encode) whilst a handle that outlives its object no longer
+	 * matches the slot and can be detected as stale.
+	 *
+	 * Generations wrap after 256 reuses of the same slot.
+	 */
+	class HandleAllocator {
+	public:
+		
+		/**
+		 * Constructor.
+		 * @param firstIndex The index of the first slot to allocate.  Slots
+		 * below this index are never handed out.
+		 */
+		HandleAllocator(unsigned int firstIndex = 0);
+		
+		/**
+		 * Allocate a new handle.  Previously released slots are reused before
+		 * new slots are created.
+		 * @return A new handle.
+		 */
+		unsigned int allocate();
+		
+		/**
+		 * Release a handle so that its slot can be reused.  Releasing a stale
+		 * handle has no effect.
+		 * @param handle The handle to release.
+		 */
+		void release(unsigned int handle);
+		
+		/**
+		 * Check if a handle refers to a currently allocated slot.
+		 * @param handle The handle to check.
+		 * @return True if the handle is live; false if it is stale or was
+		 * never allocated.
+		 */
+		bool isLive(unsigned int handle) const;
+		
+		/**
+		 * Get the number of live handles.
+		 * @return The number of live handles.
+		 */
+		inline unsigned int getLiveCount() const { return _generations.size() - _firstIndex - _freeIndices.size(); };
+		
+		/**
+		 * Extract the slot index from a handle.
+		 * @param handle The handle.
+		 * @return The slot index.
+		 */
+		inline static unsigned int getIndex(unsigned int handle) { return handle >> HANDLE_GENERATION_BITS; };
+		
+		/**
+		 * Extract the generation from a handle.
+		 * @param handle The handle.
+		 * @return The generation.
+		 */
+		inline static unsigned int getGeneration(unsigned int handle) { return handle & HANDLE_GENERATION_MASK; };
+		
+		/**
+		 * Build a handle from a slot index and a generation.
+		 * @param index The slot index.
+		 * @param generation The generation.
+		 * @return The handle.
+		 */
+		inline static unsigned int makeHandle(unsigned int index, unsigned int generation) {
+			return (index << HANDLE_GENERATION_BITS) | (generation & HANDLE_GENERATION_MASK);
+		};
+		
+		/**
+		 * Check whether a handle is a later generation of the same slot as
+		 * another handle.  Generations wrap around, so a handle counts as
+		 * newer if it is less than half of the generation range ahead.
+		 * @param handle The handle to test.
+		 * @param other The handle to compare against.
+		 * @return True if both handles share a slot and handle is newer.
+		 */
+		inline static bool isNewer(unsigned int handle, unsigned int other) {
+			unsigned int distance = (getGeneration(handle) - getGeneration(other)) & HANDLE_GENERATION_MASK;
+			
+			return (getIndex(handle) == getIndex(other)) && (distance != 0) && (distance <= HANDLE_GENERATION_MASK / 2);
+		};
+	
+	private:
+		std::vector<unsigned char> _generations;	/**< Current generation of each slot */
+		std::vector<bool> _isAllocated;				/**< Is each slot in use? */
+		std::vector<unsigned int> _freeIndices;		/**< Released slots available for reuse */
+		unsigned int _firstIndex;					/**< First slot that can be allocated */
+	};
+}
+
+#endif
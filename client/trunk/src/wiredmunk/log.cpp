@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include "log.h"
+
+#define LOG_SPEC_LENGTH 32
+
+using namespace WiredMunk;
+
+volatile int Log::_level = LOG_DEFAULT_LEVEL;
+volatile unsigned int Log::_sequence = 0;
+volatile bool Log::_isRunning = false;
+Log::Buffer* Log::_buffers = NULL;
+pthread_mutex_t Log::_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t Log::_bufferKey;
+pthread_once_t Log::_once = PTHREAD_ONCE_INIT;
+pthread_t Log::_thread;
+
+namespace {
+
+	/**
+	 * Type of the argument consumed by a printf() conversion.
+	 */
+	enum ArgType {
+		ARG_NONE,						/**< No argument; print the spec as-is */
+		ARG_PERCENT,					/**< Literal percent sign */
+		ARG_INT,						/**< int, or anything promoted to it */
+		ARG_LONG,						/**< long */
+		ARG_LONG_LONG,					/**< long long */
+		ARG_SIZE,						/**< size_t */
+		ARG_PTRDIFF,					/**< ptrdiff_t */
+		ARG_DOUBLE,						/**< double, or float promoted to it */
+		ARG_LONG_DOUBLE,				/**< long double */
+		ARG_STRING,						/**< Null-terminated string */
+		ARG_POINTER						/**< Pointer */
+	};
+	
+	/**
+	 * Parse a single printf() conversion.
+	 * @param format Pointer to the '%' that starts the conversion.
+	 * @param spec Buffer of LOG_SPEC_LENGTH chars to receive the conversion
+	 * as a standalone format string.
+	 * @param type Receives the type of argument the conversion consumes.
+	 * @return Pointer to the character after the conversion.
+	 */
+	const char* parseConversion(const char* format, char* spec, ArgType* type) {
+		const char* start = format++;
+		int longs = 0;
+		bool isSize = false;
+		bool isPtrdiff = false;
+		bool isLongDouble = false;
+		
+		while ((*format != '\0') && (strchr("-+ #0123456789.", *format) != NULL)) format++;
+		
+		while ((*format != '\0') && (strchr("hlLqjzt", *format) != NULL)) {
+			if ((*format == 'l') || (*format == 'q') || (*format == 'j')) longs++;
+			if (*format == 'q') longs++;
+			if (*format == 'z') isSize = true;
+			if (*format == 't') isPtrdiff = true;
+			if (*format == 'L') isLongDouble = true;
+			format++;
+		}
+		
+		*type = ARG_NONE;
+		
+		switch (*format) {
+			case '%':
+				*type = ARG_PERCENT;
+				break;
+			case 'd':
+			case 'i':
+			case 'u':
+			case 'o':
+			case 'x':
+			case 'X':
+			case 'c':
+				if (isSize) {
+					*type = ARG_SIZE;
+				} else if (isPtrdiff) {
+					*type = ARG_PTRDIFF;
+				} else if (longs >= 2) {
+					*type = ARG_LONG_LONG;
+				} else if (longs == 1) {
+					*type = ARG_LONG;
+				} else {
+					*type = ARG_INT;
+				}
+				break;
+			case 'e':
+			case 'E':
+			case 'f':
+			case 'F':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+				*type = (isLongDouble ? ARG_LONG_DOUBLE : ARG_DOUBLE);
+				break;
+			case 's':
+				*type = ARG_STRING;
+				break;
+			case 'p':
+				*type = ARG_POINTER;
+				break;
+		}
+		
+		if (*format != '\0') format++;
+		
+		size_t length = format - start;
+		if (length >= LOG_SPEC_LENGTH) {
+			length = LOG_SPEC_LENGTH - 1;
+			*type = ARG_NONE;
+		}
+		
+		memcpy(spec, start, length);
+		spec[length] = '\0';
+		
+		return format;
+	}
+	
+	/**
+	 * Get the number of bytes an argument occupies in a record.
+	 * @param type Type of the argument.
+	 * @return The size in bytes, or 0 for strings and conversions that take
+	 * no argument.
+	 */
+	size_t getArgSize(ArgType type) {
+		switch (type) {
+			case ARG_INT:
+				return sizeof(int);
+			case ARG_LONG:
+				return sizeof(long);
+			case ARG_LONG_LONG:
+				return sizeof(long long);
+			case ARG_SIZE:
+				return sizeof(size_t);
+			case ARG_PTRDIFF:
+				return sizeof(ptrdiff_t);
+			case ARG_DOUBLE:
+				return sizeof(double);
+			case ARG_LONG_DOUBLE:
+				return sizeof(long double);
+			case ARG_POINTER:
+				return sizeof(void*);
+			default:
+				return 0;
+		}
+	}
+}
+
+void Log::write(int level, const char* format, ...) {
+
+	pthread_once(&_once, init);
+	
+	Buffer* buffer = getBuffer();
+	unsigned int head = buffer->head;
+	
+	// Drop the record rather than wait for the writer thread
+	if (head - buffer->tail >= LOG_BUFFER_RECORDS) {
+		__sync_fetch_and_add(&buffer->dropped, 1);
+		return;
+	}
+	
+	Record* record = &buffer->records[head % LOG_BUFFER_RECORDS];
+	record->sequence = __sync_fetch_and_add(&_sequence, 1);
+	record->level = level;
+	record->format = format;
+	record->argCount = 0;
+	
+	// Copy the raw argument values; they are formatted by the writer thread
+	char spec[LOG_SPEC_LENGTH];
+	size_t length = 0;
+	ArgType type;
+	va_list args;
+	
+	va_start(args, format);
+	
+	while (*format != '\0') {
+		if (*format != '%') {
+			format++;
+			continue;
+		}
+		
+		format = parseConversion(format, spec, &type);
+		
+		if (type == ARG_STRING) {
+			const char* value = va_arg(args, const char*);
+			if (value == NULL) value = "(null)";
+			
+			size_t stringLength = strlen(value);
+			
+			if (length + stringLength + 1 > LOG_RECORD_SIZE) {
+				break;
+			}
+			
+			memcpy(record->args + length, value, stringLength + 1);
+			length += stringLength + 1;
+			record->argCount++;
+			continue;
+		}
+		
+		size_t size = getArgSize(type);
+		if (size == 0) continue;
+		
+		if (length + size > LOG_RECORD_SIZE) break;
+		
+		unsigned char* arg = record->args + length;
+		
+		switch (type) {
+			case ARG_INT: { int value = va_arg(args, int); memcpy(arg, &value, size); break; }
+			case ARG_LONG: { long value = va_arg(args, long); memcpy(arg, &value, size); break; }
+			case ARG_LONG_LONG: { long long value = va_arg(args, long long); memcpy(arg, &value, size); break; }
+			case ARG_SIZE: { size_t value = va_arg(args, size_t); memcpy(arg, &value, size); break; }
+			case ARG_PTRDIFF: { ptrdiff_t value = va_arg(args, ptrdiff_t); memcpy(arg, &value, size); break; }
+			case ARG_DOUBLE: { double value = va_arg(args, double); memcpy(arg, &value, size); break; }
+			case ARG_LONG_DOUBLE: { long double value = va_arg(args, long double); memcpy(arg, &value, size); break; }
+			case ARG_POINTER: { void* value = va_arg(args, void*); memcpy(arg, &value, size); break; }
+			default: break;
+		}
+		
+		length += size;
+		record->argCount++;
+	}
+	
+	va_end(args);
+	
+	// Publish the record only once it has been written
+	__sync_synchronize();
+	buffer->head = head + 1;
+	
+	// Nothing will write the record if the writer has already shut down
+	if (!_isRunning) flush();
+}
+
+void Log::flush() {
+	pthread_mutex_lock(&_mutex);
+	drain();
+	pthread_mutex_unlock(&_mutex);
+}
+
+void Log::init() {
+	pthread_key_create(&_bufferKey, releaseBuffer);
+	
+	_isRunning = true;
+	
+	if (pthread_create(&_thread, NULL, threadMain, NULL) != 0) {
+		perror("Error starting log writer");
+		_isRunning = false;
+		return;
+	}
+	
+	atexit(shutdown);
+}
+
+Log::Buffer* Log::getBuffer() {
+	Buffer* buffer = (Buffer*)pthread_getspecific(_bufferKey);
+	
+	if (buffer != NULL) return buffer;
+	
+	buffer = new Buffer();
+	buffer->head = 0;
+	buffer->tail = 0;
+	buffer->dropped = 0;
+	buffer->isOrphaned = false;
+	
+	pthread_setspecific(_bufferKey, buffer);
+	
+	pthread_mutex_lock(&_mutex);
+	buffer->next = _buffers;
+	_buffers = buffer;
+	pthread_mutex_unlock(&_mutex);
+	
+	return buffer;
+}
+
+void Log::print(const Record* record) {
+	char line[LOG_LINE_LENGTH];
+	char spec[LOG_SPEC_LENGTH];
+	size_t used = 0;
+	size_t offset = 0;
+	unsigned int argIndex = 0;
+	ArgType type;
+	const char* format = record->format;
+	
+	if (record->level == LOG_LEVEL_ERROR) {
+		used = snprintf(line, sizeof(line), "Error: ");
+	} else if (record->level == LOG_LEVEL_WARNING) {
+		used = snprintf(line, sizeof(line), "Warning: ");
+	}
+	
+	while ((*format != '\0') && (used < sizeof(line) - 1)) {
+		if (*format != '%') {
+			line[used++] = *format++;
+			continue;
+		}
+		
+		format = parseConversion(format, spec, &type);
+		
+		const unsigned char* arg = record->args + offset;
+		size_t size = getArgSize(type);
+		size_t remaining = sizeof(line) - used;
+		int written = 0;
+		
+		// Stop at the first argument that did not fit into the record
+		if ((type != ARG_NONE) && (type != ARG_PERCENT)) {
+			if (argIndex == record->argCount) {
+				written = snprintf(line + used, remaining, "...\n");
+				used += ((size_t)written < remaining ? written : remaining - 1);
+				break;
+			}
+			
+			argIndex++;
+		}
+		
+		switch (type) {
+			case ARG_NONE: written = snprintf(line + used, remaining, "%s", spec); break;
+			case ARG_PERCENT: written = snprintf(line + used, remaining, "%%"); break;
+			case ARG_INT: { int value; memcpy(&value, arg, size); written = snprintf(line + used, remaining, spec, value); break; }
+			case ARG_LONG: { long value; memcpy(&value, arg, size); written = snprintf(line + used, remaining, spec, value); break; }
+			case ARG_LONG_LONG: { long long value; memcpy(&value, arg, size); written = snprintf(line + used, remaining, spec, value); break; }
+			case ARG_SIZE: { size_t value; memcpy(&value, arg, size); written = snprintf(line + used, remaining, spec, value); break; }
+			case ARG_PTRDIFF: { ptrdiff_t value; memcpy(&value, arg, size); written = snprintf(line + used, remaining, spec, value); break; }
+			case ARG_DOUBLE: { double value; memcpy(&value, arg, size); written = snprintf(line + used, remaining, spec, value); break; }
+			case ARG_LONG_DOUBLE: { long double value; memcpy(&value, arg, size); written = snprintf(line + used, remaining, spec, value); break; }
+			case ARG_POINTER: { void* value; memcpy(&value, arg, size); written = snprintf(line + used, remaining, spec, value); break; }
+			case ARG_STRING:
+				written = snprintf(line + used, remaining, spec, (const char*)arg);
+				size = strlen((const char*)arg) + 1;
+				break;
+		}
+		
+		offset += size;
+		
+		if (written > 0) used += ((size_t)written < remaining ? written : remaining - 1);
+	}
+	
+	line[used] = '\0';
+	
+	fputs(line, stdout);
+}
+
+void Log::drain() {
+
+	// Print the oldest outstanding record from any buffer until all are empty
+	while (true) {
+		Buffer* oldest = NULL;
+		unsigned int oldestSequence = 0;
+		
+		for (Buffer* buffer = _buffers; buffer != NULL; buffer = buffer->next) {
+			if (buffer->tail == buffer->head) continue;
+			
+			// Ensure the record is read after the head that published it
+			__sync_synchronize();
+			
+			unsigned int sequence = buffer->records[buffer->tail % LOG_BUFFER_RECORDS].sequence;
+			
+			if ((oldest == NULL) || ((int)(sequence - oldestSequence) < 0)) {
+				oldest = buffer;
+				oldestSequence = sequence;
+			}
+		}
+		
+		if (oldest == NULL) break;
+		
+		print(&oldest->records[oldest->tail % LOG_BUFFER_RECORDS]);
+		
+		// Release the slot only once it has been read
+		__sync_synchronize();
+		oldest->tail++;
+	}
+	
+	// Report dropped records and discard the buffers of threads that have
+	// exited
+	Buffer** link = &_buffers;
+	
+	while (*link != NULL) {
+		Buffer* buffer = *link;
+		unsigned int dropped = __sync_fetch_and_and(&buffer->dropped, 0);
+		
+		if (dropped > 0) fprintf(stdout, "Warning: Log dropped %u records\n", dropped);
+		
+		if ((buffer->isOrphaned) && (buffer->tail == buffer->head)) {
+			*link = buffer->next;
+			delete buffer;
+		} else {
+			link = &buffer->next;
+		}
+	}
+	
+	fflush(stdout);
+}
+
+void Log::shutdown() {
+
+	if (!_isRunning) return;
+	
+	_isRunning = false;
+	pthread_join(_thread, NULL);
+	
+	flush();
+}
+
+void Log::releaseBuffer(void* buffer) {
+	((Buffer*)buffer)->isOrphaned = true;
+}
+
+void* Log::threadMain(void* arg) {
+	while (_isRunning) {
+		flush();
+		usleep(LOG_FLUSH_INTERVAL_US);
+	}
+	
+	return NULL;
+}
@@ -0,0 +1,195 @@
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <pthread.h>
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARNING 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef LOG_COMPILED_LEVEL
+#define LOG_COMPILED_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+#define LOG_RECORD_SIZE 256
+#define LOG_BUFFER_RECORDS 1024
+#define LOG_LINE_LENGTH 1024
+#define LOG_FLUSH_INTERVAL_US 10000
+
+/**
+ * Logging macros.  Each takes printf() arguments.  Levels above
+ * LOG_COMPILED_LEVEL compile to nothing, so their arguments are never
+ * evaluated; define LOG_COMPILED_LEVEL before including this header, or in
+ * the build settings, to strip debug logging from a build entirely.  Levels
+ * that are compiled in can still be filtered at run time with
+ * Log::setLevel().
+ */
+#if LOG_COMPILED_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) do { if (WiredMunk::Log::isEnabled(LOG_LEVEL_ERROR)) WiredMunk::Log::write(LOG_LEVEL_ERROR, __VA_ARGS__); } while (0)
+#else
+#define LOG_ERROR(...) do { } while (0)
+#endif
+
+#if LOG_COMPILED_LEVEL >= LOG_LEVEL_WARNING
+#define LOG_WARNING(...) do { if (WiredMunk::Log::isEnabled(LOG_LEVEL_WARNING)) WiredMunk::Log::write(LOG_LEVEL_WARNING, __VA_ARGS__); } while (0)
+#else
+#define LOG_WARNING(...) do { } while (0)
+#endif
+
+#if LOG_COMPILED_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) do { if (WiredMunk::Log::isEnabled(LOG_LEVEL_INFO)) WiredMunk::Log::write(LOG_LEVEL_INFO, __VA_ARGS__); } while (0)
+#else
+#define LOG_INFO(...) do { } while (0)
+#endif
+
+#if LOG_COMPILED_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) do { if (WiredMunk::Log::isEnabled(LOG_LEVEL_DEBUG)) WiredMunk::Log::write(LOG_LEVEL_DEBUG, __VA_ARGS__); } while (0)
+#else
+#define LOG_DEBUG(...) do { } while (0)
+#endif
+
+namespace WiredMunk {
+
+	/**
+	 * Asynchronous leveled logger.  Use the LOG_ERROR, LOG_WARNING, LOG_INFO
+	 * and LOG_DEBUG macros rather than calling write() directly, so that
+	 * disabled levels cost nothing.
+	 *
+	 * Logging a record does not format it.  The format string pointer and
+	 * the raw argument values are copied into a fixed-size slot in a
+	 * lock-free ring buffer owned by the calling thread, and a background
+	 * thread formats the records and writes them to stdout.  Logging from a
+	 * simulation thread therefore costs a short copy rather than a call to
+	 * vsnprintf() and a blocking write.  Records are given a global sequence
+	 * number so that the background thread can print the records from
+	 * different threads in the order in which they were logged.
+	 *
+	 * Because formatting is deferred, the format must be a string literal.
+	 * String arguments are copied, so they need not outlive the call.  The
+	 * arguments of a record must fit into LOG_RECORD_SIZE bytes; any that do
+	 * not are printed as "...".  Supported conversions are those of printf()
+	 * apart from "%n" and "*" widths.
+	 *
+	 * If a thread's ring buffer is full, the record is dropped rather than
+	 * blocking the thread, and the number of dropped records is logged once
+	 * there is room again.  The background thread starts with the first
+	 * record and is stopped, after writing every outstanding record, when the
+	 * process exits.
+	 */
+	class Log {
+	public:
+		
+		/**
+		 * Set the most detailed level to log.
+		 * @param level One of the LOG_LEVEL values.
+		 */
+		static inline void setLevel(int level) { _level = level; };
+		
+		/**
+		 * Get the most detailed level being logged.
+		 * @return The log level.
+		 */
+		static inline int getLevel() { return _level; };
+		
+		/**
+		 * Check if a level is being logged.
+		 * @param level One of the LOG_LEVEL values.
+		 * @return True if records at the level are logged.
+		 */
+		static inline bool isEnabled(int level) { return level <= _level; };
+		
+		/**
+		 * Queue a record for writing.  Uses standard printf() syntax.
+		 * @param level Level of the record.
+		 * @param format Format of the string to print; must be a string
+		 * literal.
+		 * @param ... The values to output.
+		 */
+		static void write(int level, const char* format, ...);
+		
+		/**
+		 * Write every outstanding record immediately.
+		 */
+		static void flush();
+	
+	private:
+		
+		/**
+		 * A single log record.
+		 */
+		struct Record {
+			unsigned int sequence;				/**< Global order of the record */
+			int level;							/**< Level of the record */
+			const char* format;					/**< Format string */
+			unsigned int argCount;				/**< Number of arguments that fit */
+			unsigned char args[LOG_RECORD_SIZE];	/**< Raw argument values */
+		};
+		
+		/**
+		 * Ring buffer of records logged by a single thread.
+		 */
+		struct Buffer {
+			Record records[LOG_BUFFER_RECORDS];	/**< Ring of records */
+			volatile unsigned int head;			/**< Next slot to write; owned by the logging thread */
+			volatile unsigned int tail;			/**< Next slot to read; owned by the writer */
+			volatile unsigned int dropped;		/**< Records dropped since last reported */
+			volatile bool isOrphaned;			/**< Has the logging thread exited? */
+			Buffer* next;						/**< Next buffer in the list */
+		};
+		
+		static volatile int _level;				/**< Most detailed level logged */
+		static volatile unsigned int _sequence;	/**< Sequence number of the next record */
+		static volatile bool _isRunning;		/**< Is the writer thread running? */
+		static Buffer* _buffers;				/**< Buffers of all logging threads */
+		static pthread_mutex_t _mutex;			/**< Guards the buffer list and the writer */
+		static pthread_key_t _bufferKey;		/**< Each thread's buffer */
+		static pthread_once_t _once;			/**< Initialises the logger */
+		static pthread_t _thread;				/**< Writer thread */
+		
+		/**
+		 * Create the thread key and start the writer thread.
+		 */
+		static void init();
+		
+		/**
+		 * Get the calling thread's buffer, creating it if necessary.
+		 * @return The buffer.
+		 */
+		static Buffer* getBuffer();
+		
+		/**
+		 * Format and print a record.
+		 * @param record The record.
+		 */
+		static void print(const Record* record);
+		
+		/**
+		 * Print every outstanding record in sequence order.  Must be called
+		 * with the mutex held.
+		 */
+		static void drain();
+		
+		/**
+		 * Stop the writer thread and write any outstanding records.  Called
+		 * when the process exits.
+		 */
+		static void shutdown();
+		
+		/**
+		 * Mark a thread's buffer as orphaned when the thread exits.
+		 * @param buffer The buffer.
+		 */
+		static void releaseBuffer(void* buffer);
+		
+		/**
+		 * Entry point for the writer thread.
+		 * @param arg Unused.
+		 * @return Always NULL.
+		 */
+		static void* threadMain(void* arg);
+	};
+}
+
+#endif
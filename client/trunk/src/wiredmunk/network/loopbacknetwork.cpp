@@ -0,0 +1,237 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include "loopbacknetwork.h"
+#include "tickscheduler.h"
+
+using namespace WiredMunk;
+
+LoopbackNetwork::LoopbackNetwork(unsigned int seed) {
+	_random = seed;
+	_nextEphemeralPort = LOOPBACK_FIRST_EPHEMERAL_PORT;
+	
+	memset(&_stats, 0, sizeof(_stats));
+	
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+LoopbackNetwork::~LoopbackNetwork() {
+	std::map<unsigned short, Inbox>::iterator inbox;
+	
+	for (inbox = _inboxes.begin(); inbox != _inboxes.end(); ++inbox) {
+		for (Inbox::iterator i = inbox->second.begin(); i != inbox->second.end(); ++i) {
+			delete i->second;
+		}
+	}
+	
+	pthread_mutex_destroy(&_mutex);
+}
+
+void LoopbackNetwork::setLinkSettings(const LinkSettings& settings) {
+	pthread_mutex_lock(&_mutex);
+	_settings = settings;
+	pthread_mutex_unlock(&_mutex);
+}
+
+void LoopbackNetwork::setLinkSettings(unsigned short port, const LinkSettings& settings) {
+	pthread_mutex_lock(&_mutex);
+	_portSettings[port] = settings;
+	pthread_mutex_unlock(&_mutex);
+}
+
+unsigned short LoopbackNetwork::bind(unsigned short port) {
+
+	pthread_mutex_lock(&_mutex);
+	
+	if (port == 0) {
+		
+		// Find the next free port, wrapping around within the ephemeral range
+		while (_inboxes.find(_nextEphemeralPort) != _inboxes.end()) {
+			_nextEphemeralPort = (_nextEphemeralPort == 65535 ? LOOPBACK_FIRST_EPHEMERAL_PORT : _nextEphemeralPort + 1);
+		}
+		
+		port = _nextEphemeralPort;
+	} else if (_inboxes.find(port) != _inboxes.end()) {
+		pthread_mutex_unlock(&_mutex);
+		return 0;
+	}
+	
+	_inboxes[port];
+	
+	pthread_mutex_unlock(&_mutex);
+	
+	return port;
+}
+
+void LoopbackNetwork::unbind(unsigned short port) {
+
+	pthread_mutex_lock(&_mutex);
+	
+	std::map<unsigned short, Inbox>::iterator inbox = _inboxes.find(port);
+	
+	if (inbox != _inboxes.end()) {
+		for (Inbox::iterator i = inbox->second.begin(); i != inbox->second.end(); ++i) {
+			delete i->second;
+		}
+		
+		_inboxes.erase(inbox);
+	}
+	
+	pthread_mutex_unlock(&_mutex);
+}
+
+bool LoopbackNetwork::send(unsigned short port, const struct sockaddr_in* address, const unsigned char* data, unsigned int length) {
+
+	// Too large for the receiving socket.  Refuse it rather than let the
+	// receiver decode a truncated message
+	if (length > LOOPBACK_MAX_DATAGRAM) {
+		pthread_mutex_lock(&_mutex);
+		_stats.oversized++;
+		pthread_mutex_unlock(&_mutex);
+		return false;
+	}
+	
+	unsigned short toPort = ntohs(address->sin_port);
+	unsigned long long now = TickScheduler::getTime();
+	
+	pthread_mutex_lock(&_mutex);
+	
+	_stats.sent++;
+	
+	const LinkSettings& settings = getLinkSettings(port, toPort);
+	std::map<unsigned short, Inbox>::iterator inbox = _inboxes.find(toPort);
+	
+	// Datagrams to ports that nobody has bound vanish, as with UDP
+	if ((inbox == _inboxes.end()) || (nextRandom() < settings.lossRate)) {
+		_stats.lost++;
+		pthread_mutex_unlock(&_mutex);
+		return true;
+	}
+	
+	unsigned long long sendTime = now;
+	
+	if (settings.bandwidth > 0) {
+		
+		// The datagram waits for those ahead of it on the link to be sent
+		unsigned long long& busyUntil = _busyUntil[((unsigned int)port << 16) | toPort];
+		
+		if (busyUntil > now) {
+			if ((settings.queueMs > 0) && (busyUntil - now > settings.queueMs * 1000000ULL)) {
+				_stats.dropped++;
+				pthread_mutex_unlock(&_mutex);
+				return true;
+			}
+			
+			sendTime = busyUntil;
+		}
+		
+		sendTime += (unsigned long long)length * 1000000000ULL / settings.bandwidth;
+		busyUntil = sendTime;
+	}
+	
+	unsigned long long deliveryTime = sendTime + settings.latencyMs * 1000000ULL + getRandomDelay(settings.jitterMs);
+	
+	if (nextRandom() < settings.reorderRate) {
+		deliveryTime += getRandomDelay(settings.reorderDelayMs);
+		_stats.reordered++;
+	}
+	
+	queue(inbox->second, port, data, length, deliveryTime);
+	
+	if (nextRandom() < settings.duplicateRate) {
+		
+		// The copy takes its own path, so may arrive before the original
+		queue(inbox->second, port, data, length, sendTime + settings.latencyMs * 1000000ULL + getRandomDelay(settings.jitterMs));
+		_stats.duplicated++;
+	}
+	
+	pthread_mutex_unlock(&_mutex);
+	
+	return true;
+}
+
+int LoopbackNetwork::receive(unsigned short port, unsigned char* buffer, unsigned int length, struct sockaddr_in* address) {
+
+	unsigned long long now = TickScheduler::getTime();
+	
+	pthread_mutex_lock(&_mutex);
+	
+	std::map<unsigned short, Inbox>::iterator inbox = _inboxes.find(port);
+	
+	// Nothing has arrived yet
+	if ((inbox == _inboxes.end()) || (inbox->second.empty()) || (inbox->second.begin()->first > now)) {
+		pthread_mutex_unlock(&_mutex);
+		return -1;
+	}
+	
+	Datagram* datagram = inbox->second.begin()->second;
+	inbox->second.erase(inbox->second.begin());
+	
+	unsigned int receivedBytes = datagram->data.size();
+	if (receivedBytes > length) receivedBytes = length;
+	
+	// An empty datagram has no storage to copy from
+	if (receivedBytes > 0) memcpy(buffer, &datagram->data[0], receivedBytes);
+	
+	memset(address, 0, sizeof(struct sockaddr_in));
+	address->sin_family = AF_INET;
+	address->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address->sin_port = htons(datagram->fromPort);
+	
+	_stats.delivered++;
+	_stats.bytesDelivered += receivedBytes;
+	
+	pthread_mutex_unlock(&_mutex);
+	
+	delete datagram;
+	
+	return receivedBytes;
+}
+
+LinkStats LoopbackNetwork::getStats() {
+	pthread_mutex_lock(&_mutex);
+	LinkStats stats = _stats;
+	pthread_mutex_unlock(&_mutex);
+	
+	return stats;
+}
+
+void LoopbackNetwork::resetStats() {
+	pthread_mutex_lock(&_mutex);
+	memset(&_stats, 0, sizeof(_stats));
+	pthread_mutex_unlock(&_mutex);
+}
+
+const LinkSettings& LoopbackNetwork::getLinkSettings(unsigned short fromPort, unsigned short toPort) const {
+	std::map<unsigned short, LinkSettings>::const_iterator settings = _portSettings.find(fromPort);
+	
+	if (settings != _portSettings.end()) return settings->second;
+	
+	settings = _portSettings.find(toPort);
+	
+	if (settings != _portSettings.end()) return settings->second;
+	
+	return _settings;
+}
+
+void LoopbackNetwork::queue(Inbox& inbox, unsigned short fromPort, const unsigned char* data, unsigned int length, unsigned long long deliveryTime) {
+	Datagram* datagram = new Datagram();
+	datagram->fromPort = fromPort;
+	datagram->data.assign(data, data + length);
+	
+	// Inserting at the upper bound keeps datagrams due at the same time in
+	// the order they were sent
+	inbox.insert(inbox.upper_bound(deliveryTime), Inbox::value_type(deliveryTime, datagram));
+}
+
+unsigned long long LoopbackNetwork::getRandomDelay(unsigned int maxMs) {
+	if (maxMs == 0) return 0;
+	
+	return (unsigned long long)(nextRandom() * maxMs * 1000000.0);
+}
+
+double LoopbackNetwork::nextRandom() {
+	_random = _random * 6364136223846793005ULL + 1442695040888963407ULL;
+	
+	// The top 53 bits make a double with full precision
+	return (_random >> 11) * (1.0 / 9007199254740992.0);
+}
@@ -16,19 +16,23 @@ Message::Message(MessageType type, unsigned short dataLength, const unsigned cha
 	setData(data, dataLength);
 }
 
-Message::Message(const unsigned char* data, SocketEventHandler* responseHandler) {
+Message::Message(const unsigned char* data, SocketEventHandler* responseHandler, bool copyData) {
 	
 	_responseHandler = responseHandler;
 	
 	_type = (MessageType)data[4];				// 1 byte type
-	_dataLength = (data[5] << 8) | data[6];		// 2 byte length
 	_id = (data[7] << 8) | data[8];				// 2 byte id number
 	
-	if (_dataLength > 0) {
-		_data = new unsigned char[_dataLength];
-		memcpy(_data, data + MESSAGE_HEADER_LENGTH, _dataLength);
+	unsigned short dataLength = (data[5] << 8) | data[6];		// 2 byte length
+	
+	if (copyData) {
+		setData(data + MESSAGE_HEADER_LENGTH, dataLength);
 	} else {
-		_data = NULL;
+		
+		// Refer to the data in place
+		_dataLength = dataLength;
+		_data = (dataLength > 0 ? data + MESSAGE_HEADER_LENGTH : NULL);
+		_ownsData = false;
 	}
 }
 
@@ -42,8 +46,8 @@ Message::Message(Message const& copy) {
 }
 
 Message::~Message() {
-	if (_data != NULL) {
-		delete _data;
+	if ((_data != NULL) && (_ownsData)) {
+		delete[] _data;
 	}
 }
 
@@ -69,9 +73,12 @@ unsigned int Message::getFormattedMessage(unsigned char* buffer) const {
 void Message::setData(const unsigned char* data, unsigned short dataLength) {
 	_dataLength = dataLength;
 	
+	_ownsData = true;
+	
 	if (_dataLength > 0) {
-		_data = new unsigned char[_dataLength];
-		memcpy(_data, data, _dataLength);
+		unsigned char* buffer = new unsigned char[_dataLength];
+		memcpy(buffer, data, _dataLength);
+		_data = buffer;
 	} else {
 		_data = NULL;
 	}
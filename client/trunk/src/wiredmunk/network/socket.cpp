@@ -1,5 +1,7 @@
 #include <fcntl.h>
+#include <arpa/inet.h>
 #include "socket.h"
+#include "log.h"
 
 using namespace WiredMunk;
 
@@ -40,19 +42,39 @@ bool Socket::open(const char* hostName, const int portNum) {
 	return true;
 }
 
+bool Socket::open(LoopbackNetwork* network, const int portNum) {
+	_loopbackPort = network->bind(0);
+	
+	if (_loopbackPort == 0) {
+		LOG_ERROR("Cannot open socket: no free loopback port\n");
+		return false;
+	}
+	
+	_network = network;
+	
+	memset(&_server, 0, sizeof(_server));
+	_server.sin_family = AF_INET;
+	_server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	_server.sin_port = htons(portNum);
+	
+	return true;
+}
+
 int Socket::poll() {
 	
-	unsigned char* buffer;
+	unsigned char buffer[MESSAGE_BUFFER_LENGTH];
 	int receivedBytes;
 	struct sockaddr_in remoteAddress;
 	socklen_t addressLen;
 	
-	buffer = new unsigned char[MESSAGE_BUFFER_LENGTH];
-	
 	addressLen = sizeof(remoteAddress);
 	
 	// Poll socket for data
-	receivedBytes = recvfrom(_socket, buffer, MESSAGE_BUFFER_LENGTH - 1 , 0, (struct sockaddr *)&remoteAddress, &addressLen);
+	if (_network != NULL) {
+		receivedBytes = _network->receive(_loopbackPort, buffer, MESSAGE_BUFFER_LENGTH - 1, &remoteAddress);
+	} else {
+		receivedBytes = recvfrom(_socket, buffer, MESSAGE_BUFFER_LENGTH - 1 , 0, (struct sockaddr *)&remoteAddress, &addressLen);
+	}
 	
 	// Ensure buffer terminates correctly
 	buffer[MESSAGE_BUFFER_LENGTH - 1] = '\0';
@@ -61,12 +83,10 @@ int Socket::poll() {
 	switch (receivedBytes) {
 		case -1:
 			// No data received
-			delete buffer;
 			return 0;
 		case 0:
 			// Socket closed
 			// TODO: Handle this gracefully instead of ignoring it
-			delete buffer;
 			return 0;
 		default:
 			// Data received
@@ -75,11 +95,11 @@ int Socket::poll() {
 			if (strncmp(MESSAGE_HEADER, (char*)buffer, 4) != 0) {
 				
 				// Not a valid message - discard it
-				delete buffer;
 				return 0;
 			}
 			
 			// Valid message received
+			_bytesReceived += receivedBytes;
 			
 			// Attempt to treat message as a rely
 			if (!handleReply(buffer, receivedBytes)) {
@@ -88,14 +108,13 @@ int Socket::poll() {
 				raiseMessageReceivedEvent(buffer, receivedBytes);
 			}
 			
-			// Clean up
-			delete buffer;
-			
 			return receivedBytes;
     }
 }
 
 bool Socket::write(const unsigned char* data, unsigned int length) const {
+	if (_network != NULL) return _network->send(_loopbackPort, &_server, data, length);
+	
 	int sentBytes = sendto(_socket, data, length, 0, (struct sockaddr*)&_server, sizeof(struct sockaddr_in));
 	
 	if (sentBytes == -1) {
@@ -107,8 +126,18 @@ bool Socket::write(const unsigned char* data, unsigned int length) const {
 }
 
 void Socket::shut() {
+	if (_network != NULL) {
+		_network->unbind(_loopbackPort);
+		_network = NULL;
+		_loopbackPort = 0;
+	}
+	
+	if (_socket < 0) return;
+	
 	shutdown(_socket, 2);
 	close(_socket);
+	
+	_socket = -1;
 }
 
 void Socket::addSocketEventHandler(SocketEventHandler* handler) {
@@ -124,10 +153,23 @@ void Socket::removeSocketEventHandler(SocketEventHandler* handler) {
 	}
 }
 
+bool Socket::isCompleteMessage(const unsigned char* data, int receivedBytes) {
+	if (receivedBytes < MESSAGE_HEADER_LENGTH) return false;
+	
+	unsigned short dataLength = (data[5] << 8) | data[6];		// 2 byte length
+	
+	return MESSAGE_HEADER_LENGTH + dataLength <= receivedBytes;
+}
+
 void Socket::raiseMessageReceivedEvent(unsigned char* data, int receivedBytes) const {
 	
-	// Construct a message
-	Message msg(data);
+	// Messages refer to the receive buffer, so a datagram shorter than its
+	// header claims would have handlers read past the received data
+	if (!isCompleteMessage(data, receivedBytes)) return;
+	
+	// Construct a message that refers to the receive buffer rather than
+	// copying it, as the message does not outlive this call
+	Message msg(data, NULL, false);
 	
 	// Notify all handlers of the event
 	for (unsigned int i = 0; i < _eventHandlers.size(); ++i) {
@@ -142,7 +184,7 @@ void Socket::sendMessage(const Message* msg) {
 	
 	msg->getFormattedMessage(msgData);
 	
-	write(msgData, msgLength);
+	if (write(msgData, msgLength)) _bytesSent += msgLength;
 	
 	// Add a copy of the message to the pending list if it is expecting a
 	// reply.
@@ -155,8 +197,11 @@ void Socket::sendMessage(const Message* msg) {
 
 bool Socket::handleReply(unsigned char* data, int receivedBytes) {
 	
-	// Construct a message object using the received data
-	Message msg(data);
+	// Incomplete messages are not replies, and are dropped when raised
+	if (!isCompleteMessage(data, receivedBytes)) return false;
+	
+	// Construct a message object that refers to the received data
+	Message msg(data, NULL, false);
 	
 	Message* pendingMsg;
 	
@@ -14,6 +14,7 @@
 
 #include "socketeventhandler.h"
 #include "message.h"
+#include "loopbacknetwork.h"
 
 #define MESSAGE_BUFFER_LENGTH 16384
 
@@ -22,7 +23,8 @@ namespace WiredMunk {
 	/**
 	 * Represents a socket that can be opened to connect to a server.  Socket is
 	 * bidirectional and messages can be both sent and received.  Uses UDP
-	 * datagrams for communication.  All calls are non-blocking.
+	 * datagrams for communication, or an in-process LoopbackNetwork if opened
+	 * on one.  All calls are non-blocking.
 	 */
 	class Socket {
 	public:
@@ -30,7 +32,7 @@ namespace WiredMunk {
 		/**
 		 * Constructor.
 		 */
-		inline Socket() { };
+		inline Socket() { _socket = -1; _network = NULL; _loopbackPort = 0; _bytesSent = 0; _bytesReceived = 0; };
 		
 		/**
 		 * Open a connection.
@@ -40,6 +42,15 @@ namespace WiredMunk {
 		 */
 		bool open(const char* hostName, const int portNum);
 		
+		/**
+		 * Open a connection to a server on a loopback network instead of UDP.
+		 * The socket is bound to any free port on the network.
+		 * @param network The network to open the socket on.
+		 * @param portNum Port number of the server on the network.
+		 * @return True if the socket connected successfully.
+		 */
+		bool open(LoopbackNetwork* network, const int portNum);
+		
 		/**
 		 * Close the socket.
 		 */
@@ -75,11 +86,28 @@ namespace WiredMunk {
 		 */
 		void sendMessage(const Message* msg);
 		
+		/**
+		 * Get the number of bytes sent to the server.
+		 * @return The number of bytes sent.
+		 */
+		inline unsigned long long getBytesSent() const { return _bytesSent; };
+		
+		/**
+		 * Get the number of bytes of valid messages received from the
+		 * server.
+		 * @return The number of bytes received.
+		 */
+		inline unsigned long long getBytesReceived() const { return _bytesReceived; };
+	
 	private:
 		int _socket;										/**< Socket file descriptor */
+		LoopbackNetwork* _network;							/**< Loopback network the socket is open on, or NULL */
+		unsigned short _loopbackPort;						/**< Port bound on the loopback network */
 		struct sockaddr_in _server;							/**< Address of the server */
 		std::vector<SocketEventHandler*> _eventHandlers;	/**< List of event handlers */
 		std::vector<Message*> _responsePendingMessages;		/**< List of messages awaiting a response */
+		unsigned long long _bytesSent;						/**< Bytes sent to the server */
+		unsigned long long _bytesReceived;					/**< Bytes received from the server */
 		
 		/**
 		 * Write data to the socket.
@@ -103,6 +131,15 @@ namespace WiredMunk {
 		 * @return True if the message was handled as a reply; false if not.
 		 */
 		bool handleReply(unsigned char* data, int receivedBytes);
+		
+		/**
+		 * Check that a received datagram holds the whole message its header
+		 * describes.
+		 * @param data Data received in message.
+		 * @param receivedBytes Number of bytes received.
+		 * @return True if the header and all of its data were received.
+		 */
+		static bool isCompleteMessage(const unsigned char* data, int receivedBytes);
 	};
 }
 
@@ -1,50 +1,42 @@
 #include "networkobject.h"
-#include "socket.h"
 #include "wiredmunkapp.h"
-#include "message.h"
-
-#include <stdio.h>
 
 using namespace WiredMunk;
 
-unsigned int NetworkObject::_nextId = 0;
+HandleAllocator NetworkObject::_idAllocator;
 
 NetworkObject::NetworkObject() {
-	_objectId = getNextId();
 	_isAltered = false;
+	
+	// Use a leased ID if one is available
+	WiredMunkApp* app = WiredMunkApp::getApp();
+	
+	if ((app != NULL) && (app->getObjectIdPool()->takeId(&_objectId))) {
+		_isIdOwner = false;
+		_isIdLeased = true;
+	} else {
+		
+		// Fold the client ID into the local ID so that it is unique across
+		// the network
+		unsigned int clientId = (app != NULL ? app->getClientId() : 0);
+		
+		_objectId = NETWORK_OBJECT_LOCAL_ID_FLAG;
+		_objectId |= (clientId & NETWORK_OBJECT_LOCAL_CLIENT_MASK) << NETWORK_OBJECT_LOCAL_CLIENT_SHIFT;
+		_objectId |= _idAllocator.allocate() & NETWORK_OBJECT_LOCAL_HANDLE_MASK;
+		_isIdOwner = true;
+		_isIdLeased = false;
+	}
 }
 
 NetworkObject::NetworkObject(const unsigned char* serialisedData) {
+	_isIdOwner = false;
+	_isIdLeased = false;
 	_isAltered = false;
 	deserialise(serialisedData);
 }
 
-void NetworkObject::requestObjectId() {
-	Socket* socket = WiredMunkApp::getApp()->getSocket();
-	
-	Message msg(Message::MESSAGE_OBJECT_ID, 0, NULL, this);
-	
-	socket->sendMessage(&msg);
-}
-
-void NetworkObject::handleResponseReceived(const Message& msg) {
-	
-	switch (msg.getType()) {
-		case Message::MESSAGE_OBJECT_ID:
-			
-			// Received an object ID - extract it
-			_objectId = SerialiseBase::deserialiseInt(msg.getData());
-			
-			printf("Received object ID: %d\n", _objectId);
-			
-			// Transmit the object across the network
-			sendObject();
-			
-			break;
-			
-		default:
-			break;
-	}
+NetworkObject::~NetworkObject() {
+	releaseObjectId();
 }
 
 unsigned int NetworkObject::serialise(unsigned char* buffer) {
@@ -61,5 +53,23 @@ unsigned int NetworkObject::getSerialisedLength() {
 }
 
 void NetworkObject::setObjectId(unsigned int objectId) {
+
+	// Return the ID that is being replaced
+	releaseObjectId();
+	
 	_objectId = objectId;
 }
+
+void NetworkObject::releaseObjectId() {
+	if (_isIdOwner) {
+		_idAllocator.release(_objectId & NETWORK_OBJECT_LOCAL_HANDLE_MASK);
+		_isIdOwner = false;
+	}
+	
+	if (_isIdLeased) {
+		WiredMunkApp* app = WiredMunkApp::getApp();
+		
+		if (app != NULL) app->getObjectIdPool()->releaseId(_objectId);
+		_isIdLeased = false;
+	}
+}
@@ -3,6 +3,12 @@
 
 #include "socketeventhandler.h"
 #include "serialisebase.h"
+#include "handleallocator.h"
+
+#define NETWORK_OBJECT_LOCAL_ID_FLAG 0x80000000
+#define NETWORK_OBJECT_LOCAL_CLIENT_SHIFT 20
+#define NETWORK_OBJECT_LOCAL_CLIENT_MASK 0x7FF
+#define NETWORK_OBJECT_LOCAL_HANDLE_MASK 0xFFFFF
 
 namespace WiredMunk {
 
@@ -14,7 +20,12 @@ namespace WiredMunk {
 	public:
 		
 		/**
-		 * Constructor.
+		 * Constructor.  Takes an ID from the block of IDs leased from the
+		 * server.  If no leased IDs are available, an ID is allocated locally
+		 * instead.  Local IDs have NETWORK_OBJECT_LOCAL_ID_FLAG set and
+		 * include the client's ID, so they cannot clash with leased IDs or
+		 * with the local IDs of other clients.  Each client can hold up to
+		 * 4096 local IDs at once.
 		 */
 		NetworkObject();
 		
@@ -25,6 +36,12 @@ namespace WiredMunk {
 		 */
 		NetworkObject(const unsigned char* serialisedData);
 
+		/**
+		 * Destructor.  Releases the object's ID for reuse.  Leased IDs are
+		 * returned to the server.
+		 */
+		virtual ~NetworkObject();
+		
 		/**
 		 * Gets the object's id.  The id is unique across the network.
 		 * @return The object's id.
@@ -32,10 +49,13 @@ namespace WiredMunk {
 		inline unsigned int getObjectId() const { return _objectId; };
 		
 		/**
-		 * Process response received events.  Checks for incoming object ID.
-		 * @param msg Message to be processed.
+		 * Read the object ID from a serialised object without deserialising
+		 * the rest of the object.  Works for any serialised NetworkObject, as
+		 * the ID is always the first item serialised.
+		 * @param serialisedData The serialised object.
+		 * @return The object's id.
 		 */
-		virtual void handleResponseReceived(const Message& msg);
+		inline static unsigned int peekObjectId(const unsigned char* serialisedData) { return SerialiseBase::deserialiseInt(serialisedData); };
 		
 		/**
 		 * Stores a serialised representation of the object.  The buffer must be
@@ -89,19 +109,15 @@ namespace WiredMunk {
 		
 	private:		
 		unsigned int _objectId;				/**< The object's id, unique across the network */
-		static unsigned int _nextId;		/**< The next ID to be generated */
+		bool _isIdOwner;					/**< Was the ID allocated by this object? */
+		bool _isIdLeased;					/**< Was the ID taken from the leased pool? */
+		static HandleAllocator _idAllocator;	/**< Allocates locally generated IDs */
 		bool _isAltered;					/**< Has the object been manually altered? */
 		
 		/**
-		 * Requests a unique ID for the object from the server.
-		 */
-		void requestObjectId();
-		
-		/**
-		 * Get the next unique ID.
-		 * @return The next unique ID.
+		 * Release the object's ID, either locally or back to the server.
 		 */
-		inline static unsigned int getNextId() { return _nextId++; };
+		void releaseObjectId();
 	};
 }
 
@@ -0,0 +1,113 @@
+#include "objectidpool.h"
+#include "serialisebase.h"
+#include "log.h"
+
+using namespace WiredMunk;
+
+ObjectIdPool::ObjectIdPool(Socket* socket) {
+	_socket = socket;
+	_isRequestPending = false;
+}
+
+bool ObjectIdPool::takeId(unsigned int* objectId) {
+
+	// Hand out IDs from the end of the pool so that the pool can shrink
+	// without shuffling
+	bool hasId = _objectIds.size() > 0;
+	
+	if (hasId) {
+		*objectId = _objectIds.back();
+		_objectIds.pop_back();
+	}
+	
+	topUp();
+	
+	return hasId;
+}
+
+void ObjectIdPool::topUp() {
+
+	if (_objectIds.size() >= OBJECT_ID_POOL_LOW_WATER) return;
+	
+	// Do not flood the server with requests whilst waiting for a reply,
+	// unless the reply appears to have been lost
+	if (_isRequestPending) {
+		struct timeval now;
+		struct timeval timeDiff;
+		
+		gettimeofday(&now, NULL);
+		timersub(&now, &_requestTime, &timeDiff);
+		
+		if ((timeDiff.tv_sec * 1000000) + timeDiff.tv_usec < OBJECT_ID_POOL_TIMEOUT) return;
+	}
+	
+	// Request a block of IDs
+	unsigned char data[SERIALISED_SHORT_SIZE];
+	SerialiseBase::serialise((unsigned short)OBJECT_ID_POOL_BLOCK_SIZE, data);
+	
+	Message msg(Message::MESSAGE_OBJECT_ID, SERIALISED_SHORT_SIZE, data, this);
+	_socket->sendMessage(&msg);
+	
+	_isRequestPending = true;
+	gettimeofday(&_requestTime, NULL);
+}
+
+void ObjectIdPool::releaseId(unsigned int objectId) {
+	_releasedIds.push_back(objectId);
+	
+	if (_releasedIds.size() >= OBJECT_ID_POOL_RELEASE_BATCH) sendReleasedIds();
+}
+
+void ObjectIdPool::returnAll() {
+	_releasedIds.insert(_releasedIds.end(), _objectIds.begin(), _objectIds.end());
+	_objectIds.clear();
+	
+	sendReleasedIds();
+}
+
+void ObjectIdPool::sendReleasedIds() {
+
+	// Send the IDs in batches so that each message stays small
+	unsigned char data[OBJECT_ID_POOL_RELEASE_BATCH * SERIALISED_INT_SIZE];
+	unsigned int sent = 0;
+	
+	while (sent < _releasedIds.size()) {
+		unsigned int count = _releasedIds.size() - sent;
+		if (count > OBJECT_ID_POOL_RELEASE_BATCH) count = OBJECT_ID_POOL_RELEASE_BATCH;
+		
+		for (unsigned int i = 0; i < count; ++i) {
+			SerialiseBase::serialise(_releasedIds[sent + i], data + (i * SERIALISED_INT_SIZE));
+		}
+		
+		Message msg(Message::MESSAGE_OBJECT_ID_RELEASE, count * SERIALISED_INT_SIZE, data);
+		_socket->sendMessage(&msg);
+		
+		sent += count;
+	}
+	
+	_releasedIds.clear();
+}
+
+void ObjectIdPool::handleResponseReceived(const Message& msg) {
+
+	switch (msg.getType()) {
+		case Message::MESSAGE_OBJECT_ID:
+		{
+			// Reply contains a list of IDs
+			const unsigned char* data = msg.getData();
+			unsigned int count = msg.getDataLength() / SERIALISED_INT_SIZE;
+			
+			for (unsigned int i = 0; i < count; ++i) {
+				_objectIds.push_back(SerialiseBase::deserialiseInt(data));
+				data += SERIALISED_INT_SIZE;
+			}
+			
+			_isRequestPending = false;
+			
+			LOG_DEBUG("Received %d object IDs\n", count);
+			break;
+		}
+		default:
+			break;
+	}
+}
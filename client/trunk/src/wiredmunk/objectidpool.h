@@ -0,0 +1,91 @@
+#ifndef _OBJECT_ID_POOL_H_
+#define _OBJECT_ID_POOL_H_
+
+#include <vector>
+#include <sys/time.h>
+
+#include "socketeventhandler.h"
+#include "socket.h"
+#include "message.h"
+
+#define OBJECT_ID_POOL_BLOCK_SIZE 64
+#define OBJECT_ID_POOL_LOW_WATER 16
+#define OBJECT_ID_POOL_TIMEOUT 1000000
+#define OBJECT_ID_POOL_RELEASE_BATCH 64
+
+namespace WiredMunk {
+
+	/**
+	 * Pool of network object IDs leased from the server in blocks.  Objects
+	 * take their IDs from the pool when they are created, so object creation
+	 * completes locally without waiting for a round trip to the server.
+	 * Whenever the pool runs low a new block is requested in the background;
+	 * requests that go unanswered for OBJECT_ID_POOL_TIMEOUT microseconds are
+	 * sent again.
+	 *
+	 * IDs that are no longer needed are returned to the server in batches of
+	 * OBJECT_ID_POOL_RELEASE_BATCH, so that the server can reuse them.
+	 */
+	class ObjectIdPool : public SocketEventHandler {
+	public:
+		
+		/**
+		 * Constructor.
+		 * @param socket Socket connected to the server.
+		 */
+		ObjectIdPool(Socket* socket);
+		
+		/**
+		 * Take an ID from the pool.  Requests more IDs from the server if the
+		 * pool is running low.
+		 * @param objectId Pointer to an int that will receive the ID.
+		 * @return True if an ID was taken; false if the pool is empty.
+		 */
+		bool takeId(unsigned int* objectId);
+		
+		/**
+		 * Request a new block of IDs from the server if the pool is running
+		 * low and no request is already outstanding.
+		 */
+		void topUp();
+		
+		/**
+		 * Return a leased ID that is no longer in use.  The ID is queued and
+		 * sent back to the server once a full batch has been collected.
+		 * @param objectId The ID to return.
+		 */
+		void releaseId(unsigned int objectId);
+		
+		/**
+		 * Return all unused and queued IDs to the server.  Should be called
+		 * before the client disconnects.
+		 */
+		void returnAll();
+		
+		/**
+		 * Process response received events.  Adds the leased IDs to the pool.
+		 * @param msg Message to be processed.
+		 */
+		virtual void handleResponseReceived(const Message& msg);
+		
+		/**
+		 * Get the number of IDs available in the pool.
+		 * @return The number of IDs available.
+		 */
+		inline unsigned int getAvailableCount() const { return _objectIds.size(); };
+	
+	private:
+		Socket* _socket;						/**< Socket connected to the server */
+		std::vector<unsigned int> _objectIds;	/**< IDs available for use */
+		std::vector<unsigned int> _releasedIds;	/**< IDs waiting to be returned to the server */
+		bool _isRequestPending;					/**< Is a block request awaiting a reply? */
+		struct timeval _requestTime;			/**< Time that the last block was requested */
+		
+		/**
+		 * Send the queued IDs back to the server.
+		 */
+		void sendReleasedIds();
+	};
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include <cstring>
+#include <unistd.h>
+#include "positionsampler.h"
+#include "serialisebase.h"
+#include "body.h"
+#include "log.h"
+
+using namespace WiredMunk;
+
+PositionSampler::PositionSampler(unsigned int capacity) {
+
+	// Round the capacity up to a power of two so that slots can be found
+	// with a mask
+	unsigned int size = 1;
+	while (size < capacity) size <<= 1;
+	
+	_samples = NULL;
+	_mask = size - 1;
+	_head = 0;
+	_tail = 0;
+	_interval = SAMPLER_DEFAULT_INTERVAL;
+	_droppedTicks = 0;
+	_writtenSamples = 0;
+	_file = NULL;
+	_isRunning = false;
+}
+
+PositionSampler::~PositionSampler() {
+	close();
+	
+	delete[] _samples;
+}
+
+bool PositionSampler::open(const char* fileName, Source source, unsigned int sourceId, unsigned int physicsRate) {
+
+	close();
+	
+	_file = fopen(fileName, "wb");
+	if (_file == NULL) {
+		perror("Error opening sample file");
+		return false;
+	}
+	
+	unsigned char header[SAMPLER_FILE_HEADER_LENGTH];
+	memcpy(header, SAMPLER_HEADER, SAMPLER_HEADER_LENGTH);
+	SerialiseBase::serialise((unsigned short)SAMPLER_VERSION, header + 4);
+	header[6] = (unsigned char)source;
+	SerialiseBase::serialise(sourceId, header + 7);
+	SerialiseBase::serialise((unsigned short)physicsRate, header + 11);
+	
+	fwrite(header, 1, SAMPLER_FILE_HEADER_LENGTH, _file);
+	
+	// The ring buffer is only allocated once sampling is enabled, as most
+	// simulations are never sampled
+	if (_samples == NULL) _samples = new Sample[_mask + 1];
+	
+	_head = 0;
+	_tail = 0;
+	_isRunning = true;
+	
+	if (pthread_create(&_thread, NULL, threadMain, this) != 0) {
+		perror("Error starting sampler thread");
+		_isRunning = false;
+		fclose(_file);
+		_file = NULL;
+		return false;
+	}
+	
+	LOG_INFO("Sampling positions: %s\n", fileName);
+	
+	return true;
+}
+
+void PositionSampler::close() {
+
+	if (!_isRunning) return;
+	
+	_isRunning = false;
+	pthread_join(_thread, NULL);
+	
+	// Write anything that arrived after the thread's last flush
+	flush();
+	
+	fclose(_file);
+	_file = NULL;
+	
+	if (_droppedTicks > 0) LOG_WARNING("Sampler dropped %u ticks\n", _droppedTicks);
+}
+
+void PositionSampler::sample(Space* space, unsigned int tick) {
+
+	if (!_isRunning) return;
+	if (tick % _interval != 0) return;
+	
+	BodyVector* bodies = space->getBodies();
+	unsigned int count = bodies->size();
+	unsigned int head = _head;
+	
+	// Drop the whole tick rather than wait for the writer if there is not
+	// room for every body
+	if (head - _tail + count > _mask + 1) {
+		_droppedTicks++;
+		return;
+	}
+	
+	for (unsigned int i = 0; i < count; ++i) {
+		Body* body = bodies->at(i);
+		Sample* sample = &_samples[(head + i) & _mask];
+		
+		sample->tick = tick;
+		sample->objectId = body->getObjectId();
+		sample->x = body->getPosition().x;
+		sample->y = body->getPosition().y;
+		sample->angle = body->getAngle();
+	}
+	
+	// Publish the samples only once they have been written
+	__sync_synchronize();
+	_head = head + count;
+}
+
+void PositionSampler::flush() {
+	unsigned char buffer[SAMPLER_RECORD_LENGTH * SAMPLER_WRITE_BUFFER_RECORDS];
+	unsigned int used = 0;
+	unsigned int tail = _tail;
+	unsigned int head = _head;
+	
+	// Ensure the samples are read after the head that published them
+	__sync_synchronize();
+	
+	while (tail != head) {
+		const Sample* sample = &_samples[tail & _mask];
+		unsigned char* record = buffer + used;
+		
+		SerialiseBase::serialise(sample->tick, record);
+		SerialiseBase::serialise(sample->objectId, record + 4);
+		SerialiseBase::serialise(sample->x, record + 8);
+		SerialiseBase::serialise(sample->y, record + 16);
+		SerialiseBase::serialise(sample->angle, record + 24);
+		
+		used += SAMPLER_RECORD_LENGTH;
+		tail++;
+		
+		if (used == sizeof(buffer)) {
+			fwrite(buffer, 1, used, _file);
+			used = 0;
+		}
+	}
+	
+	if (used > 0) fwrite(buffer, 1, used, _file);
+	
+	_writtenSamples += head - _tail;
+	
+	// Release the slots only once they have been read
+	__sync_synchronize();
+	_tail = tail;
+	
+	fflush(_file);
+}
+
+void PositionSampler::run() {
+	while (_isRunning) {
+		flush();
+		usleep(SAMPLER_FLUSH_INTERVAL_US);
+	}
+}
+
+void* PositionSampler::threadMain(void* sampler) {
+	((PositionSampler*)sampler)->run();
+	return NULL;
+}
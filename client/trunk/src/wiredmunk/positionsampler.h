@@ -2,64 +2,167 @@
 #define _POSITION_SAMPLER_H_
 
 #include <stdio.h>
+#include <pthread.h>
 #include "space.h"
-#include "body.h"
-#include "wiredmunkapp.h"
 
-#define SAMPLER_FILE_NAME "/Users/antonydzeryn/client_positions_"
-#define SAMPLER_FILE_EXTENSION ".txt"
-#define SAMPLER_RESOLUTION 20
-//#define SAMPLER_ENABLED
+#define SAMPLER_HEADER "WDMS"
+#define SAMPLER_HEADER_LENGTH 4
+#define SAMPLER_VERSION 1
+#define SAMPLER_FILE_HEADER_LENGTH 13
+#define SAMPLER_RECORD_LENGTH 32
+#define SAMPLER_DEFAULT_CAPACITY 16384
+#define SAMPLER_DEFAULT_INTERVAL 1
+#define SAMPLER_FLUSH_INTERVAL_US 10000
+#define SAMPLER_WRITE_BUFFER_RECORDS 256
+
+/**
+ * Sample file format (all values big-endian, as written by SerialiseBase):
+ * 4 byte header: WDMS (identify file as a wired munk sample file)
+ * 2 byte format version
+ * 1 byte source: 0 for the server, 1 for a client
+ * 4 byte source ID: room ID on the server, client ID on a client
+ * 2 byte physics rate, in ticks per second
+ * n records, each consisting of:
+ *   4 byte simulation tick
+ *   4 byte object ID of the body
+ *   8 byte x position
+ *   8 byte y position
+ *   8 byte angle
+ */
 
 namespace WiredMunk {
-	
+
 	/**
-	 * Takes a snapshot of the x, y and rotation values of all bodies in the
-	 * space and saves them to a text file.  Values can be compared using the
-	 * separate sampleranalyser program in order to determine how accurately
-	 * WiredMunk stays in sync.
+	 * Records the position and angle of every body in the space, stamped
+	 * with the simulation tick, so that client and server traces can be
+	 * compared by the bundled sampleranalyser tool to measure how far
+	 * simulations drift apart between resyncs.
+	 *
+	 * Sampling is off until open() is called.  Samples are copied into a
+	 * lock-free single-producer, single-consumer ring buffer, and a
+	 * background thread serialises them and writes them to disk, so the
+	 * simulation thread never waits for the file.  If the ring buffer does
+	 * not have room for every body in a tick, the whole tick is dropped and
+	 * counted instead, ensuring that each tick in the file is complete.
+	 *
+	 * sample() must only be called from one thread.
 	 */
 	class PositionSampler {
 	public:
-		PositionSampler() {
-#ifdef SAMPLER_ENABLED
-			char fileName[strlen(SAMPLER_FILE_NAME) + strlen(SAMPLER_FILE_EXTENSION) + 2];
-			strcpy(fileName, SAMPLER_FILE_NAME);
-			sprintf(fileName + strlen(SAMPLER_FILE_NAME), "%d", WiredMunkApp::getApp()->getClientId());
-			strcpy(fileName + strlen(SAMPLER_FILE_NAME) + 1, SAMPLER_FILE_EXTENSION);
-			
-			_file = fopen(fileName, "a+");
-			_ticks = 0;
-#endif
-		}
 		
-		~PositionSampler() {
-#ifdef SAMPLER_ENABLED
-			fclose(_file);
-#endif
-		}
+		/**
+		 * Source of a sample file.
+		 */
+		enum Source {
+			SOURCE_SERVER = 0,				/**< Samples taken by the server */
+			SOURCE_CLIENT = 1				/**< Samples taken by a client */
+		};
 		
-		void sample(Space* space) {
-#ifdef SAMPLER_ENABLED
-			_ticks++;
-			
-			if (_ticks == SAMPLER_RESOLUTION) {
-				BodyVector* bodies = space->getBodies();
-				Body* body;
-				for (int i = 0; i < bodies->size(); ++i) {
-					body = bodies->at(i);
-					
-					fprintf(_file, "%d,%f,%f,%f\n", body->getObjectId(), body->getPosition().x, body->getPosition().y, body->getAngle());
-				}
-				
-				_ticks = 0;
-			}
-#endif
-		}
+		/**
+		 * Constructor.
+		 * @param capacity Number of samples the ring buffer can hold.  Rounded
+		 * up to a power of two.  The buffer is not allocated until a file is
+		 * opened.
+		 */
+		PositionSampler(unsigned int capacity = SAMPLER_DEFAULT_CAPACITY);
+		
+		/**
+		 * Destructor.  Writes any outstanding samples and closes the file.
+		 */
+		~PositionSampler();
+		
+		/**
+		 * Open a sample file and start the writer thread.  Any existing file
+		 * is overwritten.
+		 * @param fileName Name of the sample file.
+		 * @param source Whether the samples come from the server or a client.
+		 * @param sourceId ID of the room or client taking the samples.
+		 * @param physicsRate Number of simulation ticks per second.
+		 * @return True if the file was opened successfully.
+		 */
+		bool open(const char* fileName, Source source, unsigned int sourceId, unsigned int physicsRate);
+		
+		/**
+		 * Write any outstanding samples, stop the writer thread and close the
+		 * file.
+		 */
+		void close();
+		
+		/**
+		 * Sample every body in the space if sampling is enabled and the tick
+		 * falls on the sample interval.
+		 * @param space Space to sample.
+		 * @param tick Current simulation tick.
+		 */
+		void sample(Space* space, unsigned int tick);
 		
+		/**
+		 * Set the number of ticks between samples.  Only ticks that are a
+		 * multiple of the interval are sampled, so that a client and server
+		 * with the same interval sample the same ticks.
+		 * @param interval Number of ticks between samples.
+		 */
+		inline void setInterval(unsigned int interval) { _interval = (interval < 1 ? 1 : interval); };
+		
+		/**
+		 * Check if sampling is enabled.
+		 * @return True if a sample file is open.
+		 */
+		inline bool isOpen() const { return _isRunning; };
+		
+		/**
+		 * Get the number of ticks dropped because the ring buffer was full.
+		 * @return The number of dropped ticks.
+		 */
+		inline unsigned int getDroppedTicks() const { return _droppedTicks; };
+		
+		/**
+		 * Get the number of samples written to disk.
+		 * @return The number of samples written.
+		 */
+		inline unsigned long long getWrittenSamples() const { return _writtenSamples; };
+	
 	private:
-		FILE* _file;
-		int _ticks;
+		
+		/**
+		 * State of a single body at a single tick.
+		 */
+		struct Sample {
+			unsigned int tick;					/**< Simulation tick */
+			unsigned int objectId;				/**< Object ID of the body */
+			double x;							/**< X position */
+			double y;							/**< Y position */
+			double angle;						/**< Angle */
+		};
+		
+		Sample* _samples;						/**< Ring buffer */
+		unsigned int _mask;						/**< Capacity of the ring buffer minus one */
+		volatile unsigned int _head;			/**< Next slot to write; owned by the producer */
+		volatile unsigned int _tail;			/**< Next slot to read; owned by the writer thread */
+		unsigned int _interval;					/**< Ticks between samples */
+		unsigned int _droppedTicks;				/**< Ticks dropped because the buffer was full */
+		unsigned long long _writtenSamples;		/**< Samples written to disk */
+		FILE* _file;							/**< Sample file */
+		pthread_t _thread;						/**< Writer thread */
+		volatile bool _isRunning;				/**< Is the writer thread running? */
+		
+		/**
+		 * Serialise and write every sample in the ring buffer.
+		 */
+		void flush();
+		
+		/**
+		 * Writer thread loop.  Flushes the ring buffer periodically until the
+		 * sampler is closed.
+		 */
+		void run();
+		
+		/**
+		 * Entry point for the writer thread.
+		 * @param sampler The sampler that owns the thread.
+		 * @return Always NULL.
+		 */
+		static void* threadMain(void* sampler);
 	};
 }
 
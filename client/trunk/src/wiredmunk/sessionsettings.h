@@ -0,0 +1,133 @@
+#ifndef _SESSION_SETTINGS_H_
+#define _SESSION_SETTINGS_H_
+
+#include "serialisebase.h"
+
+#define SESSION_DEFAULT_PHYSICS_RATE 85
+#define SESSION_DEFAULT_SUBSTEPS 1
+#define SESSION_DEFAULT_SEND_RATE 0
+#define SESSION_MAX_PHYSICS_RATE 1000
+#define SESSION_MAX_SUBSTEPS 16
+#define SERIALISED_SESSION_SETTINGS_SIZE 5
+
+namespace WiredMunk {
+
+	/**
+	 * Timing settings for a single session.  The server holds the settings
+	 * for each room and sends them to clients in the handshake reply, so that
+	 * every participant steps the simulation at the same rate.  The first
+	 * client to join a room may propose its own settings in its handshake
+	 * request; later clients must use whatever the room already has.
+	 *
+	 * Settings are serialised as a 2 byte physics rate, 1 byte substep count
+	 * and 2 byte send rate.
+	 */
+	class SessionSettings : public SerialiseBase {
+	public:
+		
+		/**
+		 * Constructor.  Values are clamped to the valid range.
+		 * @param physicsRate Number of simulation ticks per second.
+		 * @param substeps Number of solver steps per tick.
+		 * @param sendRate Number of snapshots of the space sent to clients
+		 * per second, or 0 to send the space only when it changes.
+		 */
+		SessionSettings(unsigned int physicsRate = SESSION_DEFAULT_PHYSICS_RATE, unsigned int substeps = SESSION_DEFAULT_SUBSTEPS, unsigned int sendRate = SESSION_DEFAULT_SEND_RATE) {
+			_physicsRate = physicsRate;
+			_substeps = substeps;
+			_sendRate = sendRate;
+			
+			clamp();
+		};
+		
+		/**
+		 * Get the number of simulation ticks per second.
+		 * @return The physics rate.
+		 */
+		inline unsigned int getPhysicsRate() const { return _physicsRate; };
+		
+		/**
+		 * Get the number of solver steps per tick.
+		 * @return The number of substeps.
+		 */
+		inline unsigned int getSubsteps() const { return _substeps; };
+		
+		/**
+		 * Get the number of snapshots sent per second.
+		 * @return The send rate, or 0 if snapshots are only sent when the
+		 * space changes.
+		 */
+		inline unsigned int getSendRate() const { return _sendRate; };
+		
+		/**
+		 * Get the length of a single solver step.
+		 * @return The length of a substep in seconds.
+		 */
+		inline double getSubstepLength() const { return 1.0 / (_physicsRate * _substeps); };
+		
+		/**
+		 * Get the number of ticks between snapshots.
+		 * @return The number of ticks, or 0 if snapshots are only sent when
+		 * the space changes.
+		 */
+		inline unsigned int getSnapshotInterval() const {
+			if (_sendRate == 0) return 0;
+			
+			unsigned int interval = _physicsRate / _sendRate;
+			
+			return (interval < 1 ? 1 : interval);
+		};
+		
+		/**
+		 * Serialise the settings.
+		 * @param buffer Buffer in which to store serialised data.
+		 * @return The size of the data in serialised form, in bytes.
+		 */
+		unsigned int serialise(unsigned char* buffer) {
+			SerialiseBase::serialise((unsigned short)_physicsRate, buffer);
+			buffer[SERIALISED_SHORT_SIZE] = (unsigned char)_substeps;
+			SerialiseBase::serialise((unsigned short)_sendRate, buffer + SERIALISED_SHORT_SIZE + 1);
+			
+			return SERIALISED_SESSION_SETTINGS_SIZE;
+		};
+		
+		/**
+		 * Deserialise the settings.  Values are clamped to the valid range.
+		 * @param data Data to deserialise.
+		 * @return The size of the data deserialised, in bytes.
+		 */
+		unsigned int deserialise(const unsigned char* data) {
+			_physicsRate = deserialiseShort(data);
+			_substeps = data[SERIALISED_SHORT_SIZE];
+			_sendRate = deserialiseShort(data + SERIALISED_SHORT_SIZE + 1);
+			
+			clamp();
+			
+			return SERIALISED_SESSION_SETTINGS_SIZE;
+		};
+		
+		/**
+		 * Get the length in bytes of the serialised data.
+		 * @return The length in bytes of the serialised data.
+		 */
+		unsigned int getSerialisedLength() { return SERIALISED_SESSION_SETTINGS_SIZE; };
+	
+	private:
+		unsigned int _physicsRate;			/**< Simulation ticks per second */
+		unsigned int _substeps;				/**< Solver steps per tick */
+		unsigned int _sendRate;				/**< Snapshots sent per second */
+		
+		/**
+		 * Clamp the settings to the valid range.
+		 */
+		void clamp() {
+			if (_physicsRate < 1) _physicsRate = 1;
+			if (_physicsRate > SESSION_MAX_PHYSICS_RATE) _physicsRate = SESSION_MAX_PHYSICS_RATE;
+			if (_substeps < 1) _substeps = 1;
+			if (_substeps > SESSION_MAX_SUBSTEPS) _substeps = SESSION_MAX_SUBSTEPS;
+			if (_sendRate > _physicsRate) _sendRate = _physicsRate;
+		};
+	};
+}
+
+#endif
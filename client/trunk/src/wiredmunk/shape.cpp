@@ -2,7 +2,7 @@
 #include "message.h"
 #include "socket.h"
 #include "wiredmunkapp.h"
-#include "debug.h"
+#include "log.h"
 
 using namespace WiredMunk;
 
@@ -21,10 +21,10 @@ Shape::Shape(Body* body, int numVerts, cpVect* verts, cpVect offset) {
 	_body = body;
 }
 
-Shape::Shape(BodyVector* bodyVector, BodyVector* staticBodyVector, const unsigned char* serialisedData) : NetworkObject(serialisedData) {
+Shape::Shape(Space* space, const unsigned char* serialisedData) : NetworkObject(serialisedData) {
 	_shape = NULL;
 	_body = NULL;
-	deserialise(bodyVector, staticBodyVector, serialisedData);
+	deserialise(space, serialisedData);
 }
 
 Shape::~Shape() {
@@ -146,7 +146,9 @@ unsigned int Shape::serialise(unsigned char* buffer) {
 	return getSerialisedLength();
 }
 
-unsigned int Shape::deserialise(BodyVector* bodyVector, BodyVector* staticBodyVector, const unsigned char* data) {
+unsigned int Shape::deserialise(Space* space, const unsigned char* data) {
+	
+	const unsigned char* serialisedData = data;
 	
 	// Move past network object
 	data += NetworkObject::getSerialisedLength();
@@ -158,28 +160,13 @@ unsigned int Shape::deserialise(BodyVector* bodyVector, BodyVector* staticBodyVe
 	// Wire up body pointer if it is not set
 	if (_body == NULL) {
 		
-		bool isBody = false;
-		
-		// Locate the body in the body vector
-		for (int i = 0; i < bodyVector->size(); ++i) {
-			if (bodyVector->at(i)->getObjectId() == bodyId) {
-				_body = bodyVector->at(i);
-				isBody = true;
-				break;
-			}
-		}
+		// Locate the body in the space's body index, which contains both
+		// standard and static bodies
+		_body = space->findBody(bodyId);
 		
-		// Did we find the body?
-		if (!isBody) {
-			
-			// Body not found; must be a static body
-			for (int i = 0; i < staticBodyVector->size(); ++i) {
-				if (staticBodyVector->at(i)->getObjectId() == bodyId) {
-					_body = staticBodyVector->at(i);
-					break;
-				}
-			}
-		}
+		// A shape cannot be created without its body, which may not have
+		// been replicated.  Leave the shape empty so the caller can skip it
+		if ((_body == NULL) && (_shape == NULL)) return peekSerialisedLength(serialisedData);
 	}
 	
 	// Extract basic shape data
@@ -283,35 +270,19 @@ unsigned int Shape::deserialise(BodyVector* bodyVector, BodyVector* staticBodyVe
 			int numVerts = SerialiseBase::deserialiseInt(data);
 			data += SERIALISED_INT_SIZE;
 			
-			// Allocate vertex and axes arrays
-			cpVect* verts = new cpVect[numVerts];
-			cpVect* transformedVerts = new cpVect[numVerts];
-			cpPolyShapeAxis* axes = new cpPolyShapeAxis[numVerts];
-			cpPolyShapeAxis* transformedAxes = new cpPolyShapeAxis[numVerts];
-			
-			for (int i = 0; i < numVerts; ++i) {
-				verts[i] = SerialiseBase::deserialiseVector(data);
-				data += SERIALISED_VECTOR_SIZE;
-				
-				axes[i].n = SerialiseBase::deserialiseVector(data);
-				data += SERIALISED_VECTOR_SIZE;
-				
-				axes[i].d = SerialiseBase::deserialiseDouble(data);
-				data += SERIALISED_DOUBLE_SIZE;
-				
-				transformedVerts[i] = SerialiseBase::deserialiseVector(data);
-				data += SERIALISED_VECTOR_SIZE;
+			if (_shape == NULL) {
 				
-				transformedAxes[i].n = SerialiseBase::deserialiseVector(data);
-				data += SERIALISED_VECTOR_SIZE;
+				// Shape does not exist, so gather its vertices and create it.
+				// Each vertex is followed by its axis and transformed data,
+				// which are skipped here and copied below
+				cpVect verts[numVerts];
+				const unsigned char* vertData = data;
 				
-				transformedAxes[i].d = SerialiseBase::deserialiseDouble(data);
-				data += SERIALISED_DOUBLE_SIZE;
-			}
-			
-			if (_shape == NULL) {
+				for (int i = 0; i < numVerts; ++i) {
+					verts[i] = SerialiseBase::deserialiseVector(vertData);
+					vertData += (SERIALISED_VECTOR_SIZE * 4) + (SERIALISED_DOUBLE_SIZE * 2);
+				}
 				
-				// Shape does not exist, so create it
 				cpVect offset;
 				offset.x = 0;
 				offset.y = 0;
@@ -319,17 +290,22 @@ unsigned int Shape::deserialise(BodyVector* bodyVector, BodyVector* staticBodyVe
 				_shape = cpPolyShapeNew(_body->getBody(), numVerts, verts, offset);
 			}
 			
-			// Override all verts and axes
+			// Override all verts and axes directly in the shape's arrays.
+			// Any vertices beyond the size of the existing shape are skipped
+			cpPolyShape* poly = (cpPolyShape*)_shape;
+			
 			for (int i = 0; i < numVerts; ++i) {
-				((cpPolyShape*)_shape)->verts[i] = verts[i];
-				((cpPolyShape*)_shape)->axes[i] = axes[i];
-				((cpPolyShape*)_shape)->tVerts[i] = transformedVerts[i];
-				((cpPolyShape*)_shape)->tAxes[i] = transformedAxes[i];
-			}
+				if (i < poly->numVerts) {
+					poly->verts[i] = SerialiseBase::deserialiseVector(data);
+					poly->axes[i].n = SerialiseBase::deserialiseVector(data + SERIALISED_VECTOR_SIZE);
+					poly->axes[i].d = SerialiseBase::deserialiseDouble(data + (SERIALISED_VECTOR_SIZE * 2));
+					poly->tVerts[i] = SerialiseBase::deserialiseVector(data + (SERIALISED_VECTOR_SIZE * 2) + SERIALISED_DOUBLE_SIZE);
+					poly->tAxes[i].n = SerialiseBase::deserialiseVector(data + (SERIALISED_VECTOR_SIZE * 3) + SERIALISED_DOUBLE_SIZE);
+					poly->tAxes[i].d = SerialiseBase::deserialiseDouble(data + (SERIALISED_VECTOR_SIZE * 4) + SERIALISED_DOUBLE_SIZE);
+				}
 			
-			// Clean up
-			delete verts;
-			delete axes;
+				data += (SERIALISED_VECTOR_SIZE * 4) + (SERIALISED_DOUBLE_SIZE * 2);
+			}
 			
 			break;
 		}
@@ -388,6 +364,43 @@ unsigned int Shape::getSerialisedLength() {
 	return size;
 }
 
+unsigned int Shape::peekSerialisedLength(const unsigned char* serialisedData) {
+	
+	// Object ID and common shape data, which ends with the shape type
+	unsigned int size = SERIALISED_INT_SIZE;
+	size += SERIALISED_DOUBLE_SIZE * 2;
+	size += SERIALISED_VECTOR_SIZE;
+	size += SERIALISED_INT_SIZE * 5;
+	
+	cpShapeType type = (cpShapeType)SerialiseBase::deserialiseInt(serialisedData + size - SERIALISED_INT_SIZE);
+	
+	// Type-specific shape data
+	switch (type) {
+		case CP_CIRCLE_SHAPE:
+			size += SERIALISED_VECTOR_SIZE * 2;
+			size += SERIALISED_DOUBLE_SIZE;
+			break;
+			
+		case CP_SEGMENT_SHAPE:
+			size += SERIALISED_VECTOR_SIZE * 6;
+			size += SERIALISED_DOUBLE_SIZE;
+			break;
+			
+		case CP_POLY_SHAPE:
+		{
+			int numVerts = SerialiseBase::deserialiseInt(serialisedData + size);
+			
+			size += SERIALISED_INT_SIZE;
+			size += numVerts * ((SERIALISED_VECTOR_SIZE * 4) + (SERIALISED_DOUBLE_SIZE * 2));
+			break;
+		}
+		default:
+			break;
+	}
+	
+	return size;
+}
+
 void Shape::sendObject() {
 	
 	// Serialise the object
@@ -406,5 +419,5 @@ void Shape::sendObject() {
 	// Remember that the changes have been transmitted
 	setAltered(false);
 	
-	Debug::printf("Client transmitted shape data\n");
+	LOG_DEBUG("Client transmitted shape data\n");
 }
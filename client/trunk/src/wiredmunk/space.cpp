@@ -5,7 +5,7 @@
 #include "shape.h"
 #include "body.h"
 #include "joint.h"
-#include "debug.h"
+#include "log.h"
 
 using namespace WiredMunk;
 
@@ -56,30 +56,30 @@ unsigned int Space::deserialise(const unsigned char* data) {
 	
 	for (int i = 0; i < bodies; ++i) {
 		
-		// Deserialise into a new body object
-		Body* body = new Body(data);
+		// Locate the existing body by peeking at its ID, so that updates to
+		// existing bodies are deserialised in place without allocating
+		Body* body = findBody(NetworkObject::peekObjectId(data));
 		
-		// Attempt to add the body to the body list
-		if (!addBody(body)) {
+		if (body != NULL) {
+			body->deserialise(data);
+		} else {
 			
-			// Body already exists, so locate the body and deserialise into it
-			for (int i = 0; i < _bodyList.size(); ++i) {
-				if (_bodyList.at(i)->getObjectId() == body->getObjectId()) {
-					_bodyList.at(i)->deserialise(data);
-					
-					// Move along data stream
-					data += _bodyList.at(i)->getSerialisedLength();
-					
-					break;
-				}
-			}
+			// Body does not exist - create it and add it to the body list
+			body = new Body(data);
 			
-			delete body;
-		} else {
+			// A newer generation replaces a despawned body in its slot, whilst
+			// an older one is discarded
+			evictStaleBody(body->getObjectId());
 			
-			// Move along data stream
-			data += body->getSerialisedLength();
+			if (!addBody(body)) {
+				data += body->getSerialisedLength();
+				delete body;
+				continue;
+			}
 		}
+		
+		// Move along data stream
+		data += body->getSerialisedLength();
 	}
 	
 	// Deserialise static bodies
@@ -88,30 +88,29 @@ unsigned int Space::deserialise(const unsigned char* data) {
 	
 	for (int i = 0; i < staticBodies; ++i) {
 		
-		// Deserialise into a new body object
-		Body* body = new Body(data);
+		// Update the existing body in place if there is one
+		Body* body = findBody(NetworkObject::peekObjectId(data));
 		
-		// Attempt to add the body to the static body list
-		if (!addStaticBody(body)) {
+		if (body != NULL) {
+			body->deserialise(data);
+		} else {
 			
-			// Body already exists, so locate the body and deserialise into it
-			for (int i = 0; i < _staticBodyList.size(); ++i) {
-				if (_staticBodyList.at(i)->getObjectId() == body->getObjectId()) {
-					_staticBodyList.at(i)->deserialise(data);
-					
-					// Move along data stream
-					data += _staticBodyList.at(i)->getSerialisedLength();
-					
-					break;
-				}
-			}
+			// Body does not exist - create it and add it to the static body list
+			body = new Body(data);
 			
-			delete body;
-		} else {
+			// A newer generation replaces a despawned body in its slot, whilst
+			// an older one is discarded
+			evictStaleBody(body->getObjectId());
 			
-			// Move along data stream
-			data += body->getSerialisedLength();
+			if (!addStaticBody(body)) {
+				data += body->getSerialisedLength();
+				delete body;
+				continue;
+			}
 		}
+		
+		// Move along data stream
+		data += body->getSerialisedLength();
 	}
 	
 	// Deserialise shapes
@@ -120,30 +119,36 @@ unsigned int Space::deserialise(const unsigned char* data) {
 	
 	for (int i = 0; i < shapes; ++i) {
 		
-		// Deserialise into a new shape object
-		Shape* shape = new Shape(&_bodyList, &_staticBodyList, data);
+		// Update the existing shape in place if there is one
+		Shape* shape = findShape(NetworkObject::peekObjectId(data));
 		
-		// Attempt to add the shape to the shape list
-		if (!addShape(shape)) {
+		if (shape != NULL) {
+			shape->deserialise(this, data);
+		} else {
+			
+			// Shape does not exist - create it and add it to the shape list
+			shape = new Shape(this, data);
 			
-			// Shape already exists, so locate the shape and deserialise into it
-			for (int i = 0; i < _shapeList.size(); ++i) {
-				if (_shapeList.at(i)->getObjectId() == shape->getObjectId()) {
-					_shapeList.at(i)->deserialise(&_bodyList, &_staticBodyList, data);
-					
-					// Move along data stream
-					data += _shapeList.at(i)->getSerialisedLength();
-					
-					break;
-				}
+			// Skip shapes whose body was not replicated
+			if (shape->getShape() == NULL) {
+				data += Shape::peekSerialisedLength(data);
+				delete shape;
+				continue;
 			}
 			
-			delete shape;
-		} else {
+			// A newer generation replaces a despawned shape in its slot,
+			// whilst an older one is discarded
+			evictStaleShape(shape->getObjectId());
 			
-			// Move along data stream
-			data += shape->getSerialisedLength();
+			if (!addShape(shape)) {
+				data += shape->getSerialisedLength();
+				delete shape;
+				continue;
+			}
 		}
+		
+		// Move along data stream
+		data += shape->getSerialisedLength();
 	}
 	
 	// Deserialise static shapes
@@ -152,30 +157,36 @@ unsigned int Space::deserialise(const unsigned char* data) {
 	
 	for (int i = 0; i < staticShapes; ++i) {
 		
-		// Deserialise into a new shape object
-		Shape* shape = new Shape(&_bodyList, &_staticBodyList, data);
+		// Update the existing shape in place if there is one
+		Shape* shape = findShape(NetworkObject::peekObjectId(data));
 		
-		// Attempt to add the shape to the static shape list
-		if (!addStaticShape(shape)) {
+		if (shape != NULL) {
+			shape->deserialise(this, data);
+		} else {
 			
-			// Shape already exists, so locate the shape and deserialise into it
-			for (int i = 0; i < _staticShapeList.size(); ++i) {
-				if (_staticShapeList.at(i)->getObjectId() == shape->getObjectId()) {
-					_staticShapeList.at(i)->deserialise(&_bodyList, &_staticBodyList, data);
-					
-					// Move along data stream
-					data += _staticShapeList.at(i)->getSerialisedLength();
-					
-					break;
-				}
+			// Shape does not exist - create it and add it to the static shape list
+			shape = new Shape(this, data);
+			
+			// Skip shapes whose body was not replicated
+			if (shape->getShape() == NULL) {
+				data += Shape::peekSerialisedLength(data);
+				delete shape;
+				continue;
 			}
 			
-			delete shape;
-		} else {
+			// A newer generation replaces a despawned shape in its slot,
+			// whilst an older one is discarded
+			evictStaleShape(shape->getObjectId());
 			
-			// Move along data stream
-			data += shape->getSerialisedLength();
+			if (!addStaticShape(shape)) {
+				data += shape->getSerialisedLength();
+				delete shape;
+				continue;
+			}
 		}
+		
+		// Move along data stream
+		data += shape->getSerialisedLength();
 	}
 	
 	/*
@@ -203,14 +214,14 @@ Space::~Space() {
 	_shapeList.clear();
 	_staticShapeList.clear();
 	_jointList.clear();
+	_bodyIndex.clear();
+	_shapeIndex.clear();
 }
 
 bool Space::addShape(Shape* shape) {
 	
 	// Ensure this shape does not exist
-	for (int i = 0; i < _shapeList.size(); ++i) {
-		if (_shapeList.at(i)->getObjectId() == shape->getObjectId()) return false;
-	}
+	if (!_shapeIndex.add(shape->getObjectId(), shape)) return false;
 	
 	// Shape does not exist, so add shape
 	cpSpaceAddShape(_space, shape->getShape());
@@ -222,9 +233,7 @@ bool Space::addShape(Shape* shape) {
 bool Space::addStaticShape(Shape* shape) {
 	
 	// Ensure this shape does not exist
-	for (int i = 0; i < _staticShapeList.size(); ++i) {
-		if (_staticShapeList.at(i)->getObjectId() == shape->getObjectId()) return false;
-	}
+	if (!_shapeIndex.add(shape->getObjectId(), shape)) return false;
 	
 	// Shape does not exist, so add shape
 	cpSpaceAddStaticShape(_space, shape->getShape());
@@ -236,9 +245,7 @@ bool Space::addStaticShape(Shape* shape) {
 bool Space::addBody(Body* body) {
 	
 	// Ensure this body does not exist
-	for (int i = 0; i < _bodyList.size(); ++i) {
-		if (_bodyList.at(i)->getObjectId() == body->getObjectId()) return false;
-	}
+	if (!_bodyIndex.add(body->getObjectId(), body)) return false;
 	
 	// Body does not exist, so add body
 	cpSpaceAddBody(_space, body->getBody());
@@ -250,9 +257,7 @@ bool Space::addBody(Body* body) {
 bool Space::addStaticBody(Body* body) {
 	
 	// Ensure this body does not exist
-	for (int i = 0; i < _staticBodyList.size(); ++i) {
-		if (_staticBodyList.at(i)->getObjectId() == body->getObjectId()) return false;
-	}
+	if (!_bodyIndex.add(body->getObjectId(), body)) return false;
 	
 	// Body does not exist, so add body.  Note that the body is not added to
 	// Chipmunk's data structures - only the wrapper keeps track of these in
@@ -262,6 +267,67 @@ bool Space::addStaticBody(Body* body) {
 	return true;
 }
 
+void Space::evictStaleBody(unsigned int objectId) {
+	Body* body = _bodyIndex.findOccupant(objectId);
+	
+	if ((body == NULL) || (!HandleAllocator::isNewer(objectId, body->getObjectId()))) return;
+	
+	// Remove the body's shapes first, as they refer to the body
+	for (int i = _shapeList.size() - 1; i >= 0; --i) {
+		Shape* shape = _shapeList.at(i);
+		
+		if (shape->getBody() == body) {
+			removeShape(shape);
+			delete shape;
+		}
+	}
+	
+	for (int i = _staticShapeList.size() - 1; i >= 0; --i) {
+		Shape* shape = _staticShapeList.at(i);
+		
+		if (shape->getBody() == body) {
+			removeStaticShape(shape);
+			delete shape;
+		}
+	}
+	
+	// Static bodies are only held in the wrapper's list
+	bool isStatic = false;
+	
+	for (int i = 0; i < _staticBodyList.size(); ++i) {
+		if (_staticBodyList.at(i) == body) {
+			_staticBodyList.erase(_staticBodyList.begin() + i);
+			_bodyIndex.remove(body->getObjectId(), body);
+			isStatic = true;
+			break;
+		}
+	}
+	
+	if (!isStatic) removeBody(body);
+	
+	delete body;
+}
+
+void Space::evictStaleShape(unsigned int objectId) {
+	Shape* shape = _shapeIndex.findOccupant(objectId);
+	
+	if ((shape == NULL) || (!HandleAllocator::isNewer(objectId, shape->getObjectId()))) return;
+	
+	bool isStatic = false;
+	
+	for (int i = 0; i < _staticShapeList.size(); ++i) {
+		if (_staticShapeList.at(i) == shape) isStatic = true;
+	}
+	
+	if (isStatic) {
+		removeStaticShape(shape);
+	} else {
+		removeShape(shape);
+	}
+	
+	delete shape;
+}
+
 void Space::addJoint(Joint* joint) {
 	cpSpaceAddJoint(_space, joint->getJoint());
 	_jointList.push_back(joint);
@@ -269,6 +335,7 @@ void Space::addJoint(Joint* joint) {
 
 void Space::removeShape(Shape* shape) {
 	cpSpaceRemoveShape(_space, shape->getShape());
+	_shapeIndex.remove(shape->getObjectId(), shape);
 	
 	for (int i = 0; i < _shapeList.size(); ++i) {
 		if (_shapeList.at(i) == shape) {
@@ -279,6 +346,7 @@ void Space::removeShape(Shape* shape) {
 
 void Space::removeStaticShape(Shape* shape) {
 	cpSpaceRemoveStaticShape(_space, shape->getShape());
+	_shapeIndex.remove(shape->getObjectId(), shape);
 	
 	for (int i = 0; i < _staticShapeList.size(); ++i) {
 		if (_staticShapeList.at(i) == shape) {
@@ -289,6 +357,7 @@ void Space::removeStaticShape(Shape* shape) {
 
 void Space::removeBody(Body* body) {
 	cpSpaceRemoveBody(_space, body->getBody());
+	_bodyIndex.remove(body->getObjectId(), body);
 	
 	for (int i = 0; i < _bodyList.size(); ++i) {
 		if (_bodyList.at(i) == body) {
@@ -440,5 +509,5 @@ void Space::sendObject() {
 	// Remember that the changes have been transmitted
 	setAltered(false);
 	
-	Debug::printf("Client transmitted space data\n");
+	LOG_DEBUG("Client transmitted space data\n");
 }
@@ -0,0 +1,110 @@
+#ifndef _TICK_SCHEDULER_H_
+#define _TICK_SCHEDULER_H_
+
+#define TICK_SCHEDULER_DEFAULT_MAX_STEPS 8
+
+namespace WiredMunk {
+
+	/**
+	 * Decides how many fixed timesteps a simulation should run to keep pace
+	 * with the clock.  Time is read from a monotonic clock, so changes to the
+	 * system time do not cause the simulation to jump or stall.  Elapsed time
+	 * is added to an accumulator, and each whole timestep in the accumulator
+	 * is one step to run.
+	 *
+	 * If the process falls so far behind that more than the maximum number of
+	 * steps are due, only the maximum is run and the rest of the backlog is
+	 * discarded.  This prevents a stall from causing a spiral in which each
+	 * update takes longer to catch up than the last; instead, the simulation
+	 * runs slower than real time until the load eases.  Every such overrun is
+	 * counted, along with the time discarded.
+	 */
+	class TickScheduler {
+	public:
+		
+		/**
+		 * A function that returns the time in nanoseconds.
+		 */
+		typedef unsigned long long (*Clock)();
+		
+		/**
+		 * Constructor.
+		 * @param rate Number of steps per second.
+		 * @param maxSteps Maximum number of steps to run in a single update.
+		 */
+		TickScheduler(double rate, int maxSteps = TICK_SCHEDULER_DEFAULT_MAX_STEPS);
+		
+		/**
+		 * Work out how many steps are due since the last update.
+		 * @return The number of steps to run.
+		 */
+		int update();
+		
+		/**
+		 * Change the number of steps per second.  Any accumulated time is
+		 * discarded.
+		 * @param rate Number of steps per second.
+		 */
+		void setRate(double rate);
+		
+		/**
+		 * Discard any accumulated time and start timing from now.  Should be
+		 * called when the simulation starts so that time spent waiting does
+		 * not count as an overrun.
+		 */
+		void reset();
+		
+		/**
+		 * Get the length of a single step.
+		 * @return The length of a step in seconds.
+		 */
+		inline double getTimestep() const { return _timestep; };
+		
+		/**
+		 * Get the number of updates that had more steps due than could be
+		 * run.
+		 * @return The number of overruns.
+		 */
+		inline unsigned int getOverrunCount() const { return _overrunCount; };
+		
+		/**
+		 * Get the number of steps discarded by overruns.
+		 * @return The number of skipped steps.
+		 */
+		inline unsigned long long getSkippedSteps() const { return _skippedSteps; };
+		
+		/**
+		 * Get the amount of time discarded by overruns.
+		 * @return The skipped time in seconds.
+		 */
+		inline double getSkippedTime() const { return _skippedSteps * _timestep; };
+		
+		/**
+		 * Read the monotonic clock.
+		 * @return The current time in nanoseconds, measured from an arbitrary
+		 * starting point.
+		 */
+		static unsigned long long getTime();
+		
+		/**
+		 * Read time from a different clock instead of the monotonic clock.
+		 * Allows a whole process to run on simulated time, eg. to make
+		 * network tests repeatable.  Must be called before any scheduler is
+		 * created.
+		 * @param clock The clock to read, or NULL to use the monotonic clock.
+		 */
+		static inline void setClock(Clock clock) { _clock = clock; };
+	
+	private:
+		static Clock _clock;					/**< Replacement clock, or NULL */
+		double _timestep;						/**< Length of a step in seconds */
+		unsigned long long _stepLength;			/**< Length of a step in nanoseconds */
+		unsigned long long _lastTime;			/**< Time of the last update */
+		unsigned long long _accumulator;		/**< Time not yet stepped */
+		int _maxSteps;							/**< Maximum steps per update */
+		unsigned int _overrunCount;				/**< Number of overruns */
+		unsigned long long _skippedSteps;		/**< Steps discarded by overruns */
+	};
+}
+
+#endif
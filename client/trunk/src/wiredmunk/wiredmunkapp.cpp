@@ -1,7 +1,7 @@
 #include "wiredmunkapp.h"
 #include "chipmunk.h"
 #include "serialisebase.h"
-#include "debug.h"
+#include "log.h"
 #include "body.h"
 #include "shape.h"
 #include "joint.h"
@@ -11,14 +11,30 @@ using namespace WiredMunk;
 
 WiredMunkApp* WiredMunkApp::_singleton = NULL;
 
-WiredMunkApp::WiredMunkApp(const char* serverIP, int portNum) {
+WiredMunkApp::WiredMunkApp(const char* serverIP, int portNum, const SessionSettings* settings) : _scheduler(SESSION_DEFAULT_PHYSICS_RATE, MAX_CATCH_UP_STEPS) {
 	_socket.open(serverIP, portNum);
+	
+	init(settings);
+}
+
+WiredMunkApp::WiredMunkApp(LoopbackNetwork* network, int portNum, const SessionSettings* settings) : _scheduler(SESSION_DEFAULT_PHYSICS_RATE, MAX_CATCH_UP_STEPS) {
+	_socket.open(network, portNum);
+	
+	init(settings);
+}
+
+void WiredMunkApp::init(const SessionSettings* settings) {
 	_socket.addSocketEventHandler(this);
+	_objectIdPool = new ObjectIdPool(&_socket);
 	_singleton = this;
 	_clientState = CLIENT_STATE_NEW;
+	_clientId = 0;
 	_space = NULL;
+	_sampler = new PositionSampler();
+	_ticks = 0;
+	_isProposingSettings = (settings != NULL);
 	
-	gettimeofday(&_lastRunTime, NULL);
+	if (settings != NULL) _settings = *settings;
 	
 	cpInitChipmunk();
 	cpResetShapeIdCounter();
@@ -29,10 +45,23 @@ WiredMunkApp::WiredMunkApp(const char* serverIP, int portNum) {
 WiredMunkApp::~WiredMunkApp() {
 	shutdown();
 	
+	// Give the server back the IDs we no longer need
+	_objectIdPool->returnAll();
+	
 	_socket.shut();
+	
+	delete _sampler;
+	delete _objectIdPool;
+	
+	if (_singleton == this) _singleton = NULL;
 }
 
 void WiredMunkApp::run() {
+
+	// Objects find their app through the singleton, so make this app the
+	// current one whilst it runs.  This allows several apps to share a
+	// process, as long as they are run from the same thread
+	_singleton = this;
 	
 	// Check for incoming messages
 	_socket.poll();
@@ -56,6 +85,13 @@ void WiredMunkApp::run() {
 			
 		case CLIENT_STATE_STARTING:
 			
+			// Wait for the leased IDs to arrive so that the objects created
+			// during startup do not fall back to local IDs
+			if (_objectIdPool->getAvailableCount() < OBJECT_ID_POOL_LOW_WATER) {
+				_objectIdPool->topUp();
+				break;
+			}
+			
 			// Handshake received, so call the startup method
 			startup();
 			
@@ -68,7 +104,12 @@ void WiredMunkApp::run() {
 			// Inform the server that the client is ready to start
 			sendReady();
 			
-			_sampler = new PositionSampler();
+			// Start sampling now that the client ID and settings are known
+			if (!_samplePrefix.empty()) {
+				char fileName[FILENAME_MAX];
+				snprintf(fileName, sizeof(fileName), "%s_%d.wdms", _samplePrefix.c_str(), _clientId);
+				_sampler->open(fileName, PositionSampler::SOURCE_CLIENT, _clientId, _settings.getPhysicsRate());
+			}
 			
 			break;
 			
@@ -76,12 +117,15 @@ void WiredMunkApp::run() {
 			
 			// Waiting for a commencement message from the server.  Do nothing
 			break;
-			
+		
 		case CLIENT_STATE_RUNNING:
 		
 			// Client is running; step the simulation
 			stepSpace();
 			
+			// Keep the pool of leased object IDs topped up
+			_objectIdPool->topUp();
+			
 			// Send any manually-altered objects to the server
 			sendAlteredObjects();
 			
@@ -119,38 +163,25 @@ void WiredMunkApp::resetAlteredState() {
 
 void WiredMunkApp::stepSpace() {
 	
-	// Calculate the time that has passed since the last time the
-	// simulation ran
-	struct timeval thisRunTime;
-	struct timeval timeDiff;
-	
-	gettimeofday(&thisRunTime, NULL);
+	// Run as many fixed steps as have fallen due since the last run
+	int steps = _scheduler.update();
 	
-	// Get time difference between last time and this time
-	timersub(&thisRunTime, &_lastRunTime, &timeDiff);
-	
-	// Calculate time in 85ths of a second
-	int steps = (((cpFloat)timeDiff.tv_usec) / 1000000.0) * REFRESH_RATE;
-	
-	// Remember current run time if we are to step the simulation
-	if (steps > 0) {
-		struct timeval increaseTime;
-		struct timeval nextRunTime;
-		increaseTime.tv_usec = steps * (1000000.0 / REFRESH_RATE);
-		timeradd(&_lastRunTime, &increaseTime, &nextRunTime);
-		_lastRunTime = nextRunTime;
-	}
-	
-	// Step the simulation
-	cpFloat dt = 1.0/REFRESH_RATE;
 	for (int i = 0; i < steps; ++i) {
-		_space->step(dt);
+		for (unsigned int j = 0; j < _settings.getSubsteps(); ++j) {
+			_space->step(_settings.getSubstepLength());
+		}
+		
+		_ticks++;
 		
 		// Sample the simulation
-		_sampler->sample(_space);
+		_sampler->sample(_space, _ticks);
 	}
 }
 
+void WiredMunkApp::startSampling(const char* prefix) {
+	_samplePrefix = prefix;
+}
+
 void WiredMunkApp::sendAlteredObjects() {
 	
 	// Send any altered bodies
@@ -196,13 +227,23 @@ Socket* WiredMunkApp::getSocket() {
 
 void WiredMunkApp::requestHandshake() {
 	
+	// Propose settings for the session if we have any.  The server expects
+	// them to follow a room ID
+	unsigned char data[SERIALISED_INT_SIZE + SERIALISED_SESSION_SETTINGS_SIZE];
+	unsigned short dataLength = 0;
+	
+	if (_isProposingSettings) {
+		dataLength += SerialiseBase::serialise((unsigned int)HANDSHAKE_ANY_ROOM, data);
+		dataLength += _settings.serialise(data + dataLength);
+	}
+	
 	// Send the request
-	Message msg(Message::MESSAGE_HANDSHAKE, 0, NULL, this);
+	Message msg(Message::MESSAGE_HANDSHAKE, dataLength, data, this);
 	_socket.sendMessage(&msg);
 	
 	// Move to next status
 	_clientState = CLIENT_STATE_WAITING_HANDSHAKE;
-	Debug::printf("Client switched to CLIENT_STATE_HANDSHAKE\n");
+	LOG_DEBUG("Client switched to CLIENT_STATE_HANDSHAKE\n");
 }
 	
 void WiredMunkApp::sendReady() {
@@ -213,7 +254,7 @@ void WiredMunkApp::sendReady() {
 	
 	// Move to next status
 	_clientState = CLIENT_STATE_WAITING_READY;
-	Debug::printf("Client switched to CLIENT_STATE_WAITING_READY\n");
+	LOG_DEBUG("Client switched to CLIENT_STATE_WAITING_READY\n");
 }	
 
 void WiredMunkApp::handleResponseReceived(const Message& msg) { 
@@ -226,11 +267,23 @@ void WiredMunkApp::handleResponseReceived(const Message& msg) {
 			_clientId = SerialiseBase::deserialiseInt(data);
 			data += SERIALISED_INT_SIZE;
 			
+			// Adopt the session's settings so that we step at the same rate
+			// as the server
+			if (msg.getDataLength() >= SERIALISED_INT_SIZE + SERIALISED_SESSION_SETTINGS_SIZE) {
+				data += _settings.deserialise(data);
+				_scheduler.setRate(_settings.getPhysicsRate());
+			}
+			
+			// Lease a block of object IDs so that objects created during
+			// startup do not need to wait for the server
+			_objectIdPool->topUp();
+			
 			// Move to next status
 			_clientState = CLIENT_STATE_WAITING_STARTUP;
-			Debug::printf("Handshake received\n");
-			Debug::printf("Client ID: %d\n", _clientId);
-			Debug::printf("Client switched to CLIENT_STATE_WAITING_STARTUP\n");
+			LOG_INFO("Handshake received\n");
+			LOG_INFO("Client ID: %d\n", _clientId);
+			LOG_INFO("Rate: %dHz x %d substeps\n", _settings.getPhysicsRate(), _settings.getSubsteps());
+			LOG_DEBUG("Client switched to CLIENT_STATE_WAITING_STARTUP\n");
 			break;
 		}
 		case Message::MESSAGE_REJECT:
@@ -253,7 +306,7 @@ void WiredMunkApp::handleMessageReceived(const Message& msg) {
 			// Move to the next status
 			if (_clientState == CLIENT_STATE_WAITING_STARTUP) {
 				_clientState = CLIENT_STATE_STARTING;
-				Debug::printf("Client switched to CLIENT_STATE_STARTING\n");
+				LOG_DEBUG("Client switched to CLIENT_STATE_STARTING\n");
 			}
 			break;
 			
@@ -261,17 +314,31 @@ void WiredMunkApp::handleMessageReceived(const Message& msg) {
 			
 			// Move to the next status
 			if (_clientState == CLIENT_STATE_WAITING_READY) {
+				
+				// Start timing from now so that the time spent waiting for
+				// the other clients is not treated as a backlog of steps
+				_scheduler.reset();
+				
 				_clientState = CLIENT_STATE_RUNNING;
-				Debug::printf("Client switched to CLIENT_STATE_RUNNING\n");
+				LOG_DEBUG("Client switched to CLIENT_STATE_RUNNING\n");
 			}
 			break;
 			
 		case Message::MESSAGE_SPACE:
 			
 			// Server has sent updated information on the simulation's space
-			Debug::printf("Client received space data\n");
+			LOG_DEBUG("Client received space data\n");
 			_space->deserialise(msg.getData());
 			break;
+		
+		case Message::MESSAGE_PING:
+		{
+			// Server is measuring the round trip time and checking that the
+			// client is still connected, so reply immediately
+			Message reply(Message::MESSAGE_PING, 0, NULL);
+			_socket.sendMessage(&reply);
+			break;
+		}
 			
 		default:
 			break;
@@ -2,13 +2,17 @@
 #define _WIRED_MUNK_APP_H_
 
 #include <sys/time.h>
+#include <string>
 
 #include "socket.h"
 #include "socketeventhandler.h"
 #include "message.h"
 #include "space.h"
+#include "objectidpool.h"
+#include "tickscheduler.h"
+#include "sessionsettings.h"
 
-#define REFRESH_RATE 85.0
+#define MAX_CATCH_UP_STEPS 8
 
 namespace WiredMunk {
 	
@@ -28,7 +32,7 @@ namespace WiredMunk {
 			CLIENT_STATE_NEW,					/**< Client is newly created */
 			CLIENT_STATE_WAITING_HANDSHAKE,		/**< Client is awaiting handshake with server */
 			CLIENT_STATE_WAITING_STARTUP,		/**< Client is awaiting permission to startup from server */
-			CLIENT_STATE_STARTING,				/**< Client is running startup code */
+			CLIENT_STATE_STARTING,				/**< Client is waiting for leased object IDs, then runs startup code */
 			CLIENT_STATE_WAITING_READY,			/**< Client is awaiting ready message from server */
 			CLIENT_STATE_RUNNING				/**< Client is running main code */
 		};
@@ -37,8 +41,22 @@ namespace WiredMunk {
 		 * Constructor.
 		 * @param serverIP IP address of the server.
 		 * @param portNum Port number to connect to server on.
+		 * @param settings Timing settings to propose to the server.  The
+		 * server only adopts them if this is the first client in its room;
+		 * otherwise, or if NULL, the client uses the settings that the
+		 * server sends back in the handshake.
 		 */
-		WiredMunkApp(const char* serverIP, int portNum);
+		WiredMunkApp(const char* serverIP, int portNum, const SessionSettings* settings = NULL);
+		
+		/**
+		 * Constructor.  Connects to a server on a loopback network instead of
+		 * over UDP.
+		 * @param network The network that the server is running on.
+		 * @param portNum Port number of the server on the network.
+		 * @param settings Timing settings to propose to the server.  See the
+		 * other constructor.
+		 */
+		WiredMunkApp(LoopbackNetwork* network, int portNum, const SessionSettings* settings = NULL);
 		
 		/**
 		 * Destructor.
@@ -69,7 +87,9 @@ namespace WiredMunk {
 		virtual void handleMessageReceived(const Message& msg);
 		
 		/**
-		 * Get a pointer to the app singleton.
+		 * Get a pointer to the app singleton.  If a process runs several
+		 * apps, this is the app that is currently running, or the most
+		 * recently created one.
 		 * @return A pointer to the app singleton.
 		 */
 		inline static WiredMunkApp* getApp() { return _singleton; };
@@ -92,6 +112,34 @@ namespace WiredMunk {
 		 */
 		inline int getClientId() { return _clientId; };
 		
+		/**
+		 * Get the session's timing settings.  Only valid once the handshake
+		 * has completed.
+		 * @return The session settings.
+		 */
+		inline const SessionSettings& getSettings() const { return _settings; };
+		
+		/**
+		 * Get the pool of object IDs leased from the server.
+		 * @return The object ID pool.
+		 */
+		inline ObjectIdPool* getObjectIdPool() { return _objectIdPool; };
+		
+		/**
+		 * Record the position and angle of every body to a sample file for
+		 * drift analysis.  The file is named after the prefix and the client
+		 * ID (eg. "prefix_1.wdms"), and is opened once the handshake has
+		 * completed.  Must be called before the client starts running.
+		 * @param prefix Prefix of the sample file name.
+		 */
+		void startSampling(const char* prefix);
+		
+		/**
+		 * Get the number of timesteps the simulation has run for.
+		 * @return The number of timesteps.
+		 */
+		inline unsigned int getTicks() const { return _ticks; };
+		
 	protected:
 		Space* _space;						/**< Simulation space */
 		
@@ -115,11 +163,22 @@ namespace WiredMunk {
 		Socket _socket;						/**< Socket connected to the server */
 		ClientState _clientState;			/**< Current state of the client */
 		int _clientId;						/**< Client's unique ID number */
-		struct timeval _lastRunTime;		/**< Time that the simulation was last stepped */
+		TickScheduler _scheduler;			/**< Paces the simulation against the clock */
+		SessionSettings _settings;			/**< Timing settings for the session */
+		bool _isProposingSettings;			/**< Should the handshake propose the settings? */
+		ObjectIdPool* _objectIdPool;		/**< Object IDs leased from the server */
 		
 		static WiredMunkApp* _singleton;	/**< Singleton instance of the app */
 		
-		PositionSampler* _sampler;
+		PositionSampler* _sampler;			/**< Records body state for drift analysis */
+		std::string _samplePrefix;			/**< Prefix of the sample file name */
+		unsigned int _ticks;				/**< Number of timesteps run */
+		
+		/**
+		 * Set up the app once its socket is open.
+		 * @param settings Timing settings to propose to the server, or NULL.
+		 */
+		void init(const SessionSettings* settings);
 		
 		/**
 		 * Handshake with the server.  Requests an ID for this client.
@@ -0,0 +1,371 @@
+/**
+ * Headless load generator for server capacity testing.  Runs hundreds of
+ * simulated clients ("bots") in a single process.  Each bot is a full
+ * WiredMunkApp: it handshakes, runs startup, sends its space, steps the
+ * simulation and applies scripted impulses in the manner of
+ * OpposingBoxesDelayDemo::runUser().
+ *
+ * Bots are run in turn from a single thread, as objects find their app
+ * through the WiredMunkApp singleton.  When the run ends the generator
+ * reports how long the bots took to become ready, the rate at which they
+ * received snapshots, how late snapshots arrived compared with the
+ * session's send rate (which shows how far the server's ticks are running
+ * behind), and the traffic per bot.
+ *
+ * The bots propose the session settings, so snapshots must be enabled with
+ * a non-zero send rate to measure snapshot timing.
+ *
+ * Build from this directory with:
+ *   gcc -std=gnu99 -c ../src/wiredmunk/chipmunk/[a-z]*.c
+ *   g++ -o loadgenerator -I../src/wiredmunk -I../src/wiredmunk/network -I../src/wiredmunk/chipmunk loadgenerator.cpp ../src/wiredmunk/[a-z]*.cpp ../src/wiredmunk/network/[a-z]*.cpp [a-z]*.o -lpthread
+ *
+ * Usage:
+ *   loadgenerator [-s serverIP] [-p port] [-b bots] [-r spawnrate] [-d seconds] [-t rate] [-u substeps] [-n sendrate] [-v]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include "wiredmunkapp.h"
+#include "body.h"
+#include "shape.h"
+#include "space.h"
+#include "log.h"
+#include "tickscheduler.h"
+#include "sessionsettings.h"
+
+#define DEFAULT_SERVER_IP "127.0.0.1"
+#define DEFAULT_PORT_NUMBER 4444
+#define DEFAULT_BOT_COUNT 100
+#define DEFAULT_SPAWN_RATE 0
+#define DEFAULT_DURATION_SECONDS 30
+#define DEFAULT_SEND_RATE 10
+#define FAST_PUSH_INTERVAL_TICKS 10
+#define SLOW_PUSH_INTERVAL_TICKS 50
+#define LATE_SNAPSHOT_FACTOR 1.5
+#define LOOP_SLEEP_MICROSECONDS 1000
+
+using namespace WiredMunk;
+
+/**
+ * A simulated client.  Builds the opposing boxes scene and pushes one of
+ * the boxes at a fixed interval.  Bots with odd client IDs push the bottom
+ * box up every FAST_PUSH_INTERVAL_TICKS ticks; the others push the top box
+ * down every SLOW_PUSH_INTERVAL_TICKS ticks.
+ */
+class BotClient : public WiredMunkApp {
+public:
+
+	/**
+	 * Constructor.  Starts the handshake with the server.
+	 * @param serverIP IP address of the server.
+	 * @param portNum Port number of the server.
+	 * @param settings Session settings to propose to the server.
+	 */
+	BotClient(const char* serverIP, int portNum, const SessionSettings* settings) : WiredMunkApp(serverIP, portNum, settings) {
+		_body1 = NULL;
+		_body2 = NULL;
+		_lastPushTick = 0;
+		_createdTime = TickScheduler::getTime();
+		_readyTime = 0;
+		_lastSnapshotTime = 0;
+		_snapshots = 0;
+		_isRejected = false;
+	};
+	
+	/**
+	 * Destructor.
+	 */
+	~BotClient() {
+		delete _space;
+		_space = NULL;
+	};
+	
+	/**
+	 * Run a single iteration of the bot and note when it becomes ready.
+	 */
+	void update() {
+		run();
+		
+		if ((_readyTime == 0) && (getClientState() == CLIENT_STATE_RUNNING)) _readyTime = TickScheduler::getTime();
+	};
+	
+	/**
+	 * Process reply received events.  Notes whether the server rejected the
+	 * bot.
+	 * @param msg Message to be processed.
+	 */
+	virtual void handleResponseReceived(const Message& msg) {
+		if (msg.getType() == Message::MESSAGE_REJECT) _isRejected = true;
+		
+		WiredMunkApp::handleResponseReceived(msg);
+	};
+	
+	/**
+	 * Process message received events.  Records the arrival of snapshots.
+	 * @param msg Message to be processed.
+	 */
+	virtual void handleMessageReceived(const Message& msg) {
+		if ((msg.getType() == Message::MESSAGE_SPACE) && (_readyTime != 0)) {
+			unsigned long long now = TickScheduler::getTime();
+			
+			if (_lastSnapshotTime != 0) _snapshotIntervals.push_back(now - _lastSnapshotTime);
+			
+			_lastSnapshotTime = now;
+			_snapshots++;
+		}
+		
+		WiredMunkApp::handleMessageReceived(msg);
+	};
+	
+	inline bool isRejected() const { return _isRejected; };
+	inline unsigned long long getCreatedTime() const { return _createdTime; };
+	inline unsigned long long getReadyTime() const { return _readyTime; };
+	inline unsigned int getSnapshots() const { return _snapshots; };
+	inline const std::vector<unsigned long long>& getSnapshotIntervals() const { return _snapshotIntervals; };
+
+protected:
+
+	/**
+	 * Build the opposing boxes scene.
+	 */
+	virtual void startup() {
+		_space = new Space();
+		_space->setIterations(20);
+		_space->resizeStaticHash(40.0, 1000);
+		_space->resizeActiveHash(40.0, 1000);
+		_space->setGravity(cpv(0, 0));
+		
+		Body* staticBody = new Body(INFINITY, INFINITY);
+		_space->addStaticBody(staticBody);
+		
+		addWall(staticBody, cpv(-320, -240), cpv(-320, 240));
+		addWall(staticBody, cpv(320, -240), cpv(320, 240));
+		addWall(staticBody, cpv(-320, -240), cpv(320, -240));
+		
+		int num = 4;
+		cpVect verts[] = {
+			cpv(-15, -15),
+			cpv(-15, 15),
+			cpv(15, 15),
+			cpv(15, -15)
+		};
+		
+		for (int i = 0; i < 8; ++i) {
+			Body* body = new Body(1.0, cpMomentForPoly(1.0, num, verts, cpvzero));
+			body->setPosition(cpv(32, -150 + (i * 32)));
+			_space->addBody(body);
+			
+			Shape* shape = new Shape(body, num, verts, cpvzero);
+			shape->setElasticity(0.0);
+			shape->setFriction(0.8);
+			_space->addShape(shape);
+		}
+		
+		_body1 = _space->getBodies()->at(0);
+		_body2 = _space->getBodies()->at(_space->getBodies()->size() - 1);
+	};
+	
+	/**
+	 * Push a box if the bot's interval has elapsed.
+	 */
+	virtual void runUser() {
+		bool isFast = (getClientId() % 2 == 1);
+		unsigned int interval = (isFast ? FAST_PUSH_INTERVAL_TICKS : SLOW_PUSH_INTERVAL_TICKS);
+		
+		if (getTicks() - _lastPushTick < interval) return;
+		
+		_lastPushTick = getTicks();
+		
+		if (isFast) {
+			_body1->applyImpulse(cpv(0, 20), cpvzero);
+		} else {
+			_body2->applyImpulse(cpv(0, -20), cpvzero);
+		}
+	};
+
+private:
+	Body* _body1;								/**< Bottom box */
+	Body* _body2;								/**< Top box */
+	unsigned int _lastPushTick;					/**< Tick of the last push */
+	unsigned long long _createdTime;			/**< Time the bot was created */
+	unsigned long long _readyTime;				/**< Time the bot started running, or 0 */
+	unsigned long long _lastSnapshotTime;		/**< Time the last snapshot arrived, or 0 */
+	unsigned int _snapshots;					/**< Snapshots received whilst running */
+	std::vector<unsigned long long> _snapshotIntervals;	/**< Time between snapshots */
+	bool _isRejected;							/**< Did the server reject the bot? */
+	
+	void addWall(Body* staticBody, cpVect a, cpVect b) {
+		Shape* shape = new Shape(staticBody, a, b, 0.0f);
+		shape->setElasticity(1.0);
+		shape->setFriction(1.0);
+		_space->addStaticShape(shape);
+	};
+};
+
+/**
+ * Get a percentile of a sorted list of times.
+ * @param times The sorted times.
+ * @param percent The percentile.
+ * @return The time in milliseconds.
+ */
+static double getPercentile(const std::vector<unsigned long long>& times, int percent) {
+	if (times.empty()) return 0;
+	
+	return times[(times.size() - 1) * percent / 100] / 1000000.0;
+}
+
+static void printUsage(const char* name) {
+	printf("Usage: %s [-s serverIP] [-p port] [-b bots] [-r spawnrate] [-d seconds] [-t rate] [-u substeps] [-n sendrate] [-v]\n", name);
+}
+
+int main(int argc, char* const argv[]) {
+
+	const char* serverIP = DEFAULT_SERVER_IP;
+	int portNumber = DEFAULT_PORT_NUMBER;
+	int botCount = DEFAULT_BOT_COUNT;
+	int spawnRate = DEFAULT_SPAWN_RATE;
+	int duration = DEFAULT_DURATION_SECONDS;
+	int physicsRate = SESSION_DEFAULT_PHYSICS_RATE;
+	int substeps = SESSION_DEFAULT_SUBSTEPS;
+	int sendRate = DEFAULT_SEND_RATE;
+	
+	Log::setLevel(LOG_LEVEL_WARNING);
+	
+	for (int i = 1; i < argc; ++i) {
+		if ((strncmp(argv[i], "-s", 2) == 0) && (i + 1 < argc)) {
+			serverIP = argv[++i];
+		} else if ((strncmp(argv[i], "-p", 2) == 0) && (i + 1 < argc)) {
+			portNumber = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-b", 2) == 0) && (i + 1 < argc)) {
+			botCount = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-r", 2) == 0) && (i + 1 < argc)) {
+			spawnRate = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-d", 2) == 0) && (i + 1 < argc)) {
+			duration = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-t", 2) == 0) && (i + 1 < argc)) {
+			physicsRate = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-u", 2) == 0) && (i + 1 < argc)) {
+			substeps = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-n", 2) == 0) && (i + 1 < argc)) {
+			sendRate = atoi(argv[++i]);
+		} else if (strncmp(argv[i], "-v", 2) == 0) {
+			Log::setLevel(LOG_LEVEL_DEBUG);
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	
+	if ((botCount < 1) || (duration < 1) || (physicsRate < 1) || (substeps < 1) || (sendRate < 0)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	
+	SessionSettings settings(physicsRate, substeps, sendRate);
+	std::vector<BotClient*> bots;
+	
+	unsigned long long start = TickScheduler::getTime();
+	unsigned long long end = start + duration * 1000000000ULL;
+	unsigned long long now = start;
+	
+	printf("Running %d bots against %s:%d for %ds\n", botCount, serverIP, portNumber, duration);
+	
+	while (now < end) {
+		
+		// Spawn bots, either all at once or at the requested rate
+		while (((int)bots.size() < botCount) && ((spawnRate == 0) || (bots.size() < (now - start) * spawnRate / 1000000000ULL + 1))) {
+			bots.push_back(new BotClient(serverIP, portNumber, &settings));
+		}
+		
+		for (unsigned int i = 0; i < bots.size(); ++i) {
+			bots[i]->update();
+		}
+		
+		usleep(LOOP_SLEEP_MICROSECONDS);
+		
+		now = TickScheduler::getTime();
+	}
+	
+	// Gather the results
+	std::vector<unsigned long long> readyTimes;
+	std::vector<unsigned long long> intervals;
+	unsigned int rejected = 0;
+	unsigned long long snapshots = 0;
+	unsigned long long bytesSent = 0;
+	unsigned long long bytesReceived = 0;
+	double runningSeconds = 0;
+	double botSeconds = 0;
+	
+	for (unsigned int i = 0; i < bots.size(); ++i) {
+		BotClient* bot = bots[i];
+		
+		if (bot->isRejected()) rejected++;
+		
+		if (bot->getReadyTime() != 0) {
+			readyTimes.push_back(bot->getReadyTime() - bot->getCreatedTime());
+			runningSeconds += (now - bot->getReadyTime()) / 1000000000.0;
+		}
+		
+		botSeconds += (now - bot->getCreatedTime()) / 1000000000.0;
+		snapshots += bot->getSnapshots();
+		bytesSent += bot->getSocket()->getBytesSent();
+		bytesReceived += bot->getSocket()->getBytesReceived();
+		intervals.insert(intervals.end(), bot->getSnapshotIntervals().begin(), bot->getSnapshotIntervals().end());
+	}
+	
+	std::sort(readyTimes.begin(), readyTimes.end());
+	std::sort(intervals.begin(), intervals.end());
+	
+	printf("\nBots:            %lu spawned, %lu ready, %u rejected, %lu never ready\n",
+		(unsigned long)bots.size(),
+		(unsigned long)readyTimes.size(),
+		rejected,
+		(unsigned long)(bots.size() - readyTimes.size() - rejected));
+	
+	printf("Time to ready:   p50 %.1fms, p90 %.1fms, p99 %.1fms, max %.1fms\n",
+		getPercentile(readyTimes, 50),
+		getPercentile(readyTimes, 90),
+		getPercentile(readyTimes, 99),
+		getPercentile(readyTimes, 100));
+	
+	printf("Snapshot rate:   %.2f/s per running bot (session rate %d/s)\n",
+		runningSeconds > 0 ? snapshots / runningSeconds : 0.0,
+		settings.getSnapshotInterval() > 0 ? physicsRate / (int)settings.getSnapshotInterval() : 0);
+	
+	if (settings.getSnapshotInterval() > 0) {
+		double expected = 1000.0 * settings.getSnapshotInterval() / physicsRate;
+		unsigned long late = 0;
+		
+		for (unsigned int i = 0; i < intervals.size(); ++i) {
+			if (intervals[i] / 1000000.0 > expected * LATE_SNAPSHOT_FACTOR) late++;
+		}
+		
+		printf("Tick latency:    snapshot interval p50 %.1fms, p90 %.1fms, p99 %.1fms, max %.1fms (expected %.1fms)\n",
+			getPercentile(intervals, 50),
+			getPercentile(intervals, 90),
+			getPercentile(intervals, 99),
+			getPercentile(intervals, 100),
+			expected);
+		
+		printf("Late snapshots:  %lu of %lu (%.2f%%)\n",
+			late,
+			(unsigned long)intervals.size(),
+			intervals.empty() ? 0.0 : 100.0 * late / intervals.size());
+	}
+	
+	printf("Traffic per bot: in %.0f B/s, out %.0f B/s (total in %llu B, out %llu B)\n",
+		botSeconds > 0 ? bytesReceived / botSeconds : 0.0,
+		botSeconds > 0 ? bytesSent / botSeconds : 0.0,
+		bytesReceived,
+		bytesSent);
+	
+	for (unsigned int i = 0; i < bots.size(); ++i) {
+		delete bots[i];
+	}
+	
+	return 0;
+}
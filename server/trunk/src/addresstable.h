@@ -0,0 +1,231 @@
+#ifndef _ADDRESS_TABLE_H_
+#define _ADDRESS_TABLE_H_
+
+#include <vector>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define ADDRESS_TABLE_INITIAL_CAPACITY 16
+#define ADDRESS_TABLE_EMPTY -1
+
+namespace WiredMunk {
+
+	/**
+	 * Maps remote addresses to values in constant time.  Addresses are reduced
+	 * to a 64-bit key made from the IP address and port.  Values are stored
+	 * contiguously in insertion order (removing a value moves the last value
+	 * into its place), and are found through an open-addressing hash table of
+	 * indices into that array, probed linearly and kept at most half full.
+	 * Removal shifts later entries in the probe sequence back rather than
+	 * leaving tombstones, so lookups never slow down as clients come and go.
+	 *
+	 * Pointers returned by find() and add() are invalidated by the next call
+	 * to add() or remove().
+	 */
+	template <class T>
+	class AddressTable {
+	public:
+		
+		/**
+		 * Constructor.
+		 */
+		AddressTable() {
+			rehash(ADDRESS_TABLE_INITIAL_CAPACITY);
+		};
+		
+		/**
+		 * Convert an address into a key.
+		 * @param address The address.
+		 * @return The key.
+		 */
+		static inline unsigned long long getKey(const struct sockaddr_in* address) {
+			return ((unsigned long long)address->sin_addr.s_addr << 16) | address->sin_port;
+		};
+		
+		/**
+		 * Find the value stored against an address.
+		 * @param address The address.
+		 * @return The value, or NULL if the address is not in the table.
+		 */
+		inline T* find(const struct sockaddr_in* address) {
+			return find(getKey(address));
+		};
+		
+		/**
+		 * Find the value stored against a key.
+		 * @param key The key.
+		 * @return The value, or NULL if the key is not in the table.
+		 */
+		inline T* find(unsigned long long key) {
+			int slot = findSlot(key);
+			
+			return (_slots[slot] == ADDRESS_TABLE_EMPTY ? NULL : &_values[_slots[slot]]);
+		};
+		
+		/**
+		 * Find the value stored against an address.
+		 * @param address The address.
+		 * @return The value, or NULL if the address is not in the table.
+		 */
+		inline const T* find(const struct sockaddr_in* address) const {
+			int slot = findSlot(getKey(address));
+			
+			return (_slots[slot] == ADDRESS_TABLE_EMPTY ? NULL : &_values[_slots[slot]]);
+		};
+		
+		/**
+		 * Store a value against an address, replacing any existing value.
+		 * @param address The address.
+		 * @param value The value to store.
+		 * @return The stored value.
+		 */
+		T* add(const struct sockaddr_in* address, const T& value) {
+			unsigned long long key = getKey(address);
+			int slot = findSlot(key);
+			
+			if (_slots[slot] != ADDRESS_TABLE_EMPTY) {
+				_values[_slots[slot]] = value;
+				return &_values[_slots[slot]];
+			}
+			
+			// Keep the table at most half full so that probe sequences stay
+			// short
+			if ((_keys.size() + 1) * 2 > _slots.size()) {
+				rehash(_slots.size() * 2);
+				slot = findSlot(key);
+			}
+			
+			_slots[slot] = _keys.size();
+			_keys.push_back(key);
+			_values.push_back(value);
+			
+			return &_values.back();
+		};
+		
+		/**
+		 * Remove the value stored against a key.
+		 * @param key The key.
+		 * @return True if a value was removed.
+		 */
+		bool remove(unsigned long long key) {
+			int slot = findSlot(key);
+			int index = _slots[slot];
+			
+			if (index == ADDRESS_TABLE_EMPTY) return false;
+			
+			removeSlot(slot);
+			
+			// Move the last value into the gap so that storage stays dense
+			int last = _keys.size() - 1;
+			
+			if (index != last) {
+				_keys[index] = _keys[last];
+				_values[index] = _values[last];
+				_slots[findSlot(_keys[index])] = index;
+			}
+			
+			_keys.pop_back();
+			_values.pop_back();
+			
+			return true;
+		};
+		
+		/**
+		 * Get the value at the specified index.  Used to iterate over the
+		 * table.
+		 * @param index The index of the value.
+		 * @return The value.
+		 */
+		inline T& at(int index) { return _values[index]; };
+		
+		/**
+		 * Get the number of values in the table.
+		 * @return The number of values.
+		 */
+		inline int size() const { return _keys.size(); };
+		
+		/**
+		 * Remove all values from the table.
+		 */
+		void clear() {
+			_keys.clear();
+			_values.clear();
+			rehash(ADDRESS_TABLE_INITIAL_CAPACITY);
+		};
+	
+	private:
+		std::vector<int> _slots;					/**< Hash table of indices into the value array */
+		std::vector<unsigned long long> _keys;		/**< Keys, parallel to the values */
+		std::vector<T> _values;						/**< Values in insertion order */
+		unsigned int _mask;							/**< Slot count minus one */
+		
+		/**
+		 * Get the slot that a key hashes to.  Keys are mixed with a Fibonacci
+		 * multiplier so that addresses that differ only in the port spread
+		 * across the table.
+		 * @param key The key.
+		 * @return The key's home slot.
+		 */
+		inline unsigned int getHomeSlot(unsigned long long key) const {
+			return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & _mask;
+		};
+		
+		/**
+		 * Find the slot containing a key, or the empty slot at which the key
+		 * would be inserted.
+		 * @param key The key.
+		 * @return The slot.
+		 */
+		inline int findSlot(unsigned long long key) const {
+			unsigned int slot = getHomeSlot(key);
+			
+			while ((_slots[slot] != ADDRESS_TABLE_EMPTY) && (_keys[_slots[slot]] != key)) {
+				slot = (slot + 1) & _mask;
+			}
+			
+			return slot;
+		};
+		
+		/**
+		 * Empty a slot, shifting back any entries further along the probe
+		 * sequence that would otherwise become unreachable.
+		 * @param slot The slot to empty.
+		 */
+		void removeSlot(unsigned int slot) {
+			unsigned int next = slot;
+			
+			while (true) {
+				next = (next + 1) & _mask;
+				
+				if (_slots[next] == ADDRESS_TABLE_EMPTY) break;
+				
+				// Entries can only move back if the gap lies between their
+				// home slot and their current slot
+				unsigned int home = getHomeSlot(_keys[_slots[next]]);
+				
+				if (((next - home) & _mask) >= ((next - slot) & _mask)) {
+					_slots[slot] = _slots[next];
+					slot = next;
+				}
+			}
+			
+			_slots[slot] = ADDRESS_TABLE_EMPTY;
+		};
+		
+		/**
+		 * Rebuild the hash table with a new number of slots.
+		 * @param capacity Number of slots; must be a power of two.
+		 */
+		void rehash(unsigned int capacity) {
+			_slots.assign(capacity, ADDRESS_TABLE_EMPTY);
+			_mask = capacity - 1;
+			
+			for (unsigned int i = 0; i < _keys.size(); ++i) {
+				_slots[findSlot(_keys[i])] = i;
+			}
+		};
+	};
+}
+
+#endif
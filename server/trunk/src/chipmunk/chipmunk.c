@@ -32,6 +32,31 @@ extern "C" {
 #endif
 
 
+#ifdef CP_COUNT_ALLOCATIONS
+unsigned long cpAllocationCount = 0;
+
+void *
+cpCountedCalloc(size_t count, size_t size)
+{
+	cpAllocationCount++;
+	return calloc(count, size);
+}
+
+void *
+cpCountedMalloc(size_t size)
+{
+	cpAllocationCount++;
+	return malloc(size);
+}
+
+void *
+cpCountedRealloc(void *ptr, size_t size)
+{
+	cpAllocationCount++;
+	return realloc(ptr, size);
+}
+#endif
+
 void
 cpInitChipmunk(void)
 {
@@ -47,7 +72,7 @@ cpMomentForCircle(cpFloat m, cpFloat r1, cpFloat r2, cpVect offset)
 cpFloat
 cpMomentForPoly(cpFloat m, const int numVerts, cpVect *verts, cpVect offset)
 {
-	cpVect *tVerts = (cpVect *)calloc(numVerts, sizeof(cpVect));
+	cpVect *tVerts = (cpVect *)cpcalloc(numVerts, sizeof(cpVect));
 	for(int i=0; i<numVerts; i++)
 		tVerts[i] = cpvadd(verts[i], offset);
 	
@@ -64,6 +89,6 @@ cpMomentForPoly(cpFloat m, const int numVerts, cpVect *verts, cpVect offset)
 		sum2 += a;
 	}
 	
-	free(tVerts);
+	cpfree(tVerts);
 	return (m*sum1)/(6.0f*sum2);
 }
@@ -0,0 +1,113 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The bounding box tree is a second alternative to the spatial hash, for
+// large worlds where objects are spread unevenly. Each object is a leaf in a
+// binary tree of bounding boxes, and each branch's box contains both of its
+// children. Queries only descend into branches whose boxes they touch.
+//
+// Leaves are given a box a little larger than their object's, and stretched
+// in the direction it is moving, so an object only has to be moved in the
+// tree when it leaves that box. The tree is kept
+// balanced with rotations, as in an AVL tree, as objects are moved.
+
+typedef struct cpBBTreeNode{
+	// Fattened bounding box of the object for leaves, and the union of the
+	// children's boxes for branches.
+	cpBB bb;
+	// Pointer to the object, or NULL for branches.
+	void *obj;
+	
+	// Parent node, or NULL for the root.
+	struct cpBBTreeNode *parent;
+	// Children of a branch.
+	struct cpBBTreeNode *a, *b;
+	// Height of the subtree. Leaves are 0.
+	int height;
+} cpBBTreeNode;
+
+// BBox callback. Called whenever the tree needs a bounding box from an object.
+typedef cpBB (*cpBBTreeBBFunc)(void *obj);
+// Velocity callback. Called when an object's leaf is given a new box.
+typedef cpVect (*cpBBTreeVelocityFunc)(void *obj);
+
+typedef struct cpBBTree{
+	// Amount added to each side of an object's box for its leaf, as a
+	// fraction of the length of the box's longer side. (Defaults to 0.1)
+	cpFloat fatten;
+	// Time an object can move for at its current velocity and stay in its
+	// leaf's box. Only used with a velocity callback. (Defaults to 0.1)
+	cpFloat predict;
+	
+	// BBox callback.
+	cpBBTreeBBFunc bbfunc;
+	// Velocity callback, or NULL if the objects don't move on their own.
+	// (Defaults to NULL)
+	cpBBTreeVelocityFunc velocityfunc;
+	
+	// Hashset of the leaves, for finding the leaf of an object.
+	cpHashSet *leaves;
+	
+	cpBBTreeNode *root;
+	// List of recycled nodes, linked through their parents.
+	cpBBTreeNode *pooledNodes;
+} cpBBTree;
+
+//Basic allocation/destruction functions.
+cpBBTree *cpBBTreeAlloc(void);
+cpBBTree *cpBBTreeInit(cpBBTree *tree, cpBBTreeBBFunc bbfunc);
+cpBBTree *cpBBTreeNew(cpBBTreeBBFunc bbfunc);
+
+void cpBBTreeDestroy(cpBBTree *tree);
+void cpBBTreeFree(cpBBTree *tree);
+
+// Add an object to the tree.
+void cpBBTreeInsert(cpBBTree *tree, void *obj, unsigned int id, cpBB bb);
+// Remove an object from the tree.
+void cpBBTreeRemove(cpBBTree *tree, void *obj, unsigned int id);
+
+// Iterator function
+typedef void (*cpBBTreeIterator)(void *obj, void *data);
+// Iterate over the objects in the tree.
+void cpBBTreeEach(cpBBTree *tree, cpBBTreeIterator func, void *data);
+
+// Fetch new bounding boxes for all the objects, and move those that have
+// left their leaves' boxes.
+void cpBBTreeReindex(cpBBTree *tree);
+
+// Query callback.
+typedef int (*cpBBTreeQueryFunc)(void *obj1, void *obj2, void *data);
+// Point query the tree. A reference to the query point is passed as obj1 to the query callback.
+void cpBBTreePointQuery(cpBBTree *tree, cpVect point, cpBBTreeQueryFunc func, void *data);
+// Query the tree for a given BBox.
+void cpBBTreeQuery(cpBBTree *tree, void *obj, cpBB bb, cpBBTreeQueryFunc func, void *data);
+// Find every pair of objects in the tree whose leaves overlap.
+void cpBBTreeQueryPairs(cpBBTree *tree, cpBBTreeQueryFunc func, void *data);
+// Find every overlapping pair with one object from each tree. The object
+// from tree is passed to the callback as obj1.
+void cpBBTreeQueryTree(cpBBTree *tree, cpBBTree *other, cpBBTreeQueryFunc func, void *data);
+
+// Segment query callback. Returns the fraction of the way from a to b that
+// the segment hits the object, or 1.0 if it misses.
+typedef cpFloat (*cpBBTreeSegmentQueryFunc)(void *obj, void *data);
+// Find the objects whose leaves the segment from a to b passes through, in
+// no particular order. Once an object is hit, leaves beyond the hit are skipped.
+void cpBBTreeSegmentQuery(cpBBTree *tree, cpVect a, cpVect b, cpBBTreeSegmentQueryFunc func, void *data);
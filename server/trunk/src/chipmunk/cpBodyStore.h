@@ -0,0 +1,66 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Structure-of-arrays copy of the motion state of a space's bodies. Spaces
+// with useBodyStore set integrate the bodies that use the default
+// integration functions from these arrays in batches, with SIMD kernels,
+// instead of calling the functions one body at a time. Bodies with custom
+// integration functions are integrated by calling them, as before.
+//
+// The bodies remain the master copy of their state, as the solver and user
+// code access them directly. Each integration phase loads the bodies that it
+// integrates into the arrays a small batch at a time, and stores the results
+// back while the bodies are still in the cache.
+//
+// Rotations are calculated with chipmunk's own sine and cosine, which can
+// differ from libm's in the last bit, so a space integrated through a store
+// will drift from the same space integrated without one.
+
+typedef struct cpBodyStore{
+	// Number of bodies loaded, and the number there is room for.
+	int num, max;
+	
+	// Bodies loaded into the arrays, in array order.
+	cpBody **bodies;
+	
+	// Linear components of motion (position, velocity and force) and the bias velocity.
+	cpFloat *px, *py, *vx, *vy, *fx, *fy, *v_biasx, *v_biasy;
+	
+	// Angular components of motion (angle, angular velocity and torque), the
+	// bias velocity and the cached rotation.
+	cpFloat *a, *w, *t, *w_bias, *rotx, *roty;
+	
+	// Inverse mass and moment of inertia.
+	cpFloat *m_inv, *i_inv;
+} cpBodyStore;
+
+// Basic allocation/destruction functions.
+cpBodyStore *cpBodyStoreAlloc(void);
+cpBodyStore *cpBodyStoreInit(cpBodyStore *store);
+cpBodyStore *cpBodyStoreNew(void);
+
+void cpBodyStoreDestroy(cpBodyStore *store);
+void cpBodyStoreFree(cpBodyStore *store);
+
+// Integrate the positions or velocities of a list of bodies, as their
+// integration functions would.
+void cpBodyStoreUpdatePositions(cpBodyStore *store, cpArray *bodies, cpFloat dt);
+void cpBodyStoreUpdateVelocities(cpBodyStore *store, cpArray *bodies, cpVect gravity, cpFloat damping, cpFloat dt);
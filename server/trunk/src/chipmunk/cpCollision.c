@@ -25,6 +25,7 @@
 #include <assert.h>
 
 #include "chipmunk.h"
+#include "cpSIMD.h"
 
 typedef int (*collisionFunc)(cpShape*, cpShape*, cpContact**);
 
@@ -45,7 +46,7 @@ circle2circleQuery(cpVect p1, cpVect p2, cpFloat r1, cpFloat r2, cpContact **con
 	cpFloat non_zero_dist = (dist ? dist : INFINITY);
 
 	// Allocate and initialize the contact.
-	(*con) = (cpContact *)malloc(sizeof(cpContact));
+	(*con) = (cpContact *)cpmalloc(sizeof(cpContact));
 	cpContactInit(
 		(*con),
 		cpvadd(p1, cpvmult(delta, 0.5 + (r1 - 0.5*mindist)/non_zero_dist)),
@@ -97,7 +98,7 @@ circle2segment(cpShape *circleShape, cpShape *segmentShape, cpContact **con)
 	} else {
 		if(dt < dtMax){
 			cpVect n = (dn < 0.0f) ? seg->tn : cpvneg(seg->tn);
-			(*con) = (cpContact *)malloc(sizeof(cpContact));
+			(*con) = (cpContact *)cpmalloc(sizeof(cpContact));
 			cpContactInit(
 				(*con),
 				cpvadd(circ->tc, cpvmult(n, circ->r + dist*0.5f)),
@@ -126,11 +127,11 @@ addContactPoint(cpContact **arr, int *max, int *num)
 		// Allocate the array if it hasn't been done.
 		(*max) = 2;
 		(*num) = 0;
-		(*arr) = (cpContact *)malloc((*max)*sizeof(cpContact));
+		(*arr) = (cpContact *)cpmalloc((*max)*sizeof(cpContact));
 	} else if(*num == *max){
 		// Extend it if necessary.
 		(*max) *= 2;
-		(*arr) = (cpContact *)realloc(*arr, (*max)*sizeof(cpContact));
+		(*arr) = (cpContact *)cprealloc(*arr, (*max)*sizeof(cpContact));
 	}
 	
 	cpContact *con = &(*arr)[*num];
@@ -236,6 +237,101 @@ findPointsBehindSeg(cpContact **arr, int *max, int *num, cpSegmentShape *seg, cp
 	}
 }
 
+#ifdef CP_SIMD_ENABLED
+// Same as findMSA(), but finds the distances of poly to four of other's axes at
+// a time, from the split axis lists. Always inlined so that the copy in
+// poly2polyLanes() is compiled for the SIMD instruction set.
+static inline __attribute__((always_inline)) int
+findMSALanes(cpPolyShape *poly, cpPolyShape *other, cpFloat *min_out)
+{
+	cpVect *verts = poly->tVerts;
+	
+	int min_index = -1;
+	cpFloat min = 0.0f;
+	
+	for(int i=0; i<other->numVerts; i+=CP_SIMD_LANES){
+		cpFloatLanes nx = cpLoadLanes(other->tAxesX + i);
+		cpFloatLanes ny = cpLoadLanes(other->tAxesY + i);
+		
+		// As cpPolyShapeValueOnAxis().
+		cpFloatLanes lanes = nx*verts[0].x + ny*verts[0].y;
+		for(int j=1; j<poly->numVerts; j++){
+			cpFloatLanes dot = nx*verts[j].x + ny*verts[j].y;
+			lanes = cpSelectLanes(lanes < dot, lanes, dot);
+		}
+		lanes -= cpLoadLanes(other->tAxesD + i);
+		
+		cpMaskLanes separated = (lanes > 0.0);
+		if(cpAnyLanes(&separated)) return -1;
+		
+		// Lanes past the last axis hold padding.
+		for(int k=0; k<CP_SIMD_LANES && i + k<other->numVerts; k++){
+			if(min_index == -1 || lanes[k] > min){
+				min = lanes[k];
+				min_index = i + k;
+			}
+		}
+	}
+	
+	(*min_out) = min;
+	return min_index;
+}
+
+// Add contacts for the vertexes of poly that are inside other, four at a time.
+// Faces of other pointing away from facing are ignored, as in
+// cpPolyShapeContainsVertPartial().
+static inline __attribute__((always_inline)) void
+findVertsLanes(cpContact **arr, int *max, int *num, cpPolyShape *poly, cpPolyShape *other, cpVect facing, cpVect n, cpFloat dist)
+{
+	cpPolyShapeAxis *axes = other->tAxes;
+	
+	for(int i=0; i<poly->numVerts; i+=CP_SIMD_LANES){
+		cpFloatLanes x = cpLoadLanes(poly->tVertsX + i);
+		cpFloatLanes y = cpLoadLanes(poly->tVertsY + i);
+		cpMaskLanes outside = {0};
+		
+		for(int j=0; j<other->numVerts; j++){
+			if(cpvdot(axes[j].n, facing) < 0.0f) continue;
+			outside |= (axes[j].n.x*x + axes[j].n.y*y - axes[j].d > 0.0);
+		}
+		
+		// Lanes past the last vertex hold padding.
+		for(int k=0; k<CP_SIMD_LANES && i + k<poly->numVerts; k++){
+			if(!outside[k])
+				cpContactInit(addContactPoint(arr, max, num), poly->tVerts[i + k], n, dist, CP_HASH_PAIR(poly, i + k));
+		}
+	}
+}
+
+// Same as poly2poly(), using the SIMD kernels.
+CP_SIMD_TARGET static int
+poly2polyLanes(cpShape *shape1, cpShape *shape2, cpContact **arr)
+{
+	cpPolyShape *poly1 = (cpPolyShape *)shape1;
+	cpPolyShape *poly2 = (cpPolyShape *)shape2;
+	
+	cpFloat min1;
+	int mini1 = findMSALanes(poly2, poly1, &min1);
+	if(mini1 == -1) return 0;
+	
+	cpFloat min2;
+	int mini2 = findMSALanes(poly1, poly2, &min2);
+	if(mini2 == -1) return 0;
+	
+	int max = 0;
+	int num = 0;
+	
+	// There is overlap, find the penetrating verts
+	cpVect n = (min1 > min2) ? poly1->tAxes[mini1].n : cpvneg(poly2->tAxes[mini2].n);
+	cpFloat dist = (min1 > min2) ? min1 : min2;
+	
+	findVertsLanes(arr, &max, &num, poly1, poly2, cpvneg(n), n, dist);
+	findVertsLanes(arr, &max, &num, poly2, poly1, n, n, dist);
+	
+	return num;
+}
+#endif
+
 // This one is complicated and gross. Just don't go there...
 // TODO: Comment me!
 static int
@@ -337,7 +433,7 @@ circle2poly(cpShape *shape1, cpShape *shape2, cpContact **con)
 	if(dt < dtb){
 		return circle2circleQuery(circ->tc, b, circ->r, 0.0f, con);
 	} else if(dt < dta) {
-		(*con) = (cpContact *)malloc(sizeof(cpContact));
+		(*con) = (cpContact *)cpmalloc(sizeof(cpContact));
 		cpContactInit(
 			(*con),
 			cpvsub(circ->tc, cpvmult(n, circ->r + min/2.0f)),
@@ -367,13 +463,20 @@ extern "C" {
 	cpInitCollisionFuncs(void)
 	{
 		if(!colfuncs)
-			colfuncs = (collisionFunc *)calloc(CP_NUM_SHAPES*CP_NUM_SHAPES, sizeof(collisionFunc));
+			colfuncs = (collisionFunc *)cpcalloc(CP_NUM_SHAPES*CP_NUM_SHAPES, sizeof(collisionFunc));
 		
 		addColFunc(CP_CIRCLE_SHAPE,  CP_CIRCLE_SHAPE,  circle2circle);
 		addColFunc(CP_CIRCLE_SHAPE,  CP_SEGMENT_SHAPE, circle2segment);
 		addColFunc(CP_SEGMENT_SHAPE, CP_POLY_SHAPE,    seg2poly);
 		addColFunc(CP_CIRCLE_SHAPE,  CP_POLY_SHAPE,    circle2poly);
 		addColFunc(CP_POLY_SHAPE,    CP_POLY_SHAPE,    poly2poly);
+		
+#ifdef CP_SIMD_ENABLED
+		// Poly shapes only fill in the split lists the kernels use when the
+		// CPU supports them.
+		if(cpSIMDSupported())
+			addColFunc(CP_POLY_SHAPE, CP_POLY_SHAPE, poly2polyLanes);
+#endif
 	}	
 #ifdef __cplusplus
 }
@@ -19,17 +19,17 @@
  * SOFTWARE.
  */
  
-// cpHashSet uses a chained hashtable implementation.
-// Other than the transformation functions, there is nothing fancy going on.
+// cpHashSet uses an open addressing hashtable with linear probing.
+// Elements are stored in the table itself along with their hashes, so
+// inserting never allocates unless the table has to grow. Removals shift the
+// rest of the run back instead of leaving tombstones.
 
-// cpHashSetBin's form the linked lists in the chained hash table.
+// cpHashSetBin's are the cells of the hash table. Empty cells have a NULL element.
 typedef struct cpHashSetBin {
 	// Pointer to the element.
 	void *elt;
 	// Hash value of the element.
 	unsigned int hash;
-	// Next element in the chain.
-	struct cpHashSetBin *next;
 } cpHashSetBin;
 
 // Equality function. Returns true if ptr is equal to elt.
@@ -54,7 +54,7 @@ typedef struct cpHashSet {
 	// Defaults to NULL.
 	void *default_value;
 	
-	cpHashSetBin **table;
+	cpHashSetBin *table;
 } cpHashSet;
 
 // Basic allocation/destruction functions.
@@ -76,4 +76,5 @@ void *cpHashSetFind(cpHashSet *set, unsigned int hash, void *ptr);
 // Iterate over a hashset.
 void cpHashSetEach(cpHashSet *set, cpHashSetIterFunc func, void *data);
 // Iterate over a hashset while rejecting certain elements.
+// Every element is visited exactly once.
 void cpHashSetReject(cpHashSet *set, cpHashSetRejectFunc func, void *data);
@@ -39,6 +39,13 @@ typedef struct cpPolyShape{
 	// Transformed vertex and axis lists.
 	cpVect *tVerts;
 	cpPolyShapeAxis *tAxes;
+	
+	// Transformed vertex and axis lists split into a list per component for
+	// the SIMD collision kernels, which fill them in only when the CPU
+	// supports them. Padded to a whole number of lanes by repeating the last
+	// vertex and axis.
+	cpFloat *tVertsX, *tVertsY;
+	cpFloat *tAxesX, *tAxesY, *tAxesD;
 } cpPolyShape;
 
 // Basic allocation functions.
@@ -0,0 +1,90 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Support for chipmunk's SIMD kernels. Not intended for external use.
+//
+// Kernels are written with the compiler's vector extensions and process
+// CP_SIMD_LANES values at a time. Each has a scalar twin that performs the
+// same operations in the same order, so both produce identical results. The
+// twin handles whatever is left over after the last full batch, and does all
+// of the work when CP_NO_SIMD is defined or the compiler has no vector
+// extensions.
+//
+// On x86-64 Linux, kernels marked CP_SIMD_DISPATCH are compiled for both
+// AVX2 and the SSE2 baseline, and the loader picks the version that the CPU
+// supports. Elsewhere they are compiled for the build's target only.
+
+#if defined(__GNUC__) && !defined(CP_NO_SIMD)
+	#define CP_SIMD_ENABLED
+	#define CP_SIMD_LANES 4
+	
+	typedef cpFloat cpFloatLanes __attribute__((vector_size(CP_SIMD_LANES*sizeof(cpFloat))));
+	typedef long long cpMaskLanes __attribute__((vector_size(CP_SIMD_LANES*sizeof(long long))));
+	typedef int cpIntLanes __attribute__((vector_size(CP_SIMD_LANES*sizeof(int))));
+	
+	// Arrays need not be aligned.
+	typedef cpFloat cpUnalignedLanes __attribute__((vector_size(CP_SIMD_LANES*sizeof(cpFloat)), aligned(sizeof(cpFloat)), may_alias));
+	
+	#define cpLoadLanes(src) (*(const cpUnalignedLanes *)(src))
+	#define cpStoreLanes(dst, lanes) (*(cpUnalignedLanes *)(dst) = (lanes))
+	
+	// Build a vector from the lanes of a and b, numbered from a's first lane to
+	// b's last.
+	#ifdef __clang__
+		#define cpShuffleLanes(a, b, ...) __builtin_shufflevector(a, b, __VA_ARGS__)
+	#else
+		#define cpShuffleLanes(a, b, ...) __builtin_shuffle(a, b, (cpMaskLanes){__VA_ARGS__})
+	#endif
+	
+	// Take each lane from a where the mask is set, and from b elsewhere.
+	#define cpSelectLanes(mask, a, b) ((cpFloatLanes)(((mask) & (cpMaskLanes)(a)) | (~(mask) & (cpMaskLanes)(b))))
+	
+	static inline int
+	cpAnyLanes(const cpMaskLanes *mask)
+	{
+		int any = 0;
+		for(int i=0; i<CP_SIMD_LANES; i++) any |= ((*mask)[i] != 0);
+		return any;
+	}
+#else
+	#define CP_SIMD_LANES 1
+#endif
+
+// Length of an array of n values padded to a whole number of lanes.
+#define CP_SIMD_PADDED(n) (((n) + CP_SIMD_LANES - 1)/CP_SIMD_LANES*CP_SIMD_LANES)
+
+#if defined(CP_SIMD_ENABLED) && defined(__x86_64__) && defined(__linux__)
+	#define CP_SIMD_DISPATCH __attribute__((target_clones("avx2", "default")))
+#else
+	#define CP_SIMD_DISPATCH
+#endif
+
+// Kernels that are only worthwhile with wide vectors are compiled for AVX2 on
+// x86 with CP_SIMD_TARGET, and used in place of the scalar code when
+// cpSIMDSupported() says the CPU can run them. Elsewhere they are compiled
+// for the build's target and always used.
+#if defined(CP_SIMD_ENABLED) && (defined(__x86_64__) || defined(__i386__))
+	#define CP_SIMD_TARGET __attribute__((target("avx2")))
+	#define cpSIMDSupported() __builtin_cpu_supports("avx2")
+#elif defined(CP_SIMD_ENABLED)
+	#define CP_SIMD_TARGET
+	#define cpSIMDSupported() 1
+#endif
@@ -23,9 +23,64 @@
 #include <stdio.h>
 #include <math.h>
 #include <assert.h>
+#include <string.h>
 
 #include "chipmunk.h"
 
+#ifdef CP_PROFILE_ENABLED
+
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+// Read a monotonic high resolution clock, in seconds.
+static double
+profileTime(void)
+{
+#ifdef __APPLE__
+	static mach_timebase_info_data_t timebase = {0, 0};
+	if(!timebase.denom) mach_timebase_info(&timebase);
+	return (double)mach_absolute_time()*timebase.numer/timebase.denom*1e-9;
+#else
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec*1e-9;
+#endif
+}
+
+// Count the bins currently linking handles into the active spatial hash.
+// The other broadphases have no bins, so they count as zero.
+static int
+countBins(cpSpace *space)
+{
+	if(space->broadphase != CP_BROADPHASE_HASH) return 0;
+	
+	cpSpaceHash *hash = space->activeShapes;
+	int count = 0;
+	for(int i=0; i<hash->numcells; i++){
+		for(cpSpaceHashBin *bin = hash->table[i]; bin; bin = bin->next)
+			count++;
+	}
+	
+	return count;
+}
+
+#define CP_PROFILE_BEGIN(space) double profileStart = profileTime(), profileMark = profileStart; memset(&(space)->stats, 0, sizeof(cpSpaceStepStats))
+#define CP_PROFILE_PHASE(space, phase) { double now = profileTime(); (space)->stats.phaseTime[phase] = now - profileMark; profileMark = now; }
+#define CP_PROFILE_END(space) (space)->stats.stepTime = profileTime() - profileStart
+#define CP_PROFILE_COUNT(space, counter, n) (space)->stats.counter += (n)
+
+#else
+
+#define CP_PROFILE_BEGIN(space)
+#define CP_PROFILE_PHASE(space, phase)
+#define CP_PROFILE_END(space)
+#define CP_PROFILE_COUNT(space, counter, n)
+
+#endif
+
 int cp_contact_persistence = 3;
 
 // Equal function for contactSet.
@@ -80,7 +135,7 @@ collFuncSetTrans(void *ptr, void *data)
 	unsigned int *ids = (unsigned int *)ptr;
 	collFuncData *funcData = (collFuncData *)data;
 
-	cpCollPairFunc *pair = (cpCollPairFunc *)malloc(sizeof(cpCollPairFunc));
+	cpCollPairFunc *pair = (cpCollPairFunc *)cpmalloc(sizeof(cpCollPairFunc));
 	pair->a = ids[0];
 	pair->b = ids[1];
 	pair->func = funcData->func;
@@ -104,8 +159,15 @@ bbfunc(void *ptr)
 	return shape->bb;
 }
 
+static cpVect
+velocityfunc(void *ptr)
+{
+	cpShape *shape = (cpShape *)ptr;
+	return shape->body->v;
+}
+
 // Iterator functions for destructors.
-static void        freeWrap(void *ptr, void *unused){          free(             ptr);}
+static void        freeWrap(void *ptr, void *unused){        cpfree(             ptr);}
 static void   shapeFreeWrap(void *ptr, void *unused){   cpShapeFree((cpShape *)  ptr);}
 static void arbiterFreeWrap(void *ptr, void *unused){ cpArbiterFree((cpArbiter *)ptr);}
 static void    bodyFreeWrap(void *ptr, void *unused){    cpBodyFree((cpBody *)   ptr);}
@@ -114,7 +176,7 @@ static void   jointFreeWrap(void *ptr, void *unused){   cpJointFree((cpJoint *)
 cpSpace*
 cpSpaceAlloc(void)
 {
-	return (cpSpace *)calloc(1, sizeof(cpSpace));
+	return (cpSpace *)cpcalloc(1, sizeof(cpSpace));
 }
 
 #define DEFAULT_DIM_SIZE 100.0f
@@ -131,13 +193,25 @@ cpSpaceInit(cpSpace *space)
 	
 	space->gravity = cpvzero;
 	space->damping = 1.0f;
+	space->useBodyStore = 0;
 	
 	space->stamp = 0;
 
+	space->broadphase = CP_BROADPHASE_HASH;
+
 	space->staticShapes = cpSpaceHashNew(DEFAULT_DIM_SIZE, DEFAULT_COUNT, &bbfunc);
 	space->activeShapes = cpSpaceHashNew(DEFAULT_DIM_SIZE, DEFAULT_COUNT, &bbfunc);
+	space->staticSweep = cpSweepNew(0, &bbfunc);
+	space->activeSweep = cpSweepNew(0, &bbfunc);
+	space->staticTree = cpBBTreeNew(&bbfunc);
+	space->activeTree = cpBBTreeNew(&bbfunc);
+	
+	// Static shapes don't move, so their leaves don't need any room to move in.
+	space->staticTree->fatten = 0.0f;
+	space->activeTree->velocityfunc = &velocityfunc;
 	
 	space->bodies = cpArrayNew(0);
+	space->bodyStore = cpBodyStoreNew();
 	space->arbiters = cpArrayNew(0);
 	space->contactSet = cpHashSetNew(0, contactSetEql, contactSetTrans);
 	
@@ -148,6 +222,13 @@ cpSpaceInit(cpSpace *space)
 	space->collFuncSet = cpHashSetNew(0, collFuncSetEql, collFuncSetTrans);
 	space->collFuncSet->default_value = &space->defaultPairFunc;
 	
+	for(int i=0; i<CP_COLL_FUNC_TABLE_SIZE; i++){
+		for(int j=0; j<CP_COLL_FUNC_TABLE_SIZE; j++)
+			space->collFuncTable[i][j] = &space->defaultPairFunc;
+	}
+	
+	memset(&space->stats, 0, sizeof(cpSpaceStepStats));
+	
 	return space;
 }
 
@@ -162,8 +243,13 @@ cpSpaceDestroy(cpSpace *space)
 {
 	cpSpaceHashFree(space->staticShapes);
 	cpSpaceHashFree(space->activeShapes);
+	cpSweepFree(space->staticSweep);
+	cpSweepFree(space->activeSweep);
+	cpBBTreeFree(space->staticTree);
+	cpBBTreeFree(space->activeTree);
 	
 	cpArrayFree(space->bodies);
+	cpBodyStoreFree(space->bodyStore);
 	
 	cpArrayFree(space->joints);
 	
@@ -181,14 +267,27 @@ void
 cpSpaceFree(cpSpace *space)
 {
 	if(space) cpSpaceDestroy(space);
-	free(space);
+	cpfree(space);
+}
+
+// Iterate over the static or active shapes in the space's broadphase.
+static void
+eachShape(cpSpace *space, int statics, cpSpaceHashIterator func, void *data)
+{
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepEach(statics ? space->staticSweep : space->activeSweep, func, data);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreeEach(statics ? space->staticTree : space->activeTree, func, data);
+	} else {
+		cpSpaceHashEach(statics ? space->staticShapes : space->activeShapes, func, data);
+	}
 }
 
 void
 cpSpaceFreeChildren(cpSpace *space)
 {
-	cpSpaceHashEach(space->staticShapes, &shapeFreeWrap, NULL);
-	cpSpaceHashEach(space->activeShapes, &shapeFreeWrap, NULL);
+	eachShape(space, 1, &shapeFreeWrap, NULL);
+	eachShape(space, 0, &shapeFreeWrap, NULL);
 	cpArrayEach(space->bodies, &bodyFreeWrap, NULL);
 	cpArrayEach(space->joints, &jointFreeWrap, NULL);
 }
@@ -203,7 +302,12 @@ cpSpaceAddCollisionPairFunc(cpSpace *space, unsigned int a, unsigned int b,
 	cpSpaceRemoveCollisionPairFunc(space, a, b);
 		
 	collFuncData funcData = {func, data};
-	cpHashSetInsert(space->collFuncSet, hash, ids, &funcData);
+	cpCollPairFunc *pair = (cpCollPairFunc *)cpHashSetInsert(space->collFuncSet, hash, ids, &funcData);
+	
+	if(a < CP_COLL_FUNC_TABLE_SIZE && b < CP_COLL_FUNC_TABLE_SIZE){
+		space->collFuncTable[a][b] = pair;
+		space->collFuncTable[b][a] = pair;
+	}
 }
 
 void
@@ -212,7 +316,12 @@ cpSpaceRemoveCollisionPairFunc(cpSpace *space, unsigned int a, unsigned int b)
 	unsigned int ids[] = {a, b};
 	unsigned int hash = CP_HASH_PAIR(a, b);
 	cpCollPairFunc *old_pair = (cpCollPairFunc *)cpHashSetRemove(space->collFuncSet, hash, ids);
-	free(old_pair);
+	cpfree(old_pair);
+	
+	if(a < CP_COLL_FUNC_TABLE_SIZE && b < CP_COLL_FUNC_TABLE_SIZE){
+		space->collFuncTable[a][b] = &space->defaultPairFunc;
+		space->collFuncTable[b][a] = &space->defaultPairFunc;
+	}
 }
 
 void
@@ -225,14 +334,27 @@ cpSpaceSetDefaultCollisionPairFunc(cpSpace *space, cpCollFunc func, void *data)
 void
 cpSpaceAddShape(cpSpace *space, cpShape *shape)
 {
-	cpSpaceHashInsert(space->activeShapes, shape, shape->id, shape->bb);
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepInsert(space->activeSweep, shape, shape->bb);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreeInsert(space->activeTree, shape, shape->id, shape->bb);
+	} else {
+		cpSpaceHashInsert(space->activeShapes, shape, shape->id, shape->bb);
+	}
 }
 
 void
 cpSpaceAddStaticShape(cpSpace *space, cpShape *shape)
 {
 	cpShapeCacheBB(shape);
-	cpSpaceHashInsert(space->staticShapes, shape, shape->id, shape->bb);
+	
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepInsert(space->staticSweep, shape, shape->bb);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreeInsert(space->staticTree, shape, shape->id, shape->bb);
+	} else {
+		cpSpaceHashInsert(space->staticShapes, shape, shape->id, shape->bb);
+	}
 }
 
 void
@@ -250,13 +372,25 @@ cpSpaceAddJoint(cpSpace *space, cpJoint *joint)
 void
 cpSpaceRemoveShape(cpSpace *space, cpShape *shape)
 {
-	cpSpaceHashRemove(space->activeShapes, shape, shape->id);
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepRemove(space->activeSweep, shape);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreeRemove(space->activeTree, shape, shape->id);
+	} else {
+		cpSpaceHashRemove(space->activeShapes, shape, shape->id);
+	}
 }
 
 void
 cpSpaceRemoveStaticShape(cpSpace *space, cpShape *shape)
 {
-	cpSpaceHashRemove(space->staticShapes, shape, shape->id);
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepRemove(space->staticSweep, shape);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreeRemove(space->staticTree, shape, shape->id);
+	} else {
+		cpSpaceHashRemove(space->staticShapes, shape, shape->id);
+	}
 }
 
 void
@@ -288,6 +422,38 @@ updateBBCache(void *ptr, void *unused)
 	cpShapeCacheBB(shape);
 }
 
+static void
+shapeArrayPush(void *ptr, void *data)
+{
+	cpArrayPush((cpArray *)data, ptr);
+}
+
+void
+cpSpaceSetBroadphase(cpSpace *space, cpSpaceBroadphase broadphase)
+{
+	if(broadphase == space->broadphase) return;
+	
+	cpArray *statics = cpArrayNew(0);
+	cpArray *actives = cpArrayNew(0);
+	eachShape(space, 1, &shapeArrayPush, statics);
+	eachShape(space, 0, &shapeArrayPush, actives);
+	
+	for(int i=0; i<statics->num; i++)
+		cpSpaceRemoveStaticShape(space, (cpShape *)statics->arr[i]);
+	for(int i=0; i<actives->num; i++)
+		cpSpaceRemoveShape(space, (cpShape *)actives->arr[i]);
+	
+	space->broadphase = broadphase;
+	
+	for(int i=0; i<statics->num; i++)
+		cpSpaceAddStaticShape(space, (cpShape *)statics->arr[i]);
+	for(int i=0; i<actives->num; i++)
+		cpSpaceAddShape(space, (cpShape *)actives->arr[i]);
+	
+	cpArrayFree(statics);
+	cpArrayFree(actives);
+}
+
 void
 cpSpaceResizeStaticHash(cpSpace *space, cpFloat dim, int count)
 {
@@ -304,8 +470,15 @@ cpSpaceResizeActiveHash(cpSpace *space, cpFloat dim, int count)
 void 
 cpSpaceRehashStatic(cpSpace *space)
 {
-	cpSpaceHashEach(space->staticShapes, &updateBBCache, NULL);
-	cpSpaceHashRehash(space->staticShapes);
+	eachShape(space, 1, &updateBBCache, NULL);
+	
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepReindex(space->staticSweep);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreeReindex(space->staticTree);
+	} else {
+		cpSpaceHashRehash(space->staticShapes);
+	}
 }
 
 typedef struct pointQueryFuncPair {
@@ -326,22 +499,29 @@ pointQueryHelper(void *point, void *obj, void *data)
 }
 
 static void
-pointQuery(cpSpaceHash *hash, cpVect point, cpSpacePointQueryFunc func, void *data)
+pointQuery(cpSpace *space, int statics, cpVect point, cpSpacePointQueryFunc func, void *data)
 {
 	pointQueryFuncPair pair = {func, data};
-	cpSpaceHashPointQuery(hash, point, pointQueryHelper, &pair);
+	
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepPointQuery(statics ? space->staticSweep : space->activeSweep, point, pointQueryHelper, &pair);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreePointQuery(statics ? space->staticTree : space->activeTree, point, pointQueryHelper, &pair);
+	} else {
+		cpSpaceHashPointQuery(statics ? space->staticShapes : space->activeShapes, point, pointQueryHelper, &pair);
+	}
 }
 
 void
 cpSpaceShapePointQuery(cpSpace *space, cpVect point, cpSpacePointQueryFunc func, void *data)
 {
-	pointQuery(space->activeShapes, point, func, data);
+	pointQuery(space, 0, point, func, data);
 }
 
 void
 cpSpaceStaticShapePointQuery(cpSpace *space, cpVect point, cpSpacePointQueryFunc func, void *data)
 {
-	pointQuery(space->staticShapes, point, func, data);
+	pointQuery(space, 1, point, func, data);
 }
 
 static inline int
@@ -358,6 +538,17 @@ queryReject(cpShape *a, cpShape *b)
 		|| !(a->layers & b->layers);
 }
 
+// Find the collision pair function for two collision types.
+static inline cpCollPairFunc *
+findCollisionPairFunc(cpSpace *space, unsigned int a, unsigned int b)
+{
+	if(a < CP_COLL_FUNC_TABLE_SIZE && b < CP_COLL_FUNC_TABLE_SIZE)
+		return space->collFuncTable[a][b];
+	
+	unsigned int ids[] = {a, b};
+	return (cpCollPairFunc *)cpHashSetFind(space->collFuncSet, CP_HASH_PAIR(a, b), ids);
+}
+
 // Callback from the spatial hash.
 // TODO: Refactor this into separate functions?
 static int
@@ -368,6 +559,8 @@ queryFunc(void *p1, void *p2, void *data)
 	cpShape *b = (cpShape *)p2;
 	cpSpace *space = (cpSpace *)data;
 	
+	CP_PROFILE_COUNT(space, pairsTested, 1);
+	
 	// Reject any of the simple cases
 	if(queryReject(a,b)) return 0;
 	
@@ -379,9 +572,7 @@ queryFunc(void *p1, void *p2, void *data)
 	}
 	
 	// Find the collision pair function for the shapes.
-	unsigned int ids[] = {a->collision_type, b->collision_type};
-	unsigned int hash = CP_HASH_PAIR(a->collision_type, b->collision_type);
-	cpCollPairFunc *pairFunc = (cpCollPairFunc *)cpHashSetFind(space->collFuncSet, hash, ids);
+	cpCollPairFunc *pairFunc = findCollisionPairFunc(space, a->collision_type, b->collision_type);
 	if(!pairFunc->func) return 0; // A NULL pair function means don't collide at all.
 	
 	// Narrow-phase collision detection.
@@ -419,11 +610,13 @@ queryFunc(void *p1, void *p2, void *data)
 		// Add the arbiter to the list of active arbiters.
 		cpArrayPush(space->arbiters, arb);
 		
+		CP_PROFILE_COUNT(space, contacts, numContacts);
+		
 		return numContacts;
 	} else {
 		// The collision pair function rejected the collision.
 		
-		free(contacts);
+		cpfree(contacts);
 		return 0;
 	}
 }
@@ -462,32 +655,63 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 	cpArray *arbiters = space->arbiters;
 	cpArray *joints = space->joints;
 	
+	CP_PROFILE_BEGIN(space);
+	
 	// Empty the arbiter list.
 	cpHashSetReject(space->contactSet, &contactSetReject, space);
 	space->arbiters->num = 0;
 
 	// Integrate positions.
-	for(int i=0; i<bodies->num; i++){
-		cpBody *body = (cpBody *)bodies->arr[i];
-		body->position_func(body, dt);
+	if(space->useBodyStore){
+		cpBodyStoreUpdatePositions(space->bodyStore, bodies, dt);
+	} else {
+		for(int i=0; i<bodies->num; i++){
+			cpBody *body = (cpBody *)bodies->arr[i];
+			body->position_func(body, dt);
+		}
 	}
+	CP_PROFILE_PHASE(space, CP_PHASE_INTEGRATE_POSITIONS);
 	
 	// Pre-cache BBoxes and shape data.
-	cpSpaceHashEach(space->activeShapes, &updateBBCache, NULL);
+	eachShape(space, 0, &updateBBCache, NULL);
+	// The sweep and tree are reindexed up front as they are used for both queries.
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepReindex(space->activeSweep);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreeReindex(space->activeTree);
+	}
+	CP_PROFILE_PHASE(space, CP_PHASE_UPDATE_BB_CACHE);
 	
 	// Collide!
-	cpSpaceHashEach(space->activeShapes, &active2staticIter, space);
-	cpSpaceHashQueryRehash(space->activeShapes, &queryFunc, space);
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepQuerySweep(space->activeSweep, space->staticSweep, &queryFunc, space);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreeQueryTree(space->activeTree, space->staticTree, &queryFunc, space);
+	} else {
+		cpSpaceHashEach(space->activeShapes, &active2staticIter, space);
+	}
+	CP_PROFILE_PHASE(space, CP_PHASE_STATIC_QUERY);
+	
+	if(space->broadphase == CP_BROADPHASE_SWEEP){
+		cpSweepQueryPairs(space->activeSweep, &queryFunc, space);
+	} else if(space->broadphase == CP_BROADPHASE_TREE){
+		cpBBTreeQueryPairs(space->activeTree, &queryFunc, space);
+	} else {
+		cpSpaceHashQueryRehash(space->activeShapes, &queryFunc, space);
+	}
+	CP_PROFILE_PHASE(space, CP_PHASE_ACTIVE_QUERY);
 
 	// Prestep the arbiters.
 	for(int i=0; i<arbiters->num; i++)
 		cpArbiterPreStep((cpArbiter *)arbiters->arr[i], dt_inv);
+	CP_PROFILE_PHASE(space, CP_PHASE_ARBITER_PRESTEP);
 
 	// Prestep the joints.
 	for(int i=0; i<joints->num; i++){
 		cpJoint *joint = (cpJoint *)joints->arr[i];
 		joint->klass->preStep(joint, dt_inv);
 	}
+	CP_PROFILE_PHASE(space, CP_PHASE_JOINT_PRESTEP);
 
 	for(int i=0; i<space->elasticIterations; i++){
 		for(int j=0; j<arbiters->num; j++)
@@ -498,13 +722,19 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			joint->klass->applyImpulse(joint);
 		}
 	}
+	CP_PROFILE_PHASE(space, CP_PHASE_ELASTIC_ITERATIONS);
 
 	// Integrate velocities.
 	cpFloat damping = pow(1.0f/space->damping, -dt);
-	for(int i=0; i<bodies->num; i++){
-		cpBody *body = (cpBody *)bodies->arr[i];
-		body->velocity_func(body, space->gravity, damping, dt);
+	if(space->useBodyStore){
+		cpBodyStoreUpdateVelocities(space->bodyStore, bodies, space->gravity, damping, dt);
+	} else {
+		for(int i=0; i<bodies->num; i++){
+			cpBody *body = (cpBody *)bodies->arr[i];
+			body->velocity_func(body, space->gravity, damping, dt);
+		}
 	}
+	CP_PROFILE_PHASE(space, CP_PHASE_INTEGRATE_VELOCITIES);
 
 	for(int i=0; i<arbiters->num; i++)
 		cpArbiterApplyCachedImpulse((cpArbiter *)arbiters->arr[i]);
@@ -519,6 +749,9 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			joint->klass->applyImpulse(joint);
 		}
 	}
+	CP_PROFILE_PHASE(space, CP_PHASE_SOLVER);
+	CP_PROFILE_COUNT(space, activeArbiters, arbiters->num);
+	CP_PROFILE_COUNT(space, binsUsed, countBins(space));
 
 //	cpFloat dvsq = cpvdot(space->gravity, space->gravity);
 //	dvsq *= dt*dt * space->damping*space->damping;
@@ -527,4 +760,6 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 	
 	// Increment the stamp.
 	space->stamp++;
+	
+	CP_PROFILE_END(space);
 }
@@ -34,6 +34,51 @@ typedef struct cpCollPairFunc {
 	void *data;
 } cpCollPairFunc;
 
+// Collision pair functions for collision types below this are also kept in a
+// table so they can be looked up without hashing.
+#define CP_COLL_FUNC_TABLE_SIZE 32
+
+// Broadphases that a space can use to find the shapes that might be touching.
+typedef enum cpSpaceBroadphase {
+	CP_BROADPHASE_HASH, // Spatial hashes. (see cpSpaceHash.h)
+	CP_BROADPHASE_SWEEP, // Sorted lists. (see cpSweep.h)
+	CP_BROADPHASE_TREE // Bounding box trees. (see cpBBTree.h)
+} cpSpaceBroadphase;
+
+// Phases of cpSpaceStep() timed by the step profiler.
+typedef enum cpSpaceStepPhase {
+	CP_PHASE_INTEGRATE_POSITIONS, // Includes discarding stale arbiters.
+	CP_PHASE_UPDATE_BB_CACHE,
+	CP_PHASE_STATIC_QUERY,
+	CP_PHASE_ACTIVE_QUERY,
+	CP_PHASE_ARBITER_PRESTEP,
+	CP_PHASE_JOINT_PRESTEP,
+	CP_PHASE_ELASTIC_ITERATIONS,
+	CP_PHASE_INTEGRATE_VELOCITIES,
+	CP_PHASE_SOLVER,
+	CP_NUM_PHASES
+} cpSpaceStepPhase;
+
+// Statistics for the most recent call to cpSpaceStep(). Only filled in when
+// chipmunk is compiled with CP_PROFILE_ENABLED defined; otherwise the
+// profiling code compiles to nothing and the stats stay zeroed.
+typedef struct cpSpaceStepStats {
+	// Time spent in each phase, in seconds.
+	double phaseTime[CP_NUM_PHASES];
+	// Total time spent in the step, in seconds.
+	double stepTime;
+	
+	// Number of shape pairs passed to the collision callback by the hashes.
+	int pairsTested;
+	// Number of contacts generated by accepted collisions.
+	int contacts;
+	// Number of arbiters handed to the solver.
+	int activeArbiters;
+	// Number of handle bins in the active hash after rehashing. Zero unless
+	// the space uses the CP_BROADPHASE_HASH broadphase.
+	int binsUsed;
+} cpSpaceStepStats;
+
 typedef struct cpSpace{
 	// *** User definable fields
 	
@@ -49,17 +94,32 @@ typedef struct cpSpace{
 	// Default damping to supply when integrating rigid body motions.
 	cpFloat damping;
 	
+	// Integrate bodies that use the default integration functions in batches
+	// with SIMD kernels. (Defaults to 0, see cpBodyStore.h)
+	int useBodyStore;
+	
 	// *** Internally Used Fields
 	
 	// Time stamp. Is incremented on every call to cpSpaceStep().
 	int stamp;
 
+	// Broadphase that the shapes are kept in. Set with cpSpaceSetBroadphase().
+	cpSpaceBroadphase broadphase;
+
 	// The static and active shape spatial hashes.
 	cpSpaceHash *staticShapes;
 	cpSpaceHash *activeShapes;
+	// The static and active shape sweeps.
+	cpSweep *staticSweep;
+	cpSweep *activeSweep;
+	// The static and active shape trees.
+	cpBBTree *staticTree;
+	cpBBTree *activeTree;
 	
 	// List of bodies in the system.
 	cpArray *bodies;
+	// Store that bodies are integrated from when useBodyStore is set.
+	cpBodyStore *bodyStore;
 	// List of active arbiters for the impulse solver.
 	cpArray *arbiters;
 	// Persistant contact set.
@@ -72,6 +132,12 @@ typedef struct cpSpace{
 	cpHashSet *collFuncSet;
 	// Default collision pair function.
 	cpCollPairFunc defaultPairFunc;
+	// Collision pair function for each pair of small collision types, or
+	// defaultPairFunc if there isn't one.
+	cpCollPairFunc *collFuncTable[CP_COLL_FUNC_TABLE_SIZE][CP_COLL_FUNC_TABLE_SIZE];
+	
+	// Statistics for the last step.
+	cpSpaceStepStats stats;
 } cpSpace;
 
 // Basic allocation/destruction functions.
@@ -111,6 +177,9 @@ void cpSpaceStaticShapePointQuery(cpSpace *space, cpVect point, cpSpacePointQuer
 typedef void (*cpSpaceBodyIterator)(cpBody *body, void *data);
 void cpSpaceEachBody(cpSpace *space, cpSpaceBodyIterator func, void *data);
 
+// Move the shapes into a different broadphase. Defaults to CP_BROADPHASE_HASH.
+void cpSpaceSetBroadphase(cpSpace *space, cpSpaceBroadphase broadphase);
+
 // Spatial hash management functions.
 void cpSpaceResizeStaticHash(cpSpace *space, cpFloat dim, int count);
 void cpSpaceResizeActiveHash(cpSpace *space, cpFloat dim, int count);
@@ -0,0 +1,201 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chipmunk.h"
+
+cpSweep *
+cpSweepAlloc(void)
+{
+	return (cpSweep *)cpcalloc(1, sizeof(cpSweep));
+}
+
+cpSweep *
+cpSweepInit(cpSweep *sweep, int size, cpSweepBBFunc bbfunc)
+{
+	sweep->num = 0;
+	sweep->max = (size ? size : 4);
+	sweep->proxies = (cpSweepProxy *)cpmalloc(sweep->max*sizeof(cpSweepProxy));
+	
+	sweep->bbfunc = bbfunc;
+	
+	return sweep;
+}
+
+cpSweep *
+cpSweepNew(int size, cpSweepBBFunc bbfunc)
+{
+	return cpSweepInit(cpSweepAlloc(), size, bbfunc);
+}
+
+void
+cpSweepDestroy(cpSweep *sweep)
+{
+	cpfree(sweep->proxies);
+}
+
+void
+cpSweepFree(cpSweep *sweep)
+{
+	if(!sweep) return;
+	cpSweepDestroy(sweep);
+	cpfree(sweep);
+}
+
+// Move the proxy at index back towards the start of the list until it's in order.
+static inline void
+sortProxy(cpSweepProxy *proxies, int index)
+{
+	cpSweepProxy proxy = proxies[index];
+	
+	for(; index > 0 && proxies[index - 1].bb.l > proxy.bb.l; index--)
+		proxies[index] = proxies[index - 1];
+	
+	proxies[index] = proxy;
+}
+
+void
+cpSweepInsert(cpSweep *sweep, void *obj, cpBB bb)
+{
+	if(sweep->num == sweep->max){
+		sweep->max *= 2;
+		sweep->proxies = (cpSweepProxy *)cprealloc(sweep->proxies, sweep->max*sizeof(cpSweepProxy));
+	}
+	
+	cpSweepProxy *proxy = &sweep->proxies[sweep->num];
+	proxy->bb = bb;
+	proxy->obj = obj;
+	
+	sortProxy(sweep->proxies, sweep->num);
+	sweep->num++;
+}
+
+void
+cpSweepRemove(cpSweep *sweep, void *obj)
+{
+	for(int i=0; i<sweep->num; i++){
+		if(sweep->proxies[i].obj == obj){
+			// Close the gap to keep the list sorted.
+			sweep->num--;
+			memmove(&sweep->proxies[i], &sweep->proxies[i + 1], (sweep->num - i)*sizeof(cpSweepProxy));
+			return;
+		}
+	}
+}
+
+void
+cpSweepEach(cpSweep *sweep, cpSweepIterator func, void *data)
+{
+	for(int i=0; i<sweep->num; i++)
+		func(sweep->proxies[i].obj, data);
+}
+
+void
+cpSweepReindex(cpSweep *sweep)
+{
+	cpSweepProxy *proxies = sweep->proxies;
+	
+	for(int i=0; i<sweep->num; i++){
+		proxies[i].bb = sweep->bbfunc(proxies[i].obj);
+		
+		// Everything before i is already in order, so this is an insertion sort.
+		sortProxy(proxies, i);
+	}
+}
+
+void
+cpSweepPointQuery(cpSweep *sweep, cpVect point, cpSweepQueryFunc func, void *data)
+{
+	cpSweepProxy *proxies = sweep->proxies;
+	
+	for(int i=0; i<sweep->num && proxies[i].bb.l <= point.x; i++){
+		cpBB bb = proxies[i].bb;
+		if(point.x <= bb.r && bb.b <= point.y && point.y <= bb.t)
+			func(&point, proxies[i].obj, data);
+	}
+}
+
+void
+cpSweepQuery(cpSweep *sweep, void *obj, cpBB bb, cpSweepQueryFunc func, void *data)
+{
+	cpSweepProxy *proxies = sweep->proxies;
+	
+	for(int i=0; i<sweep->num && proxies[i].bb.l <= bb.r; i++){
+		void *other = proxies[i].obj;
+		if(obj != other && cpBBintersects(bb, proxies[i].bb))
+			func(obj, other, data);
+	}
+}
+
+// Pairs are only tested with proxies that start between a proxy's left and
+// right edges, so they are already known to overlap on the x axis.
+static inline int
+overlapsY(cpSweepProxy *a, cpSweepProxy *b)
+{
+	return (a->bb.b <= b->bb.t && b->bb.b <= a->bb.t);
+}
+
+void
+cpSweepQueryPairs(cpSweep *sweep, cpSweepQueryFunc func, void *data)
+{
+	cpSweepProxy *proxies = sweep->proxies;
+	int num = sweep->num;
+	
+	for(int i=0; i<num; i++){
+		cpSweepProxy *a = &proxies[i];
+		
+		for(int j=i+1; j<num && proxies[j].bb.l <= a->bb.r; j++){
+			cpSweepProxy *b = &proxies[j];
+			if(overlapsY(a, b)) func(a->obj, b->obj, data);
+		}
+	}
+}
+
+void
+cpSweepQuerySweep(cpSweep *sweep, cpSweep *other, cpSweepQueryFunc func, void *data)
+{
+	cpSweepProxy *proxies = sweep->proxies;
+	cpSweepProxy *otherProxies = other->proxies;
+	
+	// Walk both lists in order. Each pair is found from whichever of its two
+	// proxies starts first, by looking ahead in the other list.
+	int i = 0, j = 0;
+	while(i < sweep->num && j < other->num){
+		cpSweepProxy *a = &proxies[i];
+		cpSweepProxy *b = &otherProxies[j];
+		
+		if(b->bb.l < a->bb.l){
+			for(int k=i; k<sweep->num && proxies[k].bb.l <= b->bb.r; k++){
+				if(overlapsY(&proxies[k], b)) func(proxies[k].obj, b->obj, data);
+			}
+			
+			j++;
+		} else {
+			for(int k=j; k<other->num && otherProxies[k].bb.l <= a->bb.r; k++){
+				if(overlapsY(a, &otherProxies[k])) func(a->obj, otherProxies[k].obj, data);
+			}
+			
+			i++;
+		}
+	}
+}
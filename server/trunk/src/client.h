@@ -6,6 +6,8 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <stdio.h>
+#include <set>
+#include "trafficstats.h"
 
 namespace WiredMunk {
 	
@@ -42,9 +44,36 @@ namespace WiredMunk {
 		 */
 		inline const int getId() const { return _id; };
 		
+		/**
+		 * Get the statistics for traffic to and from the client.
+		 * @return The client's traffic statistics.
+		 */
+		inline TrafficStats* getStats() { return &_stats; };
+		
+		/**
+		 * Record that an object ID has been leased to the client.
+		 * @param objectId The ID.
+		 */
+		inline void addLease(unsigned int objectId) { _leasedIds.insert(objectId); };
+		
+		/**
+		 * Stop recording an ID as leased to the client.
+		 * @param objectId The ID.
+		 * @return True if the ID was leased to the client.
+		 */
+		inline bool removeLease(unsigned int objectId) { return _leasedIds.erase(objectId) > 0; };
+		
+		/**
+		 * Get the IDs leased to the client.
+		 * @return The leased IDs.
+		 */
+		inline std::set<unsigned int>* getLeases() { return &_leasedIds; };
+	
 	private:
 		struct sockaddr_in _address;				/**< The client's address */
 		int _id;									/**< The client's ID */
+		TrafficStats _stats;						/**< Traffic to and from the client */
+		std::set<unsigned int> _leasedIds;			/**< Object IDs leased to the client */
 	};
 }
 
@@ -5,6 +5,7 @@ using namespace WiredMunk;
 void ClientList::add(Client* client) {
 	if (!contains(client)) {
 		_clients.push_back(client);
+		_addresses.add(client->getAddress(), client);
 	}
 }
 
@@ -13,6 +14,7 @@ void ClientList::remove(Client* client) {
 	
 	if (index > -1) {
 		_clients.erase(_clients.begin() + index);
+		_addresses.remove(AddressTable<Client*>::getKey(client->getAddress()));
 	}
 }
 
@@ -34,24 +36,10 @@ const int ClientList::find(Client* client) const {
 	return -1;
 }
 
-const Client* ClientList::findByAddress(const struct sockaddr_in* address) const {
-	const struct sockaddr_in* currentAddress;
+Client* ClientList::findByAddress(const struct sockaddr_in* address) const {
+	Client* const* client = _addresses.find(address);
 	
-	for (int i = 0; i < _clients.size(); ++i) {
-		currentAddress = _clients.at(i)->getAddress();
-		
-		// Compare sockaddr_in structure data
-		if (currentAddress->sin_len != address->sin_len) continue;
-		if (currentAddress->sin_family != address->sin_family) continue;
-		if (currentAddress->sin_port != address->sin_port) continue;
-		if (currentAddress->sin_addr.s_addr != address->sin_addr.s_addr) continue;
-		
-		// Found a match
-		return _clients.at(i);
-	}
-
-	// No match
-	return NULL;
+	return (client == NULL ? NULL : *client);
 }
 
 const int ClientList::size() const {
@@ -64,4 +52,5 @@ void ClientList::clear() {
 	}
 	
 	_clients.clear();
+	_addresses.clear();
 }
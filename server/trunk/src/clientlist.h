@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "client.h"
+#include "addresstable.h"
 
 namespace WiredMunk {
 
@@ -45,7 +46,13 @@ namespace WiredMunk {
 		 */
 		const int find(Client* client) const;
 		
-		const Client* findByAddress(const struct sockaddr_in* address) const;
+		/**
+		 * Find a client by address.  Runs in constant time regardless of the
+		 * number of clients in the list.
+		 * @param address The client's address.
+		 * @return The client, or NULL if no client has the address.
+		 */
+		Client* findByAddress(const struct sockaddr_in* address) const;
 		
 		/**
 		 * Get the number of items in the list.
@@ -60,6 +67,7 @@ namespace WiredMunk {
 		
 	private:
 		std::vector<Client*> _clients;		/**< The list of client pointers */
+		AddressTable<Client*> _addresses;	/**< Clients indexed by address */
 	};
 }
 
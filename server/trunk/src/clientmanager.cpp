@@ -1,16 +1,36 @@
 #include "clientmanager.h"
 #include "client.h"
-#include "debug.h"
+#include "log.h"
+#include "tracer.h"
 #include "idserver.h"
+#include "serialisebase.h"
 
 using namespace WiredMunk;
 
-ClientManager::ClientManager(Socket* socket, int clientCount) {
+ClientManager::ClientManager(Socket* socket, int clientCount, const SessionSettings& settings) {
 	_socket = socket;
 	_clientCount = clientCount;
+	_readyClientCount = 0;
+	_settings = settings;
+}
+
+ClientManager::~ClientManager() {
+	for (int i = 0; i < _clients.size(); ++i) {
+		_socket->removeClientStats(_clients.at(i)->getAddress());
+		
+		std::set<unsigned int>* leases = _clients.at(i)->getLeases();
+		
+		for (std::set<unsigned int>::iterator it = leases->begin(); it != leases->end(); ++it) {
+			IDServer::releaseNetworkObjectId(*it);
+		}
+	}
+	
+	_clients.clear();
 }
 
 void ClientManager::handleMessageReceived(const Message& msg) {
+
+	TRACE_SCOPE("ClientManager::handleMessageReceived");
 	
 	switch (msg.getType()) {
 			
@@ -34,7 +54,13 @@ void ClientManager::handleMessageReceived(const Message& msg) {
 void ClientManager::handleHandshakeReceived(const Message& msg) {
 	
 	// Client trying to connect
-	Debug::printf("Client requests handshake\n");
+	LOG_DEBUG("Client requests handshake\n");
+	
+	// The first client to join may choose the session's settings.  They
+	// follow the room ID in the request
+	if ((_clients.size() == 0) && (msg.getDataLength() >= SERIALISED_INT_SIZE + SERIALISED_SESSION_SETTINGS_SIZE)) {
+		_settings.deserialise(msg.getData() + SERIALISED_INT_SIZE);
+	}
 	
 	// Attempt to add the client to the list; existing clients are ignored
 	addClient(msg.getAddress());
@@ -52,16 +78,13 @@ void ClientManager::handleHandshakeReceived(const Message& msg) {
 		// not the client was added, as a client may request a handshake
 		// multiple times if the reply packet gets lost
 		
-		// Store the client ID in a string			
-		int clientId = client->getId();
+		// Store the client ID and session settings in a string
+		unsigned char data[SERIALISED_INT_SIZE + SERIALISED_SESSION_SETTINGS_SIZE];
 		
-		unsigned char data[4];
-		data[0] = (unsigned char)(clientId >> 24);		// 1st byte of ID
-		data[1] = (unsigned char)(clientId >> 16);		// 2nd byte of ID
-		data[2] = (unsigned char)(clientId >> 8);		// 3rd byte of ID
-		data[3] = (unsigned char)(clientId & 0xFF);		// 4th byte of ID
+		SerialiseBase::serialise((unsigned int)client->getId(), data);
+		_settings.serialise(data + SERIALISED_INT_SIZE);
 		
-		Message reply(Message::MESSAGE_HANDSHAKE, msg.getId(), 5, data, msg.getAddress());
+		Message reply(Message::MESSAGE_HANDSHAKE, msg.getId(), sizeof(data), data, msg.getAddress());
 		_socket->sendMessage(&reply);
 		
 		// Do we have enough clients to start the simulation?
@@ -101,19 +124,36 @@ void ClientManager::handleReadyReceived(const Message& msg) {
 
 void ClientManager::handleObjectIdRequestReceived(const Message& msg) {
 
-	// Client requesting a unique object ID
+	// Client requesting a block of unique object IDs.  The request data
+	// contains the number of IDs wanted; requests without data are treated
+	// as a request for a single ID.  Only clients in the room may lease IDs,
+	// so that every lease is recorded against its holder
+	Client* client = _clients.findByAddress(msg.getAddress());
+	
+	if (client == NULL) return;
+	
+	unsigned int count = 1;
+	
+	if (msg.getDataLength() >= SERIALISED_SHORT_SIZE) {
+		count = SerialiseBase::deserialiseShort(msg.getData());
+	}
 	
-	// Store the object ID in a string			
-	int objectId = IDServer::getNextNetworkObjectId();
+	if (count < 1) count = 1;
+	if (count > OBJECT_ID_BLOCK_MAX) count = OBJECT_ID_BLOCK_MAX;
 	
-	unsigned char data[4];
-	data[0] = (unsigned char)(objectId >> 24);
-	data[1] = (unsigned char)(objectId >> 16);
-	data[2] = (unsigned char)(objectId >> 8);
-	data[3] = (unsigned char)(objectId & 0xFF);
+	unsigned int objectIds[count];
+	IDServer::leaseNetworkObjectIds(count, objectIds);
+	
+	// Store the object IDs in a string
+	unsigned char data[count * SERIALISED_INT_SIZE];
+	
+	for (unsigned int i = 0; i < count; ++i) {
+		SerialiseBase::serialise(objectIds[i], data + (i * SERIALISED_INT_SIZE));
+		client->addLease(objectIds[i]);
+	}
 	
 	// Send reply
-	Message reply(msg.getType(), msg.getId(), 4, data, msg.getAddress());
+	Message reply(msg.getType(), msg.getId(), count * SERIALISED_INT_SIZE, data, msg.getAddress());
 	_socket->sendMessage(&reply);
 }
 
@@ -128,9 +168,56 @@ void ClientManager::addClient(const struct sockaddr_in* address) {
 	// Add the new client
 	Client* client = new Client(address, IDServer::getNextClientId());
 	_clients.add(client);
+	
+	// Count the client's traffic from now on
+	_socket->addClientStats(address, client->getStats());
+}
+
+void ClientManager::removeClient(const struct sockaddr_in* address) {
+	Client* client = _clients.findByAddress(address);
+	
+	if (client == NULL) return;
+	
+	LOG_INFO("Client %d removed\n", client->getId());
+	client->getStats()->print("Client traffic");
+	
+	_socket->removeClientStats(address);
+	
+	_clients.remove(client);
+	delete client;
+}
+
+bool ClientManager::returnObjectId(const struct sockaddr_in* address, unsigned int objectId) {
+	Client* client = _clients.findByAddress(address);
+	
+	if (client == NULL) return false;
+	
+	return client->removeLease(objectId);
+}
+
+void ClientManager::returnObjectIds(const struct sockaddr_in* address, std::vector<unsigned int>* objectIds) {
+	Client* client = _clients.findByAddress(address);
+	
+	if (client == NULL) return;
+	
+	std::set<unsigned int>* leases = client->getLeases();
+	
+	objectIds->insert(objectIds->end(), leases->begin(), leases->end());
+	leases->clear();
+}
+
+void ClientManager::printTraffic() {
+	char name[32];
+	
+	for (int i = 0; i < _clients.size(); ++i) {
+		sprintf(name, "Client %d", _clients.at(i)->getId());
+		_clients.at(i)->getStats()->print(name);
+	}
 }
 
 void ClientManager::sendSpace(Space* space) {
+	TRACE_SCOPE("ClientManager::sendSpace");
+	
 	for (int i = 0; i < _clients.size(); ++i) {
 		space->sendObject(_clients.at(i)->getAddress());
 	}
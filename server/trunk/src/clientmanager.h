@@ -6,6 +6,9 @@
 #include "socket.h"
 #include "message.h"
 #include "space.h"
+#include "sessionsettings.h"
+
+#define OBJECT_ID_BLOCK_MAX 256
 
 namespace WiredMunk {
 
@@ -20,8 +23,16 @@ namespace WiredMunk {
 		 * @param socket Pointer to a socket used for communicating with
 		 * clients.
 		 * @param clientCount Number of clients required to connect.
+		 * @param settings Timing settings for the session, used unless the
+		 * first client to connect proposes its own.
+		 */
+		ClientManager(Socket* socket, int clientCount, const SessionSettings& settings);
+		
+		/**
+		 * Destructor.  Returns the IDs still leased to clients to the
+		 * IDServer.
 		 */
-		ClientManager(Socket* socket, int clientCount);
+		virtual ~ClientManager();
 		
 		/**
 		 * Handles incoming messages from the socket.
@@ -35,11 +46,45 @@ namespace WiredMunk {
 		 */
 		void sendSpace(Space* space);
 		
+		/**
+		 * Remove a client that has disconnected or timed out.
+		 * @param address The client's address.
+		 */
+		void removeClient(const struct sockaddr_in* address);
+		
+		/**
+		 * Take back an object ID that a client has finished with.
+		 * @param address The client's address.
+		 * @param objectId The ID.
+		 * @return True if the ID was leased to the client; false if the
+		 * client does not hold it and it must not be released.
+		 */
+		bool returnObjectId(const struct sockaddr_in* address, unsigned int objectId);
+		
+		/**
+		 * Take back all of the object IDs leased to a client.
+		 * @param address The client's address.
+		 * @param objectIds Vector that receives the IDs.
+		 */
+		void returnObjectIds(const struct sockaddr_in* address, std::vector<unsigned int>* objectIds);
+		
+		/**
+		 * Print the traffic statistics for each client.
+		 */
+		void printTraffic();
+		
+		/**
+		 * Get the session's timing settings.
+		 * @return The session settings.
+		 */
+		inline const SessionSettings& getSettings() const { return _settings; };
+	
 	private:
 		ClientList _clients;			/**< List of clients */
 		Socket* _socket;				/**< Socket for client communication */
 		int _clientCount;				/**< Number of expected clients */
 		int _readyClientCount;			/**< Number of clients ready to start */
+		SessionSettings _settings;		/**< Timing settings for the session */
 		
 		/**
 		 * Add a client to the list of clients.
@@ -49,8 +94,10 @@ namespace WiredMunk {
 		
 		/**
 		 * Receives handshake requests from clients and responds with a
-		 * message containing a unique client id.  If the simulation is full,
-		 * the client is sent a rejection message instead.
+		 * message containing a unique client id and the session settings.  If
+		 * the simulation is full, the client is sent a rejection message
+		 * instead.  If the first client to join includes settings after the
+		 * room ID in its request, they become the session's settings.
 		 * @param msg Message data.
 		 */
 		void handleHandshakeReceived(const Message& msg);
@@ -65,8 +112,8 @@ namespace WiredMunk {
 		void handleReadyReceived(const Message& msg);
 		
 		/**
-		 * Receives requests for unique object ids from the clients.  Responds
-		 * with a unique id.
+		 * Receives requests for blocks of unique object ids from the clients.
+		 * Responds with up to OBJECT_ID_BLOCK_MAX unique ids.
 		 * @param msg Message data.
 		 */
 		void handleObjectIdRequestReceived(const Message& msg);
@@ -0,0 +1,143 @@
+#ifndef _CONNECTION_H_
+#define _CONNECTION_H_
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define CONNECTION_RTT_SMOOTHING 0.125
+
+namespace WiredMunk {
+
+	class Room;
+	
+	/**
+	 * Server-side state for a single remote address, stored by value in the
+	 * server's connection table.
+	 */
+	class Connection {
+	public:
+		
+		/**
+		 * Constructor.
+		 */
+		inline Connection() {
+			_key = 0;
+			_room = NULL;
+			_lastSeenTime = 0;
+			_pingSentTime = 0;
+			_nextCheckTime = 0;
+			_rtt = 0;
+		};
+		
+		/**
+		 * Constructor.
+		 * @param key The connection's key in the connection table.
+		 * @param address The remote address.
+		 * @param room The room that the client belongs to.
+		 * @param now The current time in milliseconds.
+		 */
+		inline Connection(unsigned long long key, const struct sockaddr_in* address, Room* room, unsigned long long now) {
+			_key = key;
+			_address = *address;
+			_room = room;
+			_lastSeenTime = now;
+			_pingSentTime = 0;
+			_nextCheckTime = 0;
+			_rtt = 0;
+		};
+		
+		/**
+		 * Get the connection's key.
+		 * @return The connection's key.
+		 */
+		inline unsigned long long getKey() const { return _key; };
+		
+		/**
+		 * Get the remote address.
+		 * @return The remote address.
+		 */
+		inline const struct sockaddr_in* getAddress() const { return &_address; };
+		
+		/**
+		 * Get the room that the client belongs to.
+		 * @return The client's room.
+		 */
+		inline Room* getRoom() const { return _room; };
+		
+		/**
+		 * Get the time at which a message was last received from the client.
+		 * @return The time in milliseconds.
+		 */
+		inline unsigned long long getLastSeenTime() const { return _lastSeenTime; };
+		
+		/**
+		 * Record that a message has been received from the client.
+		 * @param now The current time in milliseconds.
+		 */
+		inline void touch(unsigned long long now) { _lastSeenTime = now; };
+		
+		/**
+		 * Get the time at which the connection is next due to be checked for
+		 * idleness.
+		 * @return The time in milliseconds.
+		 */
+		inline unsigned long long getNextCheckTime() const { return _nextCheckTime; };
+		
+		/**
+		 * Set the time at which the connection is next due to be checked for
+		 * idleness.  Checks that fire at any other time are stale.
+		 * @param time The time in milliseconds.
+		 */
+		inline void setNextCheckTime(unsigned long long time) { _nextCheckTime = time; };
+		
+		/**
+		 * Check if a ping has been sent that has not yet been answered.
+		 * @return True if a ping is outstanding.
+		 */
+		inline bool isPingOutstanding() const { return _pingSentTime != 0; };
+		
+		/**
+		 * Record that a ping has been sent to the client.
+		 * @param now The current time in milliseconds.
+		 */
+		inline void pingSent(unsigned long long now) { _pingSentTime = now; };
+		
+		/**
+		 * Record that a ping reply has been received from the client, and
+		 * update the smoothed round trip time.  Replies with no outstanding
+		 * ping are ignored.
+		 * @param now The current time in milliseconds.
+		 */
+		inline void pingReceived(unsigned long long now) {
+			if (_pingSentTime == 0) return;
+			
+			unsigned int sample = (unsigned int)(now - _pingSentTime);
+			_pingSentTime = 0;
+			
+			if (_rtt == 0) {
+				_rtt = sample;
+			} else {
+				_rtt = (unsigned int)(_rtt + (sample - (double)_rtt) * CONNECTION_RTT_SMOOTHING);
+			}
+		};
+		
+		/**
+		 * Get the smoothed round trip time.
+		 * @return The round trip time in milliseconds, or 0 if it has not yet
+		 * been measured.
+		 */
+		inline unsigned int getRtt() const { return _rtt; };
+	
+	private:
+		unsigned long long _key;				/**< Key in the connection table */
+		struct sockaddr_in _address;			/**< The remote address */
+		Room* _room;							/**< The room the client belongs to */
+		unsigned long long _lastSeenTime;		/**< Time the client was last heard from */
+		unsigned long long _pingSentTime;		/**< Time of the outstanding ping, or 0 */
+		unsigned long long _nextCheckTime;		/**< Time of the next idle check */
+		unsigned int _rtt;						/**< Smoothed round trip time */
+	};
+}
+
+#endif
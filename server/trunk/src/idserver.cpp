@@ -3,4 +3,51 @@
 using namespace WiredMunk;
 
 unsigned int IDServer::_clientId = 1;
-unsigned int IDServer::_networkObjectId = 1;
+HandleAllocator IDServer::_networkObjectIds(1);
+pthread_mutex_t IDServer::_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+unsigned int IDServer::getNextClientId() {
+	pthread_mutex_lock(&_mutex);
+	unsigned int clientId = _clientId++;
+	pthread_mutex_unlock(&_mutex);
+	
+	LOG_DEBUG("Generated client ID: %d\n", clientId);
+	
+	return clientId;
+}
+
+unsigned int IDServer::getNextNetworkObjectId() {
+	pthread_mutex_lock(&_mutex);
+	unsigned int objectId = _networkObjectIds.allocate();
+	pthread_mutex_unlock(&_mutex);
+	
+	LOG_DEBUG("Generated network object ID: %d\n", objectId);
+	
+	return objectId;
+}
+
+void IDServer::leaseNetworkObjectIds(unsigned int count, unsigned int* objectIds) {
+	pthread_mutex_lock(&_mutex);
+	
+	for (unsigned int i = 0; i < count; ++i) {
+		objectIds[i] = _networkObjectIds.allocate();
+	}
+	
+	pthread_mutex_unlock(&_mutex);
+	
+	LOG_DEBUG("Leased %d network object IDs\n", count);
+}
+
+void IDServer::releaseNetworkObjectId(unsigned int objectId) {
+	pthread_mutex_lock(&_mutex);
+	_networkObjectIds.release(objectId);
+	pthread_mutex_unlock(&_mutex);
+}
+
+bool IDServer::isNetworkObjectIdLive(unsigned int objectId) {
+	pthread_mutex_lock(&_mutex);
+	bool isLive = _networkObjectIds.isLive(objectId);
+	pthread_mutex_unlock(&_mutex);
+	
+	return isLive;
+}
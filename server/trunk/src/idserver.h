@@ -1,12 +1,16 @@
 #ifndef _ID_SERVER_H_
 #define _ID_SERVER_H_
 
-#include "debug.h"
+#include <pthread.h>
+#include "log.h"
+#include "handleallocator.h"
 
 namespace WiredMunk {
 
 	/**
-	 * Generates unique ID numbers for clients and network objects.
+	 * Generates unique ID numbers for clients and network objects.  IDs are
+	 * shared by all rooms, which may run on different threads, so all
+	 * functions are thread-safe.
 	 */
 	class IDServer {
 	public:
@@ -15,25 +19,43 @@ namespace WiredMunk {
 		 * Get a unique client ID.
 		 * @return A unique client ID.
 		 */
-		inline static unsigned int getNextClientId() {
-			Debug::printf("Generated client ID: %d\n", _clientId);
-					
-			return _clientId++;
-		};
+		static unsigned int getNextClientId();
 		
 		/**
 		 * Get a unique network object ID.
 		 * @return A unique network object ID.
 		 */
-		inline static unsigned int getNextNetworkObjectId() {
-			Debug::printf("Generated network object ID: %d\n", _networkObjectId);
-			
-			return _networkObjectId++;
-		};
+		static unsigned int getNextNetworkObjectId();
+		
+		/**
+		 * Lease a block of network object IDs to a client, so that the client
+		 * can create objects without a round trip to the server per object.
+		 * @param count The number of IDs to lease.
+		 * @param objectIds Array that will receive the IDs.  Must be large
+		 * enough to hold count IDs.
+		 */
+		static void leaseNetworkObjectIds(unsigned int count, unsigned int* objectIds);
+		
+		/**
+		 * Return a network object ID to the pool once the object it was
+		 * allocated to has been destroyed.  The ID's slot will be reused with
+		 * a new generation, so the returned ID itself is never handed out
+		 * again until the generation wraps.
+		 * @param objectId The ID to release.
+		 */
+		static void releaseNetworkObjectId(unsigned int objectId);
+		
+		/**
+		 * Check if a network object ID is still allocated.
+		 * @param objectId The ID to check.
+		 * @return True if the ID is live; false if it is stale.
+		 */
+		static bool isNetworkObjectIdLive(unsigned int objectId);
 		
 	private:
 		static unsigned int _clientId;			/**< The next client ID */
-		static unsigned int _networkObjectId;	/**< The next network object ID */
+		static HandleAllocator _networkObjectIds;	/**< Allocates network object IDs */
+		static pthread_mutex_t _mutex;			/**< Guards the IDs */
 	};
 }
 
@@ -0,0 +1,208 @@
+#ifndef _LOOPBACK_NETWORK_H_
+#define _LOOPBACK_NETWORK_H_
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <map>
+#include <vector>
+
+#define LOOPBACK_FIRST_EPHEMERAL_PORT 49152
+// Largest datagram carried, which is the largest message a Socket can
+// receive (MESSAGE_BUFFER_LENGTH - 1)
+#define LOOPBACK_MAX_DATAGRAM 16383
+
+namespace WiredMunk {
+
+	/**
+	 * Conditions on a simulated link.  Rates are probabilities between 0 and
+	 * 1.  The defaults describe a perfect link.
+	 */
+	struct LinkSettings {
+		unsigned int latencyMs;				/**< One-way delay */
+		unsigned int jitterMs;				/**< Largest random delay added to the latency */
+		double lossRate;					/**< Chance of a datagram being lost */
+		double reorderRate;					/**< Chance of a datagram being held back so that later datagrams overtake it */
+		unsigned int reorderDelayMs;		/**< Largest extra delay of a held back datagram */
+		double duplicateRate;				/**< Chance of a datagram being delivered twice */
+		unsigned int bandwidth;				/**< Bytes per second the link carries, or 0 for no limit */
+		unsigned int queueMs;				/**< Longest a datagram can wait for bandwidth before it is dropped, or 0 for no limit */
+		
+		LinkSettings() {
+			latencyMs = 0;
+			jitterMs = 0;
+			lossRate = 0;
+			reorderRate = 0;
+			reorderDelayMs = 0;
+			duplicateRate = 0;
+			bandwidth = 0;
+			queueMs = 0;
+		};
+	};
+	
+	/**
+	 * Counts of what happened to the datagrams sent over a loopback network.
+	 */
+	struct LinkStats {
+		unsigned long sent;					/**< Datagrams sent */
+		unsigned long delivered;			/**< Datagrams received, including duplicates */
+		unsigned long lost;					/**< Datagrams lost to the loss rate or sent to an unbound port */
+		unsigned long dropped;				/**< Datagrams dropped because the link's queue was full */
+		unsigned long reordered;			/**< Datagrams held back */
+		unsigned long duplicated;			/**< Extra copies of datagrams */
+		unsigned long oversized;			/**< Datagrams refused for being larger than LOOPBACK_MAX_DATAGRAM */
+		unsigned long long bytesDelivered;	/**< Bytes received, including duplicates */
+	};
+	
+	/**
+	 * An in-process network that carries datagrams between sockets over
+	 * simulated links, in place of UDP.  Each socket binds a port on the
+	 * network and appears to its peers at 127.0.0.1 on that port.
+	 *
+	 * Every datagram passes over the link from its sender to its receiver,
+	 * which applies the link's latency, jitter, loss, reordering,
+	 * duplication and bandwidth limit.  Each direction between two ports is
+	 * a separate link with its own bandwidth.  All random decisions come
+	 * from a generator seeded at construction, and time is read from
+	 * TickScheduler::getTime(), so a single-threaded run driven by a
+	 * simulated clock (see TickScheduler::setClock()) behaves identically
+	 * every time.
+	 *
+	 * All methods are thread safe.
+	 */
+	class LoopbackNetwork {
+	public:
+		
+		/**
+		 * Constructor.
+		 * @param seed Seed for the random number generator.
+		 */
+		LoopbackNetwork(unsigned int seed);
+		
+		/**
+		 * Destructor.  Discards any datagrams still in flight.
+		 */
+		~LoopbackNetwork();
+		
+		/**
+		 * Set the conditions on every link that has no settings of its own.
+		 * @param settings The link conditions.
+		 */
+		void setLinkSettings(const LinkSettings& settings);
+		
+		/**
+		 * Set the conditions on the links to and from a port, overriding the
+		 * network's settings.  If both ends of a link have settings, the
+		 * sender's are used.
+		 * @param port The port.
+		 * @param settings The link conditions.
+		 */
+		void setLinkSettings(unsigned short port, const LinkSettings& settings);
+		
+		/**
+		 * Claim a port.
+		 * @param port The port to claim, or 0 to claim any free port.
+		 * @return The port claimed, or 0 if the port is already in use.
+		 */
+		unsigned short bind(unsigned short port);
+		
+		/**
+		 * Release a port, discarding any datagrams waiting for it.
+		 * @param port The port to release.
+		 */
+		void unbind(unsigned short port);
+		
+		/**
+		 * Send a datagram.  As with UDP, a datagram that is lost on the way
+		 * still counts as sent.
+		 * @param port Port of the sender.
+		 * @param address Address to send to.
+		 * @param data Data to send.
+		 * @param length Length of the data.
+		 * @return True if the datagram was sent; false if it was larger than
+		 * LOOPBACK_MAX_DATAGRAM.
+		 */
+		bool send(unsigned short port, const struct sockaddr_in* address, const unsigned char* data, unsigned int length);
+		
+		/**
+		 * Receive the next datagram that has arrived at a port.  Datagrams
+		 * that are too large for the buffer are truncated.
+		 * @param port Port to receive on.
+		 * @param buffer Buffer to receive into.
+		 * @param length Length of the buffer.
+		 * @param address Populated with the address of the sender.
+		 * @return The number of bytes received, or -1 if no datagram has
+		 * arrived.
+		 */
+		int receive(unsigned short port, unsigned char* buffer, unsigned int length, struct sockaddr_in* address);
+		
+		/**
+		 * Get counts of what has happened to the datagrams sent so far.
+		 * @return The network's statistics.
+		 */
+		LinkStats getStats();
+		
+		/**
+		 * Reset the statistics to zero.
+		 */
+		void resetStats();
+	
+	private:
+		
+		/**
+		 * A datagram in flight.
+		 */
+		struct Datagram {
+			unsigned short fromPort;					/**< Port of the sender */
+			std::vector<unsigned char> data;			/**< Contents */
+		};
+		
+		/**
+		 * Datagrams ordered by delivery time.  Datagrams due at the same time
+		 * are delivered in the order they were sent.
+		 */
+		typedef std::multimap<unsigned long long, Datagram*> Inbox;
+		
+		std::map<unsigned short, Inbox> _inboxes;				/**< Datagrams in flight to each bound port */
+		std::map<unsigned short, LinkSettings> _portSettings;	/**< Settings for individual ports */
+		std::map<unsigned int, unsigned long long> _busyUntil;	/**< Time each link finishes sending its queue */
+		LinkSettings _settings;									/**< Settings for all other links */
+		LinkStats _stats;										/**< Statistics */
+		unsigned long long _random;								/**< State of the random number generator */
+		unsigned short _nextEphemeralPort;						/**< Next port to try when claiming any port */
+		pthread_mutex_t _mutex;									/**< Guards all state */
+		
+		/**
+		 * Get the settings for the link between two ports.
+		 * @param fromPort Port of the sender.
+		 * @param toPort Port of the receiver.
+		 * @return The link's settings.
+		 */
+		const LinkSettings& getLinkSettings(unsigned short fromPort, unsigned short toPort) const;
+		
+		/**
+		 * Place a copy of a datagram in a port's inbox.
+		 * @param inbox The receiving port's inbox.
+		 * @param fromPort Port of the sender.
+		 * @param data Data to send.
+		 * @param length Length of the data.
+		 * @param deliveryTime Time at which the datagram arrives.
+		 */
+		void queue(Inbox& inbox, unsigned short fromPort, const unsigned char* data, unsigned int length, unsigned long long deliveryTime);
+		
+		/**
+		 * Get a random delay.
+		 * @param maxMs The largest delay in milliseconds.
+		 * @return A delay between 0 and maxMs, in nanoseconds.
+		 */
+		unsigned long long getRandomDelay(unsigned int maxMs);
+		
+		/**
+		 * Get the next pseudo-random number.  The generator is local so that
+		 * runs are identical on every platform.
+		 * @return A number from 0 up to but not including 1.
+		 */
+		double nextRandom();
+	};
+}
+
+#endif
@@ -1,4 +1,6 @@
 #include "server.h"
+#include "log.h"
+#include "tracer.h"
 
 #define DEFAULT_CLIENT_COUNT 2
 #define DEFAULT_PORT_NUMBER 4444
@@ -9,6 +11,19 @@ int main (int argc, char * const argv[]) {
 	
 	int portNumber = DEFAULT_PORT_NUMBER;
 	int clientCount = DEFAULT_CLIENT_COUNT;
+	int workerCount = 0;
+	int maxRooms = DEFAULT_MAX_ROOMS;
+	int physicsRate = SESSION_DEFAULT_PHYSICS_RATE;
+	int substeps = SESSION_DEFAULT_SUBSTEPS;
+	int sendRate = SESSION_DEFAULT_SEND_RATE;
+	const char* recordFile = NULL;
+	const char* replayFile = NULL;
+	const char* samplePrefix = NULL;
+	const char* metricsFile = NULL;
+	int metricsPort = 0;
+	const char* traceFile = NULL;
+	int traceSeconds = 0;
+	bool realTime = true;
 	
 	// Get settings from command line
 	for (int i = 0; i < argc; ++i) {
@@ -16,13 +31,61 @@ int main (int argc, char * const argv[]) {
 			portNumber = atoi(argv[i + 1]);
 		} else if (strncmp(argv[i], "-c", 2) == 0) {
 			clientCount = atoi(argv[i + 1]);
+		} else if (strncmp(argv[i], "-w", 2) == 0) {
+			workerCount = atoi(argv[i + 1]);
+		} else if (strncmp(argv[i], "-m", 2) == 0) {
+			maxRooms = atoi(argv[i + 1]);
+		} else if (strncmp(argv[i], "-t", 2) == 0) {
+			physicsRate = atoi(argv[i + 1]);
+		} else if (strncmp(argv[i], "-s", 2) == 0) {
+			substeps = atoi(argv[i + 1]);
+		} else if (strncmp(argv[i], "-n", 2) == 0) {
+			sendRate = atoi(argv[i + 1]);
+		} else if (strncmp(argv[i], "-r", 2) == 0) {
+			recordFile = argv[i + 1];
+		} else if (strncmp(argv[i], "-R", 2) == 0) {
+			replayFile = argv[i + 1];
+		} else if (strncmp(argv[i], "-S", 2) == 0) {
+			samplePrefix = argv[i + 1];
+		} else if (strncmp(argv[i], "-M", 2) == 0) {
+			metricsPort = atoi(argv[i + 1]);
+		} else if (strncmp(argv[i], "-F", 2) == 0) {
+			metricsFile = argv[i + 1];
+		} else if (strncmp(argv[i], "-T", 2) == 0) {
+			traceFile = argv[i + 1];
+		} else if (strncmp(argv[i], "-D", 2) == 0) {
+			traceSeconds = atoi(argv[i + 1]);
+		} else if (strncmp(argv[i], "-v", 2) == 0) {
+			Log::setLevel(LOG_LEVEL_DEBUG);
+		} else if (strncmp(argv[i], "-f", 2) == 0) {
+			realTime = false;
 		} else if (strncmp(argv[i], "-h", 2) == 0) {
-			std::cout << "Usage: " << argv[0] << " [-c clients] [-p port]\n";
+			std::cout << "Usage: " << argv[0] << " [-c clients] [-p port] [-w workers] [-m rooms] [-t rate] [-s substeps] [-n sendrate] [-r journal] [-R journal [-f]] [-S sampleprefix] [-M metricsport] [-F metricsfile] [-T tracefile [-D seconds]] [-v]\n";
 			return 0;
 		}
 	}
 
-	Server server(clientCount, portNumber);
+	Server server(clientCount, portNumber, workerCount, maxRooms, SessionSettings(physicsRate, substeps, sendRate));
+	
+	if (samplePrefix != NULL) server.sample(samplePrefix);
+	
+	if ((metricsPort > 0) || (metricsFile != NULL)) {
+		if (!server.exportMetrics(metricsPort, metricsFile)) return 1;
+	}
+	
+	if (traceFile != NULL) {
+		if (!Tracer::start(traceFile, traceSeconds * 1000)) return 1;
+	}
+	
+	if (replayFile != NULL) {
+		server.replay(replayFile, realTime);
+		return 0;
+	}
+	
+	if (recordFile != NULL) {
+		if (!server.record(recordFile)) return 1;
+	}
+	
 	server.run();
 	
 	return 0;
@@ -14,17 +14,21 @@ Message::Message(MessageType type, unsigned short msgId, unsigned short dataLeng
 	setData(data, dataLength);
 }
 		
-Message::Message(const unsigned char* data, const struct sockaddr_in* address) {
+Message::Message(const unsigned char* data, const struct sockaddr_in* address, bool copyData) {
 			
 	_type = (MessageType)data[4];				// 1 byte type
-	_dataLength = (data[5] << 8) | data[6];		// 2 byte length
 	_id = (data[7] << 8) | data[8];				// 2 byte id number
 	
-	if (_dataLength > 0) {
-		_data = new unsigned char[_dataLength];
-		memcpy(_data, data + MESSAGE_HEADER_LENGTH, _dataLength);
+	unsigned short dataLength = (data[5] << 8) | data[6];		// 2 byte length
+	
+	if (copyData) {
+		setData(data + MESSAGE_HEADER_LENGTH, dataLength);
 	} else {
-		_data = NULL;
+		
+		// Refer to the data in place
+		_dataLength = dataLength;
+		_data = (dataLength > 0 ? data + MESSAGE_HEADER_LENGTH : NULL);
+		_ownsData = false;
 	}
 	
 	_address = *address;
@@ -40,8 +44,8 @@ Message::Message(Message const& copy) {
 }
 
 Message::~Message() {
-	if (_data != NULL) {
-		delete _data;
+	if ((_data != NULL) && (_ownsData)) {
+		delete[] _data;
 	}
 }
 
@@ -67,9 +71,12 @@ unsigned int Message::getFormattedMessage(unsigned char* buffer) const {
 void Message::setData(const unsigned char* data, unsigned short dataLength) {
 	_dataLength = dataLength;
 	
+	_ownsData = true;
+	
 	if (_dataLength > 0) {
-		_data = new unsigned char[_dataLength];
-		memcpy(_data, data, _dataLength);
+		unsigned char* buffer = new unsigned char[_dataLength];
+		memcpy(buffer, data, _dataLength);
+		_data = buffer;
 	} else {
 		_data = NULL;
 	}
@@ -3,6 +3,7 @@
 
 #define MESSAGE_HEADER "WDMK"
 #define MESSAGE_HEADER_LENGTH 9
+#define HANDSHAKE_ANY_ROOM 0xFFFFFFFF
 
 #include <string>
 #include <sys/types.h>
@@ -40,12 +41,13 @@ namespace WiredMunk {
 			MESSAGE_REJECT = 3,				/**< Server rejects client's handshake because the session is full */
 			MESSAGE_STARTUP = 4,			/**< Sent to clients to tell them to run their startup() method */
 			MESSAGE_READY = 5,				/**< Sent to server to indicate client readiness and to clients to start session */
-			MESSAGE_PING = 6,				/**< Not implemented */
+			MESSAGE_PING = 6,				/**< Sent by the server to idle clients, which echo it back */
 			MESSAGE_ACKNOWLEDGE = 7,		/**< Not implemented */
-			MESSAGE_OBJECT_ID = 8,			/**< Sent if client requesting a unique ID for an object */
+			MESSAGE_OBJECT_ID = 8,			/**< Sent if client requesting a block of unique IDs for objects */
 			MESSAGE_BODY = 9,				/**< Message contains body data */
 			MESSAGE_SHAPE = 10,				/**< Message contains shape data */
-			MESSAGE_SPACE = 11				/**< Message contains space data */
+			MESSAGE_SPACE = 11,				/**< Message contains space data */
+			MESSAGE_OBJECT_ID_RELEASE = 12	/**< Sent by clients to return leased object IDs that are no longer needed */
 		};
 		
 		/**
@@ -64,8 +66,12 @@ namespace WiredMunk {
 		 * message components.
 		 * @param data Data string containing message.
 		 * @param address Address to send to or address that message came from.
+		 * @param copyData If true, the message takes a copy of its data.  If
+		 * false, the message refers directly to the data string, which must
+		 * outlive the message; this avoids an allocation for messages that
+		 * are only used whilst the data string is valid.
 		 */
-		Message(const unsigned char* data, const struct sockaddr_in* address);
+		Message(const unsigned char* data, const struct sockaddr_in* address, bool copyData = true);
 		
 		/**
 		 * Copy constructor.
@@ -139,7 +145,8 @@ namespace WiredMunk {
 	private:
 		unsigned short _dataLength;				/**< Length of the data component */
 		MessageType _type;						/**< Type of message */
-		unsigned char* _data;					/**< Message data */
+		const unsigned char* _data;				/**< Message data */
+		bool _ownsData;							/**< Was the data allocated by the message? */
 		unsigned short _id;						/**< Message ID */
 		struct sockaddr_in _address;			/**< The address the message was sent from/is being sent to */
 	};
@@ -0,0 +1,133 @@
+#include <cstring>
+#include "messagejournal.h"
+#include "socket.h"
+#include "serialisebase.h"
+#include "log.h"
+
+using namespace WiredMunk;
+
+MessageJournal::MessageJournal() {
+	_file = NULL;
+	_recordCount = 0;
+}
+
+MessageJournal::~MessageJournal() {
+	close();
+}
+
+bool MessageJournal::openForRecording(const char* fileName) {
+
+	close();
+	
+	_file = fopen(fileName, "ab");
+	if (_file == NULL) {
+		perror("Error opening journal");
+		return false;
+	}
+	
+	// Write the header if this is a new journal
+	fseek(_file, 0, SEEK_END);
+	if (ftell(_file) == 0) {
+		fwrite(JOURNAL_HEADER, 1, JOURNAL_HEADER_LENGTH, _file);
+	}
+	
+	LOG_INFO("Recording journal: %s\n", fileName);
+	
+	return true;
+}
+
+bool MessageJournal::openForReplay(const char* fileName) {
+
+	close();
+	
+	_file = fopen(fileName, "rb");
+	if (_file == NULL) {
+		perror("Error opening journal");
+		return false;
+	}
+	
+	// Does the file have the journal header?
+	char header[JOURNAL_HEADER_LENGTH];
+	if ((fread(header, 1, JOURNAL_HEADER_LENGTH, _file) != JOURNAL_HEADER_LENGTH) ||
+		(strncmp(JOURNAL_HEADER, header, JOURNAL_HEADER_LENGTH) != 0)) {
+		
+		LOG_ERROR("Not a valid journal: %s\n", fileName);
+		close();
+		return false;
+	}
+	
+	LOG_INFO("Replaying journal: %s\n", fileName);
+	
+	return true;
+}
+
+void MessageJournal::close() {
+	if (_file != NULL) {
+		fclose(_file);
+		_file = NULL;
+	}
+}
+
+void MessageJournal::record(const Message& msg, unsigned int roomId, unsigned int tick) {
+
+	if (_file == NULL) return;
+	
+	unsigned int msgLength = msg.getFormattedMessageLength();
+	
+	// Messages read from the socket always fit in its buffer
+	if (msgLength > MESSAGE_BUFFER_LENGTH) {
+		LOG_ERROR("Message too long to journal: %u bytes\n", msgLength);
+		return;
+	}
+	
+	unsigned char record[JOURNAL_RECORD_HEADER_LENGTH + MESSAGE_BUFFER_LENGTH];
+	unsigned char* buffer = record;
+	
+	// Record header
+	buffer += SerialiseBase::serialise(roomId, buffer);
+	buffer += SerialiseBase::serialise(tick, buffer);
+	memcpy(buffer, &msg.getAddress()->sin_addr.s_addr, 4);
+	buffer += 4;
+	memcpy(buffer, &msg.getAddress()->sin_port, 2);
+	buffer += 2;
+	buffer += SerialiseBase::serialise((unsigned short)msgLength, buffer);
+	
+	// Message, including its header
+	msg.getFormattedMessage(buffer);
+	
+	fwrite(record, 1, JOURNAL_RECORD_HEADER_LENGTH + msgLength, _file);
+	
+	_recordCount++;
+}
+
+Message* MessageJournal::readMessage(unsigned int* roomId, unsigned int* tick) {
+
+	if (_file == NULL) return NULL;
+	
+	// Read the record header
+	unsigned char header[JOURNAL_RECORD_HEADER_LENGTH];
+	if (fread(header, 1, JOURNAL_RECORD_HEADER_LENGTH, _file) != JOURNAL_RECORD_HEADER_LENGTH) return NULL;
+	
+	*roomId = SerialiseBase::deserialiseInt(header);
+	*tick = SerialiseBase::deserialiseInt(header + 4);
+	
+	// Rebuild the address of the client that sent the message
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	memcpy(&address.sin_addr.s_addr, header + 8, 4);
+	memcpy(&address.sin_port, header + 12, 2);
+	
+	unsigned int msgLength = SerialiseBase::deserialiseShort(header + 14);
+	
+	// Discard truncated or corrupt records, which can be left behind if the
+	// server was killed whilst recording
+	if (msgLength < MESSAGE_HEADER_LENGTH || msgLength > MESSAGE_BUFFER_LENGTH) return NULL;
+	
+	unsigned char data[MESSAGE_BUFFER_LENGTH];
+	if (fread(data, 1, msgLength, _file) != msgLength) return NULL;
+	
+	_recordCount++;
+	
+	return new Message(data, &address);
+}
@@ -0,0 +1,99 @@
+#ifndef _MESSAGE_JOURNAL_H_
+#define _MESSAGE_JOURNAL_H_
+
+#include <stdio.h>
+#include "message.h"
+
+#define JOURNAL_HEADER "WDMJ"
+#define JOURNAL_HEADER_LENGTH 4
+#define JOURNAL_RECORD_HEADER_LENGTH 16
+
+/**
+ * Journal format:
+ * 4 byte header: WDMJ (identify file as a wired munk journal)
+ * n records, each consisting of:
+ *   4 byte ID of the room that received the message
+ *   4 byte tick of that room's simulation at which the message arrived
+ *   4 byte source IP address (network byte order)
+ *   2 byte source port (network byte order)
+ *   2 byte formatted message length
+ *   n bytes formatted message, including its WDMK header
+ */
+
+namespace WiredMunk {
+
+	/**
+	 * Append-only journal of inbound messages.  When recording, the server
+	 * writes each message that it routes to a room to disk along with the
+	 * room's ID, the tick of the room's simulation at which the message
+	 * arrived and the address of the client that sent it.  When replaying,
+	 * messages are read back in order so that they can be fed through the
+	 * rooms without a socket.
+	 */
+	class MessageJournal {
+	public:
+		
+		/**
+		 * Constructor.
+		 */
+		MessageJournal();
+		
+		/**
+		 * Destructor.  Closes the journal file.
+		 */
+		virtual ~MessageJournal();
+		
+		/**
+		 * Open a journal for recording.  New records are appended to the end
+		 * of any existing journal.
+		 * @param fileName Name of the journal file.
+		 * @return True if the journal was opened successfully.
+		 */
+		bool openForRecording(const char* fileName);
+		
+		/**
+		 * Open a journal for replay.
+		 * @param fileName Name of the journal file.
+		 * @return True if the journal was opened and has a valid header.
+		 */
+		bool openForReplay(const char* fileName);
+		
+		/**
+		 * Close the journal file.
+		 */
+		void close();
+		
+		/**
+		 * Record an incoming message to the journal.
+		 * @param msg Message data.
+		 * @param roomId ID of the room that received the message.
+		 * @param tick Tick of the room's simulation at which the message
+		 * arrived.
+		 */
+		void record(const Message& msg, unsigned int roomId, unsigned int tick);
+		
+		/**
+		 * Read the next message from a journal opened for replay.  The caller
+		 * is responsible for deleting the returned message.
+		 * @param roomId Pointer to an int that will receive the ID of the
+		 * room that received the message.
+		 * @param tick Pointer to an int that will receive the tick of the
+		 * room's simulation at which the message originally arrived.
+		 * @return The next message, or NULL if the end of the journal has been
+		 * reached.
+		 */
+		Message* readMessage(unsigned int* roomId, unsigned int* tick);
+		
+		/**
+		 * Get the number of records written or read so far.
+		 * @return The number of records.
+		 */
+		inline unsigned int getRecordCount() const { return _recordCount; };
+	
+	private:
+		FILE* _file;						/**< The journal file */
+		unsigned int _recordCount;			/**< Number of records processed */
+	};
+}
+
+#endif
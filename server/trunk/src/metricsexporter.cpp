@@ -0,0 +1,376 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include "metricsexporter.h"
+#include "tickscheduler.h"
+#include "log.h"
+
+using namespace WiredMunk;
+
+namespace {
+
+	/**
+	 * Names of the message types, used as metric labels.  Indexed in the
+	 * same way as TrafficStats.
+	 */
+	const char* MESSAGE_TYPE_NAMES[TRAFFIC_MESSAGE_TYPES] = {
+		"unknown", "none", "handshake", "reject", "startup", "ready",
+		"ping", "acknowledge", "object_id", "body", "shape", "space",
+		"object_id_release"
+	};
+	
+	/**
+	 * Names of the traffic directions, used as metric labels.
+	 */
+	const char* DIRECTION_NAMES[2] = { "in", "out" };
+	
+	/**
+	 * Append formatted text to a string.  Uses standard printf() syntax.
+	 * @param output String to append to.
+	 * @param format Format of the text.
+	 * @param ... The values to output.
+	 */
+	void append(std::string* output, const char* format, ...) {
+		char buffer[256];
+		
+		va_list args;
+		va_start(args, format);
+		vsnprintf(buffer, sizeof(buffer), format, args);
+		va_end(args);
+		
+		output->append(buffer);
+	}
+}
+
+MetricsExporter::MetricsExporter(const TrafficStats* traffic, int maxSimulations) {
+	_traffic = traffic;
+	_simulations = new Entry[maxSimulations];
+	_maxSimulations = maxSimulations;
+	_simulationCount = 0;
+	_connectionCount = 0;
+	_listenSocket = -1;
+	_fileIntervalMs = METRICS_DEFAULT_FILE_INTERVAL_MS;
+	_isRunning = false;
+}
+
+MetricsExporter::~MetricsExporter() {
+	stop();
+	
+	delete[] _simulations;
+}
+
+void MetricsExporter::addSimulation(unsigned int roomId, const SimulationMetrics* metrics) {
+
+	if (_simulationCount >= _maxSimulations) return;
+	
+	_simulations[_simulationCount].roomId = roomId;
+	_simulations[_simulationCount].metrics = metrics;
+	
+	// Publish the entry only once it has been written
+	__sync_synchronize();
+	_simulationCount++;
+}
+
+bool MetricsExporter::start(int port, const char* fileName, int fileIntervalMs) {
+
+	if (_isRunning) return true;
+	
+	if ((port > 0) && (!listen(port))) return false;
+	
+	_fileName = (fileName != NULL ? fileName : "");
+	_fileIntervalMs = fileIntervalMs;
+	_isRunning = true;
+	
+	if (pthread_create(&_thread, NULL, threadMain, this) != 0) {
+		perror("Error starting metrics exporter");
+		_isRunning = false;
+		return false;
+	}
+	
+	if (port > 0) LOG_INFO("Metrics:  http://127.0.0.1:%d/metrics\n", port);
+	if (fileName != NULL) LOG_INFO("Metrics:  %s\n", fileName);
+	
+	return true;
+}
+
+void MetricsExporter::stop() {
+
+	if (_isRunning) {
+		_isRunning = false;
+		pthread_join(_thread, NULL);
+	}
+	
+	if (_listenSocket >= 0) {
+		close(_listenSocket);
+		_listenSocket = -1;
+	}
+}
+
+bool MetricsExporter::listen(int port) {
+	struct sockaddr_in address;
+	int reuse = 1;
+	
+	_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+	if (_listenSocket < 0) {
+		perror("Error opening metrics socket");
+		return false;
+	}
+	
+	setsockopt(_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	
+	// Only serve the local machine
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+	
+	if ((bind(_listenSocket, (struct sockaddr*)&address, sizeof(address)) < 0) ||
+		(::listen(_listenSocket, SOMAXCONN) < 0)) {
+		
+		perror("Error binding metrics socket");
+		close(_listenSocket);
+		_listenSocket = -1;
+		return false;
+	}
+	
+	return true;
+}
+
+void MetricsExporter::serve() {
+	int client = accept(_listenSocket, NULL, NULL);
+	if (client < 0) return;
+	
+	// Don't let a slow client hold up the exporter
+	struct timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = METRICS_POLL_INTERVAL_MS * 1000;
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	
+	// The request is ignored; every path returns the metrics
+	char request[METRICS_REQUEST_LENGTH];
+	recv(client, request, sizeof(request), 0);
+	
+	std::string body;
+	format(&body);
+	
+	std::string response;
+	append(&response, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long)body.size());
+	response.append(body);
+	
+	const char* data = response.data();
+	size_t remaining = response.size();
+	
+	while (remaining > 0) {
+		ssize_t sent = send(client, data, remaining, 0);
+		if (sent <= 0) break;
+		
+		data += sent;
+		remaining -= sent;
+	}
+	
+	close(client);
+}
+
+void MetricsExporter::writeFile() {
+	std::string body;
+	format(&body);
+	
+	std::string tempName = _fileName + ".tmp";
+	
+	FILE* file = fopen(tempName.c_str(), "w");
+	if (file == NULL) {
+		perror("Error opening metrics file");
+		return;
+	}
+	
+	fwrite(body.data(), 1, body.size(), file);
+	fclose(file);
+	
+	if (rename(tempName.c_str(), _fileName.c_str()) != 0) perror("Error replacing metrics file");
+}
+
+void MetricsExporter::run() {
+	unsigned long long nextWrite = 0;
+	
+	while (_isRunning) {
+		
+		if (!_fileName.empty()) {
+			unsigned long long now = TickScheduler::getTime() / 1000000;
+			
+			if (now >= nextWrite) {
+				writeFile();
+				nextWrite = now + _fileIntervalMs;
+			}
+		}
+		
+		// Wait for a scrape, or just sleep if not serving
+		struct timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = METRICS_POLL_INTERVAL_MS * 1000;
+		
+		if (_listenSocket < 0) {
+			select(0, NULL, NULL, NULL, &timeout);
+			continue;
+		}
+		
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(_listenSocket, &readSet);
+		
+		if (select(_listenSocket + 1, &readSet, NULL, NULL, &timeout) > 0) serve();
+	}
+}
+
+void* MetricsExporter::threadMain(void* exporter) {
+	((MetricsExporter*)exporter)->run();
+	return NULL;
+}
+
+void MetricsExporter::format(std::string* output) const {
+
+	append(output, "# HELP wiredmunk_connected_clients Number of clients connected to the server.\n");
+	append(output, "# TYPE wiredmunk_connected_clients gauge\n");
+	append(output, "wiredmunk_connected_clients %d\n", _connectionCount);
+	
+	int simulationCount = _simulationCount;
+	
+	// Ensure the entries are read after the count that published them
+	__sync_synchronize();
+	
+	append(output, "# HELP wiredmunk_rooms Number of rooms hosted by the server.\n");
+	append(output, "# TYPE wiredmunk_rooms gauge\n");
+	append(output, "wiredmunk_rooms %d\n", simulationCount);
+	
+	// Traffic by message type
+	append(output, "# HELP wiredmunk_packets_total Packets sent and received, by message type.\n");
+	append(output, "# TYPE wiredmunk_packets_total counter\n");
+	
+	for (int direction = 0; direction < 2; ++direction) {
+		for (unsigned int type = 0; type < TRAFFIC_MESSAGE_TYPES; ++type) {
+			unsigned int packets = _traffic->getPackets((TrafficStats::Direction)direction, type);
+			if (packets == 0) continue;
+			
+			append(output, "wiredmunk_packets_total{direction=\"%s\",type=\"%s\"} %u\n", DIRECTION_NAMES[direction], MESSAGE_TYPE_NAMES[type], packets);
+		}
+	}
+	
+	append(output, "# HELP wiredmunk_bytes_total Bytes sent and received, by message type.\n");
+	append(output, "# TYPE wiredmunk_bytes_total counter\n");
+	
+	for (int direction = 0; direction < 2; ++direction) {
+		for (unsigned int type = 0; type < TRAFFIC_MESSAGE_TYPES; ++type) {
+			unsigned long long bytes = _traffic->getBytes((TrafficStats::Direction)direction, type);
+			if (bytes == 0) continue;
+			
+			append(output, "wiredmunk_bytes_total{direction=\"%s\",type=\"%s\"} %llu\n", DIRECTION_NAMES[direction], MESSAGE_TYPE_NAMES[type], bytes);
+		}
+	}
+	
+	append(output, "# HELP wiredmunk_send_failures_total Packets that could not be sent, by message type.\n");
+	append(output, "# TYPE wiredmunk_send_failures_total counter\n");
+	
+	for (unsigned int type = 0; type < TRAFFIC_MESSAGE_TYPES; ++type) {
+		unsigned int failures = _traffic->getSendFailures(type);
+		if (failures == 0) continue;
+		
+		append(output, "wiredmunk_send_failures_total{type=\"%s\"} %u\n", MESSAGE_TYPE_NAMES[type], failures);
+	}
+	
+	// Tick duration histogram for each room
+	append(output, "# HELP wiredmunk_tick_duration_seconds Time taken to run a simulation tick.\n");
+	append(output, "# TYPE wiredmunk_tick_duration_seconds histogram\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		const SimulationMetrics* metrics = _simulations[i].metrics;
+		unsigned int roomId = _simulations[i].roomId;
+		unsigned int cumulative = 0;
+		
+		for (unsigned int bucket = 0; bucket < METRICS_TICK_BUCKETS; ++bucket) {
+			cumulative += metrics->getTickCount(bucket);
+			
+			if (bucket < METRICS_TICK_BUCKETS - 1) {
+				append(output, "wiredmunk_tick_duration_seconds_bucket{room=\"%u\",le=\"%g\"} %u\n", roomId, SimulationMetrics::getBucketLimit(bucket) / 1000000000.0, cumulative);
+			} else {
+				append(output, "wiredmunk_tick_duration_seconds_bucket{room=\"%u\",le=\"+Inf\"} %u\n", roomId, cumulative);
+			}
+		}
+		
+		append(output, "wiredmunk_tick_duration_seconds_sum{room=\"%u\"} %.9f\n", roomId, metrics->getTickTime() / 1000000000.0);
+		append(output, "wiredmunk_tick_duration_seconds_count{room=\"%u\"} %u\n", roomId, cumulative);
+	}
+	
+	// Scheduler and space counters for each room
+	append(output, "# HELP wiredmunk_catch_up_steps_total Steps run to catch up with the clock.\n");
+	append(output, "# TYPE wiredmunk_catch_up_steps_total counter\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		append(output, "wiredmunk_catch_up_steps_total{room=\"%u\"} %u\n", _simulations[i].roomId, _simulations[i].metrics->getCatchUpSteps());
+	}
+	
+	append(output, "# HELP wiredmunk_overruns_total Updates that fell too far behind the clock to catch up.\n");
+	append(output, "# TYPE wiredmunk_overruns_total counter\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		append(output, "wiredmunk_overruns_total{room=\"%u\"} %u\n", _simulations[i].roomId, _simulations[i].metrics->getOverruns());
+	}
+	
+	append(output, "# HELP wiredmunk_skipped_steps_total Steps discarded by overruns.\n");
+	append(output, "# TYPE wiredmunk_skipped_steps_total counter\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		append(output, "wiredmunk_skipped_steps_total{room=\"%u\"} %llu\n", _simulations[i].roomId, _simulations[i].metrics->getSkippedSteps());
+	}
+	
+	append(output, "# HELP wiredmunk_bodies Bodies in the space.\n");
+	append(output, "# TYPE wiredmunk_bodies gauge\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		append(output, "wiredmunk_bodies{room=\"%u\"} %u\n", _simulations[i].roomId, _simulations[i].metrics->getBodies());
+	}
+	
+	append(output, "# HELP wiredmunk_shapes Shapes in the space.\n");
+	append(output, "# TYPE wiredmunk_shapes gauge\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		append(output, "wiredmunk_shapes{room=\"%u\"} %u\n", _simulations[i].roomId, _simulations[i].metrics->getShapes());
+	}
+	
+	append(output, "# HELP wiredmunk_arbiters Active collision arbiters in the space.\n");
+	append(output, "# TYPE wiredmunk_arbiters gauge\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		append(output, "wiredmunk_arbiters{room=\"%u\"} %u\n", _simulations[i].roomId, _simulations[i].metrics->getArbiters());
+	}
+	
+	append(output, "# HELP wiredmunk_spatial_hash_cells Cells in the active shape spatial hash.\n");
+	append(output, "# TYPE wiredmunk_spatial_hash_cells gauge\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		if (!_simulations[i].metrics->isHashInUse()) continue;
+		append(output, "wiredmunk_spatial_hash_cells{room=\"%u\"} %u\n", _simulations[i].roomId, _simulations[i].metrics->getHashCells());
+	}
+	
+	append(output, "# HELP wiredmunk_spatial_hash_cells_used Cells in the active shape spatial hash holding at least one shape.\n");
+	append(output, "# TYPE wiredmunk_spatial_hash_cells_used gauge\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		if (!_simulations[i].metrics->isHashInUse()) continue;
+		append(output, "wiredmunk_spatial_hash_cells_used{room=\"%u\"} %u\n", _simulations[i].roomId, _simulations[i].metrics->getHashCellsUsed());
+	}
+	
+	append(output, "# HELP wiredmunk_spatial_hash_objects Shapes in the active shape spatial hash.\n");
+	append(output, "# TYPE wiredmunk_spatial_hash_objects gauge\n");
+	
+	for (int i = 0; i < simulationCount; ++i) {
+		if (!_simulations[i].metrics->isHashInUse()) continue;
+		append(output, "wiredmunk_spatial_hash_objects{room=\"%u\"} %u\n", _simulations[i].roomId, _simulations[i].metrics->getHashObjects());
+	}
+}
@@ -0,0 +1,136 @@
+#ifndef _METRICS_EXPORTER_H_
+#define _METRICS_EXPORTER_H_
+
+#include <string>
+#include <pthread.h>
+#include "trafficstats.h"
+#include "simulationmetrics.h"
+
+#define METRICS_POLL_INTERVAL_MS 100
+#define METRICS_DEFAULT_FILE_INTERVAL_MS 1000
+#define METRICS_REQUEST_LENGTH 1024
+
+namespace WiredMunk {
+
+	/**
+	 * Publishes the server's runtime counters in the Prometheus text
+	 * exposition format.  The counters can be scraped over HTTP from a port
+	 * on the loopback interface, written to a file that is rewritten
+	 * periodically, or both.
+	 *
+	 * Exports traffic by message type from the socket, the number of rooms
+	 * and connected clients, and for each room the tick duration histogram,
+	 * catch-up steps, scheduler overruns, object counts and spatial hash
+	 * occupancy.
+	 *
+	 * All counters are read from lock-free sources on the exporter's own
+	 * thread, so scraping never blocks the simulation or network threads.
+	 * Simulations must be added before they start running and must outlive
+	 * the exporter.
+	 */
+	class MetricsExporter {
+	public:
+		
+		/**
+		 * Constructor.
+		 * @param traffic Statistics for all traffic through the socket.
+		 * @param maxSimulations Maximum number of simulations to export.
+		 */
+		MetricsExporter(const TrafficStats* traffic, int maxSimulations);
+		
+		/**
+		 * Destructor.  Stops the exporter thread.
+		 */
+		~MetricsExporter();
+		
+		/**
+		 * Add a simulation to the exported metrics.  Must only be called from
+		 * one thread.
+		 * @param roomId ID of the room running the simulation.
+		 * @param metrics The simulation's counters.
+		 */
+		void addSimulation(unsigned int roomId, const SimulationMetrics* metrics);
+		
+		/**
+		 * Set the number of connected clients.
+		 * @param count The number of clients.
+		 */
+		inline void setConnectionCount(int count) { _connectionCount = count; };
+		
+		/**
+		 * Start the exporter thread.
+		 * @param port Port on the loopback interface to serve metrics on, or
+		 * 0 to disable serving.
+		 * @param fileName Name of the file to write metrics to, or NULL to
+		 * disable writing.
+		 * @param fileIntervalMs Milliseconds between rewrites of the file.
+		 * @return True if the exporter started successfully.
+		 */
+		bool start(int port, const char* fileName, int fileIntervalMs = METRICS_DEFAULT_FILE_INTERVAL_MS);
+		
+		/**
+		 * Stop the exporter thread and close the port.
+		 */
+		void stop();
+		
+		/**
+		 * Format the current metrics.
+		 * @param output String to append the metrics to.
+		 */
+		void format(std::string* output) const;
+	
+	private:
+		
+		/**
+		 * A simulation added to the exporter.
+		 */
+		struct Entry {
+			unsigned int roomId;					/**< ID of the room */
+			const SimulationMetrics* metrics;		/**< The simulation's counters */
+		};
+		
+		const TrafficStats* _traffic;				/**< Statistics for all traffic */
+		Entry* _simulations;						/**< Exported simulations */
+		int _maxSimulations;						/**< Size of the simulation array */
+		volatile int _simulationCount;				/**< Number of exported simulations */
+		volatile int _connectionCount;				/**< Number of connected clients */
+		int _listenSocket;							/**< Socket accepting scrapes */
+		std::string _fileName;						/**< File to write metrics to */
+		int _fileIntervalMs;						/**< Milliseconds between file writes */
+		pthread_t _thread;							/**< Exporter thread */
+		volatile bool _isRunning;					/**< Is the exporter thread running? */
+		
+		/**
+		 * Open the listening socket.
+		 * @param port Port on the loopback interface to listen on.
+		 * @return True if the socket was opened successfully.
+		 */
+		bool listen(int port);
+		
+		/**
+		 * Answer a single scrape on the listening socket.
+		 */
+		void serve();
+		
+		/**
+		 * Write the metrics file.  The metrics are written to a temporary
+		 * file that then replaces the old one, so readers never see a
+		 * partially-written file.
+		 */
+		void writeFile();
+		
+		/**
+		 * Exporter thread loop.
+		 */
+		void run();
+		
+		/**
+		 * Entry point for the exporter thread.
+		 * @param exporter The exporter that owns the thread.
+		 * @return Always NULL.
+		 */
+		static void* threadMain(void* exporter);
+	};
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include "room.h"
+#include "log.h"
+#include "tracer.h"
+
+using namespace WiredMunk;
+
+Room::Room(unsigned int roomId, Socket* socket, int clientCount, const SessionSettings& settings) {
+	_id = roomId;
+	_clientCount = clientCount;
+	_reservedCount = 0;
+	_isQueued = false;
+	
+	_clientManager = new ClientManager(socket, clientCount, settings);
+	_simulation = new Simulation(_clientManager);
+	
+	pthread_mutex_init(&_inboxMutex, NULL);
+	
+	LOG_INFO("Room %d created\n", roomId);
+}
+
+Room::~Room() {
+
+	// Discard any unprocessed messages
+	for (unsigned int i = 0; i < _inbox.size(); ++i) {
+		delete _inbox.at(i);
+	}
+	
+	delete _simulation;
+	delete _clientManager;
+	
+	pthread_mutex_destroy(&_inboxMutex);
+}
+
+void Room::handleMessageReceived(const Message& msg) {
+
+	TRACE_SCOPE("Room::handleMessageReceived");
+	
+	if (!_isQueued) {
+		dispatch(msg);
+		return;
+	}
+	
+	// The message refers to the socket's receive buffer, so the queue must
+	// hold a copy
+	Message* copy = new Message(msg);
+	
+	pthread_mutex_lock(&_inboxMutex);
+	_inbox.push_back(copy);
+	pthread_mutex_unlock(&_inboxMutex);
+}
+
+void Room::run() {
+	processMessages();
+	
+	_simulation->run();
+}
+
+void Room::processMessages() {
+
+	// Take the queued messages so that the server can keep queueing whilst
+	// they are processed
+	std::vector<struct sockaddr_in> evictions;
+	
+	pthread_mutex_lock(&_inboxMutex);
+	_processing.swap(_inbox);
+	evictions.swap(_evictions);
+	pthread_mutex_unlock(&_inboxMutex);
+	
+	// Evictions were requested before any of the queued messages could have
+	// been routed to the room by a returning client, so apply them first
+	for (unsigned int i = 0; i < evictions.size(); ++i) {
+		removeClient(&evictions.at(i));
+	}
+	
+	for (unsigned int i = 0; i < _processing.size(); ++i) {
+		dispatch(*_processing.at(i));
+		delete _processing.at(i);
+	}
+	
+	_processing.clear();
+}
+
+bool Room::reserve() {
+	if (isFull()) return false;
+	
+	_reservedCount++;
+	
+	return true;
+}
+
+void Room::evict(const struct sockaddr_in* address) {
+	if (_reservedCount > 0) _reservedCount--;
+	
+	if (!_isQueued) {
+		removeClient(address);
+		return;
+	}
+	
+	pthread_mutex_lock(&_inboxMutex);
+	_evictions.push_back(*address);
+	pthread_mutex_unlock(&_inboxMutex);
+}
+
+void Room::dispatch(const Message& msg) {
+	_clientManager->handleMessageReceived(msg);
+	_simulation->handleMessageReceived(msg);
+}
+
+void Room::removeClient(const struct sockaddr_in* address) {
+	
+	// Reclaim the IDs leased to the client before forgetting it
+	std::vector<unsigned int> objectIds;
+	_clientManager->returnObjectIds(address, &objectIds);
+	_simulation->releaseObjectIds(objectIds);
+	
+	_clientManager->removeClient(address);
+}
@@ -0,0 +1,136 @@
+#ifndef _ROOM_H_
+#define _ROOM_H_
+
+#include <vector>
+#include <pthread.h>
+#include "socketeventhandler.h"
+#include "socket.h"
+#include "message.h"
+#include "clientmanager.h"
+#include "simulation.h"
+
+namespace WiredMunk {
+
+	/**
+	 * A single independent session hosted by the server.  Each room has its
+	 * own set of clients and its own simulation, and so its own space.  The
+	 * server routes incoming messages to the room that the sending client
+	 * belongs to.
+	 *
+	 * Rooms can either be run on the server's main thread, in which case
+	 * messages are dispatched to the room as soon as they arrive, or on a
+	 * RoomWorker thread, in which case messages are queued and processed by
+	 * the worker the next time it runs the room.
+	 */
+	class Room : public SocketEventHandler {
+	public:
+		
+		/**
+		 * Constructor.
+		 * @param roomId The room's ID.
+		 * @param socket Socket used for communicating with clients.
+		 * @param clientCount Number of clients required for the room's
+		 * session.
+		 * @param settings Default timing settings for the room's session.
+		 */
+		Room(unsigned int roomId, Socket* socket, int clientCount, const SessionSettings& settings);
+		
+		/**
+		 * Destructor.
+		 */
+		virtual ~Room();
+		
+		/**
+		 * Receives messages routed to the room by the server.  Messages are
+		 * dispatched immediately unless the room is queued, in which case a
+		 * copy is queued for processing on the room's worker thread.
+		 * @param msg Message data.
+		 */
+		void handleMessageReceived(const Message& msg);
+		
+		/**
+		 * Process any queued messages and run a single iteration of the
+		 * room's simulation.  Should be called in a loop.
+		 */
+		void run();
+		
+		/**
+		 * Dispatch all queued messages to the room's client manager and
+		 * simulation.
+		 */
+		void processMessages();
+		
+		/**
+		 * Set whether or not incoming messages are queued.  Must be set
+		 * before the room is handed to a worker thread.
+		 * @param queued True to queue messages.
+		 */
+		inline void setQueued(bool queued) { _isQueued = queued; };
+		
+		/**
+		 * Reserve a place in the room for a new client.  Called by the
+		 * server when routing a handshake from an unknown address.
+		 * @return True if a place was reserved; false if the room is full.
+		 */
+		bool reserve();
+		
+		/**
+		 * Remove a client from the room, freeing its place.  Called by the
+		 * server when a client times out.  If the room is queued, the client
+		 * is removed from the client manager on the room's worker thread.
+		 * @param address The client's address.
+		 */
+		void evict(const struct sockaddr_in* address);
+		
+		/**
+		 * Check if the room has any places left.
+		 * @return True if the room is full.
+		 */
+		inline bool isFull() const { return _reservedCount >= _clientCount; };
+		
+		/**
+		 * Get the room's ID.
+		 * @return The room's ID.
+		 */
+		inline unsigned int getId() const { return _id; };
+		
+		/**
+		 * Get the room's simulation.
+		 * @return The room's simulation.
+		 */
+		inline Simulation* getSimulation() { return _simulation; };
+		
+		/**
+		 * Get the room's client manager.
+		 * @return The room's client manager.
+		 */
+		inline ClientManager* getClientManager() { return _clientManager; };
+	
+	private:
+		unsigned int _id;						/**< The room's ID */
+		ClientManager* _clientManager;			/**< The room's clients */
+		Simulation* _simulation;				/**< The room's simulation */
+		int _clientCount;						/**< Number of clients the room holds */
+		int _reservedCount;						/**< Number of places reserved */
+		bool _isQueued;							/**< Are incoming messages queued? */
+		std::vector<Message*> _inbox;			/**< Messages awaiting processing */
+		std::vector<Message*> _processing;		/**< Messages being processed */
+		std::vector<struct sockaddr_in> _evictions;	/**< Clients awaiting removal */
+		pthread_mutex_t _inboxMutex;			/**< Guards the inbox and evictions */
+		
+		/**
+		 * Dispatch a message to the room's client manager and simulation.
+		 * @param msg Message data.
+		 */
+		void dispatch(const Message& msg);
+		
+		/**
+		 * Remove a client from the room, returning the object IDs leased to
+		 * it that no object in the room still uses.
+		 * @param address The client's address.
+		 */
+		void removeClient(const struct sockaddr_in* address);
+	};
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#endif
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+#include <unistd.h>
+#include "roomworker.h"
+#include "log.h"
+#include "tracer.h"
+
+using namespace WiredMunk;
+
+RoomWorker::RoomWorker(int core) {
+	_core = core;
+	_isRunning = false;
+	
+	pthread_mutex_init(&_roomMutex, NULL);
+}
+
+RoomWorker::~RoomWorker() {
+	stop();
+	
+	pthread_mutex_destroy(&_roomMutex);
+}
+
+bool RoomWorker::start() {
+
+	if (_isRunning) return true;
+	
+	_isRunning = true;
+	
+	if (pthread_create(&_thread, NULL, threadMain, this) != 0) {
+		perror("Error starting room worker");
+		_isRunning = false;
+		return false;
+	}
+	
+	return true;
+}
+
+void RoomWorker::stop() {
+
+	if (!_isRunning) return;
+	
+	_isRunning = false;
+	pthread_join(_thread, NULL);
+}
+
+void RoomWorker::addRoom(Room* room) {
+	pthread_mutex_lock(&_roomMutex);
+	_rooms.push_back(room);
+	pthread_mutex_unlock(&_roomMutex);
+}
+
+int RoomWorker::getRoomCount() {
+	pthread_mutex_lock(&_roomMutex);
+	int count = _rooms.size();
+	pthread_mutex_unlock(&_roomMutex);
+	
+	return count;
+}
+
+void RoomWorker::run() {
+
+	if (_core >= 0) pinToCore(_core);
+	
+	char name[TRACE_THREAD_NAME_LENGTH];
+	snprintf(name, sizeof(name), "Room worker %d", _core);
+	Tracer::setThreadName(name);
+	
+	while (_isRunning) {
+		
+		pthread_mutex_lock(&_roomMutex);
+		
+		for (unsigned int i = 0; i < _rooms.size(); ++i) {
+			_rooms.at(i)->run();
+		}
+		
+		pthread_mutex_unlock(&_roomMutex);
+		
+		// Rooms step at a fixed rate, so there is no need to spin
+		usleep(ROOM_WORKER_SLEEP_MICROSECONDS);
+	}
+}
+
+void RoomWorker::pinToCore(int core) {
+
+#if defined(__linux__)
+
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(core, &cpuSet);
+	
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+		LOG_WARNING("Could not pin room worker to core %d\n", core);
+	}
+
+#elif defined(__APPLE__)
+
+	// Mac OS X cannot pin threads to cores; the closest equivalent is to
+	// give each worker its own affinity tag, which asks the scheduler to
+	// keep workers with different tags on different cores
+	thread_affinity_policy_data_t policy = { core + 1 };
+	thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+
+#endif
+
+}
+
+void* RoomWorker::threadMain(void* worker) {
+	((RoomWorker*)worker)->run();
+	
+	return NULL;
+}
@@ -0,0 +1,83 @@
+#ifndef _ROOM_WORKER_H_
+#define _ROOM_WORKER_H_
+
+#include <vector>
+#include <pthread.h>
+#include "room.h"
+
+#define ROOM_WORKER_SLEEP_MICROSECONDS 1000
+
+namespace WiredMunk {
+
+	/**
+	 * Thread that runs a set of rooms.  Each worker is pinned to a single
+	 * core where the platform allows it, so that the rooms it runs keep
+	 * their spaces in that core's cache.  The server places new rooms onto
+	 * the worker with the fewest rooms.
+	 */
+	class RoomWorker {
+	public:
+		
+		/**
+		 * Constructor.
+		 * @param core Index of the core to pin the worker to, or -1 to leave
+		 * the worker unpinned.
+		 */
+		RoomWorker(int core);
+		
+		/**
+		 * Destructor.  Stops the worker thread.
+		 */
+		~RoomWorker();
+		
+		/**
+		 * Start the worker thread.
+		 * @return True if the thread started successfully.
+		 */
+		bool start();
+		
+		/**
+		 * Stop the worker thread and wait for it to finish.
+		 */
+		void stop();
+		
+		/**
+		 * Add a room to the worker.  The room must already be queued.
+		 * @param room The room to add.
+		 */
+		void addRoom(Room* room);
+		
+		/**
+		 * Get the number of rooms run by the worker.
+		 * @return The number of rooms.
+		 */
+		int getRoomCount();
+	
+	private:
+		pthread_t _thread;					/**< The worker thread */
+		pthread_mutex_t _roomMutex;			/**< Guards the room list */
+		std::vector<Room*> _rooms;			/**< Rooms run by the worker */
+		int _core;							/**< Core the worker is pinned to */
+		volatile bool _isRunning;			/**< Is the worker thread running? */
+		
+		/**
+		 * Run all rooms until the worker is stopped.
+		 */
+		void run();
+		
+		/**
+		 * Pin the calling thread to a core.
+		 * @param core Index of the core.
+		 */
+		static void pinToCore(int core);
+		
+		/**
+		 * Thread entry point.
+		 * @param worker The worker to run.
+		 * @return Always NULL.
+		 */
+		static void* threadMain(void* worker);
+	};
+}
+
+#endif
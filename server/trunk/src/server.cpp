@@ -1,41 +1,376 @@
 #include "server.h"
-#include "debug.h"
+#include "chipmunk.h"
+#include "serialisebase.h"
+#include "log.h"
+#include "tickscheduler.h"
+#include "tracer.h"
 
 using namespace WiredMunk;
 
 Server* Server::_singleton = NULL;
 
-Server::Server(int clientCount, int portNum) {
+Server::Server(int clientCount, int portNum, int workerCount, int maxRooms, const SessionSettings& settings) {
 	
 	_socket = new Socket();
-	_clientManager = new ClientManager(_socket, clientCount);
 	_singleton = this;
 	
-	_socket->addSocketEventHandler(_clientManager);
-	_socket->open(portNum);
+	_socket->addSocketEventHandler(this);
+	_portNum = portNum;
+	_network = NULL;
+	_clientCount = clientCount;
+	_maxRooms = maxRooms;
+	_settings = settings;
 	
-	_simulation = new Simulation();
-	_socket->addSocketEventHandler(_simulation);
+	_journal = NULL;
+	_metrics = new MetricsExporter(_socket->getStats(), maxRooms);
+	_idleChecks = new TimingWheel(CONNECTION_WHEEL_SLOTS, CONNECTION_WHEEL_RESOLUTION_MS, getTime());
 	
-	Debug::printf("Server started\n");
-	Debug::printf("Port:    %d\n", portNum);
-	Debug::printf("Clients: %d\n", clientCount);
+	// Chipmunk's collision tables are shared by all rooms, so initialise
+	// them once before any room is created
+	cpInitChipmunk();
+	cpResetShapeIdCounter();
+	
+	// Create the worker pool, one worker per core
+	for (int i = 0; i < workerCount; ++i) {
+		_workers.push_back(new RoomWorker(i));
+	}
+	
+	// Create the first room up front so that clients can join it at once
+	createRoom();
+	
+	LOG_INFO("Server started\n");
+	LOG_INFO("Port:    %d\n", portNum);
+	LOG_INFO("Clients: %d\n", clientCount);
+	LOG_INFO("Workers: %d\n", workerCount);
+	LOG_INFO("Rate:    %dHz x %d substeps\n", settings.getPhysicsRate(), settings.getSubsteps());
+	LOG_INFO("Send:    %dHz\n", settings.getSendRate());
 }
 
 Server::~Server() {
 	_socket->shut();
 	
-	delete _clientManager;
+	_socket->getStats()->print("Traffic");
+	
+	// Stop the exporter before destroying the simulations it reads
+	delete _metrics;
+	
+	// Stop the workers before destroying the rooms they run
+	for (unsigned int i = 0; i < _workers.size(); ++i) {
+		delete _workers.at(i);
+	}
+	
+	for (unsigned int i = 0; i < _rooms.size(); ++i) {
+		_rooms.at(i)->getClientManager()->printTraffic();
+		delete _rooms.at(i);
+	}
+	
 	delete _socket;
-	delete _simulation;
+	delete _journal;
+	delete _idleChecks;
 	
-	Debug::printf("Server stopped\n");
+	LOG_INFO("Server stopped\n");
 }
 
 void Server::run() {
+	Tracer::setThreadName("Main");
+	
+	start();
+	
 	while(1) {
-		_socket->poll();
+		update();
+	}
+}
+
+bool Server::start() {
+	bool isOpen = (_network != NULL ? _socket->open(_network, _portNum) : _socket->open(_portNum));
+	
+	startWorkers();
+	
+	return isOpen;
+}
+
+bool Server::update() {
+	unsigned long long iterationStart = (Tracer::isEnabled() ? TickScheduler::getTime() : 0);
+	
+	int receivedBytes = _socket->poll();
+	
+	checkConnections();
+	
+	_metrics->setConnectionCount(_connections.size());
+	
+	// Rooms on worker threads run themselves
+	if (_workers.size() == 0) runRooms();
+	
+	// The loop spins whilst idle, so only iterations that received a
+	// message or ran long enough to matter are traced
+	if (iterationStart > 0) {
+		unsigned long long duration = TickScheduler::getTime() - iterationStart;
+		
+		if ((receivedBytes > 0) || (duration >= SERVER_TRACE_MIN_ITERATION_NS)) Tracer::complete("Server::run", iterationStart, duration);
+	}
+	
+	return (receivedBytes > 0);
+}
+
+void Server::runRooms() {
+	for (unsigned int i = 0; i < _rooms.size(); ++i) {
+		_rooms.at(i)->run();
+	}
+}
+
+void Server::startWorkers() {
+	for (unsigned int i = 0; i < _workers.size(); ++i) {
+		_workers.at(i)->start();
+	}
+}
+
+void Server::handleMessageReceived(const Message& msg) {
+
+	TRACE_SCOPE("Server::handleMessageReceived");
+	
+	// Route the message to the room that the client belongs to
+	Connection* connection = _connections.find(msg.getAddress());
+	
+	if (connection != NULL) {
+		unsigned long long now = getTime();
+		connection->touch(now);
+		
+		journal(msg, connection->getRoom());
 		
-		_simulation->run();
+		// Ping replies are consumed by the server
+		if (msg.getType() == Message::MESSAGE_PING) {
+			connection->pingReceived(now);
+			return;
+		}
+		
+		connection->getRoom()->handleMessageReceived(msg);
+		return;
+	}
+	
+	// Clients that are not in a room can only send handshakes
+	if (msg.getType() != Message::MESSAGE_HANDSHAKE) return;
+	
+	Room* room = assignRoom(msg);
+	
+	if (room == NULL) {
+		
+		// No room can take the client
+		Message reply(Message::MESSAGE_REJECT, msg.getId(), 0, NULL, msg.getAddress());
+		_socket->sendMessage(&reply);
+		return;
 	}
+	
+	addConnection(msg.getAddress(), room);
+	
+	journal(msg, room);
+	
+	room->handleMessageReceived(msg);
+}
+
+void Server::journal(const Message& msg, Room* room) {
+	if (_journal == NULL) return;
+	
+	_journal->record(msg, room->getId(), room->getSimulation()->getTicks());
+}
+
+Room* Server::assignRoom(const Message& msg) {
+
+	// Has the client asked for a specific room?
+	if (msg.getDataLength() >= SERIALISED_INT_SIZE) {
+		unsigned int roomId = SerialiseBase::deserialiseInt(msg.getData());
+		
+		if (roomId != HANDSHAKE_ANY_ROOM) {
+			if ((roomId < _rooms.size()) && (_rooms.at(roomId)->reserve())) return _rooms.at(roomId);
+			
+			return NULL;
+		}
+	}
+	
+	// Join the first room with a free place
+	for (unsigned int i = 0; i < _rooms.size(); ++i) {
+		if (_rooms.at(i)->reserve()) return _rooms.at(i);
+	}
+	
+	// All rooms are full, so open a new one
+	Room* room = createRoom();
+	
+	if ((room != NULL) && (room->reserve())) return room;
+	
+	return NULL;
+}
+
+Room* Server::createRoom() {
+
+	if (_rooms.size() >= _maxRooms) return NULL;
+	
+	Room* room = new Room(_rooms.size(), _socket, _clientCount, _settings);
+	_rooms.push_back(room);
+	
+	_metrics->addSimulation(room->getId(), room->getSimulation()->getMetrics());
+	
+	if (!_samplePrefix.empty()) startSampling(room);
+	
+	if (_workers.size() > 0) {
+		
+		// Place the room onto the least busy worker
+		RoomWorker* worker = _workers.at(0);
+		int roomCount = worker->getRoomCount();
+		
+		for (unsigned int i = 1; i < _workers.size(); ++i) {
+			int count = _workers.at(i)->getRoomCount();
+			
+			if (count < roomCount) {
+				worker = _workers.at(i);
+				roomCount = count;
+			}
+		}
+		
+		room->setQueued(true);
+		worker->addRoom(room);
+	}
+	
+	return room;
+}
+
+void Server::addConnection(const struct sockaddr_in* address, Room* room) {
+	unsigned long long now = getTime();
+	unsigned long long key = AddressTable<Connection>::getKey(address);
+	
+	Connection* connection = _connections.add(address, Connection(key, address, room, now));
+	
+	connection->setNextCheckTime(now + CONNECTION_PING_INTERVAL_MS);
+	_idleChecks->schedule(key, connection->getNextCheckTime());
+}
+
+void Server::checkConnections() {
+	unsigned long long now = getTime();
+	
+	_expiredChecks.clear();
+	_idleChecks->advance(now, _expiredChecks);
+	
+	for (unsigned int i = 0; i < _expiredChecks.size(); ++i) {
+		Connection* connection = _connections.find(_expiredChecks[i]);
+		
+		// Ignore checks for clients that have since been evicted, and checks
+		// that have been superseded
+		if (connection == NULL) continue;
+		if (connection->getNextCheckTime() > now) continue;
+		
+		unsigned long long idleTime = now - connection->getLastSeenTime();
+		
+		if (idleTime >= CONNECTION_TIMEOUT_MS) {
+			LOG_INFO("Client timed out\n");
+			
+			connection->getRoom()->evict(connection->getAddress());
+			_connections.remove(_expiredChecks[i]);
+			continue;
+		}
+		
+		unsigned long long nextCheckTime;
+		
+		if (idleTime >= CONNECTION_PING_INTERVAL_MS) {
+			
+			// The client has gone quiet; ping it to see if it is still there
+			Message ping(Message::MESSAGE_PING, 0, 0, NULL, connection->getAddress());
+			_socket->sendMessage(&ping);
+			
+			connection->pingSent(now);
+			nextCheckTime = now + CONNECTION_PING_INTERVAL_MS;
+		} else {
+			
+			// The client has been heard from since the check was scheduled
+			nextCheckTime = connection->getLastSeenTime() + CONNECTION_PING_INTERVAL_MS;
+		}
+		
+		connection->setNextCheckTime(nextCheckTime);
+		_idleChecks->schedule(_expiredChecks[i], nextCheckTime);
+	}
+}
+
+unsigned long long Server::getTime() {
+	return TickScheduler::getTime() / 1000000;
+}
+
+bool Server::record(const char* fileName) {
+
+	if (_journal == NULL) _journal = new MessageJournal();
+	
+	return _journal->openForRecording(fileName);
+}
+
+bool Server::exportMetrics(int port, const char* fileName) {
+	return _metrics->start(port, fileName);
+}
+
+void Server::sample(const char* prefix) {
+	_samplePrefix = prefix;
+	
+	for (unsigned int i = 0; i < _rooms.size(); ++i) {
+		startSampling(_rooms.at(i));
+	}
+}
+
+void Server::startSampling(Room* room) {
+	char fileName[FILENAME_MAX];
+	
+	snprintf(fileName, sizeof(fileName), "%s_%u.wdms", _samplePrefix.c_str(), room->getId());
+	
+	room->getSimulation()->startSampling(fileName, room->getId());
+}
+
+void Server::replay(const char* fileName, bool realTime) {
+
+	Tracer::setThreadName("Main");
+	
+	MessageJournal journal;
+	
+	if (!journal.openForReplay(fileName)) return;
+	
+	struct timeval startTime;
+	struct timeval endTime;
+	struct timeval timeDiff;
+	
+	gettimeofday(&startTime, NULL);
+	
+	Message* msg;
+	unsigned int roomId;
+	unsigned int tick;
+	
+	while ((msg = journal.readMessage(&roomId, &tick)) != NULL) {
+		
+		// Bring the room's simulation up to the tick at which the message
+		// arrived.  The simulation does not tick until a space has been
+		// received, so there is nothing to catch up on until then.  Rooms
+		// are created by the handshakes that open them, so a room that does
+		// not exist yet has not ticked either
+		Simulation* simulation = (roomId < _rooms.size() ? _rooms.at(roomId)->getSimulation() : NULL);
+		
+		while ((simulation != NULL) && (simulation->getTicks() < tick) && (simulation->getSpace() != NULL)) {
+			if (realTime) {
+				runRooms();
+			} else {
+				simulation->tick();
+			}
+		}
+		
+		// Deliver the message as though it had arrived at the socket
+		_socket->dispatchMessage(*msg);
+		
+		delete msg;
+	}
+	
+	gettimeofday(&endTime, NULL);
+	timersub(&endTime, &startTime, &timeDiff);
+	
+	unsigned int ticks = 0;
+	
+	for (unsigned int i = 0; i < _rooms.size(); ++i) {
+		ticks += _rooms.at(i)->getSimulation()->getTicks();
+	}
+	
+	LOG_INFO("Replay complete\n");
+	LOG_INFO("Messages: %d\n", journal.getRecordCount());
+	LOG_INFO("Rooms:    %d\n", (int)_rooms.size());
+	LOG_INFO("Ticks:    %d\n", ticks);
+	LOG_INFO("Time:     %d.%06ds\n", (int)timeDiff.tv_sec, (int)timeDiff.tv_usec);
 }
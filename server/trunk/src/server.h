@@ -1,26 +1,65 @@
 #include <iostream>
+#include <vector>
+#include <string>
 #include "socket.h"
-#include "clientmanager.h"
-#include "simulation.h"
+#include "socketeventhandler.h"
+#include "room.h"
+#include "roomworker.h"
+#include "messagejournal.h"
+#include "addresstable.h"
+#include "connection.h"
+#include "timingwheel.h"
+#include "metricsexporter.h"
+
+#define DEFAULT_MAX_ROOMS 256
+#define CONNECTION_PING_INTERVAL_MS 2000
+#define CONNECTION_TIMEOUT_MS 10000
+#define CONNECTION_WHEEL_SLOTS 256
+#define CONNECTION_WHEEL_RESOLUTION_MS 100
+#define SERVER_TRACE_MIN_ITERATION_NS 20000
 
 namespace WiredMunk {
 	
 	/**
-	 * Server class.  Runs the simulation and maintains communication with
-	 * clients via the ClientManager class.  Contains the socket through which
-	 * all communication takes place.
+	 * Server class.  Hosts any number of rooms, each of which runs its own
+	 * simulation and maintains communication with its own clients via a
+	 * ClientManager.  Contains the socket through which all communication
+	 * takes place, and routes incoming messages to the room that the sending
+	 * client belongs to.
+	 *
+	 * Clients are placed into rooms when they send a handshake.  A handshake
+	 * may contain a 4 byte room ID to join a specific room; otherwise, or if
+	 * the ID is HANDSHAKE_ANY_ROOM, the client joins the first room with a
+	 * free place, and a new room is created if all rooms are full.  The room
+	 * ID may be followed by proposed session settings (see SessionSettings).
+	 *
+	 * Every client is tracked in a connection table keyed by address, so
+	 * identifying the sender of a message takes the same time no matter how
+	 * many clients are connected.  Idle clients are pinged every
+	 * CONNECTION_PING_INTERVAL_MS, which also measures their round trip
+	 * time, and are removed from their room once nothing has been heard from
+	 * them for CONNECTION_TIMEOUT_MS.  Idle checks are scheduled on a timing
+	 * wheel, so the main loop never scans the whole table.
+	 *
+	 * Rooms are either run on the main thread, or spread across a pool of
+	 * RoomWorker threads, each pinned to its own core.
 	 *
 	 * Only one instance should be created.
 	 */
-	class Server {
+	class Server : public SocketEventHandler {
 	public:
 		
 		/**
 		 * Constructor.
-		 * @param clientCount Number of clients required for a session.
+		 * @param clientCount Number of clients required for a session in each
+		 * room.
 		 * @param portNum Port to open server on.
+		 * @param workerCount Number of worker threads to run rooms on.  If 0,
+		 * rooms are run on the main thread.
+		 * @param maxRooms Maximum number of rooms to host.
+		 * @param settings Default timing settings for each room's session.
 		 */
-		Server(int clientCount, int portNum);
+		Server(int clientCount, int portNum, int workerCount = 0, int maxRooms = DEFAULT_MAX_ROOMS, const SessionSettings& settings = SessionSettings());
 		
 		/**
 		 * Destructor.
@@ -28,10 +67,82 @@ namespace WiredMunk {
 		~Server();
 		
 		/**
-		 * Main loop.
+		 * Main loop.  Opens the socket and services clients until the process
+		 * is killed.
 		 */
 		virtual void run();
 		
+		/**
+		 * Run the server on a loopback network instead of UDP.  Must be called
+		 * before the server starts.
+		 * @param network The network to open the server's socket on.
+		 */
+		inline void setNetwork(LoopbackNetwork* network) { _network = network; };
+		
+		/**
+		 * Open the socket and start the workers.  Called by run(); call
+		 * directly, followed by update(), to drive the server from another
+		 * loop.
+		 * @return True if the socket opened successfully.
+		 */
+		bool start();
+		
+		/**
+		 * Run a single iteration of the main loop.  Services any message that
+		 * has arrived, checks for idle clients and, if there are no workers,
+		 * runs the rooms.
+		 * @return True if a message was received.
+		 */
+		bool update();
+		
+		/**
+		 * Routes incoming messages to rooms.
+		 * @param msg Message data.
+		 */
+		void handleMessageReceived(const Message& msg);
+		
+		/**
+		 * Record every inbound message to a journal whilst the server runs.
+		 * Must be called before run().  Messages are recorded with the ID of
+		 * the room they are routed to, and timestamped with the ticks of
+		 * that room's simulation.
+		 * @param fileName Name of the journal file to append to.
+		 * @return True if the journal was opened successfully.
+		 */
+		bool record(const char* fileName);
+		
+		/**
+		 * Record the state of every room's simulation to sample files for
+		 * drift analysis.  Each room writes to its own file, named after the
+		 * prefix and the room ID (eg. "prefix_0.wdms").  Rooms created later
+		 * are sampled too.
+		 * @param prefix Prefix of the sample file names.
+		 */
+		void sample(const char* prefix);
+		
+		/**
+		 * Publish the server's runtime counters in Prometheus text format
+		 * (see MetricsExporter).
+		 * @param port Port on the loopback interface to serve metrics on, or
+		 * 0 to disable serving.
+		 * @param fileName Name of a file to rewrite with the metrics every
+		 * second, or NULL to disable writing.
+		 * @return True if the exporter started successfully.
+		 */
+		bool exportMetrics(int port, const char* fileName);
+		
+		/**
+		 * Replay a recorded journal through the rooms without opening the
+		 * socket.  Rooms are run on the main thread.  Messages are delivered
+		 * when their room reaches the tick at which they originally arrived.
+		 * Any messages the server tries to send are discarded.
+		 * @param fileName Name of the journal file to replay.
+		 * @param realTime If true, the simulation is stepped against the
+		 * clock as it would be in a live session; if false, the simulation is
+		 * stepped as fast as possible.
+		 */
+		void replay(const char* fileName, bool realTime);
+		
 		/**
 		 * Get a pointer to the singleton.
 		 * @return A pointer to the server singleton.
@@ -45,16 +156,93 @@ namespace WiredMunk {
 		Socket* getSocket() { return _socket; };
 		
 		/**
-		 * Get a pointer to the client manager.
-		 * @return The client manager.
+		 * Get the number of rooms hosted by the server.
+		 * @return The number of rooms.
+		 */
+		int getRoomCount() const { return _rooms.size(); };
+		
+		/**
+		 * Get the number of clients connected to the server.
+		 * @return The number of clients.
 		 */
-		ClientManager* getClientManager() { return _clientManager; };
+		int getConnectionCount() const { return _connections.size(); };
 		
 	private:
-		Socket* _socket;				/**< Socket used for comms */
-		ClientManager* _clientManager;	/**< Client management */
-		Simulation* _simulation;		/**< Server-side physics simulation */
+		Socket* _socket;						/**< Socket used for comms */
+		std::vector<Room*> _rooms;				/**< Rooms hosted by the server */
+		AddressTable<Connection> _connections;	/**< Connected clients */
+		TimingWheel* _idleChecks;				/**< Schedule of connection idle checks */
+		std::vector<unsigned long long> _expiredChecks;	/**< Idle checks due this iteration */
+		std::vector<RoomWorker*> _workers;		/**< Threads that run the rooms */
+		MessageJournal* _journal;				/**< Journal of inbound messages */
+		MetricsExporter* _metrics;				/**< Publishes runtime counters */
+		int _clientCount;						/**< Number of clients per room */
+		unsigned int _maxRooms;					/**< Maximum number of rooms */
+		int _portNum;							/**< Port to open server on */
+		LoopbackNetwork* _network;				/**< Loopback network to run on, or NULL for UDP */
+		SessionSettings _settings;				/**< Default session settings */
+		std::string _samplePrefix;				/**< Prefix of sample file names */
+		
+		static Server* _singleton;				/**< Single server instance */
+		
+		/**
+		 * Create a new room.  If the server has worker threads, the room is
+		 * placed onto the worker with the fewest rooms.
+		 * @return The new room, or NULL if the server already hosts the
+		 * maximum number of rooms.
+		 */
+		Room* createRoom();
+		
+		/**
+		 * Start sampling a room's simulation.
+		 * @param room The room to sample.
+		 */
+		void startSampling(Room* room);
+		
+		/**
+		 * Record a message to the journal, if one is being recorded.
+		 * @param msg The message.
+		 * @param room The room that the message is routed to.
+		 */
+		void journal(const Message& msg, Room* room);
+		
+		/**
+		 * Choose a room for a client that has sent a handshake, and reserve a
+		 * place in it.
+		 * @param msg The handshake message.
+		 * @return The room, or NULL if no room can take the client.
+		 */
+		Room* assignRoom(const Message& msg);
 		
-		static Server* _singleton;		/**< Single server instance */
+		/**
+		 * Start the worker threads.
+		 */
+		void startWorkers();
+		
+		/**
+		 * Run every room once.  Used when there are no worker threads.
+		 */
+		void runRooms();
+		
+		/**
+		 * Add a client to the connection table and schedule its first idle
+		 * check.
+		 * @param address The client's address.
+		 * @param room The room that the client has joined.
+		 */
+		void addConnection(const struct sockaddr_in* address, Room* room);
+		
+		/**
+		 * Run all idle checks that have fallen due.  Clients that have been
+		 * idle for too long are evicted from their rooms; other idle clients
+		 * are pinged.
+		 */
+		void checkConnections();
+		
+		/**
+		 * Read the monotonic clock.
+		 * @return The current time in milliseconds.
+		 */
+		static unsigned long long getTime();
 	};
 }
@@ -0,0 +1,56 @@
+#include "handleallocator.h"
+
+using namespace WiredMunk;
+
+HandleAllocator::HandleAllocator(unsigned int firstIndex) {
+	_firstIndex = firstIndex;
+	
+	// Reserve the slots that cannot be allocated
+	_generations.resize(firstIndex, 0);
+	_isAllocated.resize(firstIndex, false);
+}
+
+unsigned int HandleAllocator::allocate() {
+
+	unsigned int index;
+	
+	if (_freeIndices.size() > 0) {
+		
+		// Reuse the most recently released slot
+		index = _freeIndices.back();
+		_freeIndices.pop_back();
+	} else {
+		
+		// No free slots - create a new one
+		index = _generations.size();
+		_generations.push_back(0);
+		_isAllocated.push_back(false);
+	}
+	
+	_isAllocated[index] = true;
+	
+	return makeHandle(index, _generations[index]);
+}
+
+void HandleAllocator::release(unsigned int handle) {
+
+	// Ignore handles that are stale or were never allocated
+	if (!isLive(handle)) return;
+	
+	unsigned int index = getIndex(handle);
+	
+	// Bump the generation so that the released handle no longer matches
+	_generations[index] = (_generations[index] + 1) & HANDLE_GENERATION_MASK;
+	_isAllocated[index] = false;
+	
+	_freeIndices.push_back(index);
+}
+
+bool HandleAllocator::isLive(unsigned int handle) const {
+	unsigned int index = getIndex(handle);
+	
+	if (index >= _generations.size()) return false;
+	if (!_isAllocated[index]) return false;
+	
+	return _generations[index] == getGeneration(handle);
+}
@@ -2,21 +2,26 @@
 #include "socket.h"
 #include "simulation.h"
 #include "message.h"
+#include "idserver.h"
 
 #include <stdio.h>
 
 using namespace WiredMunk;
 
-unsigned int NetworkObject::_nextId = 0;
-
 NetworkObject::NetworkObject() {
-	_objectId = getNextId();
+	_objectId = IDServer::getNextNetworkObjectId();
+	_isIdOwner = true;
 }
 
 NetworkObject::NetworkObject(const unsigned char* serialisedData) {
+	_isIdOwner = false;
 	deserialise(serialisedData);
 }
 
+NetworkObject::~NetworkObject() {
+	if (_isIdOwner) IDServer::releaseNetworkObjectId(_objectId);
+}
+
 unsigned int NetworkObject::serialise(unsigned char* buffer) {
 	return SerialiseBase::serialise(_objectId, buffer);
 }
@@ -31,5 +36,12 @@ unsigned int NetworkObject::getSerialisedLength() {
 }
 
 void NetworkObject::setObjectId(unsigned int objectId) {
+
+	// Return the allocated ID, which is being replaced
+	if (_isIdOwner) {
+		IDServer::releaseNetworkObjectId(_objectId);
+		_isIdOwner = false;
+	}
+	
 	_objectId = objectId;
 }
@@ -14,7 +14,7 @@ namespace WiredMunk {
 	public:
 		
 		/**
-		 * Constructor.
+		 * Constructor.  Allocates a new ID for the object from the IDServer.
 		 */
 		NetworkObject();
 		
@@ -25,12 +25,27 @@ namespace WiredMunk {
 		 */
 		NetworkObject(const unsigned char* serialisedData);
 
+		/**
+		 * Destructor.  Returns the object's ID to the IDServer for reuse if
+		 * the ID was allocated by the object.
+		 */
+		virtual ~NetworkObject();
+		
 		/**
 		 * Gets the object's id.  The id is unique across the network.
 		 * @return The object's id.
 		 */
 		inline unsigned int getObjectId() const { return _objectId; };
 		
+		/**
+		 * Read the object ID from a serialised object without deserialising
+		 * the rest of the object.  Works for any serialised NetworkObject, as
+		 * the ID is always the first item serialised.
+		 * @param serialisedData The serialised object.
+		 * @return The object's id.
+		 */
+		inline static unsigned int peekObjectId(const unsigned char* serialisedData) { return SerialiseBase::deserialiseInt(serialisedData); };
+		
 		/**
 		 * Stores a serialised representation of the object.  The buffer must be
 		 * large enough to contain the serialised data.  The size of the data
@@ -72,18 +87,12 @@ namespace WiredMunk {
 		
 	private:		
 		unsigned int _objectId;				/**< The object's id, unique across the network */
-		static unsigned int _nextId;		/**< The next ID to be generated */
+		bool _isIdOwner;					/**< Was the ID allocated by this object? */
 		
 		/**
 		 * Requests a unique ID for the object from the server.
 		 */
 		void requestObjectId();
-		
-		/**
-		 * Get the next unique ID.
-		 * @return The next unique ID.
-		 */
-		inline static unsigned int getNextId() { return _nextId++; };
 	};
 }
 
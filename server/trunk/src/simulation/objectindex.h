@@ -0,0 +1,132 @@
+#ifndef _OBJECT_INDEX_H_
+#define _OBJECT_INDEX_H_
+
+#include <vector>
+#include <map>
+#include "handleallocator.h"
+
+#define OBJECT_INDEX_DENSE_LIMIT 65536
+
+namespace WiredMunk {
+
+	/**
+	 * Maps network object IDs to objects in constant time.  Object IDs are
+	 * generational handles (see HandleAllocator), so the index is a dense
+	 * array of slots indexed directly by the handle's slot index.  Each slot
+	 * remembers the full handle it was filled with, so looking up a stale
+	 * handle whose slot has since been reused fails rather than returning the
+	 * wrong object.  Slot indices at or above OBJECT_INDEX_DENSE_LIMIT are
+	 * stored in a map instead.  A single bad ID can therefore grow the array
+	 * to at most OBJECT_INDEX_DENSE_LIMIT slots (1MB with 64-bit pointers),
+	 * whilst the server can still hand out that many live IDs before lookups
+	 * fall back to the map.
+	 */
+	template <class T>
+	class ObjectIndex {
+	public:
+		
+		/**
+		 * Find the object with the specified ID.
+		 * @param objectId The ID of the object to find.
+		 * @return The object, or NULL if no object has the ID.
+		 */
+		inline T* find(unsigned int objectId) const {
+			unsigned int index = HandleAllocator::getIndex(objectId);
+			
+			if (index < _slots.size()) {
+				return (_slots[index].objectId == objectId ? _slots[index].object : NULL);
+			}
+			
+			if (index < OBJECT_INDEX_DENSE_LIMIT) return NULL;
+			
+			typename std::map<unsigned int, T*>::const_iterator iterator = _sparseObjects.find(objectId);
+			return (iterator == _sparseObjects.end() ? NULL : iterator->second);
+		};
+		
+		/**
+		 * Find the object that holds the slot an ID maps to, whatever its
+		 * generation.  IDs at or above OBJECT_INDEX_DENSE_LIMIT do not share
+		 * slots, so for those only an exact match is found.
+		 * @param objectId The ID to look up.
+		 * @return The object in the slot, or NULL if the slot is empty.
+		 */
+		inline T* findOccupant(unsigned int objectId) const {
+			unsigned int index = HandleAllocator::getIndex(objectId);
+			
+			if (index < _slots.size()) return _slots[index].object;
+			if (index < OBJECT_INDEX_DENSE_LIMIT) return NULL;
+			
+			return find(objectId);
+		};
+		
+		/**
+		 * Add an object to the index.  A slot holds one object at a time, so
+		 * an object whose slot is held by another generation is not added
+		 * until the other object has been removed.
+		 * @param objectId The ID of the object.
+		 * @param object The object to add.
+		 * @return True if the object was added; false if an object with the
+		 * same ID or slot already exists.
+		 */
+		bool add(unsigned int objectId, T* object) {
+			if (find(objectId) != NULL) return false;
+			
+			unsigned int index = HandleAllocator::getIndex(objectId);
+			
+			if (index < OBJECT_INDEX_DENSE_LIMIT) {
+				if (index >= _slots.size()) _slots.resize(index + 1);
+				if (_slots[index].object != NULL) return false;
+				
+				_slots[index].objectId = objectId;
+				_slots[index].object = object;
+			} else {
+				_sparseObjects[objectId] = object;
+			}
+			
+			return true;
+		};
+		
+		/**
+		 * Remove an object from the index.  Nothing is removed if a different
+		 * object is stored against the ID.
+		 * @param objectId The ID of the object.
+		 * @param object The object to remove.
+		 */
+		void remove(unsigned int objectId, T* object) {
+			if (find(objectId) != object) return;
+			
+			unsigned int index = HandleAllocator::getIndex(objectId);
+			
+			if (index < OBJECT_INDEX_DENSE_LIMIT) {
+				_slots[index].object = NULL;
+			} else {
+				_sparseObjects.erase(objectId);
+			}
+		};
+		
+		/**
+		 * Remove all objects from the index.
+		 */
+		void clear() {
+			_slots.clear();
+			_sparseObjects.clear();
+		};
+	
+	private:
+		
+		/**
+		 * A single slot in the dense array.
+		 */
+		struct Slot {
+			unsigned int objectId;		/**< Full ID of the object in the slot */
+			T* object;					/**< The object, or NULL if the slot is empty */
+			
+			Slot() : objectId(0), object(NULL) { };
+		};
+		
+		std::vector<Slot> _slots;					/**< Objects indexed by slot */
+		std::map<unsigned int, T*> _sparseObjects;	/**< Objects with out-of-range slots */
+	};
+}
+
+#endif
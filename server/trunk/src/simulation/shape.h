@@ -46,12 +46,10 @@ namespace WiredMunk {
 		 * into an object. The serialised data does not contain a serialised
 		 * body - instead it contains the unique ID of the body, which
 		 * references an existing body in the space.
-		 * @param bodyVector Vector of bodies from the containing space.
-		 * @param staticBodyVector Vector of static bodies from the containing
-		 * space.
+		 * @param space The containing space.
 		 * @param serialisedData The serialised data.
 		 */
-		Shape(BodyVector* bodyVector, BodyVector* staticBodyVector, const unsigned char* serialisedData);
+		Shape(Space* space, const unsigned char* serialisedData);
 		
 		/**
 		 * Destructor.
@@ -184,13 +182,11 @@ namespace WiredMunk {
 		/**
 		 * Deserialises the data.  Should be called by the object's constructor
 		 * in order to create a new object that contains the deserialised data.
-		 * @param bodyVector Vector of bodies from the containing space.
-		 * @param staticBodyVector Vector of static bodies from the containing
-		 * space.
+		 * @param space The containing space, used to locate the shape's body.
 		 * @param data Data to deserialise.
 		 * @return The size of the data deserialised, in bytes.
 		 */
-		virtual unsigned int deserialise(BodyVector* bodyVector, BodyVector* staticBodyVector, const unsigned char* data);
+		virtual unsigned int deserialise(Space* space, const unsigned char* data);
 		
 		/**
 		 * Get the length in bytes of the serialised data.
@@ -198,6 +194,14 @@ namespace WiredMunk {
 		 */
 		unsigned int getSerialisedLength();
 		
+		/**
+		 * Read the length of a serialised shape without deserialising it.
+		 * Used to skip shapes that cannot be created.
+		 * @param serialisedData The serialised shape.
+		 * @return The length in bytes of the serialised data.
+		 */
+		static unsigned int peekSerialisedLength(const unsigned char* serialisedData);
+		
 		/**
 		 * Transmit the object in serialised form across the network.
 		 * @param address Address to send the object to.
@@ -1,27 +1,49 @@
 #include "simulation.h"
 #include "chipmunk.h"
 #include "serialisebase.h"
-#include "debug.h"
+#include "log.h"
+#include "tracer.h"
 #include "body.h"
 #include "shape.h"
-#include "server.h"
+#include "clientmanager.h"
+#include "idserver.h"
 
 using namespace WiredMunk;
 
-Simulation::Simulation() {
+Simulation::Simulation(ClientManager* clientManager) : _scheduler(SESSION_DEFAULT_PHYSICS_RATE, SIMULATION_MAX_CATCH_UP_STEPS) {
 	_space = NULL;
+	_clientManager = clientManager;
+	_ticks = 0;
+	_lastSnapshotTick = 0;
+	_sampleSourceId = 0;
 	
-	_sampler = new PositionSampler();
+	applySettings();
 	
-	gettimeofday(&_lastRunTime, NULL);
-	gettimeofday(&_lastSyncTime, NULL);
-	
-	cpInitChipmunk();
-	cpResetShapeIdCounter();
+	_lastSyncTime = TickScheduler::getTime();
 }
 
 Simulation::~Simulation() {
-	delete _sampler;
+	_sampler.close();
+	
+	if (_space == NULL) return;
+	
+	// The clients have gone, so the IDs of the objects left in the space
+	// can be reused
+	for (unsigned int i = 0; i < _space->getBodies()->size(); ++i) {
+		IDServer::releaseNetworkObjectId(_space->getBodies()->at(i)->getObjectId());
+	}
+	
+	for (unsigned int i = 0; i < _space->getStaticBodies()->size(); ++i) {
+		IDServer::releaseNetworkObjectId(_space->getStaticBodies()->at(i)->getObjectId());
+	}
+	
+	for (unsigned int i = 0; i < _space->getShapes()->size(); ++i) {
+		IDServer::releaseNetworkObjectId(_space->getShapes()->at(i)->getObjectId());
+	}
+	
+	for (unsigned int i = 0; i < _space->getStaticShapes()->size(); ++i) {
+		IDServer::releaseNetworkObjectId(_space->getStaticShapes()->at(i)->getObjectId());
+	}
 }
 
 void Simulation::run() {
@@ -34,66 +56,160 @@ void Simulation::run() {
 void Simulation::sync() {
 	
 	// Calculate the time that has passed since the last time the clients were
-	// synced
-	struct timeval now;
-	struct timeval timeDiff;
-	
-	gettimeofday(&now, NULL);
-	
-	timersub(&now, &_lastSyncTime, &timeDiff);
+	// synced.  The scheduler's clock is used so that a simulated clock
+	// controls resyncs too
+	unsigned long long timeDiff = TickScheduler::getTime() - _lastSyncTime;
 	
 	// Do we need to resync the clients?
-	if (timeDiff.tv_sec > RESYNC_SECONDS) {
+	if (timeDiff > RESYNC_SECONDS * 1000000000ULL) {
 		
-		Debug::printf("Resyncing with clients\n");
+		LOG_DEBUG("Resyncing with clients\n");
 		
 		// Distribute the new simulation to all clients
-		Server::getServer()->getClientManager()->sendSpace(_space);
+		_clientManager->sendSpace(_space);
 		
 		// Remember that we have synced all clients
-		gettimeofday(&_lastSyncTime, NULL);
+		_lastSyncTime = TickScheduler::getTime();
 	}
 }
 
 void Simulation::step() {
 		
-	// Calculate the time that has passed since the last time the
-	// simulation ran
-	struct timeval thisRunTime;
-	struct timeval timeDiff;
+	// Run as many fixed steps as have fallen due since the last run
+	int steps = _scheduler.update();
 	
-	gettimeofday(&thisRunTime, NULL);
+	_metrics.recordUpdate(steps, _scheduler.getOverrunCount(), _scheduler.getSkippedSteps());
 	
-	// Get time difference between last time and this time
-	timersub(&thisRunTime, &_lastRunTime, &timeDiff);
+	// Most runs have nothing due, and are not worth tracing
+	if (steps == 0) return;
 	
-	// Calculate time in 85ths of a second
-	int steps = (((cpFloat)timeDiff.tv_usec) / 1000000.0) * 85.0;
+	TRACE_SCOPE("Simulation::step");
 	
-	// Remember current run time if we are to step the simulation
-	//if (steps > 0) _lastRunTime = thisRunTime;
-	if (steps > 0) {
-		struct timeval increaseTime;
-		struct timeval nextRunTime;
-		increaseTime.tv_usec = steps * (1000000.0 / 85.0);;
-		timeradd(&_lastRunTime, &increaseTime, &nextRunTime);
-		_lastRunTime = nextRunTime;
+	for (int i = 0; i < steps; ++i) {
+		tick();
 	}
 	
-	// Step the simulation
-	cpFloat dt = 1.0/85.0;
-	for (int i = 0; i < steps; ++i) {
-		_space->step(dt);
+	sendSnapshot();
+}
+
+void Simulation::sendSnapshot() {
+	unsigned int interval = _settings.getSnapshotInterval();
+	
+	if (interval == 0) return;
+	if (_ticks - _lastSnapshotTick < interval) return;
+	
+	_clientManager->sendSpace(_space);
+	
+	_lastSnapshotTick = _ticks;
+	_lastSyncTime = TickScheduler::getTime();
+}
+
+void Simulation::applySettings() {
+	const SessionSettings& settings = _clientManager->getSettings();
+	
+	if ((settings.getPhysicsRate() == _settings.getPhysicsRate()) && (settings.getSubsteps() == _settings.getSubsteps()) && (settings.getSendRate() == _settings.getSendRate())) return;
+	
+	_settings = settings;
+	_scheduler.setRate(_settings.getPhysicsRate());
+}
+
+void Simulation::tick() {
+	if (_space == NULL) return;
+	
+	TRACE_SCOPE("Simulation::tick");
+	
+	unsigned long long start = TickScheduler::getTime();
+	cpFloat dt = _settings.getSubstepLength();
+	
+	for (unsigned int i = 0; i < _settings.getSubsteps(); ++i) {
+		if (Tracer::isEnabled()) {
+			unsigned long long stepStart = TickScheduler::getTime();
+			
+			_space->step(dt);
+			
+			Tracer::complete("cpSpaceStep", stepStart, TickScheduler::getTime() - stepStart);
+			traceStepPhases(stepStart);
+		} else {
+			_space->step(dt);
+		}
+	}
+	
+	_ticks++;
+	
+	_metrics.recordTick(TickScheduler::getTime() - start);
+	updateMetrics();
+	
+	// Sample the simulation
+	_sampler.sample(_space, _ticks);
+}
+
+void Simulation::updateMetrics() {
+	cpSpace* space = _space->getSpace();
+	
+	_metrics.setObjectCounts(_space->getBodies()->size(), _space->getShapes()->size(), space->arbiters->num);
+	
+	if (_ticks % METRICS_OCCUPANCY_INTERVAL != 0) return;
+	
+	// The hash is left empty when the space uses another broadphase
+	if (space->broadphase != CP_BROADPHASE_HASH) {
+		_metrics.clearHashOccupancy();
+		return;
+	}
+	
+	cpSpaceHash* hash = space->activeShapes;
+	unsigned int cellsUsed = 0;
+	
+	for (int i = 0; i < hash->numcells; ++i) {
+		if (hash->table[i] != NULL) cellsUsed++;
+	}
+	
+	_metrics.setHashOccupancy(hash->numcells, hash->handleSet->entries, cellsUsed);
+}
+
+void Simulation::traceStepPhases(unsigned long long start) {
+	static const char* const phaseNames[CP_NUM_PHASES] = {
+		"Integrate positions",
+		"Update bounding boxes",
+		"Static query",
+		"Active query",
+		"Arbiter prestep",
+		"Joint prestep",
+		"Elastic iterations",
+		"Integrate velocities",
+		"Solver"
+	};
+	
+	const cpSpaceStepStats& stats = _space->getStepStats();
+	
+	// Nothing is timed unless the profiler is compiled in
+	if (stats.stepTime <= 0) return;
+	
+	for (int i = 0; i < CP_NUM_PHASES; ++i) {
+		unsigned long long duration = (unsigned long long)(stats.phaseTime[i] * 1000000000.0);
 		
-		// Sample the simulation
-		_sampler->sample(_space);
+		Tracer::complete(phaseNames[i], start, duration);
+		start += duration;
 	}
 }
 
+void Simulation::startSampling(const char* fileName, unsigned int sourceId) {
+	_sampleFileName = fileName;
+	_sampleSourceId = sourceId;
+	
+	// Open immediately if the session has already started
+	if (_space != NULL) _sampler.open(fileName, PositionSampler::SOURCE_SERVER, sourceId, _settings.getPhysicsRate());
+}
+
 void Simulation::handleMessageReceived(const Message& msg) {
 	
+	TRACE_SCOPE("Simulation::handleMessageReceived");
+	
 	switch (msg.getType()) {
-			
+		
+		case Message::MESSAGE_HANDSHAKE:
+			applySettings();
+			break;
+		
 		case Message::MESSAGE_SPACE:
 			handleSpaceReceived(msg);
 			break;
@@ -106,6 +222,10 @@ void Simulation::handleMessageReceived(const Message& msg) {
 			handleShapeReceived(msg);
 			break;
 			
+		case Message::MESSAGE_OBJECT_ID_RELEASE:
+			handleObjectIdReleaseReceived(msg);
+			break;
+			
 		default:
 			break;
 	}
@@ -114,13 +234,21 @@ void Simulation::handleMessageReceived(const Message& msg) {
 void Simulation::handleSpaceReceived(const Message& msg) {
 	
 	// Create a space on the server
-	Debug::printf("Space data received\n");
+	LOG_DEBUG("Space data received\n");
 	
 	// Do we need to create a new space?
 	if (_space == NULL) {
 		
 		// Create a new space and deserialise data into it
 		_space = new Space(msg.getData());
+		
+		// Start timing from now so that the time spent waiting for the
+		// space is not treated as a backlog of steps
+		_scheduler.reset();
+		
+		if (!_sampleFileName.empty()) {
+			_sampler.open(_sampleFileName.c_str(), PositionSampler::SOURCE_SERVER, _sampleSourceId, _settings.getPhysicsRate());
+		}
 	} else {
 		
 		// Space exists; deserialise data into existing space
@@ -131,84 +259,80 @@ void Simulation::handleSpaceReceived(const Message& msg) {
 void Simulation::handleBodyReceived(const Message& msg) {
 	
 	// Create a body on the server
-	Debug::printf("Body data received\n");
+	LOG_DEBUG("Body data received\n");
 	
 	// Abort if the space has not yet been initialised
 	if (_space == NULL) return;
 	
-	// Deserialise the body in order to work out which local body it
-	// represents
-	Body* newBody = new Body(msg.getData());
+	// Peek at the body's ID in order to work out which local body it
+	// represents, then update the existing body in place
+	Body* body = _space->findBody(NetworkObject::peekObjectId(msg.getData()));
 	
-	// Locate the existing body and update it
-	for (int i = 0; i < _space->getBodies()->size(); ++i) {
+	if (body != NULL) {
 		
-		Body* oldBody = _space->getBodies()->at(i);
-		
-		// Found the body?
-		if (newBody->getObjectId() == oldBody->getObjectId()) {
-			
-			// Located body - deserialise into it
-			oldBody->deserialise(msg.getData());
-		}
+		// Located body - deserialise into it
+		body->deserialise(msg.getData());
 	}
 	
-	delete newBody;
+	// Periodic snapshots will carry the change, so only sessions without a
+	// send rate distribute the new simulation immediately
+	if (_settings.getSnapshotInterval() > 0) return;
 	
 	// Distribute the new simulation to all clients
-	Server::getServer()->getClientManager()->sendSpace(_space);
+	_clientManager->sendSpace(_space);
 	
 	// Remember that we have synced all clients
-	gettimeofday(&_lastSyncTime, NULL);
+	_lastSyncTime = TickScheduler::getTime();
 }
 
 void Simulation::handleShapeReceived(const Message& msg) {
 	
 	// Create a shape on the server
-	Debug::printf("Shape data received\n");
+	LOG_DEBUG("Shape data received\n");
 	
 	
 	// Abort if the space has not yet been initialised
 	if (_space == NULL) return;
 	
-	// Deserialise the shape in order to work out which local shape it
-	// represents
-	Shape* newShape = new Shape(_space->getBodies(), _space->getStaticBodies(), msg.getData());
-	bool isShape = false;
+	// Peek at the shape's ID in order to work out which local shape it
+	// represents, then update the existing shape in place.  The shape may be
+	// either a standard or a static shape
+	Shape* shape = _space->findShape(NetworkObject::peekObjectId(msg.getData()));
 	
-	// Locate the existing shape and update it
-	for (int i = 0; i < _space->getShapes()->size(); ++i) {
+	if (shape != NULL) {
 		
-		Shape* oldShape = _space->getShapes()->at(i);
+		// Located shape - deserialise into it
+		shape->deserialise(_space, msg.getData());
+	}
+}
+
+void Simulation::handleObjectIdReleaseReceived(const Message& msg) {
+	
+	// Message contains a list of IDs.  Only IDs leased to the sender are
+	// released, so a client cannot free IDs that others are using
+	const unsigned char* data = msg.getData();
+	unsigned int count = msg.getDataLength() / SERIALISED_INT_SIZE;
+	std::vector<unsigned int> objectIds;
+	
+	for (unsigned int i = 0; i < count; ++i) {
+		unsigned int objectId = SerialiseBase::deserialiseInt(data);
+		data += SERIALISED_INT_SIZE;
 		
-		// Found the shape?
-		if (newShape->getObjectId() == oldShape->getObjectId()) {
-			
-			// Located shape - deserialise into it
-			oldShape->deserialise(_space->getBodies(), _space->getStaticBodies(), msg.getData());
-			
-			// Remember that the shape is a standard shape
-			isShape = true;
-		}
+		if (_clientManager->returnObjectId(msg.getAddress(), objectId)) objectIds.push_back(objectId);
 	}
 	
-	// Did we find the shape?
-	if (!isShape) {
+	releaseObjectIds(objectIds);
+}
+
+void Simulation::releaseObjectIds(const std::vector<unsigned int>& objectIds) {
+	for (unsigned int i = 0; i < objectIds.size(); ++i) {
 		
-		// Shape must be a static shape
-		// Locate the existing shape and update it
-		for (int i = 0; i < _space->getStaticShapes()->size(); ++i) {
-			
-			Shape* oldShape = _space->getStaticShapes()->at(i);
-			
-			// Found the shape?
-			if (newShape->getObjectId() == oldShape->getObjectId()) {
-				
-				// Located shape - deserialise into it
-				oldShape->deserialise(_space->getBodies(), _space->getStaticBodies(), msg.getData());
-			}
+		// Keep IDs that objects in the room still use
+		if (_space != NULL) {
+			if (_space->findBody(objectIds[i]) != NULL) continue;
+			if (_space->findShape(objectIds[i]) != NULL) continue;
 		}
+		
+		IDServer::releaseNetworkObjectId(objectIds[i]);
 	}
-	
-	delete newShape;
 }
@@ -2,20 +2,38 @@
 #define _SIMULATION_H_
 
 #include <sys/time.h>
+#include <string>
 
 #include "space.h"
 #include "socketeventhandler.h"
 #include "positionsampler.h"
+#include "tickscheduler.h"
+#include "sessionsettings.h"
+#include "simulationmetrics.h"
 
 #define RESYNC_SECONDS 10
+#define SIMULATION_MAX_CATCH_UP_STEPS 8
 
 namespace WiredMunk {
 
+	class ClientManager;
+
 	class Simulation : public SocketEventHandler {
 	
 	public:
-		Simulation();
-		~Simulation();
+		
+		/**
+		 * Constructor.
+		 * @param clientManager Manager of the clients taking part in the
+		 * simulation.  Updated spaces are distributed to these clients.
+		 */
+		Simulation(ClientManager* clientManager);
+		
+		/**
+		 * Destructor.  Returns the IDs of the objects in the space to the
+		 * IDServer.
+		 */
+		virtual ~Simulation();
 		
 		/**
 		 * Runs a single iteration of the simulation.  Should be called in a
@@ -23,12 +41,55 @@ namespace WiredMunk {
 		 */
 		virtual void run();
 		
+		/**
+		 * Steps the simulation by a single fixed timestep, regardless of how
+		 * much time has passed.  The timestep is divided into the session's
+		 * number of substeps.  Used when replaying journals as fast as
+		 * possible.
+		 */
+		void tick();
+		
+		/**
+		 * Get the number of timesteps the simulation has run for.
+		 * @return The number of timesteps.
+		 */
+		inline unsigned int getTicks() const { return _ticks; };
+		
 		/**
 		 * Get a pointer to the space.
 		 * @return A pointer to the space.
 		 */
 		inline Space* getSpace() { return _space; };
 		
+		/**
+		 * Get the scheduler that paces the simulation.  Its overrun counts
+		 * show how often the simulation has fallen behind real time.
+		 * @return The tick scheduler.
+		 */
+		inline const TickScheduler* getScheduler() const { return &_scheduler; };
+		
+		/**
+		 * Get the simulation's runtime counters.
+		 * @return The metrics.
+		 */
+		inline const SimulationMetrics* getMetrics() const { return &_metrics; };
+		
+		/**
+		 * Record the position and angle of every body to a sample file for
+		 * drift analysis.  The file is opened when the space is created, so
+		 * that it is stamped with the negotiated physics rate and its ticks
+		 * count from the start of the session.
+		 * @param fileName Name of the sample file.
+		 * @param sourceId ID written to the file to identify the simulation.
+		 */
+		void startSampling(const char* fileName, unsigned int sourceId);
+		
+		/**
+		 * Get the position sampler.
+		 * @return The position sampler.
+		 */
+		inline PositionSampler* getSampler() { return &_sampler; };
+		
 		/**
 		 * Listens for incoming notifications about client object updates.
 		 * @param msg Message data.
@@ -52,17 +113,65 @@ namespace WiredMunk {
 		 */
 		void handleBodyReceived(const Message& msg);
 		
+		/**
+		 * Receives object IDs that a client no longer needs, and returns
+		 * those leased to the client to the IDServer (see releaseObjectIds()).
+		 */
+		void handleObjectIdReleaseReceived(const Message& msg);
+		
+		/**
+		 * Return object IDs to the IDServer.  IDs still used by objects in the
+		 * space are kept until the simulation ends, so that a reused ID cannot
+		 * clash with an object that the room still holds.
+		 * @param objectIds The IDs to release.
+		 */
+		void releaseObjectIds(const std::vector<unsigned int>& objectIds);
+	
 	private:
 		Space* _space;
-		struct timeval _lastRunTime;
-		struct timeval _lastSyncTime;
-		PositionSampler* _sampler;
+		ClientManager* _clientManager;
+		TickScheduler _scheduler;
+		unsigned long long _lastSyncTime;
+		PositionSampler _sampler;
+		std::string _sampleFileName;
+		unsigned int _sampleSourceId;
+		unsigned int _ticks;
+		unsigned int _lastSnapshotTick;
+		SessionSettings _settings;
+		SimulationMetrics _metrics;
+		
+		/**
+		 * Adopt the session settings held by the client manager.  Called
+		 * whenever a client joins, as the first client may have changed them.
+		 */
+		void applySettings();
+		
+		/**
+		 * Send a snapshot of the space to all clients if the session's send
+		 * interval has elapsed.
+		 */
+		void sendSnapshot();
 		
 		/**
 		 * Steps the simulation.
 		 */
 		void step();
 		
+		/**
+		 * Update the object counts and spatial hash occupancy in the metrics.
+		 * The hash is only scanned every METRICS_OCCUPANCY_INTERVAL ticks.
+		 */
+		void updateMetrics();
+		
+		/**
+		 * Add the phases of the space's most recent step to the trace.  The
+		 * phases are only timed if chipmunk is built with CP_PROFILE_ENABLED,
+		 * and are laid end to end from the start of the step.
+		 * @param start Time at which the step started, from
+		 * TickScheduler::getTime().
+		 */
+		void traceStepPhases(unsigned long long start);
+		
 		/**
 		 * Sync the simulation with clients if no communication has occurred
 		 * within RESYNC_SECONDS.
@@ -0,0 +1,222 @@
+#ifndef _SIMULATION_METRICS_H_
+#define _SIMULATION_METRICS_H_
+
+#define METRICS_TICK_BUCKETS 11
+#define METRICS_OCCUPANCY_INTERVAL 64
+
+namespace WiredMunk {
+
+	/**
+	 * Runtime counters for a single simulation, read by the MetricsExporter.
+	 * Counters are only ever written by the thread running the simulation,
+	 * and are updated with atomic adds or single stores, so the exporter can
+	 * read them from another thread without locking.  Readers may see a
+	 * tick partially recorded, which is harmless for monitoring.
+	 *
+	 * Tick durations are recorded in a histogram of METRICS_TICK_BUCKETS
+	 * buckets.  The first holds ticks of up to 50us, and the last holds
+	 * everything longer than 50ms.
+	 */
+	class SimulationMetrics {
+	public:
+		
+		/**
+		 * Constructor.
+		 */
+		SimulationMetrics() {
+			for (unsigned int i = 0; i < METRICS_TICK_BUCKETS; ++i) {
+				_tickBuckets[i] = 0;
+			}
+			
+			_ticks = 0;
+			_tickTime = 0;
+			_catchUpSteps = 0;
+			_overruns = 0;
+			_skippedSteps = 0;
+			_bodies = 0;
+			_shapes = 0;
+			_arbiters = 0;
+			_hashCells = 0;
+			_hashObjects = 0;
+			_hashCellsUsed = 0;
+			_isHashInUse = false;
+		};
+		
+		/**
+		 * Record the duration of a tick.
+		 * @param time Duration of the tick in nanoseconds.
+		 */
+		inline void recordTick(unsigned long long time) {
+			unsigned int bucket = 0;
+			
+			while ((bucket < METRICS_TICK_BUCKETS - 1) && (time > getBucketLimit(bucket))) bucket++;
+			
+			__sync_fetch_and_add(&_tickBuckets[bucket], 1);
+			__sync_fetch_and_add(&_tickTime, time);
+			__sync_fetch_and_add(&_ticks, 1);
+		};
+		
+		/**
+		 * Record an update of the simulation's scheduler.
+		 * @param steps Number of steps run by the update.
+		 * @param overruns Total number of scheduler overruns.
+		 * @param skippedSteps Total number of steps discarded by overruns.
+		 */
+		inline void recordUpdate(int steps, unsigned int overruns, unsigned long long skippedSteps) {
+			if (steps > 1) __sync_fetch_and_add(&_catchUpSteps, steps - 1);
+			
+			_overruns = overruns;
+			_skippedSteps = skippedSteps;
+		};
+		
+		/**
+		 * Record the number of objects in the space.
+		 * @param bodies Number of bodies.
+		 * @param shapes Number of shapes.
+		 * @param arbiters Number of active arbiters.
+		 */
+		inline void setObjectCounts(unsigned int bodies, unsigned int shapes, unsigned int arbiters) {
+			_bodies = bodies;
+			_shapes = shapes;
+			_arbiters = arbiters;
+		};
+		
+		/**
+		 * Record the occupancy of the space's active shape hash.
+		 * @param cells Number of cells in the hash.
+		 * @param objects Number of shapes in the hash.
+		 * @param cellsUsed Number of cells that hold at least one shape.
+		 */
+		inline void setHashOccupancy(unsigned int cells, unsigned int objects, unsigned int cellsUsed) {
+			_hashCells = cells;
+			_hashObjects = objects;
+			_hashCellsUsed = cellsUsed;
+			_isHashInUse = true;
+		};
+		
+		/**
+		 * Record that the space does not use the spatial hash broadphase, so
+		 * there is no hash occupancy to report.
+		 */
+		inline void clearHashOccupancy() {
+			_isHashInUse = false;
+			_hashCells = 0;
+			_hashObjects = 0;
+			_hashCellsUsed = 0;
+		};
+		
+		/**
+		 * Get the number of ticks in a duration bucket.
+		 * @param bucket Index of the bucket.
+		 * @return The number of ticks.
+		 */
+		inline unsigned int getTickCount(unsigned int bucket) const { return _tickBuckets[bucket]; };
+		
+		/**
+		 * Get the number of ticks run.
+		 * @return The number of ticks.
+		 */
+		inline unsigned int getTicks() const { return _ticks; };
+		
+		/**
+		 * Get the total time spent running ticks.
+		 * @return The time in nanoseconds.
+		 */
+		inline unsigned long long getTickTime() const { return _tickTime; };
+		
+		/**
+		 * Get the number of steps run to catch up with the clock, ie. every
+		 * step after the first in a single update.
+		 * @return The number of catch-up steps.
+		 */
+		inline unsigned int getCatchUpSteps() const { return _catchUpSteps; };
+		
+		/**
+		 * Get the number of scheduler updates that fell too far behind to
+		 * catch up.
+		 * @return The number of overruns.
+		 */
+		inline unsigned int getOverruns() const { return _overruns; };
+		
+		/**
+		 * Get the number of steps discarded by overruns.
+		 * @return The number of skipped steps.
+		 */
+		inline unsigned long long getSkippedSteps() const { return _skippedSteps; };
+		
+		/**
+		 * Get the number of bodies in the space.
+		 * @return The number of bodies.
+		 */
+		inline unsigned int getBodies() const { return _bodies; };
+		
+		/**
+		 * Get the number of shapes in the space.
+		 * @return The number of shapes.
+		 */
+		inline unsigned int getShapes() const { return _shapes; };
+		
+		/**
+		 * Get the number of active arbiters in the space.
+		 * @return The number of arbiters.
+		 */
+		inline unsigned int getArbiters() const { return _arbiters; };
+		
+		/**
+		 * Get the number of cells in the active shape hash.
+		 * @return The number of cells.
+		 */
+		inline unsigned int getHashCells() const { return _hashCells; };
+		
+		/**
+		 * Check whether the hash occupancy figures are meaningful.
+		 * @return True if the space uses the spatial hash broadphase.
+		 */
+		inline bool isHashInUse() const { return _isHashInUse; };
+		
+		/**
+		 * Get the number of shapes in the active shape hash.
+		 * @return The number of shapes.
+		 */
+		inline unsigned int getHashObjects() const { return _hashObjects; };
+		
+		/**
+		 * Get the number of cells in the active shape hash that hold at least
+		 * one shape.
+		 * @return The number of occupied cells.
+		 */
+		inline unsigned int getHashCellsUsed() const { return _hashCellsUsed; };
+		
+		/**
+		 * Get the longest tick counted by a bucket.
+		 * @param bucket Index of the bucket.
+		 * @return The duration in nanoseconds, or 0 for the last bucket,
+		 * which has no limit.
+		 */
+		static inline unsigned long long getBucketLimit(unsigned int bucket) {
+			static const unsigned long long limits[METRICS_TICK_BUCKETS - 1] = {
+				50000ULL, 100000ULL, 250000ULL, 500000ULL, 1000000ULL,
+				2500000ULL, 5000000ULL, 10000000ULL, 25000000ULL, 50000000ULL
+			};
+			
+			return (bucket < METRICS_TICK_BUCKETS - 1 ? limits[bucket] : 0);
+		};
+	
+	private:
+		volatile unsigned int _tickBuckets[METRICS_TICK_BUCKETS];	/**< Ticks by duration */
+		volatile unsigned int _ticks;					/**< Number of ticks */
+		volatile unsigned long long _tickTime;			/**< Total tick time in nanoseconds */
+		volatile unsigned int _catchUpSteps;			/**< Steps run to catch up */
+		volatile unsigned int _overruns;				/**< Scheduler overruns */
+		volatile unsigned long long _skippedSteps;		/**< Steps discarded by overruns */
+		volatile unsigned int _bodies;					/**< Bodies in the space */
+		volatile unsigned int _shapes;					/**< Shapes in the space */
+		volatile unsigned int _arbiters;				/**< Active arbiters */
+		volatile unsigned int _hashCells;				/**< Cells in the active hash */
+		volatile unsigned int _hashObjects;				/**< Shapes in the active hash */
+		volatile unsigned int _hashCellsUsed;			/**< Occupied cells in the active hash */
+		volatile bool _isHashInUse;						/**< Does the space use the spatial hash? */
+	};
+}
+
+#endif
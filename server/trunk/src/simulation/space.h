@@ -6,6 +6,7 @@
 #include <vector>
 #include "chipmunk.h"
 #include "networkobject.h"
+#include "objectindex.h"
 
 namespace WiredMunk {
 
@@ -125,6 +126,14 @@ namespace WiredMunk {
 		 */
 		inline int getTimeStamp() const { return _space->stamp; };
 		
+		/**
+		 * Get the timings and counters recorded during the most recent step.
+		 * Only filled in if Chipmunk was built with CP_PROFILE_ENABLED
+		 * defined; otherwise all values are zero.
+		 * @return The step statistics.
+		 */
+		inline const cpSpaceStepStats& getStepStats() const { return _space->stats; };
+		
 		/**
 		 * Get the list of shapes.
 		 * @return The list of shapes.
@@ -154,6 +163,20 @@ namespace WiredMunk {
 		 * @return The list of joints.
 		 */
 		inline JointVector* getJoints() { return &_jointList; };
+		
+		/**
+		 * Find a body or static body by its object ID.
+		 * @param objectId The ID of the body.
+		 * @return The body, or NULL if the space does not contain the body.
+		 */
+		inline Body* findBody(unsigned int objectId) const { return _bodyIndex.find(objectId); };
+		
+		/**
+		 * Find a shape or static shape by its object ID.
+		 * @param objectId The ID of the shape.
+		 * @return The shape, or NULL if the space does not contain the shape.
+		 */
+		inline Shape* findShape(unsigned int objectId) const { return _shapeIndex.find(objectId); };
 
 		/**
 		 * Get the Chipmunk space.
@@ -274,6 +297,26 @@ namespace WiredMunk {
 		ShapeVector _staticShapeList;			/**< List of all static shapes in the space */
 		ShapeVector _shapeList;					/**< List of all shapes in the space */
 		JointVector _jointList;					/**< List of all joints in the space */
+		
+		ObjectIndex<Body> _bodyIndex;			/**< All bodies and static bodies, indexed by ID */
+		ObjectIndex<Shape> _shapeIndex;			/**< All shapes and static shapes, indexed by ID */
+		
+		/**
+		 * Make way for a newly replicated body.  If an older generation of
+		 * the body's ID holds its slot, the old body has been despawned by
+		 * its owner, so it is removed from the space and deleted along with
+		 * its shapes.
+		 * @param objectId The ID of the new body.
+		 */
+		void evictStaleBody(unsigned int objectId);
+		
+		/**
+		 * Make way for a newly replicated shape.  If an older generation of
+		 * the shape's ID holds its slot, the old shape is removed from the
+		 * space and deleted.
+		 * @param objectId The ID of the new shape.
+		 */
+		void evictStaleShape(unsigned int objectId);
 	};
 }
 
@@ -0,0 +1,80 @@
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#include "tickscheduler.h"
+
+using namespace WiredMunk;
+
+TickScheduler::Clock TickScheduler::_clock = NULL;
+
+TickScheduler::TickScheduler(double rate, int maxSteps) {
+	_maxSteps = maxSteps;
+	_overrunCount = 0;
+	_skippedSteps = 0;
+	
+	setRate(rate);
+}
+
+int TickScheduler::update() {
+	unsigned long long now = getTime();
+	
+	_accumulator += now - _lastTime;
+	_lastTime = now;
+	
+	unsigned long long steps = _accumulator / _stepLength;
+	
+	if (steps > (unsigned long long)_maxSteps) {
+		
+		// Too far behind to catch up; run as many steps as allowed and drop
+		// the rest of the backlog, keeping only the partial step
+		_overrunCount++;
+		_skippedSteps += steps - _maxSteps;
+		_accumulator %= _stepLength;
+		
+		return _maxSteps;
+	}
+	
+	_accumulator -= steps * _stepLength;
+	
+	return (int)steps;
+}
+
+void TickScheduler::setRate(double rate) {
+	_timestep = 1.0 / rate;
+	_stepLength = (unsigned long long)(1000000000.0 / rate);
+	
+	reset();
+}
+
+void TickScheduler::reset() {
+	_lastTime = getTime();
+	_accumulator = 0;
+}
+
+unsigned long long TickScheduler::getTime() {
+
+	if (_clock != NULL) return _clock();
+
+#ifdef __APPLE__
+
+	// Mac OS X has no CLOCK_MONOTONIC; mach_absolute_time() is the monotonic
+	// equivalent, measured in units that must be converted to nanoseconds
+	static mach_timebase_info_data_t timebase = { 0, 0 };
+	
+	if (timebase.denom == 0) mach_timebase_info(&timebase);
+	
+	return mach_absolute_time() * timebase.numer / timebase.denom;
+
+#else
+
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	
+	return ((unsigned long long)time.tv_sec * 1000000000ULL) + time.tv_nsec;
+
+#endif
+
+}
@@ -1,9 +1,21 @@
 #include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
 #include "socket.h"
-#include "debug.h"
+#include "log.h"
+#include "tracer.h"
 
 using namespace WiredMunk;
 
+Socket::Socket() {
+	_socket = -1;
+	_network = NULL;
+	_loopbackPort = 0;
+	
+	pthread_rwlock_init(&_clientStatsLock, NULL);
+}
+
 bool Socket::open(const int portNum) {
 	
 	// Uses code from http://beej.us/guide/bgnet/output/html/multipage/clientserver.html#datagram
@@ -36,23 +48,40 @@ bool Socket::open(const int portNum) {
     return true;
 }
 
+bool Socket::open(LoopbackNetwork* network, const int portNum) {
+	_loopbackPort = network->bind(portNum);
+	
+	if (_loopbackPort == 0) {
+		LOG_ERROR("Error binding socket: loopback port %d in use\n", portNum);
+		return false;
+	}
+	
+	_network = network;
+	
+	return true;
+}
+
 Socket::~Socket() {
 	shut();
+	
+	pthread_rwlock_destroy(&_clientStatsLock);
 }
 
 int Socket::poll() const {
 
-	unsigned char* buffer;
+	unsigned char buffer[MESSAGE_BUFFER_LENGTH];
 	int receivedBytes;
 	struct sockaddr_in remoteAddress;
 	socklen_t addressLen;
 	
-	buffer = new unsigned char[MESSAGE_BUFFER_LENGTH];
-	
 	addressLen = sizeof(remoteAddress);
 	
 	// Poll socket for data
-	receivedBytes = recvfrom(_socket, buffer, MESSAGE_BUFFER_LENGTH - 1 , 0, (struct sockaddr *)&remoteAddress, &addressLen);
+	if (_network != NULL) {
+		receivedBytes = _network->receive(_loopbackPort, buffer, MESSAGE_BUFFER_LENGTH - 1, &remoteAddress);
+	} else {
+		receivedBytes = recvfrom(_socket, buffer, MESSAGE_BUFFER_LENGTH - 1 , 0, (struct sockaddr *)&remoteAddress, &addressLen);
+	}
 	
 	// Ensure buffer terminates correctly
 	buffer[MESSAGE_BUFFER_LENGTH - 1] = '\0';
@@ -61,12 +90,10 @@ int Socket::poll() const {
 	switch (receivedBytes) {
 		case -1:
 			// No data received
-			delete buffer;
 			return 0;
 		case 0:
 			// Socket closed
 			// TODO: Handle this gracefully instead of ignoring it
-			delete buffer;
 			return 0;
 		default:
 			// Data received
@@ -75,24 +102,32 @@ int Socket::poll() const {
 			if (strncmp(MESSAGE_HEADER, (char*)buffer, 4) != 0) {
 				
 				// Not a valid message - discard it
-				delete buffer;
 				return 0;
 			}
 			
-			// Valid message received
-			Debug::printf("Received incoming message\n");
+			// Valid message received.  Polls that receive nothing are not
+			// traced, as the server polls continuously
+			TRACE_SCOPE("Socket::poll");
+			
+			LOG_DEBUG("Received incoming message\n");
+			
+			recordTraffic(TrafficStats::DIRECTION_IN, &remoteAddress, buffer[4], receivedBytes, true);
 			
 			// Notify listeners of incoming data
 			raiseMessageReceivedEvent(&remoteAddress, buffer, receivedBytes);
 			
-			// Clean up
-			delete buffer;
-			
 			return receivedBytes;
     }
 }
 
 bool Socket::write(const unsigned char* data, unsigned int length, const struct sockaddr_in* address) const {
+
+	// Messages sent whilst the socket is closed (eg. during journal replay)
+	// are silently dropped
+	if (!isOpen()) return false;
+	
+	if (_network != NULL) return _network->send(_loopbackPort, address, data, length);
+	
 	int sentBytes = sendto(_socket, data, length, 0, (struct sockaddr*)address, sizeof(struct sockaddr_in));
 	
 	if (sentBytes == -1) {
@@ -104,8 +139,18 @@ bool Socket::write(const unsigned char* data, unsigned int length, const struct
 }
 
 void Socket::shut() {
+	if (_network != NULL) {
+		_network->unbind(_loopbackPort);
+		_network = NULL;
+		_loopbackPort = 0;
+	}
+	
+	if (_socket < 0) return;
+	
 	shutdown(_socket, 2);
 	close(_socket);
+	
+	_socket = -1;
 }
 
 void Socket::addSocketEventHandler(SocketEventHandler* handler) {
@@ -121,10 +166,28 @@ void Socket::removeSocketEventHandler(SocketEventHandler* handler) {
 	}
 }
 
+bool Socket::isCompleteMessage(const unsigned char* data, int receivedBytes) {
+	if (receivedBytes < MESSAGE_HEADER_LENGTH) return false;
+	
+	unsigned short dataLength = (data[5] << 8) | data[6];		// 2 byte length
+	
+	return MESSAGE_HEADER_LENGTH + dataLength <= receivedBytes;
+}
+
 void Socket::raiseMessageReceivedEvent(const struct sockaddr_in* address, unsigned char* data, int receivedBytes) const {
 	
-	// Construct a message
-	Message msg(data, address);
+	// Messages refer to the receive buffer, so a datagram shorter than its
+	// header claims would have handlers read past the received data
+	if (!isCompleteMessage(data, receivedBytes)) return;
+	
+	// Construct a message that refers to the receive buffer rather than
+	// copying it, as the message does not outlive this call
+	Message msg(data, address, false);
+	
+	dispatchMessage(msg);
+}
+
+void Socket::dispatchMessage(const Message& msg) const {
 	
 	// Notify all handlers of the event
 	for (unsigned int i = 0; i < _eventHandlers.size(); ++i) {
@@ -132,12 +195,50 @@ void Socket::raiseMessageReceivedEvent(const struct sockaddr_in* address, unsign
 	}
 }
 
-void Socket::sendMessage(const Message* msg) const {
+bool Socket::sendMessage(const Message* msg) const {
 	
 	int msgLength = msg->getFormattedMessageLength();
 	unsigned char msgData[msgLength];
 	
 	msg->getFormattedMessage(msgData);
 	
-	write(msgData, msgLength, msg->getAddress());
+	// Messages dropped because the socket is closed are not failures
+	if (!isOpen()) return false;
+	
+	bool sent = write(msgData, msgLength, msg->getAddress());
+	
+	recordTraffic(TrafficStats::DIRECTION_OUT, msg->getAddress(), msg->getType(), msgLength, sent);
+	
+	return sent;
+}
+
+void Socket::addClientStats(const struct sockaddr_in* address, TrafficStats* stats) {
+	pthread_rwlock_wrlock(&_clientStatsLock);
+	_clientStats.add(address, stats);
+	pthread_rwlock_unlock(&_clientStatsLock);
+}
+
+void Socket::removeClientStats(const struct sockaddr_in* address) {
+	pthread_rwlock_wrlock(&_clientStatsLock);
+	_clientStats.remove(AddressTable<TrafficStats*>::getKey(address));
+	pthread_rwlock_unlock(&_clientStatsLock);
+}
+
+void Socket::recordTraffic(TrafficStats::Direction direction, const struct sockaddr_in* address, unsigned int type, unsigned int bytes, bool sent) const {
+
+	// Counters are atomic, so only the lookup needs the lock; any number of
+	// rooms can record traffic at once
+	pthread_rwlock_rdlock(&_clientStatsLock);
+	
+	TrafficStats* const* clientStats = _clientStats.find(address);
+	
+	if (sent) {
+		_stats.record(direction, type, bytes);
+		if (clientStats != NULL) (*clientStats)->record(direction, type, bytes);
+	} else {
+		_stats.recordSendFailure(type);
+		if (clientStats != NULL) (*clientStats)->recordSendFailure(type);
+	}
+	
+	pthread_rwlock_unlock(&_clientStatsLock);
 }
@@ -7,9 +7,13 @@
 #include <netdb.h>
 #include <stdio.h>
 #include <vector>
+#include <pthread.h>
 #include "socketeventhandler.h"
 #include "socketeventargs.h"
 #include "message.h"
+#include "trafficstats.h"
+#include "addresstable.h"
+#include "loopbacknetwork.h"
 
 #define MESSAGE_BUFFER_LENGTH 16384
 
@@ -18,7 +22,12 @@ namespace WiredMunk {
 	/**
 	 * Represents a socket that can be opened to listen for incoming messages.
 	 * Socket is bidirectional and can send messages as well as receive them.
-	 * Uses UDP datagrams for communication.  All calls are non-blocking.
+	 * Uses UDP datagrams for communication, or an in-process LoopbackNetwork
+	 * if opened on one.  All calls are non-blocking.
+	 *
+	 * The socket counts all traffic that passes through it.  Traffic to and
+	 * from addresses registered with addClientStats() is also counted
+	 * against that client.
 	 */
 	class Socket {
 	public:
@@ -26,7 +35,7 @@ namespace WiredMunk {
 		/**
 		 * Constructor.
 		 */
-		inline Socket() { };
+		Socket();
 		
 		/**
 		 * Open a connection.
@@ -35,6 +44,21 @@ namespace WiredMunk {
 		 */
 		bool open(const int portNum);
 		
+		/**
+		 * Open the socket on a loopback network instead of UDP.
+		 * @param network The network to open the socket on.
+		 * @param portNum Port number to bind, or 0 for any free port.
+		 * @return True if the socket opened successfully.
+		 */
+		bool open(LoopbackNetwork* network, const int portNum);
+		
+		/**
+		 * Get the port that the socket is bound to on its loopback network.
+		 * @return The port, or 0 if the socket is not open on a loopback
+		 * network.
+		 */
+		inline unsigned short getLoopbackPort() const { return _loopbackPort; };
+		
 		/**
 		 * Check for incoming data from socket.  Raises a message received event
 		 * if any messages are found.
@@ -67,12 +91,64 @@ namespace WiredMunk {
 		/**
 		 * Sends the message.
 		 * @param msg Message to send.
+		 * @return True if the message was sent; false if not.
+		 */
+		bool sendMessage(const Message* msg) const;
+		
+		/**
+		 * Notify all event handlers of a message as though it had been
+		 * received by the socket.  Used to replay recorded messages without
+		 * opening the socket.
+		 * @param msg Message to distribute.
+		 */
+		void dispatchMessage(const Message& msg) const;
+		
+		/**
+		 * Start counting traffic to and from an address against a client.
+		 * @param address The client's address.
+		 * @param stats The client's statistics.  Must remain valid until
+		 * removed with removeClientStats().
+		 */
+		void addClientStats(const struct sockaddr_in* address, TrafficStats* stats);
+		
+		/**
+		 * Stop counting traffic against a client.
+		 * @param address The client's address.
 		 */
-		void sendMessage(const Message* msg) const;
+		void removeClientStats(const struct sockaddr_in* address);
+		
+		/**
+		 * Get the statistics for all traffic through the socket.
+		 * @return The socket's traffic statistics.
+		 */
+		inline const TrafficStats* getStats() const { return &_stats; };
 		
 	private:
 		int _socket;										/**< File descriptor of socket */
+		LoopbackNetwork* _network;							/**< Loopback network the socket is open on, or NULL */
+		unsigned short _loopbackPort;						/**< Port bound on the loopback network */
 		std::vector<SocketEventHandler*> _eventHandlers;	/**< List of event handlers */
+		mutable TrafficStats _stats;						/**< Statistics for all traffic */
+		AddressTable<TrafficStats*> _clientStats;			/**< Statistics by client address */
+		mutable pthread_rwlock_t _clientStatsLock;			/**< Guards the client statistics table */
+		
+		/**
+		 * Check whether the socket is open, either on UDP or a loopback
+		 * network.
+		 * @return True if the socket is open.
+		 */
+		inline bool isOpen() const { return (_socket >= 0) || (_network != NULL); };
+		
+		/**
+		 * Record a packet against the socket and, if the address belongs to
+		 * a registered client, against the client.
+		 * @param direction Direction of the packet.
+		 * @param address The remote address.
+		 * @param type Message type of the packet.
+		 * @param bytes Size of the packet in bytes.
+		 * @param sent False if the packet could not be sent.
+		 */
+		void recordTraffic(TrafficStats::Direction direction, const struct sockaddr_in* address, unsigned int type, unsigned int bytes, bool sent) const;
 		
 		/**
 		 * Write data to the socket.
@@ -90,6 +166,15 @@ namespace WiredMunk {
 		 * @param receivedBytes Number of bytes received.
 		 */
 		void raiseMessageReceivedEvent(const struct sockaddr_in* address, unsigned char* data, int receivedBytes) const;
+		
+		/**
+		 * Check that a received datagram holds the whole message its header
+		 * describes.
+		 * @param data Data received in message.
+		 * @param receivedBytes Number of bytes received.
+		 * @return True if the header and all of its data were received.
+		 */
+		static bool isCompleteMessage(const unsigned char* data, int receivedBytes);
 	};
 }
 
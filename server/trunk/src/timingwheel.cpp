@@ -0,0 +1,56 @@
+#include "timingwheel.h"
+
+using namespace WiredMunk;
+
+TimingWheel::TimingWheel(unsigned int slotCount, unsigned int resolution, unsigned long long now) {
+	_slots.resize(slotCount);
+	_resolution = resolution;
+	_currentTick = now / resolution;
+	_count = 0;
+}
+
+void TimingWheel::schedule(unsigned long long key, unsigned long long deadline) {
+
+	// Round up so that keys never expire before their deadline
+	Entry entry;
+	entry.key = key;
+	entry.tick = (deadline + _resolution - 1) / _resolution;
+	
+	// Deadlines that have already passed expire on the next advance
+	if (entry.tick < _currentTick) entry.tick = _currentTick;
+	
+	_slots[entry.tick % _slots.size()].push_back(entry);
+	_count++;
+}
+
+void TimingWheel::advance(unsigned long long now, std::vector<unsigned long long>& expired) {
+
+	unsigned long long targetTick = now / _resolution;
+	
+	if (targetTick < _currentTick) return;
+	
+	// Process every tick up to and including the current one.  Only one turn
+	// of the wheel needs visiting, no matter how long it has been since the
+	// last advance
+	if (targetTick - _currentTick >= _slots.size()) _currentTick = targetTick - _slots.size() + 1;
+	
+	while (_currentTick <= targetTick) {
+		std::vector<Entry>& slot = _slots[_currentTick % _slots.size()];
+		
+		// Remove expired keys, keeping those due on a later turn
+		unsigned int kept = 0;
+		
+		for (unsigned int i = 0; i < slot.size(); ++i) {
+			if (slot[i].tick <= targetTick) {
+				expired.push_back(slot[i].key);
+				_count--;
+			} else {
+				slot[kept++] = slot[i];
+			}
+		}
+		
+		slot.resize(kept);
+		
+		_currentTick++;
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef _TIMING_WHEEL_H_
+#define _TIMING_WHEEL_H_
+
+#include <vector>
+
+namespace WiredMunk {
+
+	/**
+	 * Schedules timeouts for a large number of keys.  Time is divided into
+	 * ticks of a fixed resolution, and the wheel has one slot per tick,
+	 * wrapping around.  Scheduling a key appends it to the slot for its
+	 * deadline, and advancing the wheel visits only the slots for the ticks
+	 * that have passed, so the cost of both is independent of the number of
+	 * keys scheduled.  Deadlines further away than a full turn of the wheel
+	 * stay in their slot until the wheel comes round to them again.
+	 *
+	 * Keys are never cancelled.  Owners should check whether a key that
+	 * expires is still of interest, and ignore it if not.
+	 */
+	class TimingWheel {
+	public:
+		
+		/**
+		 * Constructor.
+		 * @param slotCount Number of slots in the wheel.
+		 * @param resolution Length of each tick, in milliseconds.
+		 * @param now The current time in milliseconds.
+		 */
+		TimingWheel(unsigned int slotCount, unsigned int resolution, unsigned long long now);
+		
+		/**
+		 * Schedule a key to expire.  Keys expire within one tick after
+		 * their deadline.
+		 * @param key The key.
+		 * @param deadline Time at which the key expires, in milliseconds.
+		 */
+		void schedule(unsigned long long key, unsigned long long deadline);
+		
+		/**
+		 * Advance the wheel to the current time, collecting all keys whose
+		 * deadlines have passed.
+		 * @param now The current time in milliseconds.
+		 * @param expired Vector to append expired keys to.
+		 */
+		void advance(unsigned long long now, std::vector<unsigned long long>& expired);
+		
+		/**
+		 * Get the number of keys scheduled.
+		 * @return The number of keys scheduled.
+		 */
+		inline int getCount() const { return _count; };
+	
+	private:
+		
+		/**
+		 * A scheduled key.
+		 */
+		struct Entry {
+			unsigned long long key;			/**< The key */
+			unsigned long long tick;		/**< Tick at which the key expires */
+		};
+		
+		std::vector<std::vector<Entry> > _slots;	/**< Keys, by tick modulo slot count */
+		unsigned long long _currentTick;			/**< First tick not yet processed */
+		unsigned int _resolution;					/**< Length of a tick in milliseconds */
+		int _count;									/**< Number of keys scheduled */
+	};
+}
+
+#endif
@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tracer.h"
+#include "tickscheduler.h"
+#include "log.h"
+
+using namespace WiredMunk;
+
+volatile bool Tracer::_isEnabled = false;
+volatile bool Tracer::_isRunning = false;
+Tracer::Buffer* Tracer::_buffers = NULL;
+unsigned int Tracer::_nextThreadId = 1;
+pthread_mutex_t Tracer::_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t Tracer::_bufferKey;
+pthread_once_t Tracer::_once = PTHREAD_ONCE_INIT;
+pthread_t Tracer::_thread;
+FILE* Tracer::_file = NULL;
+bool Tracer::_isFirstEvent = true;
+unsigned long long Tracer::_stopTime = 0;
+
+bool Tracer::start(const char* fileName, unsigned int durationMs) {
+
+	pthread_once(&_once, init);
+	
+	// Finish any earlier trace, including one that stopped itself
+	stop();
+	
+	pthread_mutex_lock(&_mutex);
+	
+	_file = fopen(fileName, "w");
+	
+	if (_file == NULL) {
+		pthread_mutex_unlock(&_mutex);
+		perror("Error opening trace file");
+		return false;
+	}
+	
+	fprintf(_file, "{\"traceEvents\":[");
+	_isFirstEvent = true;
+	
+	// Discard events left over from an earlier trace, and name every known
+	// thread again in the new one
+	for (Buffer* buffer = _buffers; buffer != NULL; buffer = buffer->next) {
+		buffer->tail = buffer->head;
+		buffer->dropped = 0;
+		buffer->isNameWritten = false;
+	}
+	
+	_stopTime = (durationMs > 0 ? TickScheduler::getTime() + (unsigned long long)durationMs * 1000000ULL : 0);
+	
+	pthread_mutex_unlock(&_mutex);
+	
+	_isRunning = true;
+	
+	if (pthread_create(&_thread, NULL, threadMain, NULL) != 0) {
+		perror("Error starting trace writer");
+		_isRunning = false;
+		
+		pthread_mutex_lock(&_mutex);
+		finish();
+		pthread_mutex_unlock(&_mutex);
+		return false;
+	}
+	
+	_isEnabled = true;
+	
+	LOG_INFO("Tracing to %s\n", fileName);
+	
+	return true;
+}
+
+void Tracer::stop() {
+
+	if (!_isRunning) return;
+	
+	_isRunning = false;
+	pthread_join(_thread, NULL);
+	
+	pthread_mutex_lock(&_mutex);
+	finish();
+	pthread_mutex_unlock(&_mutex);
+}
+
+void Tracer::setThreadName(const char* name) {
+
+	pthread_once(&_once, init);
+	
+	Buffer* buffer = getBuffer();
+	
+	strncpy(buffer->threadName, name, TRACE_THREAD_NAME_LENGTH - 1);
+	buffer->threadName[TRACE_THREAD_NAME_LENGTH - 1] = '\0';
+	
+	// Publish the name only once it has been written
+	__sync_synchronize();
+	buffer->isNamed = true;
+}
+
+void Tracer::begin(const char* name) {
+	record(name, 'B', TickScheduler::getTime(), 0);
+}
+
+void Tracer::end(const char* name) {
+	record(name, 'E', TickScheduler::getTime(), 0);
+}
+
+void Tracer::complete(const char* name, unsigned long long start, unsigned long long duration) {
+	record(name, 'X', start, duration);
+}
+
+void Tracer::init() {
+	pthread_key_create(&_bufferKey, releaseBuffer);
+	
+	atexit(stop);
+}
+
+Tracer::Buffer* Tracer::getBuffer() {
+	Buffer* buffer = (Buffer*)pthread_getspecific(_bufferKey);
+	
+	if (buffer != NULL) return buffer;
+	
+	buffer = new Buffer();
+	buffer->events = NULL;
+	buffer->head = 0;
+	buffer->tail = 0;
+	buffer->dropped = 0;
+	buffer->isOrphaned = false;
+	buffer->threadName[0] = '\0';
+	buffer->isNamed = false;
+	buffer->isNameWritten = false;
+	
+	pthread_setspecific(_bufferKey, buffer);
+	
+	pthread_mutex_lock(&_mutex);
+	buffer->threadId = _nextThreadId++;
+	buffer->next = _buffers;
+	_buffers = buffer;
+	pthread_mutex_unlock(&_mutex);
+	
+	return buffer;
+}
+
+void Tracer::record(const char* name, char phase, unsigned long long time, unsigned long long duration) {
+
+	pthread_once(&_once, init);
+	
+	Buffer* buffer = getBuffer();
+	
+	// Threads that are never traced do not pay for a ring
+	if (buffer->events == NULL) buffer->events = new Event[TRACE_BUFFER_EVENTS];
+	
+	unsigned int head = buffer->head;
+	
+	// Drop the event rather than wait for the writer thread
+	if (head - buffer->tail >= TRACE_BUFFER_EVENTS) {
+		__sync_fetch_and_add(&buffer->dropped, 1);
+		return;
+	}
+	
+	Event* event = &buffer->events[head % TRACE_BUFFER_EVENTS];
+	event->name = name;
+	event->phase = phase;
+	event->time = time;
+	event->duration = duration;
+	
+	// Publish the event only once it has been written
+	__sync_synchronize();
+	buffer->head = head + 1;
+}
+
+void Tracer::drain() {
+
+	if (_file == NULL) return;
+	
+	int pid = (int)getpid();
+	
+	for (Buffer* buffer = _buffers; buffer != NULL; buffer = buffer->next) {
+		
+		if ((buffer->isNamed) && (!buffer->isNameWritten)) {
+			
+			// Ensure the name is read after the flag that published it
+			__sync_synchronize();
+			
+			fprintf(_file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", _isFirstEvent ? "" : ",", pid, buffer->threadId, buffer->threadName);
+			_isFirstEvent = false;
+			buffer->isNameWritten = true;
+		}
+		
+		unsigned int head = buffer->head;
+		
+		// Ensure the events are read after the head that published them
+		__sync_synchronize();
+		
+		while (buffer->tail != head) {
+			const Event* event = &buffer->events[buffer->tail % TRACE_BUFFER_EVENTS];
+			
+			// Timestamps are in microseconds
+			fprintf(_file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%u", _isFirstEvent ? "" : ",", event->name, event->phase, event->time / 1000, event->time % 1000, pid, buffer->threadId);
+			
+			if (event->phase == 'X') fprintf(_file, ",\"dur\":%llu.%03llu", event->duration / 1000, event->duration % 1000);
+			
+			fputc('}', _file);
+			_isFirstEvent = false;
+			
+			// Release the slot only once it has been read
+			__sync_synchronize();
+			buffer->tail++;
+		}
+	}
+	
+	// Discard the buffers of threads that have exited
+	Buffer** link = &_buffers;
+	
+	while (*link != NULL) {
+		Buffer* buffer = *link;
+		
+		if ((buffer->isOrphaned) && (buffer->tail == buffer->head)) {
+			*link = buffer->next;
+			delete[] buffer->events;
+			delete buffer;
+		} else {
+			link = &buffer->next;
+		}
+	}
+	
+	fflush(_file);
+}
+
+void Tracer::finish() {
+
+	if (_file == NULL) return;
+	
+	_isEnabled = false;
+	
+	drain();
+	
+	fprintf(_file, "\n]}\n");
+	fclose(_file);
+	_file = NULL;
+	
+	unsigned int dropped = 0;
+	
+	for (Buffer* buffer = _buffers; buffer != NULL; buffer = buffer->next) {
+		dropped += __sync_fetch_and_and(&buffer->dropped, 0);
+	}
+	
+	if (dropped > 0) LOG_WARNING("Trace dropped %u events\n", dropped);
+	
+	LOG_INFO("Trace complete\n");
+}
+
+void Tracer::releaseBuffer(void* buffer) {
+	((Buffer*)buffer)->isOrphaned = true;
+}
+
+void* Tracer::threadMain(void* arg) {
+	while (_isRunning) {
+		pthread_mutex_lock(&_mutex);
+		
+		drain();
+		
+		// Close the file as soon as the capture window ends, so that it is
+		// complete even if the process is never stopped
+		if ((_stopTime > 0) && (TickScheduler::getTime() >= _stopTime)) finish();
+		
+		bool isFinished = (_file == NULL);
+		
+		pthread_mutex_unlock(&_mutex);
+		
+		if (isFinished) break;
+		
+		usleep(TRACE_FLUSH_INTERVAL_US);
+	}
+	
+	return NULL;
+}
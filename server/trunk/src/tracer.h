@@ -0,0 +1,214 @@
+#ifndef _TRACER_H_
+#define _TRACER_H_
+
+#include <stdio.h>
+#include <pthread.h>
+
+#ifndef TRACE_COMPILED
+#define TRACE_COMPILED 1
+#endif
+
+#define TRACE_BUFFER_EVENTS 65536
+#define TRACE_FLUSH_INTERVAL_US 50000
+#define TRACE_THREAD_NAME_LENGTH 32
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+/**
+ * Trace the enclosing scope.  Records a begin event now and an end event
+ * when the scope exits.  Compiles to nothing if TRACE_COMPILED is 0.
+ * @param name Name of the event; must be a string literal.
+ */
+#if TRACE_COMPILED
+#define TRACE_SCOPE(name) WiredMunk::TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) do { } while (0)
+#endif
+
+namespace WiredMunk {
+
+	/**
+	 * Records timed events and writes them to a file in the Chrome trace
+	 * event format, which can be loaded into chrome://tracing or Perfetto.
+	 * Tracing is off until start() is called, and costs a single flag test
+	 * per scope whilst it is off.
+	 *
+	 * Events are written into a lock-free ring buffer owned by the calling
+	 * thread, and a background thread converts them to JSON and writes them
+	 * to disk, so tracing does not perform any I/O on the traced threads.
+	 * Each thread's events are given the thread's own ID in the trace.  If a
+	 * thread's ring buffer is full, events are dropped rather than blocking
+	 * the thread, and the number dropped is reported when tracing stops.
+	 *
+	 * Only one trace can be captured at a time.
+	 */
+	class Tracer {
+	public:
+		
+		/**
+		 * Start capturing a trace.
+		 * @param fileName Name of the trace file.  Any existing file is
+		 * overwritten.
+		 * @param durationMs Length of the capture in milliseconds, after
+		 * which tracing stops automatically, or 0 to trace until stop() is
+		 * called.
+		 * @return True if the trace was started successfully.
+		 */
+		static bool start(const char* fileName, unsigned int durationMs = 0);
+		
+		/**
+		 * Stop capturing, write any outstanding events and close the file.
+		 */
+		static void stop();
+		
+		/**
+		 * Check if a trace is being captured.
+		 * @return True if tracing is enabled.
+		 */
+		static inline bool isEnabled() { return _isEnabled; };
+		
+		/**
+		 * Name the calling thread in the trace.
+		 * @param name Name of the thread.
+		 */
+		static void setThreadName(const char* name);
+		
+		/**
+		 * Record the start of an event on the calling thread.
+		 * @param name Name of the event; must be a string literal.
+		 */
+		static void begin(const char* name);
+		
+		/**
+		 * Record the end of an event on the calling thread.
+		 * @param name Name of the event; must be a string literal.
+		 */
+		static void end(const char* name);
+		
+		/**
+		 * Record an event that has already finished.
+		 * @param name Name of the event; must be a string literal.
+		 * @param start Start time of the event, from TickScheduler::getTime().
+		 * @param duration Duration of the event in nanoseconds.
+		 */
+		static void complete(const char* name, unsigned long long start, unsigned long long duration);
+	
+	private:
+		
+		/**
+		 * A single event.
+		 */
+		struct Event {
+			const char* name;					/**< Name of the event */
+			unsigned long long time;			/**< Time of the event in nanoseconds */
+			unsigned long long duration;		/**< Duration of complete events */
+			char phase;							/**< Chrome event phase: B, E or X */
+		};
+		
+		/**
+		 * Ring buffer of events recorded by a single thread.
+		 */
+		struct Buffer {
+			Event* events;						/**< Ring of events */
+			volatile unsigned int head;			/**< Next slot to write; owned by the traced thread */
+			volatile unsigned int tail;			/**< Next slot to read; owned by the writer */
+			volatile unsigned int dropped;		/**< Events dropped because the ring was full */
+			volatile bool isOrphaned;			/**< Has the traced thread exited? */
+			unsigned int threadId;				/**< ID of the thread in the trace */
+			char threadName[TRACE_THREAD_NAME_LENGTH];	/**< Name of the thread */
+			volatile bool isNamed;				/**< Has the thread been named? */
+			bool isNameWritten;					/**< Has the name been written to the trace? */
+			Buffer* next;						/**< Next buffer in the list */
+		};
+		
+		static volatile bool _isEnabled;		/**< Is a trace being captured? */
+		static volatile bool _isRunning;		/**< Is the writer thread running? */
+		static Buffer* _buffers;				/**< Buffers of all traced threads */
+		static unsigned int _nextThreadId;		/**< ID of the next traced thread */
+		static pthread_mutex_t _mutex;			/**< Guards the buffer list and the file */
+		static pthread_key_t _bufferKey;		/**< Each thread's buffer */
+		static pthread_once_t _once;			/**< Creates the thread key */
+		static pthread_t _thread;				/**< Writer thread */
+		static FILE* _file;						/**< Trace file */
+		static bool _isFirstEvent;				/**< Has no event been written yet? */
+		static unsigned long long _stopTime;	/**< Time to stop automatically, or 0 */
+		
+		/**
+		 * Create the thread key.
+		 */
+		static void init();
+		
+		/**
+		 * Get the calling thread's buffer, creating it if necessary.
+		 * @return The buffer.
+		 */
+		static Buffer* getBuffer();
+		
+		/**
+		 * Add an event to the calling thread's buffer.
+		 * @param name Name of the event.
+		 * @param phase Chrome event phase.
+		 * @param time Time of the event.
+		 * @param duration Duration of complete events.
+		 */
+		static void record(const char* name, char phase, unsigned long long time, unsigned long long duration);
+		
+		/**
+		 * Write every outstanding event to the file.  Must be called with the
+		 * mutex held.
+		 */
+		static void drain();
+		
+		/**
+		 * Disable tracing, write any outstanding events and close the file.
+		 * Must be called with the mutex held.
+		 */
+		static void finish();
+		
+		/**
+		 * Mark a thread's buffer as orphaned when the thread exits.
+		 * @param buffer The buffer.
+		 */
+		static void releaseBuffer(void* buffer);
+		
+		/**
+		 * Writer thread loop.
+		 * @param arg Unused.
+		 * @return Always NULL.
+		 */
+		static void* threadMain(void* arg);
+	};
+	
+	/**
+	 * Traces the scope in which it is declared.  Use the TRACE_SCOPE macro
+	 * rather than declaring one directly.
+	 */
+	class TraceScope {
+	public:
+		
+		/**
+		 * Constructor.  Records the begin event.
+		 * @param name Name of the event; must be a string literal.
+		 */
+		inline TraceScope(const char* name) {
+			_name = name;
+			_isRecording = Tracer::isEnabled();
+			
+			if (_isRecording) Tracer::begin(name);
+		};
+		
+		/**
+		 * Destructor.  Records the end event.
+		 */
+		inline ~TraceScope() {
+			if (_isRecording) Tracer::end(_name);
+		};
+	
+	private:
+		const char* _name;						/**< Name of the event */
+		bool _isRecording;						/**< Was the begin event recorded? */
+	};
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include <string.h>
+#include "trafficstats.h"
+#include "log.h"
+
+using namespace WiredMunk;
+
+TrafficStats::TrafficStats() {
+	memset(_counters, 0, sizeof(_counters));
+	memset(_sendFailures, 0, sizeof(_sendFailures));
+}
+
+void TrafficStats::record(Direction direction, unsigned int type, unsigned int bytes) {
+	Counters* counters = &_counters[direction][getIndex(type)];
+	
+	__sync_fetch_and_add(&counters->packets, 1);
+	__sync_fetch_and_add(&counters->bytes, (unsigned long long)bytes);
+	__sync_fetch_and_add(&counters->sizes[getBucket(bytes)], 1);
+}
+
+void TrafficStats::recordSendFailure(unsigned int type) {
+	__sync_fetch_and_add(&_sendFailures[getIndex(type)], 1);
+}
+
+unsigned int TrafficStats::getTotalPackets(Direction direction) const {
+	unsigned int total = 0;
+	
+	for (unsigned int i = 0; i < TRAFFIC_MESSAGE_TYPES; ++i) {
+		total += _counters[direction][i].packets;
+	}
+	
+	return total;
+}
+
+unsigned long long TrafficStats::getTotalBytes(Direction direction) const {
+	unsigned long long total = 0;
+	
+	for (unsigned int i = 0; i < TRAFFIC_MESSAGE_TYPES; ++i) {
+		total += _counters[direction][i].bytes;
+	}
+	
+	return total;
+}
+
+unsigned int TrafficStats::getBucketLimit(unsigned int bucket) {
+	if (bucket >= TRAFFIC_SIZE_BUCKETS - 1) return 0;
+	
+	return 1 << (bucket + TRAFFIC_SMALLEST_BUCKET_BITS);
+}
+
+unsigned int TrafficStats::getBucket(unsigned int bytes) {
+
+	// Find the first bucket whose limit is at least the packet size
+	unsigned int bucket = 0;
+	unsigned int limit = 1 << TRAFFIC_SMALLEST_BUCKET_BITS;
+	
+	while ((bytes > limit) && (bucket < TRAFFIC_SIZE_BUCKETS - 1)) {
+		limit <<= 1;
+		bucket++;
+	}
+	
+	return bucket;
+}
+
+void TrafficStats::print(const char* name) const {
+	LOG_INFO("%s\n", name);
+	LOG_INFO("Type  In packets  In bytes    Out packets Out bytes   Failures\n");
+	
+	for (unsigned int i = 0; i < TRAFFIC_MESSAGE_TYPES; ++i) {
+		const Counters& in = _counters[DIRECTION_IN][i];
+		const Counters& out = _counters[DIRECTION_OUT][i];
+		
+		if ((in.packets == 0) && (out.packets == 0) && (_sendFailures[i] == 0)) continue;
+		
+		LOG_INFO("%-5d %-11u %-11llu %-11u %-11llu %u\n", i, in.packets, in.bytes, out.packets, out.bytes, _sendFailures[i]);
+	}
+}
@@ -0,0 +1,147 @@
+#ifndef _TRAFFIC_STATS_H_
+#define _TRAFFIC_STATS_H_
+
+#define TRAFFIC_MESSAGE_TYPES 13
+#define TRAFFIC_SIZE_BUCKETS 10
+#define TRAFFIC_SMALLEST_BUCKET_BITS 5
+
+namespace WiredMunk {
+
+	/**
+	 * Counts the packets and bytes sent and received, by message type, along
+	 * with a histogram of packet sizes and the number of sends that failed.
+	 * The socket keeps one set of statistics for all traffic, and each client
+	 * has its own.
+	 *
+	 * Counters are updated with atomic adds, so statistics can be shared by
+	 * rooms running on different threads without locking.  Readers may see
+	 * the counters for a packet partially updated, which is harmless for
+	 * monitoring.
+	 *
+	 * Size histograms have TRAFFIC_SIZE_BUCKETS buckets.  The first holds
+	 * packets of up to 32 bytes, each subsequent bucket doubles the limit,
+	 * and the last holds everything larger.  Message types outside the known
+	 * range are counted as type 0.
+	 */
+	class TrafficStats {
+	public:
+		
+		/**
+		 * Direction of traffic.
+		 */
+		enum Direction {
+			DIRECTION_IN = 0,				/**< Packets received */
+			DIRECTION_OUT = 1				/**< Packets sent */
+		};
+		
+		/**
+		 * Constructor.
+		 */
+		TrafficStats();
+		
+		/**
+		 * Record a packet.
+		 * @param direction Direction of the packet.
+		 * @param type Message type of the packet.
+		 * @param bytes Size of the packet in bytes, including the header.
+		 */
+		void record(Direction direction, unsigned int type, unsigned int bytes);
+		
+		/**
+		 * Record a packet that could not be sent.
+		 * @param type Message type of the packet.
+		 */
+		void recordSendFailure(unsigned int type);
+		
+		/**
+		 * Get the number of packets of a type.
+		 * @param direction Direction of the packets.
+		 * @param type Message type.
+		 * @return The number of packets.
+		 */
+		inline unsigned int getPackets(Direction direction, unsigned int type) const { return _counters[direction][getIndex(type)].packets; };
+		
+		/**
+		 * Get the number of bytes of a type.
+		 * @param direction Direction of the packets.
+		 * @param type Message type.
+		 * @return The number of bytes.
+		 */
+		inline unsigned long long getBytes(Direction direction, unsigned int type) const { return _counters[direction][getIndex(type)].bytes; };
+		
+		/**
+		 * Get the number of packets of a type in a size bucket.
+		 * @param direction Direction of the packets.
+		 * @param type Message type.
+		 * @param bucket Index of the bucket.
+		 * @return The number of packets.
+		 */
+		inline unsigned int getSizeCount(Direction direction, unsigned int type, unsigned int bucket) const { return _counters[direction][getIndex(type)].sizes[bucket]; };
+		
+		/**
+		 * Get the number of packets of a type that could not be sent.
+		 * @param type Message type.
+		 * @return The number of failed sends.
+		 */
+		inline unsigned int getSendFailures(unsigned int type) const { return _sendFailures[getIndex(type)]; };
+		
+		/**
+		 * Get the total number of packets in a direction.
+		 * @param direction Direction of the packets.
+		 * @return The number of packets.
+		 */
+		unsigned int getTotalPackets(Direction direction) const;
+		
+		/**
+		 * Get the total number of bytes in a direction.
+		 * @param direction Direction of the packets.
+		 * @return The number of bytes.
+		 */
+		unsigned long long getTotalBytes(Direction direction) const;
+		
+		/**
+		 * Get the largest packet size counted by a bucket.
+		 * @param bucket Index of the bucket.
+		 * @return The size in bytes, or 0 for the last bucket, which has no
+		 * limit.
+		 */
+		static unsigned int getBucketLimit(unsigned int bucket);
+		
+		/**
+		 * Print the statistics for each message type that has seen any
+		 * traffic.
+		 * @param name Name to print above the statistics.
+		 */
+		void print(const char* name) const;
+	
+	private:
+		
+		/**
+		 * Counters for one message type in one direction.
+		 */
+		struct Counters {
+			unsigned int packets;						/**< Number of packets */
+			unsigned long long bytes;					/**< Number of bytes */
+			unsigned int sizes[TRAFFIC_SIZE_BUCKETS];	/**< Packets by size */
+		};
+		
+		Counters _counters[2][TRAFFIC_MESSAGE_TYPES];	/**< Counters by direction and type */
+		unsigned int _sendFailures[TRAFFIC_MESSAGE_TYPES];	/**< Failed sends by type */
+		
+		/**
+		 * Get the counter index for a message type.
+		 * @param type Message type.
+		 * @return The index.
+		 */
+		static inline unsigned int getIndex(unsigned int type) { return (type < TRAFFIC_MESSAGE_TYPES ? type : 0); };
+		
+		/**
+		 * Get the size bucket for a packet.
+		 * @param bytes Size of the packet in bytes.
+		 * @return Index of the bucket.
+		 */
+		static unsigned int getBucket(unsigned int bytes);
+	};
+}
+
+#endif
@@ -0,0 +1,297 @@
+/**
+ * Object ID churn test.  Spawns and despawns bodies and shapes in a space
+ * in the way that a busy room would, and checks that:
+ *
+ * - objects take their IDs from the IDServer;
+ * - the IDs of destroyed objects are returned to the IDServer and their
+ *   slots reused, so the highest slot in use stays close to the number of
+ *   objects alive at once;
+ * - a destroyed object's ID is stale, and the space no longer finds an
+ *   object with it;
+ * - the space's ID indexes stay in step with its object lists;
+ * - an object whose slot is still held by another generation is not added,
+ *   so it cannot displace the live object from the index;
+ * - a replica space replaces despawned objects with the newer generations
+ *   that reuse their slots, and skips shapes whose body is missing.
+ *
+ * Also reports how many bodies, with their shapes, are replaced per second.
+ * Exits with a non-zero status if any check fails.
+ *
+ * Built by the chipmunk CMake project as "churntest", and run by ctest:
+ *   cmake -S ../src/chipmunk -B build && cmake --build build && ctest --test-dir build
+ *
+ * Usage:
+ *   churntest [-o objects] [-r rounds] [-k killsperround] [-s seed]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "chipmunk.h"
+#include "idserver.h"
+#include "handleallocator.h"
+#include "objectindex.h"
+#include "space.h"
+#include "body.h"
+#include "shape.h"
+#include "tickscheduler.h"
+
+#define DEFAULT_OBJECT_COUNT 1000
+#define DEFAULT_ROUND_COUNT 2000
+#define DEFAULT_KILLS_PER_ROUND 50
+#define DEFAULT_SEED 1
+
+using namespace WiredMunk;
+
+/**
+ * Number of checks that have failed.
+ */
+static int failures = 0;
+
+/**
+ * Report a failed check.
+ * @param message Description of the failure.
+ * @param objectId ID of the object involved.
+ */
+static void fail(const char* message, unsigned int objectId) {
+	printf("FAIL: %s (ID %u)\n", message, objectId);
+	failures++;
+}
+
+/**
+ * Spawn a body with a circle shape.
+ * @param space The space to add the objects to.
+ * @param i Number used to place the body.
+ * @return The new body.
+ */
+static Body* spawn(Space* space, unsigned int i) {
+	Body* body = new Body(1.0, cpMomentForCircle(1.0, 0.0, 5.0, cpvzero));
+	body->setPosition(cpv((i % 100) * 12.0, (i / 100) * 12.0));
+	space->addBody(body);
+	
+	Shape* shape = new Shape(body, 5.0, cpvzero);
+	space->addShape(shape);
+	
+	if (!IDServer::isNetworkObjectIdLive(body->getObjectId())) fail("Body ID not allocated by the IDServer", body->getObjectId());
+	if (!IDServer::isNetworkObjectIdLive(shape->getObjectId())) fail("Shape ID not allocated by the IDServer", shape->getObjectId());
+	
+	return body;
+}
+
+/**
+ * Despawn a body and its shape, and check that their IDs are released.
+ * @param space The space to remove the objects from.
+ * @param body The body to remove.
+ */
+static void despawn(Space* space, Body* body) {
+
+	// Find the body's shape
+	Shape* shape = NULL;
+	
+	for (unsigned int i = 0; i < space->getShapes()->size(); ++i) {
+		if (space->getShapes()->at(i)->getBody() == body) shape = space->getShapes()->at(i);
+	}
+	
+	unsigned int bodyId = body->getObjectId();
+	unsigned int shapeId = shape->getObjectId();
+	
+	space->removeShape(shape);
+	space->removeBody(body);
+	
+	delete shape;
+	delete body;
+	
+	if (IDServer::isNetworkObjectIdLive(bodyId)) fail("Body ID still live after despawn", bodyId);
+	if (IDServer::isNetworkObjectIdLive(shapeId)) fail("Shape ID still live after despawn", shapeId);
+	if (space->findBody(bodyId) != NULL) fail("Despawned body still indexed", bodyId);
+	if (space->findShape(shapeId) != NULL) fail("Despawned shape still indexed", shapeId);
+}
+
+/**
+ * Check that every object in the space's lists can be found by its ID.
+ * @param space The space to check.
+ */
+static void checkIndex(Space* space) {
+	for (unsigned int i = 0; i < space->getBodies()->size(); ++i) {
+		Body* body = space->getBodies()->at(i);
+		if (space->findBody(body->getObjectId()) != body) fail("Body missing from index", body->getObjectId());
+	}
+	
+	for (unsigned int i = 0; i < space->getShapes()->size(); ++i) {
+		Shape* shape = space->getShapes()->at(i);
+		if (space->findShape(shape->getObjectId()) != shape) fail("Shape missing from index", shape->getObjectId());
+	}
+}
+
+/**
+ * Check that a handle from an older generation cannot displace the live
+ * object in its slot.
+ */
+static void checkStaleAdd() {
+	ObjectIndex<int> index;
+	int live = 1;
+	int stale = 2;
+	
+	unsigned int liveId = HandleAllocator::makeHandle(5, 3);
+	unsigned int staleId = HandleAllocator::makeHandle(5, 2);
+	
+	index.add(liveId, &live);
+	
+	if (index.add(staleId, &stale)) fail("Stale handle displaced a live object", staleId);
+	if (index.find(liveId) != &live) fail("Live object lost from index", liveId);
+	
+	// Once the live object goes, the slot can be refilled
+	index.remove(liveId, &live);
+	
+	if (!index.add(staleId, &stale)) fail("Object not added to an empty slot", staleId);
+}
+
+/**
+ * Copy a space into a replica by serialising it, as a snapshot would.
+ * @param space The space to copy.
+ * @param replica The replica to update, or NULL to create one.
+ * @return The replica.
+ */
+static Space* replicate(Space* space, Space* replica) {
+	std::vector<unsigned char> data(space->getSerialisedLength());
+	space->serialise(&data[0]);
+	
+	if (replica == NULL) return new Space(&data[0]);
+	
+	replica->deserialise(&data[0]);
+	return replica;
+}
+
+/**
+ * Check that a replica follows the source space as objects are despawned
+ * and their slots reused, and that a shape without a body is skipped.
+ */
+static void checkReplication() {
+	Space* space = new Space();
+	Body* body = spawn(space, 0);
+	Space* replica = replicate(space, NULL);
+	
+	unsigned int oldId = body->getObjectId();
+	
+	// Respawn into the same slot with a newer generation
+	despawn(space, body);
+	body = spawn(space, 0);
+	
+	if (HandleAllocator::getIndex(body->getObjectId()) != HandleAllocator::getIndex(oldId)) fail("Slot not reused for respawn", body->getObjectId());
+	
+	replicate(space, replica);
+	
+	if (replica->findBody(body->getObjectId()) == NULL) fail("Newer generation not replicated", body->getObjectId());
+	if (replica->findBody(oldId) != NULL) fail("Despawned body still replicated", oldId);
+	if (replica->getBodies()->size() != 1) fail("Replica body count wrong", replica->getBodies()->size());
+	if (replica->getShapes()->size() != 1) fail("Replica shape count wrong", replica->getShapes()->size());
+	
+	// A shape whose body is not in the space must be skipped
+	Space* orphans = new Space();
+	Body* missing = new Body(1.0, 1.0);
+	Shape* orphan = new Shape(missing, 5.0, cpvzero);
+	orphans->addShape(orphan);
+	
+	Space* orphanReplica = replicate(orphans, NULL);
+	
+	if (orphanReplica->getShapes()->size() != 0) fail("Shape without a body replicated", orphan->getObjectId());
+	
+	orphans->removeShape(orphan);
+	delete orphan;
+	delete missing;
+	delete orphanReplica;
+	delete orphans;
+	despawn(space, body);
+	delete replica;
+	delete space;
+}
+
+static void printUsage(const char* name) {
+	printf("Usage: %s [-o objects] [-r rounds] [-k killsperround] [-s seed]\n", name);
+}
+
+int main(int argc, char* const argv[]) {
+
+	int objectCount = DEFAULT_OBJECT_COUNT;
+	int roundCount = DEFAULT_ROUND_COUNT;
+	int killsPerRound = DEFAULT_KILLS_PER_ROUND;
+	unsigned int seed = DEFAULT_SEED;
+	
+	for (int i = 1; i < argc; ++i) {
+		if ((strncmp(argv[i], "-o", 2) == 0) && (i + 1 < argc)) {
+			objectCount = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-r", 2) == 0) && (i + 1 < argc)) {
+			roundCount = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-k", 2) == 0) && (i + 1 < argc)) {
+			killsPerRound = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-s", 2) == 0) && (i + 1 < argc)) {
+			seed = atoi(argv[++i]);
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	
+	if ((objectCount < 1) || (roundCount < 1) || (killsPerRound < 1) || (killsPerRound > objectCount)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	
+	cpInitChipmunk();
+	srand(seed);
+	
+	checkStaleAdd();
+	checkReplication();
+	
+	Space* space = new Space();
+	
+	for (int i = 0; i < objectCount; ++i) {
+		spawn(space, i);
+	}
+	
+	// Each body and its shape hold two IDs
+	unsigned int maxIndex = 0;
+	unsigned int allowedIndex = objectCount * 2 + 1;
+	unsigned long long start = TickScheduler::getTime();
+	
+	for (int round = 0; round < roundCount; ++round) {
+		
+		// Despawn random bodies, then replace them
+		for (int i = 0; i < killsPerRound; ++i) {
+			BodyVector* bodies = space->getBodies();
+			despawn(space, bodies->at(rand() % bodies->size()));
+		}
+		
+		for (int i = 0; i < killsPerRound; ++i) {
+			Body* body = spawn(space, rand() % objectCount);
+			
+			unsigned int index = HandleAllocator::getIndex(body->getObjectId());
+			if (index > maxIndex) maxIndex = index;
+		}
+		
+		space->step(1.0 / 60.0);
+	}
+	
+	double seconds = (TickScheduler::getTime() - start) / 1000000000.0;
+	
+	checkIndex(space);
+	
+	if (maxIndex > allowedIndex) fail("Slots not reused; highest slot", maxIndex);
+	
+	unsigned long long churned = (unsigned long long)roundCount * killsPerRound;
+	
+	printf("Objects:          %d\n", objectCount);
+	printf("Replaced:         %llu\n", churned);
+	printf("Highest slot:     %u (limit %u)\n", maxIndex, allowedIndex);
+	printf("Replaced/second:  %.0f\n", churned / seconds);
+	
+	if (failures > 0) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	
+	printf("All checks passed\n");
+	
+	return 0;
+}
@@ -0,0 +1,552 @@
+/**
+ * Headless physics benchmark.  Builds standard scenes through the Space,
+ * Body, Shape and Joint wrappers, steps each one a fixed number of times,
+ * and reports steps per second, per-step duration percentiles and the
+ * number of allocations chipmunk makes per step.  Run it before and after
+ * any change to the engine to get a baseline to compare against.
+ *
+ * Scenes are built deterministically, so runs on the same machine are
+ * directly comparable.  The airhockey and opposingboxes scenes are the
+ * client demos' layouts, repeated side by side, with the impulses the demo
+ * players would apply standing in for input.  Every scene grows with the
+ * scale factor.
+ *
+ * -s integrates the bodies through chipmunk's structure-of-arrays body store
+ * (cpSpace's useBodyStore) instead of one body at a time.
+ *
+ * -b selects the broadphase used to find colliding shapes: "hash" for the
+ * spatial hashes (the default), "sweep" for the sorted lists in cpSweep or
+ * "tree" for the bounding box trees in cpBBTree.
+ *
+ * Built by the chipmunk CMake project as "physicsbench", with chipmunk
+ * compiled in with CP_COUNT_ALLOCATIONS:
+ *   cmake -S ../src/chipmunk -B build && cmake --build build
+ *
+ * Usage:
+ *   physicsbench [-n steps] [-w warmup] [-x scale] [-s] [-b broadphase] [scene ...]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "chipmunk.h"
+#include "space.h"
+#include "body.h"
+#include "shape.h"
+#include "joint.h"
+#include "tickscheduler.h"
+
+#define DEFAULT_STEPS 1000
+#define DEFAULT_WARMUP_STEPS 100
+#define DEFAULT_SCALE 1
+#define TIMESTEP (1.0 / 60.0)
+#define GRAVITY -100.0
+#define IMPULSE_INTERVAL 10
+
+using namespace WiredMunk;
+
+/**
+ * An impulse applied to a body every IMPULSE_INTERVAL steps.
+ */
+struct Impulse {
+	Body* body;
+	cpVect force;
+};
+
+/**
+ * A scene ready to be stepped.
+ */
+struct Scene {
+	Space* space;
+	std::vector<Impulse> impulses;
+};
+
+typedef void (*SceneBuilder)(Scene* scene, int scale);
+
+/**
+ * A named scene that can be selected from the command line.
+ */
+struct SceneType {
+	const char* name;
+	SceneBuilder build;
+};
+
+/**
+ * Get a pseudo-random number.  The generator is local so that scenes are
+ * identical on every platform.
+ * @param seed State of the generator.
+ * @return A number between 0 and 1.
+ */
+static double nextRandom(unsigned int* seed) {
+	*seed = *seed * 1103515245 + 12345;
+	return ((*seed >> 16) & 0x7fff) / 32767.0;
+}
+
+static Body* addStaticBody(Space* space) {
+	Body* body = new Body(INFINITY, INFINITY);
+	space->addStaticBody(body);
+	
+	return body;
+}
+
+static void addWall(Space* space, Body* staticBody, cpVect a, cpVect b) {
+	Shape* shape = new Shape(staticBody, a, b, 0.0);
+	shape->setElasticity(1.0);
+	shape->setFriction(1.0);
+	space->addStaticShape(shape);
+}
+
+static Body* addPoly(Space* space, cpFloat mass, int numVerts, cpVect* verts, cpVect position) {
+	Body* body = new Body(mass, cpMomentForPoly(mass, numVerts, verts, cpvzero));
+	body->setPosition(position);
+	space->addBody(body);
+	
+	Shape* shape = new Shape(body, numVerts, verts, cpvzero);
+	shape->setElasticity(0.0);
+	shape->setFriction(0.8);
+	space->addShape(shape);
+	
+	return body;
+}
+
+static Body* addBox(Space* space, cpFloat mass, cpFloat width, cpFloat height, cpVect position) {
+	cpVect verts[] = {
+		cpv(-width / 2, -height / 2),
+		cpv(-width / 2, height / 2),
+		cpv(width / 2, height / 2),
+		cpv(width / 2, -height / 2)
+	};
+	
+	return addPoly(space, mass, 4, verts, position);
+}
+
+static Body* addCircle(Space* space, cpFloat mass, cpFloat radius, cpVect position) {
+	Body* body = new Body(mass, cpMomentForCircle(mass, 0.0, radius, cpvzero));
+	body->setPosition(position);
+	space->addBody(body);
+	
+	Shape* shape = new Shape(body, radius, cpvzero);
+	shape->setElasticity(0.0);
+	shape->setFriction(0.8);
+	space->addShape(shape);
+	
+	return body;
+}
+
+/**
+ * A pyramid of boxes resting on the ground.
+ */
+static void buildPyramid(Scene* scene, int scale) {
+	Space* space = new Space(20);
+	space->setGravity(cpv(0, GRAVITY));
+	space->resizeActiveHash(20.0, 1000 * scale);
+	scene->space = space;
+	
+	int rows = 14 * scale;
+	
+	Body* staticBody = addStaticBody(space);
+	addWall(space, staticBody, cpv(-rows * 20.0, 0), cpv(rows * 20.0, 0));
+	
+	for (int row = 0; row < rows; ++row) {
+		for (int i = 0; i < rows - row; ++i) {
+			cpFloat x = (i - (rows - row - 1) / 2.0) * 21.0;
+			addBox(space, 1.0, 20.0, 20.0, cpv(x, 10.0 + row * 20.0));
+		}
+	}
+}
+
+/**
+ * Circles of mixed sizes dropped into a bin.
+ */
+static void buildCircles(Scene* scene, int scale) {
+	Space* space = new Space();
+	space->setGravity(cpv(0, GRAVITY));
+	space->resizeActiveHash(20.0, 2000 * scale);
+	scene->space = space;
+	
+	int columns = 20 * scale;
+	int rows = 15;
+	cpFloat width = columns * 20.0;
+	unsigned int seed = 1;
+	
+	Body* staticBody = addStaticBody(space);
+	addWall(space, staticBody, cpv(-width / 2, 0), cpv(width / 2, 0));
+	addWall(space, staticBody, cpv(-width / 2, 0), cpv(-width / 2, 1000));
+	addWall(space, staticBody, cpv(width / 2, 0), cpv(width / 2, 1000));
+	
+	for (int row = 0; row < rows; ++row) {
+		for (int i = 0; i < columns; ++i) {
+			cpFloat radius = 5.0 + nextRandom(&seed) * 4.0;
+			cpVect position = cpv(-width / 2 + 10.0 + i * 20.0, 20.0 + row * 20.0);
+			
+			addCircle(space, 1.0, radius, position);
+		}
+	}
+}
+
+/**
+ * Irregular polygons sliding down a slope onto the ground.
+ */
+static void buildAvalanche(Scene* scene, int scale) {
+	Space* space = new Space();
+	space->setGravity(cpv(0, GRAVITY));
+	space->resizeActiveHash(30.0, 2000 * scale);
+	scene->space = space;
+	
+	int columns = 10 * scale;
+	int rows = 20;
+	cpFloat width = columns * 30.0;
+	unsigned int seed = 1;
+	
+	Body* staticBody = addStaticBody(space);
+	addWall(space, staticBody, cpv(-width, width / 2), cpv(width / 2, 0));
+	addWall(space, staticBody, cpv(width / 2, 0), cpv(width * 2, 0));
+	addWall(space, staticBody, cpv(width * 2, 0), cpv(width * 2, 1000));
+	
+	for (int row = 0; row < rows; ++row) {
+		for (int i = 0; i < columns; ++i) {
+			cpVect verts[6];
+			int numVerts = 3 + (int)(nextRandom(&seed) * 4);
+			
+			// Vary the radius of each vertex to make the polygons irregular;
+			// they stay convex as the vertices are in clockwise order
+			for (int v = 0; v < numVerts; ++v) {
+				cpFloat angle = -2.0 * M_PI * v / numVerts;
+				cpFloat radius = 8.0 + nextRandom(&seed) * 4.0;
+				verts[v] = cpv(cos(angle) * radius, sin(angle) * radius);
+			}
+			
+			cpVect position = cpv(-width + 15.0 + i * 30.0, width / 2 + 40.0 + row * 30.0);
+			addPoly(space, 1.0, numVerts, verts, position);
+		}
+	}
+}
+
+/**
+ * Chains of circles joined by pivot joints, released from the horizontal so
+ * that they swing.
+ */
+static void buildChains(Scene* scene, int scale) {
+	Space* space = new Space(20);
+	space->setGravity(cpv(0, GRAVITY));
+	space->resizeActiveHash(10.0, 1000 * scale);
+	scene->space = space;
+	
+	int chains = 8 * scale;
+	int links = 20;
+	
+	Body* staticBody = addStaticBody(space);
+	
+	for (int chain = 0; chain < chains; ++chain) {
+		cpVect anchor = cpv(chain * 40.0, 0);
+		Body* previous = staticBody;
+		
+		for (int i = 0; i < links; ++i) {
+			cpVect position = cpvadd(anchor, cpv(5.0 + i * 10.0, 0));
+			Body* link = addCircle(space, 1.0, 4.0, position);
+			
+			// Join each link to the previous one halfway between them
+			space->addJoint(new Joint(previous, link, cpvsub(position, cpv(5.0, 0))));
+			
+			previous = link;
+		}
+	}
+}
+
+/**
+ * The airhockey demo's arena, repeated side by side, with the two paddles
+ * in each arena driven into each other.
+ */
+static void buildAirHockey(Scene* scene, int scale) {
+	Space* space = new Space(20);
+	space->setGravity(cpv(0, 0));
+	space->resizeStaticHash(40.0, 1000);
+	space->resizeActiveHash(40.0, 1000 * scale);
+	scene->space = space;
+	
+	cpVect paddleVerts[] = {
+		cpv(-15, -50),
+		cpv(-15, 50),
+		cpv(15, 50),
+		cpv(15, -50)
+	};
+	
+	Body* staticBody = addStaticBody(space);
+	
+	for (int arena = 0; arena < 4 * scale; ++arena) {
+		cpFloat x = arena * 700.0;
+		
+		addWall(space, staticBody, cpv(x - 320, -240), cpv(x - 320, 240));
+		addWall(space, staticBody, cpv(x + 320, -240), cpv(x + 320, 240));
+		addWall(space, staticBody, cpv(x - 320, -240), cpv(x + 320, -240));
+		addWall(space, staticBody, cpv(x - 320, 240), cpv(x + 320, 240));
+		
+		for (int i = 0; i < 20; ++i) {
+			addCircle(space, 10.0, 10 + i, cpv(x + 32 + ((10 - i) * 8), -150 + (i * 16)));
+		}
+		
+		Impulse impulse;
+		
+		impulse.body = addPoly(space, 10.0, 4, paddleVerts, cpv(x + 32, -150));
+		impulse.force = cpv(0, 200);
+		scene->impulses.push_back(impulse);
+		
+		impulse.body = addPoly(space, 10.0, 4, paddleVerts, cpv(x + 32, -78));
+		impulse.force = cpv(0, -200);
+		scene->impulses.push_back(impulse);
+	}
+}
+
+/**
+ * The opposingboxes demo's stack, repeated side by side, with the top and
+ * bottom box in each stack pushed towards each other.
+ */
+static void buildOpposingBoxes(Scene* scene, int scale) {
+	Space* space = new Space(20);
+	space->setGravity(cpv(0, 0));
+	space->resizeStaticHash(40.0, 1000);
+	space->resizeActiveHash(40.0, 1000 * scale);
+	scene->space = space;
+	
+	Body* staticBody = addStaticBody(space);
+	
+	for (int stack = 0; stack < 16 * scale; ++stack) {
+		cpFloat x = stack * 700.0;
+		
+		addWall(space, staticBody, cpv(x - 320, -240), cpv(x - 320, 240));
+		addWall(space, staticBody, cpv(x + 320, -240), cpv(x + 320, 240));
+		addWall(space, staticBody, cpv(x - 320, -240), cpv(x + 320, -240));
+		
+		Impulse impulse;
+		
+		for (int i = 0; i < 8; ++i) {
+			Body* body = addBox(space, 1.0, 30.0, 30.0, cpv(x + 32, -150 + (i * 32)));
+			
+			if ((i == 0) || (i == 7)) {
+				impulse.body = body;
+				impulse.force = cpv(0, i == 0 ? 20 : -20);
+				scene->impulses.push_back(impulse);
+			}
+		}
+	}
+}
+
+static const SceneType sceneTypes[] = {
+	{ "pyramid", buildPyramid },
+	{ "circles", buildCircles },
+	{ "avalanche", buildAvalanche },
+	{ "chains", buildChains },
+	{ "airhockey", buildAirHockey },
+	{ "opposingboxes", buildOpposingBoxes }
+};
+
+static const int sceneTypeCount = sizeof(sceneTypes) / sizeof(sceneTypes[0]);
+
+/**
+ * Delete a scene's space and every object in it.  Deleting the space frees
+ * chipmunk's objects but not the wrappers around them, so the objects are
+ * removed from the space and deleted first.
+ */
+static void freeScene(Scene* scene) {
+	Space* space = scene->space;
+	
+	while (!space->getJoints()->empty()) {
+		Joint* joint = space->getJoints()->back();
+		space->removeJoint(joint);
+		delete joint;
+	}
+	
+	while (!space->getShapes()->empty()) {
+		Shape* shape = space->getShapes()->back();
+		space->removeShape(shape);
+		delete shape;
+	}
+	
+	while (!space->getStaticShapes()->empty()) {
+		Shape* shape = space->getStaticShapes()->back();
+		space->removeStaticShape(shape);
+		delete shape;
+	}
+	
+	while (!space->getBodies()->empty()) {
+		Body* body = space->getBodies()->back();
+		space->removeBody(body);
+		delete body;
+	}
+	
+	// Static bodies are never added to chipmunk's space, so they can be
+	// deleted once the space has gone
+	BodyVector staticBodies = *space->getStaticBodies();
+	
+	delete space;
+	
+	for (unsigned int i = 0; i < staticBodies.size(); ++i) {
+		delete staticBodies[i];
+	}
+	
+	scene->space = NULL;
+}
+
+static void stepScene(Scene* scene, int step) {
+	if (step % IMPULSE_INTERVAL == 0) {
+		for (unsigned int i = 0; i < scene->impulses.size(); ++i) {
+			scene->impulses[i].body->applyImpulse(scene->impulses[i].force, cpvzero);
+		}
+	}
+	
+	scene->space->step(TIMESTEP);
+}
+
+/**
+ * A broadphase that can be selected with -b.
+ */
+struct Broadphase {
+	const char* name;
+	cpSpaceBroadphase broadphase;
+};
+
+static const Broadphase broadphases[] = {
+	{ "hash", CP_BROADPHASE_HASH },
+	{ "sweep", CP_BROADPHASE_SWEEP },
+	{ "tree", CP_BROADPHASE_TREE }
+};
+
+static const int broadphaseCount = sizeof(broadphases) / sizeof(broadphases[0]);
+
+static void runScene(const SceneType& type, int scale, int steps, int warmupSteps, bool bodyStore, const Broadphase* broadphase) {
+	Scene scene;
+	type.build(&scene, scale);
+	
+	scene.space->getSpace()->useBodyStore = bodyStore ? 1 : 0;
+	cpSpaceSetBroadphase(scene.space->getSpace(), broadphase->broadphase);
+	
+	// Let the scene settle into its typical contact count before timing
+	for (int i = 0; i < warmupSteps; ++i) {
+		stepScene(&scene, i);
+	}
+	
+	std::vector<unsigned long long> times(steps);
+	unsigned long allocations = cpAllocationCount;
+	unsigned long long start = TickScheduler::getTime();
+	
+	for (int i = 0; i < steps; ++i) {
+		unsigned long long stepStart = TickScheduler::getTime();
+		
+		stepScene(&scene, warmupSteps + i);
+		
+		times[i] = TickScheduler::getTime() - stepStart;
+	}
+	
+	unsigned long long total = TickScheduler::getTime() - start;
+	allocations = cpAllocationCount - allocations;
+	
+	std::sort(times.begin(), times.end());
+	
+	printf("%-15s %-8lu %-8lu %-11.1f %-9.1f %-9.1f %-9.1f %-9.1f %.1f\n",
+		type.name,
+		(unsigned long)scene.space->getBodies()->size(),
+		(unsigned long)scene.space->getShapes()->size(),
+		steps / (total / 1000000000.0),
+		times[(steps - 1) * 50 / 100] / 1000.0,
+		times[(steps - 1) * 90 / 100] / 1000.0,
+		times[(steps - 1) * 99 / 100] / 1000.0,
+		times[steps - 1] / 1000.0,
+		(double)allocations / steps);
+	
+	freeScene(&scene);
+}
+
+static void printUsage(const char* name) {
+	printf("Usage: %s [-n steps] [-w warmup] [-x scale] [-s] [-b broadphase] [scene ...]\n", name);
+	printf("Scenes:");
+	
+	for (int i = 0; i < sceneTypeCount; ++i) {
+		printf(" %s", sceneTypes[i].name);
+	}
+	
+	printf("\n");
+	printf("Broadphases:");
+	
+	for (int i = 0; i < broadphaseCount; ++i) {
+		printf(" %s", broadphases[i].name);
+	}
+	
+	printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+
+	int steps = DEFAULT_STEPS;
+	int warmupSteps = DEFAULT_WARMUP_STEPS;
+	int scale = DEFAULT_SCALE;
+	bool bodyStore = false;
+	const Broadphase* broadphase = &broadphases[0];
+	std::vector<const SceneType*> selected;
+	
+	for (int i = 1; i < argc; ++i) {
+		if ((strncmp(argv[i], "-n", 2) == 0) && (i + 1 < argc)) {
+			steps = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-w", 2) == 0) && (i + 1 < argc)) {
+			warmupSteps = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-x", 2) == 0) && (i + 1 < argc)) {
+			scale = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0) {
+			bodyStore = true;
+		} else if ((strncmp(argv[i], "-b", 2) == 0) && (i + 1 < argc)) {
+			const char* name = argv[++i];
+			broadphase = NULL;
+			
+			for (int j = 0; j < broadphaseCount; ++j) {
+				if (strcmp(name, broadphases[j].name) == 0) broadphase = &broadphases[j];
+			}
+			
+			if (broadphase == NULL) {
+				printf("Unknown broadphase: %s\n", name);
+				printUsage(argv[0]);
+				return 1;
+			}
+		} else if (argv[i][0] != '-') {
+			const SceneType* type = NULL;
+			
+			for (int j = 0; j < sceneTypeCount; ++j) {
+				if (strcmp(argv[i], sceneTypes[j].name) == 0) type = &sceneTypes[j];
+			}
+			
+			if (type == NULL) {
+				printf("Unknown scene: %s\n", argv[i]);
+				printUsage(argv[0]);
+				return 1;
+			}
+			
+			selected.push_back(type);
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	
+	if ((steps < 1) || (warmupSteps < 0) || (scale < 1)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	
+	if (selected.empty()) {
+		for (int i = 0; i < sceneTypeCount; ++i) {
+			selected.push_back(&sceneTypes[i]);
+		}
+	}
+	
+	cpInitChipmunk();
+	
+	printf("Steps: %d, warmup: %d, scale: %d, body store: %s, broadphase: %s\n\n", steps, warmupSteps, scale, bodyStore ? "on" : "off", broadphase->name);
+	printf("Scene           Bodies   Shapes   Steps/s     p50 us    p90 us    p99 us    Max us    Allocs/step\n");
+	
+	for (unsigned int i = 0; i < selected.size(); ++i) {
+		runScene(*selected[i], scale, steps, warmupSteps, bodyStore, broadphase);
+	}
+	
+	return 0;
+}
@@ -0,0 +1,670 @@
+/**
+ * Replication benchmark.  Runs a server and its clients in a single process,
+ * connected by a LoopbackNetwork rather than UDP, and measures how well the
+ * clients' simulations track the server's over links with the requested
+ * latency, jitter, loss, reordering, duplication and bandwidth limit.
+ *
+ * The handshake is not retried if it is lost, so clients connect over a
+ * perfect link; the link's conditions are applied, and measurement starts,
+ * once every client is running.
+ *
+ * Time is simulated: the clock only moves when the benchmark advances it,
+ * and the server and clients are run in turn from a single thread.  Runs
+ * with the same options and seed therefore produce identical results, and
+ * a run of any length completes as fast as the machine can simulate it.
+ *
+ * Each client builds the opposing boxes scene, offset so that the clients'
+ * scenes do not overlap in the room's merged space, and pushes one of its
+ * boxes at a fixed interval in the manner of the load generator.  Whenever
+ * a snapshot arrives, the distance that it moves each body is recorded as
+ * drift, as that is the error the client's prediction had accumulated.
+ *
+ * A blackout, in which every datagram is lost, can be placed in the middle
+ * of the run.  Convergence time is then the time from the end of the
+ * blackout until a client first receives a snapshot that moves none of its
+ * bodies further than the convergence threshold.
+ *
+ * Snapshots for large rooms can outgrow the largest datagram.  If any
+ * message is refused for being too large, the run is reported as invalid
+ * rather than measured, and the benchmark exits with a non-zero status.
+ *
+ * The clients are built from the server's simulation wrappers, as the
+ * client and server classes share names and cannot be linked together.
+ * They speak the same protocol as WiredMunkApp.
+ *
+ * Built by the chipmunk CMake project as "replicationbench":
+ *   cmake -S ../src/chipmunk -B build && cmake --build build
+ *
+ * Usage:
+ *   replicationbench [-c clients] [-k clientsperroom] [-d seconds] [-t rate] [-u substeps] [-n sendrate] [-s seed] [-l latency] [-j jitter] [-L loss%] [-r reorder%] [-D duplicate%] [-b bandwidth] [-q queuems] [-B blackoutms] [-e threshold]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <arpa/inet.h>
+#include "chipmunk.h"
+#include "server.h"
+#include "socket.h"
+#include "loopbacknetwork.h"
+#include "message.h"
+#include "serialisebase.h"
+#include "sessionsettings.h"
+#include "tickscheduler.h"
+#include "space.h"
+#include "body.h"
+#include "shape.h"
+#include "simulation.h"
+#include "log.h"
+
+#define DEFAULT_CLIENT_COUNT 8
+#define DEFAULT_CLIENTS_PER_ROOM 2
+#define DEFAULT_DURATION_SECONDS 60
+#define DEFAULT_SEND_RATE 10
+#define DEFAULT_SEED 1
+#define DEFAULT_CONVERGENCE_THRESHOLD 1.0
+#define SETUP_TIMEOUT_SECONDS 10
+#define SERVER_PORT 4444
+#define VIRTUAL_STEP_NS 500000ULL
+#define SCENE_SPACING 700
+#define BOX_COUNT 10
+#define FAST_PUSH_INTERVAL_TICKS 10
+#define SLOW_PUSH_INTERVAL_TICKS 50
+
+using namespace WiredMunk;
+
+/**
+ * The simulated time, in nanoseconds.
+ */
+static unsigned long long virtualTime = 1000000000ULL;
+
+/**
+ * Clock that reads the simulated time.  Installed with
+ * TickScheduler::setClock().
+ * @return The simulated time in nanoseconds.
+ */
+static unsigned long long getVirtualTime() {
+	return virtualTime;
+}
+
+/**
+ * A simulated client.  Handshakes with the server, builds the opposing boxes
+ * scene when the room starts up, steps its copy of the room's space and
+ * pushes one of its boxes at a fixed interval.  Clients with odd IDs push
+ * the bottom box up every FAST_PUSH_INTERVAL_TICKS ticks; the others push
+ * the top box down every SLOW_PUSH_INTERVAL_TICKS ticks.
+ */
+class BenchClient : public SocketEventHandler {
+public:
+
+	enum ClientState {
+		CLIENT_STATE_WAITING_HANDSHAKE = 0,
+		CLIENT_STATE_WAITING_STARTUP = 1,
+		CLIENT_STATE_WAITING_READY = 2,
+		CLIENT_STATE_RUNNING = 3,
+		CLIENT_STATE_REJECTED = 4
+	};
+	
+	/**
+	 * Constructor.  Starts the handshake with the server.
+	 * @param network The network that the server is running on.
+	 * @param settings Session settings to propose to the server.
+	 * @param threshold Largest correction a converged snapshot can make.
+	 */
+	BenchClient(LoopbackNetwork* network, const SessionSettings& settings, double threshold) : _scheduler(settings.getPhysicsRate(), SIMULATION_MAX_CATCH_UP_STEPS) {
+		_socket.open(network, 0);
+		_socket.addSocketEventHandler(this);
+		
+		memset(&_server, 0, sizeof(_server));
+		_server.sin_family = AF_INET;
+		_server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		_server.sin_port = htons(SERVER_PORT);
+		
+		_state = CLIENT_STATE_WAITING_HANDSHAKE;
+		_settings = settings;
+		_threshold = threshold;
+		_space = NULL;
+		_pushBody = NULL;
+		_clientId = 0;
+		_ticks = 0;
+		_snapshots = 0;
+		_bytesIn = 0;
+		_bytesOut = 0;
+		_blackoutEndTime = 0;
+		_convergenceTime = 0;
+		
+		// Propose the settings after a room ID, as WiredMunkApp does
+		unsigned char data[SERIALISED_INT_SIZE + SERIALISED_SESSION_SETTINGS_SIZE];
+		unsigned short dataLength = SerialiseBase::serialise((unsigned int)HANDSHAKE_ANY_ROOM, data);
+		dataLength += _settings.serialise(data + dataLength);
+		
+		send(Message::MESSAGE_HANDSHAKE, data, dataLength);
+	};
+	
+	/**
+	 * Destructor.
+	 */
+	~BenchClient() {
+		_socket.shut();
+		delete _space;
+	};
+	
+	/**
+	 * Receive everything that has arrived, then step the simulation as far
+	 * as the clock has moved.
+	 */
+	void update() {
+		while (_socket.poll() > 0) { }
+		
+		if (_state != CLIENT_STATE_RUNNING) return;
+		
+		int steps = _scheduler.update();
+		
+		for (int i = 0; i < steps; ++i) {
+			for (unsigned int j = 0; j < _settings.getSubsteps(); ++j) {
+				_space->step(_settings.getSubstepLength());
+			}
+			
+			_ticks++;
+			
+			push();
+		}
+	};
+	
+	/**
+	 * Process message received events.
+	 * @param msg Message to be processed.
+	 */
+	void handleMessageReceived(const Message& msg) {
+		switch (msg.getType()) {
+			case Message::MESSAGE_HANDSHAKE:
+				if (_state != CLIENT_STATE_WAITING_HANDSHAKE) break;
+				
+				_clientId = SerialiseBase::deserialiseInt(msg.getData());
+				
+				if (msg.getDataLength() >= SERIALISED_INT_SIZE + SERIALISED_SESSION_SETTINGS_SIZE) {
+					_settings.deserialise(msg.getData() + SERIALISED_INT_SIZE);
+					_scheduler.setRate(_settings.getPhysicsRate());
+				}
+				
+				_state = CLIENT_STATE_WAITING_STARTUP;
+				break;
+			
+			case Message::MESSAGE_REJECT:
+				_state = CLIENT_STATE_REJECTED;
+				break;
+			
+			case Message::MESSAGE_STARTUP:
+				if (_state != CLIENT_STATE_WAITING_STARTUP) break;
+				
+				startup();
+				sendSpace();
+				send(Message::MESSAGE_READY, NULL, 0);
+				
+				_state = CLIENT_STATE_WAITING_READY;
+				break;
+			
+			case Message::MESSAGE_READY:
+				if (_state != CLIENT_STATE_WAITING_READY) break;
+				
+				_scheduler.reset();
+				_state = CLIENT_STATE_RUNNING;
+				break;
+			
+			case Message::MESSAGE_SPACE:
+				if (_space != NULL) handleSnapshot(msg);
+				break;
+			
+			case Message::MESSAGE_PING:
+				send(Message::MESSAGE_PING, NULL, 0);
+				break;
+			
+			default:
+				break;
+		}
+	};
+	
+	/**
+	 * Discard everything recorded so far, so that only what follows is
+	 * measured.
+	 */
+	void startMeasuring() {
+		_snapshots = 0;
+		_corrections.clear();
+		_bytesIn = _socket.getStats()->getTotalBytes(TrafficStats::DIRECTION_IN);
+		_bytesOut = _socket.getStats()->getTotalBytes(TrafficStats::DIRECTION_OUT);
+	};
+	
+	/**
+	 * Note that a blackout has just ended, and start timing convergence.
+	 */
+	void endBlackout() {
+		_blackoutEndTime = TickScheduler::getTime();
+		_convergenceTime = 0;
+	};
+	
+	inline ClientState getState() const { return _state; };
+	inline unsigned int getSnapshots() const { return _snapshots; };
+	inline unsigned long long getConvergenceTime() const { return _convergenceTime; };
+	inline const std::vector<double>& getCorrections() const { return _corrections; };
+	inline unsigned long long getBytesIn() const { return _socket.getStats()->getTotalBytes(TrafficStats::DIRECTION_IN) - _bytesIn; };
+	inline unsigned long long getBytesOut() const { return _socket.getStats()->getTotalBytes(TrafficStats::DIRECTION_OUT) - _bytesOut; };
+
+private:
+	Socket _socket;								/**< Socket on the loopback network */
+	struct sockaddr_in _server;					/**< Address of the server */
+	ClientState _state;							/**< Current state */
+	SessionSettings _settings;					/**< Session settings */
+	TickScheduler _scheduler;					/**< Paces the simulation against the clock */
+	Space* _space;								/**< Copy of the room's space */
+	Body* _pushBody;							/**< Box pushed by the client */
+	unsigned int _clientId;						/**< ID given by the server */
+	unsigned int _ticks;						/**< Number of timesteps run */
+	unsigned int _snapshots;					/**< Snapshots received whilst measuring */
+	unsigned long long _bytesIn;				/**< Bytes received before measuring started */
+	unsigned long long _bytesOut;				/**< Bytes sent before measuring started */
+	double _threshold;							/**< Largest correction of a converged snapshot */
+	unsigned long long _blackoutEndTime;		/**< Time at which the blackout ended, or 0 */
+	unsigned long long _convergenceTime;		/**< Time taken to converge after the blackout, or 0 */
+	std::vector<double> _corrections;			/**< Distance each snapshot moved each body */
+	std::map<unsigned int, cpVect> _predicted;	/**< Positions of the bodies before a snapshot */
+	
+	/**
+	 * Send a message to the server.
+	 * @param type Type of the message.
+	 * @param data Message data.
+	 * @param dataLength Length of the data.
+	 */
+	void send(Message::MessageType type, const unsigned char* data, unsigned short dataLength) {
+		Message msg(type, 0, dataLength, data, &_server);
+		_socket.sendMessage(&msg);
+	};
+	
+	/**
+	 * Build the opposing boxes scene.
+	 */
+	void startup() {
+		_space = new Space(10);
+		_space->setGravity(cpv(0, 0));
+		
+		cpVect offset = cpv(_clientId * SCENE_SPACING, 0);
+		
+		Body* staticBody = new Body(INFINITY, INFINITY);
+		_space->addStaticBody(staticBody);
+		
+		addWall(staticBody, cpvadd(offset, cpv(-320, -240)), cpvadd(offset, cpv(-320, 240)));
+		addWall(staticBody, cpvadd(offset, cpv(320, -240)), cpvadd(offset, cpv(320, 240)));
+		addWall(staticBody, cpvadd(offset, cpv(-320, -240)), cpvadd(offset, cpv(320, -240)));
+		
+		cpVect verts[] = {
+			cpv(-15, -15),
+			cpv(-15, 15),
+			cpv(15, 15),
+			cpv(15, -15)
+		};
+		
+		for (int i = 0; i < BOX_COUNT; ++i) {
+			Body* body = new Body(1.0, cpMomentForPoly(1.0, 4, verts, cpvzero));
+			body->setPosition(cpvadd(offset, cpv(32, -150 + (i * 32))));
+			_space->addBody(body);
+			
+			Shape* shape = new Shape(body, 4, verts, cpvzero);
+			shape->setElasticity(0.0);
+			shape->setFriction(1.5);
+			_space->addShape(shape);
+			
+			if ((i == 0) && (_clientId % 2 == 1)) _pushBody = body;
+			if ((i == BOX_COUNT - 1) && (_clientId % 2 == 0)) _pushBody = body;
+		}
+	};
+	
+	void addWall(Body* staticBody, cpVect a, cpVect b) {
+		Shape* shape = new Shape(staticBody, a, b, 0.0f);
+		shape->setElasticity(1.0);
+		shape->setFriction(1.0);
+		_space->addStaticShape(shape);
+	};
+	
+	/**
+	 * Send the space to the server.
+	 */
+	void sendSpace() {
+		unsigned int length = _space->getSerialisedLength();
+		unsigned char* data = new unsigned char[length];
+		
+		_space->serialise(data);
+		send(Message::MESSAGE_SPACE, data, length);
+		
+		delete[] data;
+	};
+	
+	/**
+	 * Push the client's box if it is due, and send it to the server.
+	 */
+	void push() {
+		if (_clientId % 2 == 1) {
+			if (_ticks % FAST_PUSH_INTERVAL_TICKS != 0) return;
+			
+			_pushBody->applyImpulse(cpv(0, 20), cpvzero);
+		} else {
+			if (_ticks % SLOW_PUSH_INTERVAL_TICKS != 0) return;
+			
+			_pushBody->applyImpulse(cpv(0, -20), cpvzero);
+		}
+		
+		unsigned int length = _pushBody->getSerialisedLength();
+		unsigned char data[length];
+		
+		_pushBody->serialise(data);
+		send(Message::MESSAGE_BODY, data, length);
+	};
+	
+	/**
+	 * Apply a snapshot, recording how far it moves each body.
+	 * @param msg The snapshot.
+	 */
+	void handleSnapshot(const Message& msg) {
+		BodyVector* bodies = _space->getBodies();
+		
+		_predicted.clear();
+		
+		for (int i = 0; i < bodies->size(); ++i) {
+			_predicted[bodies->at(i)->getObjectId()] = bodies->at(i)->getPosition();
+		}
+		
+		_space->deserialise(msg.getData());
+		
+		if (_state != CLIENT_STATE_RUNNING) return;
+		
+		_snapshots++;
+		
+		double maxCorrection = 0;
+		
+		for (int i = 0; i < bodies->size(); ++i) {
+			std::map<unsigned int, cpVect>::const_iterator predicted = _predicted.find(bodies->at(i)->getObjectId());
+			
+			// Bodies seen for the first time have nothing to correct
+			if (predicted == _predicted.end()) continue;
+			
+			double correction = cpvlength(cpvsub(predicted->second, bodies->at(i)->getPosition()));
+			
+			_corrections.push_back(correction);
+			
+			if (correction > maxCorrection) maxCorrection = correction;
+		}
+		
+		if ((_blackoutEndTime != 0) && (_convergenceTime == 0) && (maxCorrection <= _threshold)) {
+			_convergenceTime = TickScheduler::getTime() - _blackoutEndTime;
+		}
+	};
+};
+
+/**
+ * Run the clients and the server, then advance the clock by one step.
+ * @param server The server.
+ * @param clients The clients.
+ */
+static void runStep(Server* server, std::vector<BenchClient*>& clients) {
+	for (unsigned int i = 0; i < clients.size(); ++i) {
+		clients[i]->update();
+	}
+	
+	// Service everything that has arrived at the server
+	while (server->update()) { }
+	
+	virtualTime += VIRTUAL_STEP_NS;
+}
+
+/**
+ * Get a percentile of a sorted list of values.
+ * @param values The sorted values.
+ * @param percent The percentile.
+ * @return The value at the percentile.
+ */
+static double getPercentile(const std::vector<double>& values, int percent) {
+	if (values.empty()) return 0;
+	
+	return values[(values.size() - 1) * percent / 100];
+}
+
+static void printUsage(const char* name) {
+	printf("Usage: %s [-c clients] [-k clientsperroom] [-d seconds] [-t rate] [-u substeps] [-n sendrate] [-s seed] [-l latency] [-j jitter] [-L loss%%] [-r reorder%%] [-D duplicate%%] [-b bandwidth] [-q queuems] [-B blackoutms] [-e threshold]\n", name);
+}
+
+int main(int argc, char* const argv[]) {
+
+	int clientCount = DEFAULT_CLIENT_COUNT;
+	int clientsPerRoom = DEFAULT_CLIENTS_PER_ROOM;
+	int duration = DEFAULT_DURATION_SECONDS;
+	int physicsRate = SESSION_DEFAULT_PHYSICS_RATE;
+	int substeps = SESSION_DEFAULT_SUBSTEPS;
+	int sendRate = DEFAULT_SEND_RATE;
+	unsigned int seed = DEFAULT_SEED;
+	int blackoutMs = 0;
+	double threshold = DEFAULT_CONVERGENCE_THRESHOLD;
+	LinkSettings link;
+	
+	Log::setLevel(LOG_LEVEL_WARNING);
+	
+	for (int i = 1; i < argc; ++i) {
+		if ((strncmp(argv[i], "-c", 2) == 0) && (i + 1 < argc)) {
+			clientCount = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-k", 2) == 0) && (i + 1 < argc)) {
+			clientsPerRoom = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-d", 2) == 0) && (i + 1 < argc)) {
+			duration = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-t", 2) == 0) && (i + 1 < argc)) {
+			physicsRate = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-u", 2) == 0) && (i + 1 < argc)) {
+			substeps = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-n", 2) == 0) && (i + 1 < argc)) {
+			sendRate = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-s", 2) == 0) && (i + 1 < argc)) {
+			seed = strtoul(argv[++i], NULL, 10);
+		} else if ((strncmp(argv[i], "-l", 2) == 0) && (i + 1 < argc)) {
+			link.latencyMs = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-j", 2) == 0) && (i + 1 < argc)) {
+			link.jitterMs = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-L", 2) == 0) && (i + 1 < argc)) {
+			link.lossRate = atof(argv[++i]) / 100.0;
+		} else if ((strncmp(argv[i], "-r", 2) == 0) && (i + 1 < argc)) {
+			link.reorderRate = atof(argv[++i]) / 100.0;
+		} else if ((strncmp(argv[i], "-D", 2) == 0) && (i + 1 < argc)) {
+			link.duplicateRate = atof(argv[++i]) / 100.0;
+		} else if ((strncmp(argv[i], "-b", 2) == 0) && (i + 1 < argc)) {
+			link.bandwidth = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-q", 2) == 0) && (i + 1 < argc)) {
+			link.queueMs = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-B", 2) == 0) && (i + 1 < argc)) {
+			blackoutMs = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-e", 2) == 0) && (i + 1 < argc)) {
+			threshold = atof(argv[++i]);
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	
+	if ((clientCount < 1) || (clientsPerRoom < 1) || (duration < 1) || (physicsRate < 1) || (substeps < 1) || (sendRate < 0) || (blackoutMs < 0) || (blackoutMs >= duration * 500)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	
+	// Held back datagrams must be able to fall behind those sent after them,
+	// whatever order the options were given in
+	if (link.reorderRate > 0) link.reorderDelayMs = link.latencyMs + link.jitterMs + 1;
+	
+	// The clock must be replaced before anything reads it
+	TickScheduler::setClock(getVirtualTime);
+	
+	LoopbackNetwork network(seed);
+	
+	SessionSettings settings(physicsRate, substeps, sendRate);
+	
+	Server* server = new Server(clientsPerRoom, SERVER_PORT, 0, DEFAULT_MAX_ROOMS, settings);
+	server->setNetwork(&network);
+	
+	if (!server->start()) return 1;
+	
+	std::vector<BenchClient*> clients;
+	
+	for (int i = 0; i < clientCount; ++i) {
+		clients.push_back(new BenchClient(&network, settings, threshold));
+	}
+	
+	// Connect every client before the link's conditions apply
+	unsigned long long setupEnd = virtualTime + SETUP_TIMEOUT_SECONDS * 1000000000ULL;
+	bool isSetUp = false;
+	
+	while ((!isSetUp) && (virtualTime < setupEnd)) {
+		runStep(server, clients);
+		
+		isSetUp = true;
+		
+		for (unsigned int i = 0; i < clients.size(); ++i) {
+			if ((clients[i]->getState() != BenchClient::CLIENT_STATE_RUNNING) && (clients[i]->getState() != BenchClient::CLIENT_STATE_REJECTED)) isSetUp = false;
+		}
+	}
+	
+	for (unsigned int i = 0; i < clients.size(); ++i) {
+		clients[i]->startMeasuring();
+	}
+	
+	network.setLinkSettings(link);
+	network.resetStats();
+	
+	unsigned long long start = virtualTime;
+	unsigned long long end = start + duration * 1000000000ULL;
+	unsigned long long blackoutStart = start + (end - start) / 2 - blackoutMs * 500000ULL;
+	unsigned long long blackoutEnd = blackoutStart + blackoutMs * 1000000ULL;
+	bool isBlackout = false;
+	
+	printf("Running %d clients in rooms of %d for %ds (seed %u)\n", clientCount, clientsPerRoom, duration, seed);
+	printf("Link: latency %ums, jitter %ums, loss %.1f%%, reorder %.1f%%, duplicate %.1f%%, bandwidth %u B/s, queue %ums\n",
+		link.latencyMs,
+		link.jitterMs,
+		link.lossRate * 100.0,
+		link.reorderRate * 100.0,
+		link.duplicateRate * 100.0,
+		link.bandwidth,
+		link.queueMs);
+	
+	if (blackoutMs > 0) printf("Blackout: %dms at %.1fs\n", blackoutMs, (blackoutStart - start) / 1000000000.0);
+	
+	while (virtualTime < end) {
+		
+		// Black out every link by losing everything sent over it
+		if ((blackoutMs > 0) && (!isBlackout) && (virtualTime >= blackoutStart) && (virtualTime < blackoutEnd)) {
+			LinkSettings blackout = link;
+			blackout.lossRate = 1.0;
+			network.setLinkSettings(blackout);
+			isBlackout = true;
+		} else if (isBlackout && (virtualTime >= blackoutEnd)) {
+			network.setLinkSettings(link);
+			isBlackout = false;
+			
+			for (unsigned int i = 0; i < clients.size(); ++i) {
+				clients[i]->endBlackout();
+			}
+		}
+		
+		runStep(server, clients);
+	}
+	
+	LinkStats linkStats = network.getStats();
+	
+	delete server;
+	
+	// Messages too large for a datagram never arrive, so the clients would
+	// be measuring a broken session
+	if (linkStats.oversized > 0) {
+		printf("\n%lu datagrams were larger than the %d byte limit and were not sent.\n", linkStats.oversized, LOOPBACK_MAX_DATAGRAM);
+		printf("Snapshots do not fit in a datagram with %d clients per room, so nothing was measured.\n", clientsPerRoom);
+		
+		for (unsigned int i = 0; i < clients.size(); ++i) {
+			delete clients[i];
+		}
+		
+		return 1;
+	}
+	
+	// Gather the results
+	std::vector<double> corrections;
+	std::vector<double> convergenceTimes;
+	unsigned int running = 0;
+	unsigned int unconverged = 0;
+	unsigned long long snapshots = 0;
+	unsigned long long bytesIn = 0;
+	unsigned long long bytesOut = 0;
+	
+	for (unsigned int i = 0; i < clients.size(); ++i) {
+		BenchClient* client = clients[i];
+		
+		bytesIn += client->getBytesIn();
+		bytesOut += client->getBytesOut();
+		
+		if (client->getState() != BenchClient::CLIENT_STATE_RUNNING) continue;
+		
+		running++;
+		snapshots += client->getSnapshots();
+		corrections.insert(corrections.end(), client->getCorrections().begin(), client->getCorrections().end());
+		
+		if (client->getConvergenceTime() > 0) {
+			convergenceTimes.push_back(client->getConvergenceTime() / 1000000.0);
+		} else {
+			unconverged++;
+		}
+	}
+	
+	std::sort(corrections.begin(), corrections.end());
+	std::sort(convergenceTimes.begin(), convergenceTimes.end());
+	
+	double correctionTotal = 0;
+	
+	for (unsigned int i = 0; i < corrections.size(); ++i) {
+		correctionTotal += corrections[i];
+	}
+	
+	printf("\nClients:         %u of %d running\n", running, clientCount);
+	
+	printf("Traffic/client:  in %.0f B/s, out %.0f B/s\n",
+		bytesIn / (double)clientCount / duration,
+		bytesOut / (double)clientCount / duration);
+	
+	printf("Snapshot rate:   %.2f/s per running client\n",
+		running > 0 ? snapshots / (double)running / duration : 0.0);
+	
+	printf("Drift:           mean %.3f, p50 %.3f, p99 %.3f, max %.3f (%lu corrections)\n",
+		corrections.empty() ? 0.0 : correctionTotal / corrections.size(),
+		getPercentile(corrections, 50),
+		getPercentile(corrections, 99),
+		getPercentile(corrections, 100),
+		(unsigned long)corrections.size());
+	
+	if (blackoutMs > 0) {
+		printf("Convergence:     p50 %.1fms, max %.1fms, %u of %u never converged (threshold %.2f)\n",
+			getPercentile(convergenceTimes, 50),
+			getPercentile(convergenceTimes, 100),
+			unconverged,
+			running,
+			threshold);
+	}
+	
+	printf("Link:            %lu sent, %lu delivered, %lu lost, %lu dropped, %lu reordered, %lu duplicated\n",
+		linkStats.sent,
+		linkStats.delivered,
+		linkStats.lost,
+		linkStats.dropped,
+		linkStats.reordered,
+		linkStats.duplicated);
+	
+	for (unsigned int i = 0; i < clients.size(); ++i) {
+		delete clients[i];
+	}
+	
+	return 0;
+}
@@ -0,0 +1,270 @@
+/**
+ * Compares two position sample files written by PositionSampler, typically
+ * one from the server and one from a client, and reports how far each body
+ * has drifted between them.  Samples are matched by object ID and tick.
+ *
+ * The two simulations do not start on the same tick, as a client only starts
+ * stepping once the server has told it to, so the tick offset between the
+ * files can either be given explicitly or found automatically by trying
+ * every offset within a window and choosing the one with the smallest mean
+ * position drift.
+ *
+ * Build from this directory with:
+ *   g++ -o sampleranalyser -I../src/simulation -I../src/chipmunk sampleranalyser.cpp ../src/simulation/serialisebase.cpp
+ *
+ * Usage:
+ *   sampleranalyser [-o offset | -a window] reference.wdms other.wdms
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <vector>
+#include "serialisebase.h"
+
+// Must match positionsampler.h
+#define SAMPLER_HEADER "WDMS"
+#define SAMPLER_HEADER_LENGTH 4
+#define SAMPLER_FILE_HEADER_LENGTH 13
+#define SAMPLER_RECORD_LENGTH 32
+
+#define DEFAULT_WINDOW 0
+
+using namespace WiredMunk;
+
+/**
+ * State of a body at a single tick.
+ */
+struct BodyState {
+	double x;
+	double y;
+	double angle;
+};
+
+typedef std::map<unsigned int, BodyState> Trace;
+typedef std::map<unsigned int, Trace> TraceSet;
+
+/**
+ * Contents of a sample file.
+ */
+struct SampleFile {
+	const char* fileName;
+	unsigned int source;
+	unsigned int sourceId;
+	unsigned int physicsRate;
+	unsigned int sampleCount;
+	TraceSet bodies;
+};
+
+/**
+ * Drift statistics for one body.
+ */
+struct Drift {
+	unsigned int samples;
+	double totalPosition;
+	double maxPosition;
+	double finalPosition;
+	double totalAngle;
+	double maxAngle;
+	double finalAngle;
+};
+
+static bool load(const char* fileName, SampleFile* file) {
+
+	FILE* input = fopen(fileName, "rb");
+	if (input == NULL) {
+		perror(fileName);
+		return false;
+	}
+	
+	unsigned char header[SAMPLER_FILE_HEADER_LENGTH];
+	if ((fread(header, 1, SAMPLER_FILE_HEADER_LENGTH, input) != SAMPLER_FILE_HEADER_LENGTH) ||
+		(strncmp(SAMPLER_HEADER, (const char*)header, SAMPLER_HEADER_LENGTH) != 0)) {
+		
+		printf("Not a valid sample file: %s\n", fileName);
+		fclose(input);
+		return false;
+	}
+	
+	file->fileName = fileName;
+	file->source = header[6];
+	file->sourceId = SerialiseBase::deserialiseInt(header + 7);
+	file->physicsRate = SerialiseBase::deserialiseShort(header + 11);
+	file->sampleCount = 0;
+	
+	unsigned char record[SAMPLER_RECORD_LENGTH];
+	while (fread(record, 1, SAMPLER_RECORD_LENGTH, input) == SAMPLER_RECORD_LENGTH) {
+		unsigned int tick = SerialiseBase::deserialiseInt(record);
+		unsigned int objectId = SerialiseBase::deserialiseInt(record + 4);
+		
+		BodyState& state = file->bodies[objectId][tick];
+		state.x = SerialiseBase::deserialiseDouble(record + 8);
+		state.y = SerialiseBase::deserialiseDouble(record + 16);
+		state.angle = SerialiseBase::deserialiseDouble(record + 24);
+		
+		file->sampleCount++;
+	}
+	
+	fclose(input);
+	
+	return true;
+}
+
+static void compare(const SampleFile& reference, const SampleFile& other, int offset, std::map<unsigned int, Drift>* drifts) {
+
+	drifts->clear();
+	
+	for (TraceSet::const_iterator body = other.bodies.begin(); body != other.bodies.end(); ++body) {
+		TraceSet::const_iterator referenceBody = reference.bodies.find(body->first);
+		if (referenceBody == reference.bodies.end()) continue;
+		
+		Drift drift;
+		memset(&drift, 0, sizeof(drift));
+		
+		for (Trace::const_iterator sample = body->second.begin(); sample != body->second.end(); ++sample) {
+			Trace::const_iterator match = referenceBody->second.find(sample->first + offset);
+			if (match == referenceBody->second.end()) continue;
+			
+			double dx = sample->second.x - match->second.x;
+			double dy = sample->second.y - match->second.y;
+			double position = sqrt((dx * dx) + (dy * dy));
+			double angle = fabs(sample->second.angle - match->second.angle);
+			
+			drift.samples++;
+			drift.totalPosition += position;
+			drift.totalAngle += angle;
+			drift.finalPosition = position;
+			drift.finalAngle = angle;
+			if (position > drift.maxPosition) drift.maxPosition = position;
+			if (angle > drift.maxAngle) drift.maxAngle = angle;
+		}
+		
+		if (drift.samples > 0) (*drifts)[body->first] = drift;
+	}
+}
+
+static bool getMeanPositionDrift(const std::map<unsigned int, Drift>& drifts, double* mean) {
+	unsigned int samples = 0;
+	double total = 0;
+	
+	for (std::map<unsigned int, Drift>::const_iterator i = drifts.begin(); i != drifts.end(); ++i) {
+		samples += i->second.samples;
+		total += i->second.totalPosition;
+	}
+	
+	if (samples == 0) return false;
+	
+	*mean = total / samples;
+	return true;
+}
+
+static void printFile(const SampleFile& file) {
+	printf("%s: %s %u, %uHz, %lu bodies, %u samples\n",
+		file.fileName,
+		file.source == 0 ? "server room" : "client",
+		file.sourceId,
+		file.physicsRate,
+		(unsigned long)file.bodies.size(),
+		file.sampleCount);
+}
+
+int main(int argc, char* const argv[]) {
+
+	int offset = 0;
+	int window = DEFAULT_WINDOW;
+	const char* fileNames[2];
+	int fileCount = 0;
+	
+	for (int i = 1; i < argc; ++i) {
+		if ((strncmp(argv[i], "-o", 2) == 0) && (i + 1 < argc)) {
+			offset = atoi(argv[++i]);
+		} else if ((strncmp(argv[i], "-a", 2) == 0) && (i + 1 < argc)) {
+			window = atoi(argv[++i]);
+		} else if ((argv[i][0] != '-') && (fileCount < 2)) {
+			fileNames[fileCount++] = argv[i];
+		} else {
+			fileCount = 0;
+			break;
+		}
+	}
+	
+	if (fileCount != 2) {
+		printf("Usage: %s [-o offset | -a window] reference.wdms other.wdms\n", argv[0]);
+		return 1;
+	}
+	
+	SampleFile reference;
+	SampleFile other;
+	
+	if (!load(fileNames[0], &reference)) return 1;
+	if (!load(fileNames[1], &other)) return 1;
+	
+	printFile(reference);
+	printFile(other);
+	
+	std::map<unsigned int, Drift> drifts;
+	
+	// Search the window for the offset that best aligns the traces
+	if (window > 0) {
+		double bestMean = 0;
+		bool found = false;
+		
+		for (int candidate = -window; candidate <= window; ++candidate) {
+			double mean;
+			
+			compare(reference, other, candidate, &drifts);
+			
+			if (!getMeanPositionDrift(drifts, &mean)) continue;
+			
+			if ((!found) || (mean < bestMean)) {
+				bestMean = mean;
+				offset = candidate;
+				found = true;
+			}
+		}
+	}
+	
+	compare(reference, other, offset, &drifts);
+	
+	if (drifts.empty()) {
+		printf("No samples could be matched at offset %d\n", offset);
+		return 1;
+	}
+	
+	printf("Tick offset: %d\n\n", offset);
+	printf("Body        Samples   Mean pos    Max pos     Final pos   Mean angle  Max angle   Final angle\n");
+	
+	Drift total;
+	memset(&total, 0, sizeof(total));
+	
+	for (std::map<unsigned int, Drift>::const_iterator i = drifts.begin(); i != drifts.end(); ++i) {
+		const Drift& drift = i->second;
+		
+		printf("%-11u %-9u %-11f %-11f %-11f %-11f %-11f %f\n",
+			i->first,
+			drift.samples,
+			drift.totalPosition / drift.samples,
+			drift.maxPosition,
+			drift.finalPosition,
+			drift.totalAngle / drift.samples,
+			drift.maxAngle,
+			drift.finalAngle);
+		
+		total.samples += drift.samples;
+		total.totalPosition += drift.totalPosition;
+		total.totalAngle += drift.totalAngle;
+		if (drift.maxPosition > total.maxPosition) total.maxPosition = drift.maxPosition;
+		if (drift.maxAngle > total.maxAngle) total.maxAngle = drift.maxAngle;
+	}
+	
+	printf("\nAll         %-9u %-11f %-11f             %-11f %f\n",
+		total.samples,
+		total.totalPosition / total.samples,
+		total.maxPosition,
+		total.totalAngle / total.samples,
+		total.maxAngle);
+	
+	return 0;
+}
@@ -0,0 +1,507 @@
+/**
+ * Serialisation microbenchmark.  Measures how quickly each SerialiseBase
+ * primitive, bodies, every shape type and whole spaces are encoded and
+ * decoded, in objects and bytes per second, along with the number of bytes
+ * each object produces.  Encoding happens every tick for every object sent,
+ * so run this before and after any change to the serialisation code.
+ *
+ * Objects are decoded in place into existing objects, as happens when a
+ * snapshot arrives for objects that are already known.  Spaces are decoded
+ * into a mirror of the encoded space, and each of their objects is a body
+ * with a single box or circle shape.
+ *
+ * Built by the chipmunk CMake project as "serialisebench":
+ *   cmake -S ../src/chipmunk -B build && cmake --build build
+ *
+ * Usage:
+ *   serialisebench [-t milliseconds] [group ...]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include "chipmunk.h"
+#include "serialisebase.h"
+#include "space.h"
+#include "body.h"
+#include "shape.h"
+#include "tickscheduler.h"
+
+#define DEFAULT_MIN_TIME_MS 200
+#define PRIMITIVE_BATCH 4096
+#define OBJECT_BATCH 1024
+
+using namespace WiredMunk;
+
+/**
+ * Set when a decoded value is used, so that the compiler cannot discard the
+ * decoding.
+ */
+static volatile double decodeSink = 0;
+
+/**
+ * A set of objects that can be encoded into and decoded from a buffer.
+ */
+class BenchCase {
+public:
+
+	/**
+	 * Constructor.
+	 * @param name Name of the case.
+	 * @param objectCount Number of objects encoded by each call to encode().
+	 */
+	BenchCase(const char* name, unsigned int objectCount) {
+		_name = name;
+		_objectCount = objectCount;
+	};
+	
+	virtual ~BenchCase() { };
+	
+	inline const char* getName() const { return _name; };
+	inline unsigned int getObjectCount() const { return _objectCount; };
+	
+	/**
+	 * Get the size of buffer needed to encode the objects.
+	 * @return The buffer size in bytes.
+	 */
+	virtual unsigned int getBufferSize() = 0;
+	
+	/**
+	 * Encode every object into the buffer.
+	 * @param buffer The buffer to encode into.
+	 * @return The number of bytes encoded.
+	 */
+	virtual unsigned int encode(unsigned char* buffer) = 0;
+	
+	/**
+	 * Decode every object from the buffer.
+	 * @param data The data written by encode().
+	 */
+	virtual void decode(const unsigned char* data) = 0;
+
+private:
+	const char* _name;
+	unsigned int _objectCount;
+};
+
+static inline void decodeValue(const unsigned char* data, unsigned short* value) { *value = SerialiseBase::deserialiseShort(data); }
+static inline void decodeValue(const unsigned char* data, unsigned int* value) { *value = SerialiseBase::deserialiseInt(data); }
+static inline void decodeValue(const unsigned char* data, bool* value) { *value = SerialiseBase::deserialiseBool(data); }
+static inline void decodeValue(const unsigned char* data, float* value) { *value = SerialiseBase::deserialiseFloat(data); }
+static inline void decodeValue(const unsigned char* data, double* value) { *value = SerialiseBase::deserialiseDouble(data); }
+static inline void decodeValue(const unsigned char* data, cpVect* value) { *value = SerialiseBase::deserialiseVector(data); }
+
+static inline void makeValue(unsigned int i, unsigned short* value) { *value = (unsigned short)(i * 7919); }
+static inline void makeValue(unsigned int i, unsigned int* value) { *value = i * 2654435761u; }
+static inline void makeValue(unsigned int i, bool* value) { *value = (i % 3 == 0); }
+static inline void makeValue(unsigned int i, float* value) { *value = (float)((i - 2048.0) * 0.37); }
+static inline void makeValue(unsigned int i, double* value) { *value = (i - 2048.0) * 0.37; }
+static inline void makeValue(unsigned int i, cpVect* value) { *value = cpv((i - 2048.0) * 0.37, i * 1.91); }
+
+static inline double sinkValue(unsigned short value) { return value; }
+static inline double sinkValue(unsigned int value) { return value; }
+static inline double sinkValue(bool value) { return value; }
+static inline double sinkValue(float value) { return value; }
+static inline double sinkValue(double value) { return value; }
+static inline double sinkValue(const cpVect& value) { return value.x + value.y; }
+
+/**
+ * A batch of primitive values, encoded one after another.
+ */
+template <typename T>
+class PrimitiveCase : public BenchCase {
+public:
+	PrimitiveCase(const char* name, unsigned int size) : BenchCase(name, PRIMITIVE_BATCH) {
+		_size = size;
+		
+		for (unsigned int i = 0; i < PRIMITIVE_BATCH; ++i) {
+			makeValue(i, &_values[i]);
+		}
+	};
+	
+	virtual unsigned int getBufferSize() {
+		return _size * PRIMITIVE_BATCH;
+	};
+	
+	virtual unsigned int encode(unsigned char* buffer) {
+		unsigned char* start = buffer;
+		
+		for (unsigned int i = 0; i < PRIMITIVE_BATCH; ++i) {
+			buffer += SerialiseBase::serialise(_values[i], buffer);
+		}
+		
+		return buffer - start;
+	};
+	
+	virtual void decode(const unsigned char* data) {
+		double sum = 0;
+		T value;
+		
+		for (unsigned int i = 0; i < PRIMITIVE_BATCH; ++i) {
+			decodeValue(data, &value);
+			sum += sinkValue(value);
+			data += _size;
+		}
+		
+		decodeSink = sum;
+	};
+
+private:
+	unsigned int _size;
+	T _values[PRIMITIVE_BATCH];
+};
+
+/**
+ * A batch of moving bodies.
+ */
+class BodyCase : public BenchCase {
+public:
+	BodyCase() : BenchCase("body", OBJECT_BATCH) {
+		for (unsigned int i = 0; i < OBJECT_BATCH; ++i) {
+			Body* body = new Body(1.0 + i % 5, 100.0 + i);
+			body->setPosition(cpv(i * 3.1, i * -1.7));
+			body->setVelocity(cpv(i * 0.5, 20.0 - i * 0.25));
+			body->setAngle(i * 0.01);
+			body->setAngularVelocity(i * 0.02);
+			_bodies.push_back(body);
+		}
+	};
+	
+	~BodyCase() {
+		for (unsigned int i = 0; i < _bodies.size(); ++i) {
+			delete _bodies[i];
+		}
+	};
+	
+	virtual unsigned int getBufferSize() {
+		return _bodies[0]->getSerialisedLength() * OBJECT_BATCH;
+	};
+	
+	virtual unsigned int encode(unsigned char* buffer) {
+		unsigned char* start = buffer;
+		
+		for (unsigned int i = 0; i < _bodies.size(); ++i) {
+			buffer += _bodies[i]->serialise(buffer);
+		}
+		
+		return buffer - start;
+	};
+	
+	virtual void decode(const unsigned char* data) {
+		for (unsigned int i = 0; i < _bodies.size(); ++i) {
+			data += _bodies[i]->deserialise(data);
+		}
+		
+		decodeSink = _bodies[0]->getPosition().x;
+	};
+
+private:
+	std::vector<Body*> _bodies;
+};
+
+/**
+ * A batch of shapes of one type, each attached to its own body.
+ */
+class ShapeCase : public BenchCase {
+public:
+
+	/**
+	 * Constructor.
+	 * @param name Name of the case.
+	 * @param type Type of shape to create.
+	 * @param numVerts Number of vertices in each polygon.
+	 */
+	ShapeCase(const char* name, cpShapeType type, int numVerts) : BenchCase(name, OBJECT_BATCH) {
+		_space = new Space();
+		
+		cpVect verts[numVerts > 0 ? numVerts : 1];
+		
+		// Regular polygon with its vertices in clockwise order
+		for (int i = 0; i < numVerts; ++i) {
+			cpFloat angle = -2.0 * M_PI * i / numVerts;
+			verts[i] = cpv(cos(angle) * 10.0, sin(angle) * 10.0);
+		}
+		
+		for (unsigned int i = 0; i < OBJECT_BATCH; ++i) {
+			Body* body = new Body(1.0, 1.0);
+			body->setPosition(cpv(i * 25.0, 0));
+			_space->addBody(body);
+			
+			Shape* shape = NULL;
+			
+			switch (type) {
+				case CP_CIRCLE_SHAPE:
+					shape = new Shape(body, 10.0, cpvzero);
+					break;
+				case CP_SEGMENT_SHAPE:
+					shape = new Shape(body, cpv(-10, 0), cpv(10, 0), 1.0);
+					break;
+				default:
+					shape = new Shape(body, numVerts, verts, cpvzero);
+					break;
+			}
+			
+			shape->setFriction(0.8);
+			_space->addShape(shape);
+			_shapes.push_back(shape);
+		}
+		
+		// Calculate the transformed data that is serialised with each shape
+		_space->step(1.0 / 60.0);
+	};
+	
+	~ShapeCase() {
+		delete _space;
+	};
+	
+	virtual unsigned int getBufferSize() {
+		return _shapes[0]->getSerialisedLength() * OBJECT_BATCH;
+	};
+	
+	virtual unsigned int encode(unsigned char* buffer) {
+		unsigned char* start = buffer;
+		
+		for (unsigned int i = 0; i < _shapes.size(); ++i) {
+			buffer += _shapes[i]->serialise(buffer);
+		}
+		
+		return buffer - start;
+	};
+	
+	virtual void decode(const unsigned char* data) {
+		for (unsigned int i = 0; i < _shapes.size(); ++i) {
+			data += _shapes[i]->deserialise(_space, data);
+		}
+		
+		decodeSink = _shapes[0]->getFriction();
+	};
+
+private:
+	Space* _space;
+	std::vector<Shape*> _shapes;
+};
+
+/**
+ * A whole space, decoded into a mirror of itself.
+ */
+class SpaceCase : public BenchCase {
+public:
+	SpaceCase(const char* name, unsigned int objectCount) : BenchCase(name, objectCount) {
+		_space = new Space(10);
+		_space->setGravity(cpv(0, -100));
+		_space->resizeActiveHash(30.0, objectCount * 2);
+		
+		Body* staticBody = new Body(INFINITY, INFINITY);
+		_space->addStaticBody(staticBody);
+		
+		Shape* ground = new Shape(staticBody, cpv(-10000, 0), cpv(10000, 0), 0.0);
+		_space->addStaticShape(ground);
+		
+		cpVect verts[] = {
+			cpv(-10, -10),
+			cpv(-10, 10),
+			cpv(10, 10),
+			cpv(10, -10)
+		};
+		
+		int columns = (int)sqrt((double)objectCount) + 1;
+		
+		for (unsigned int i = 0; i < objectCount; ++i) {
+			Body* body = new Body(1.0, cpMomentForPoly(1.0, 4, verts, cpvzero));
+			body->setPosition(cpv((i % columns) * 25.0, 20.0 + (i / columns) * 25.0));
+			_space->addBody(body);
+			
+			// Alternate boxes and circles
+			if (i % 2 == 0) {
+				_space->addShape(new Shape(body, 4, verts, cpvzero));
+			} else {
+				_space->addShape(new Shape(body, 10.0, cpvzero));
+			}
+		}
+		
+		_space->step(1.0 / 60.0);
+		
+		// Build the mirror from the space's own data
+		unsigned char* buffer = new unsigned char[getBufferSize()];
+		_space->serialise(buffer);
+		_mirror = new Space(buffer);
+		delete[] buffer;
+	};
+	
+	~SpaceCase() {
+		delete _space;
+		delete _mirror;
+	};
+	
+	virtual unsigned int getBufferSize() {
+		return _space->getSerialisedLength();
+	};
+	
+	virtual unsigned int encode(unsigned char* buffer) {
+		return _space->serialise(buffer);
+	};
+	
+	virtual void decode(const unsigned char* data) {
+		_mirror->deserialise(data);
+		
+		decodeSink = _mirror->getBodies()->at(0)->getPosition().x;
+	};
+
+private:
+	Space* _space;
+	Space* _mirror;
+};
+
+/**
+ * A named group of cases that can be selected from the command line.
+ */
+struct CaseGroup {
+	const char* name;
+	void (*create)(std::vector<BenchCase*>* cases);
+};
+
+static void createPrimitiveCases(std::vector<BenchCase*>* cases) {
+	cases->push_back(new PrimitiveCase<unsigned short>("short", SERIALISED_SHORT_SIZE));
+	cases->push_back(new PrimitiveCase<unsigned int>("int", SERIALISED_INT_SIZE));
+	cases->push_back(new PrimitiveCase<bool>("bool", SERIALISED_BOOL_SIZE));
+	cases->push_back(new PrimitiveCase<float>("float", SERIALISED_FLOAT_SIZE));
+	cases->push_back(new PrimitiveCase<double>("double", SERIALISED_DOUBLE_SIZE));
+	cases->push_back(new PrimitiveCase<cpVect>("vector", SERIALISED_VECTOR_SIZE));
+}
+
+static void createBodyCases(std::vector<BenchCase*>* cases) {
+	cases->push_back(new BodyCase());
+}
+
+static void createShapeCases(std::vector<BenchCase*>* cases) {
+	cases->push_back(new ShapeCase("circle", CP_CIRCLE_SHAPE, 0));
+	cases->push_back(new ShapeCase("segment", CP_SEGMENT_SHAPE, 0));
+	cases->push_back(new ShapeCase("poly4", CP_POLY_SHAPE, 4));
+	cases->push_back(new ShapeCase("poly16", CP_POLY_SHAPE, 16));
+	cases->push_back(new ShapeCase("poly64", CP_POLY_SHAPE, 64));
+}
+
+static void createSpaceCases(std::vector<BenchCase*>* cases) {
+	cases->push_back(new SpaceCase("space100", 100));
+	cases->push_back(new SpaceCase("space1k", 1000));
+	cases->push_back(new SpaceCase("space10k", 10000));
+}
+
+static const CaseGroup caseGroups[] = {
+	{ "primitives", createPrimitiveCases },
+	{ "body", createBodyCases },
+	{ "shapes", createShapeCases },
+	{ "space", createSpaceCases }
+};
+
+static const int caseGroupCount = sizeof(caseGroups) / sizeof(caseGroups[0]);
+
+static void runCase(BenchCase* benchCase, unsigned long long minTime) {
+	unsigned char* buffer = new unsigned char[benchCase->getBufferSize()];
+	unsigned int bytes = benchCase->encode(buffer);
+	
+	// Repeat each operation until it has run for long enough to time
+	unsigned long long iterations = 0;
+	unsigned long long start = TickScheduler::getTime();
+	unsigned long long encodeTime = 0;
+	
+	do {
+		benchCase->encode(buffer);
+		iterations++;
+		encodeTime = TickScheduler::getTime() - start;
+	} while (encodeTime < minTime);
+	
+	double encodeSeconds = encodeTime / 1000000000.0 / iterations;
+	
+	iterations = 0;
+	start = TickScheduler::getTime();
+	unsigned long long decodeTime = 0;
+	
+	do {
+		benchCase->decode(buffer);
+		iterations++;
+		decodeTime = TickScheduler::getTime() - start;
+	} while (decodeTime < minTime);
+	
+	double decodeSeconds = decodeTime / 1000000000.0 / iterations;
+	
+	printf("%-11s %-9.1f %-13.0f %-11.1f %-13.0f %.1f\n",
+		benchCase->getName(),
+		(double)bytes / benchCase->getObjectCount(),
+		benchCase->getObjectCount() / encodeSeconds,
+		bytes / encodeSeconds / 1000000.0,
+		benchCase->getObjectCount() / decodeSeconds,
+		bytes / decodeSeconds / 1000000.0);
+	
+	delete[] buffer;
+}
+
+static void printUsage(const char* name) {
+	printf("Usage: %s [-t milliseconds] [group ...]\n", name);
+	printf("Groups:");
+	
+	for (int i = 0; i < caseGroupCount; ++i) {
+		printf(" %s", caseGroups[i].name);
+	}
+	
+	printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+
+	int minTimeMs = DEFAULT_MIN_TIME_MS;
+	std::vector<const CaseGroup*> selected;
+	
+	for (int i = 1; i < argc; ++i) {
+		if ((strncmp(argv[i], "-t", 2) == 0) && (i + 1 < argc)) {
+			minTimeMs = atoi(argv[++i]);
+		} else if (argv[i][0] != '-') {
+			const CaseGroup* group = NULL;
+			
+			for (int j = 0; j < caseGroupCount; ++j) {
+				if (strcmp(argv[i], caseGroups[j].name) == 0) group = &caseGroups[j];
+			}
+			
+			if (group == NULL) {
+				printf("Unknown group: %s\n", argv[i]);
+				printUsage(argv[0]);
+				return 1;
+			}
+			
+			selected.push_back(group);
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	
+	if (minTimeMs < 1) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	
+	if (selected.empty()) {
+		for (int i = 0; i < caseGroupCount; ++i) {
+			selected.push_back(&caseGroups[i]);
+		}
+	}
+	
+	cpInitChipmunk();
+	
+	printf("Minimum time per operation: %dms\n\n", minTimeMs);
+	printf("Case        Bytes/obj Encode obj/s  Encode MB/s Decode obj/s  Decode MB/s\n");
+	
+	for (unsigned int i = 0; i < selected.size(); ++i) {
+		std::vector<BenchCase*> cases;
+		selected[i]->create(&cases);
+		
+		for (unsigned int j = 0; j < cases.size(); ++j) {
+			runCase(cases[j], minTimeMs * 1000000ULL);
+			delete cases[j];
+		}
+	}
+	
+	return 0;
+}